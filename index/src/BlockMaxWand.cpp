@@ -0,0 +1,226 @@
+#include "BlockMaxWand.h"
+
+#include "PostingBlock.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace mithril {
+
+BlockMaxWand::BlockMaxWand(std::vector<List> lists,
+                           const DocumentMapReader& documents,
+                           double avg_body_length,
+                           IndexStreamReader* filter)
+    : documents_(documents), avg_body_length_(avg_body_length), filter_(filter) {
+    cursors_.reserve(lists.size());
+    for (auto& list : lists) {
+        if (list.reader == nullptr || !list.reader->hasNext()) {
+            continue;
+        }
+        const float max_score = list.bm25 ? static_cast<float>(list.weight * bm25(list.idf, list.reader->maxImpact()))
+                                          : presence(list, std::numeric_limits<uint8_t>::max());
+        auto& cursors = list.follower ? followers_ : cursors_;
+        cursors.push_back({std::move(list), max_score, 0});
+    }
+}
+
+double BlockMaxWand::bm25(double idf, double impact) {
+    // Same saturation and cap as ranking::BM25::ScoreTermForDoc, clamped at 0 so terms in more than half of the
+    // documents (negative idf) neither add to nor take from a score
+    const double score = idf * (impact * (BM25_K1 + 1)) / (impact + BM25_K1);
+    return std::clamp(score, 0.0, 6.0) / 6.0;
+}
+
+float BlockMaxWand::blockBound(Cursor& cursor, data::docid_t target) {
+    cursor.block = cursor.list.reader->findBlock(target);
+    if (cursor.block == cursor.list.reader->numBlocks()) {
+        return 0.0F;
+    }
+    if (!cursor.list.bm25) {
+        return cursor.max_score;
+    }
+    const double impact = cursor.list.reader->blockMaxImpact(cursor.block);
+    return static_cast<float>(cursor.list.weight * bm25(cursor.list.idf, impact));
+}
+
+float BlockMaxWand::score(const Cursor& cursor, data::docid_t doc) const {
+    if (!cursor.list.bm25) {
+        return cursor.list.field_weights.empty() ? cursor.list.weight
+                                                 : presence(cursor.list, cursor.list.reader->currentFieldMask());
+    }
+
+    double norm = 1.0;
+    const DocInfo* info = documents_.findDocInfo(doc);
+    if (info != nullptr && avg_body_length_ > 0) {
+        norm = (1.0 - BM25_B) + BM25_B * (static_cast<double>(info->body_length) / avg_body_length_);
+    }
+    const double tf = cursor.list.reader->currentFrequency() / norm;
+    return static_cast<float>(cursor.list.weight * bm25(cursor.list.idf, tf));
+}
+
+float BlockMaxWand::presence(const List& list, uint8_t field_mask) {
+    if (list.field_weights.empty()) {
+        return list.weight;
+    }
+    float score = 0.0F;
+    for (const auto& [flag, weight] : list.field_weights) {
+        if ((field_mask & flag) != 0) {
+            score += weight;
+        }
+    }
+    return list.weight * score;
+}
+
+float BlockMaxWand::scoreFollowers(data::docid_t doc) {
+    float total = 0.0F;
+    for (auto& follower : followers_) {
+        if (follower.doc() < doc) {
+            follower.list.reader->seekToDocID(doc);
+        }
+        if (follower.list.reader->hasNext() && follower.doc() == doc) {
+            total += score(follower, doc);
+        }
+    }
+    std::erase_if(followers_, [](const Cursor& cursor) { return !cursor.list.reader->hasNext(); });
+    return total;
+}
+
+void BlockMaxWand::advanceTo(size_t end, data::docid_t target) {
+    for (size_t i = 0; i < end; ++i) {
+        if (cursors_[i].doc() < target) {
+            cursors_[i].list.reader->seekToDocID(target);
+        }
+    }
+    std::erase_if(cursors_, [](const Cursor& cursor) { return !cursor.list.reader->hasNext(); });
+}
+
+void BlockMaxWand::sortCursors() {
+    // Only the cursors that moved are out of place, insertion sort is linear then
+    for (size_t i = 1; i < cursors_.size(); ++i) {
+        for (size_t j = i; j > 0 && cursors_[j].doc() < cursors_[j - 1].doc(); --j) {
+            std::swap(cursors_[j], cursors_[j - 1]);
+        }
+    }
+}
+
+std::vector<std::pair<data::docid_t, float>> BlockMaxWand::topK(size_t k) {
+    scored_ = 0;
+    if (k == 0) {
+        return {};
+    }
+
+    // Min heap on score, the front is the k-th best document once the heap is full
+    std::vector<std::pair<data::docid_t, float>> heap;
+    heap.reserve(k);
+    auto worse = [](const auto& a, const auto& b) { return a.second > b.second; };
+    // Until k documents were found every document qualifies, scores are never negative
+    float threshold = -1.0F;
+
+    while (!cursors_.empty()) {
+        sortCursors();
+
+        // Pivot: the first cursor at which the lists' bounds add up to more than the threshold, documents before
+        // its doc can only appear in the lists before it and cannot qualify
+        // Any candidate may also be in every follower
+        float followers_bound = 0.0F;
+        for (const auto& follower : followers_) {
+            followers_bound += follower.max_score;
+        }
+        size_t pivot = cursors_.size();
+        float bound = followers_bound;
+        for (size_t i = 0; i < cursors_.size(); ++i) {
+            bound += cursors_[i].max_score;
+            if (bound > threshold) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == cursors_.size()) {
+            break;
+        }
+        const data::docid_t doc = cursors_[pivot].doc();
+        while (pivot + 1 < cursors_.size() && cursors_[pivot + 1].doc() == doc) {
+            ++pivot;
+        }
+
+        // Shallow check against the blocks that would hold doc, nothing is decoded
+        float block_bound = 0.0F;
+        for (size_t i = 0; i <= pivot; ++i) {
+            block_bound += blockBound(cursors_[i], doc);
+        }
+        for (auto& follower : followers_) {
+            block_bound += blockBound(follower, doc);
+        }
+        if (block_bound <= threshold) {
+            // No document can qualify before one of the checked blocks ends or the next list starts
+            uint64_t next = pivot + 1 < cursors_.size() ? cursors_[pivot + 1].doc()
+                                                        : std::numeric_limits<data::docid_t>::max();
+            const auto block_end = [&next](const Cursor& cursor) {
+                const auto& reader = *cursor.list.reader;
+                if (cursor.block < reader.numBlocks()) {
+                    next = std::min<uint64_t>(next, uint64_t{reader.blockLastDocID(cursor.block)} + 1);
+                }
+            };
+            for (size_t i = 0; i <= pivot; ++i) {
+                block_end(cursors_[i]);
+            }
+            for (const auto& follower : followers_) {
+                block_end(follower);
+            }
+            next = std::max<uint64_t>(next, uint64_t{doc} + 1);
+            if (next > std::numeric_limits<data::docid_t>::max()) {
+                break;
+            }
+            advanceTo(pivot + 1, static_cast<data::docid_t>(next));
+            continue;
+        }
+
+        if (cursors_.front().doc() != doc) {
+            advanceTo(pivot, doc);
+            continue;
+        }
+
+        // Every list holding doc is at it, the filter decides whether it is a match at all
+        if (filter_ != nullptr) {
+            if (filter_->hasNext() && filter_->currentDocID() < doc) {
+                filter_->seekToDocID(doc);
+            }
+            if (!filter_->hasNext()) {
+                break;
+            }
+            if (filter_->currentDocID() != doc) {
+                advanceTo(cursors_.size(), filter_->currentDocID());
+                continue;
+            }
+        }
+
+        float doc_score = scoreFollowers(doc);
+        for (size_t i = 0; i <= pivot; ++i) {
+            doc_score += score(cursors_[i], doc);
+        }
+        ++scored_;
+
+        if (heap.size() < k) {
+            heap.emplace_back(doc, doc_score);
+            std::push_heap(heap.begin(), heap.end(), worse);
+        } else if (doc_score > threshold) {
+            std::pop_heap(heap.begin(), heap.end(), worse);
+            heap.back() = {doc, doc_score};
+            std::push_heap(heap.begin(), heap.end(), worse);
+        }
+        if (heap.size() == k) {
+            threshold = heap.front().second;
+        }
+
+        for (size_t i = 0; i <= pivot; ++i) {
+            cursors_[i].list.reader->moveNext();
+        }
+        std::erase_if(cursors_, [](const Cursor& cursor) { return !cursor.list.reader->hasNext(); });
+    }
+
+    std::sort(heap.begin(), heap.end());
+    return heap;
+}
+
+}  // namespace mithril
@@ -0,0 +1,85 @@
+#ifndef INDEX_BLOCKMAXWAND_H
+#define INDEX_BLOCKMAXWAND_H
+
+#include "DocumentMapReader.h"
+#include "IndexStreamReader.h"
+#include "TermReader.h"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace mithril {
+
+// Top-k evaluation of a sum of per-list scores with Block-Max WAND (Ding and Suel, "Faster top-k document retrieval
+// using block-max indexes"). A document's score is the sum of the scores of the lists it appears in. Every list
+// has an upper bound on its scores, and every block of a list a tighter one derived from the block's max impact,
+// so documents and whole blocks that cannot beat the current k-th best score are skipped without being decoded or
+// scored.
+//
+// A list is either a BM25 list, scored like ranking::BM25 from its frequencies and the documents' body lengths, or
+// a presence list that scores its weight for every document it contains. A presence list with field weights scores
+// its weight times the field weights of the fields in each posting's field mask instead, so one any-field list
+// scores every field of a term. A follower list only adds its scores to documents the other lists produce, it
+// never makes a document a candidate, so it can score a term for a tier of lists that hold only part of the
+// documents. An optional filter ISR restricts the
+// results to the documents it matches, it only has to be positioned on documents that survive the bounds. Every
+// document the filter matches must appear in at least one list, documents in none of them are never seen.
+class BlockMaxWand {
+public:
+    struct List {
+        std::unique_ptr<TermReader> reader;
+        float weight;  // Multiplies the list's scores
+        double idf;    // BM25 lists only
+        bool bm25;
+        // Presence lists only, {FIELD_FLAG_* bit, weight} pairs scored for the fields of each posting
+        std::vector<std::pair<uint8_t, float>> field_weights{};
+        bool follower{false};
+    };
+
+    BlockMaxWand(std::vector<List> lists,
+                 const DocumentMapReader& documents,
+                 double avg_body_length,
+                 IndexStreamReader* filter = nullptr);
+
+    // {doc ID, score} of the k best scoring documents, sorted by doc ID. Ties on the k-th score keep the document
+    // seen first.
+    std::vector<std::pair<data::docid_t, float>> topK(size_t k);
+
+    // Documents matched by the filter and scored in full by the last topK(), every match of the query when nothing
+    // could be pruned and a lower bound otherwise
+    size_t scoredDocuments() const { return scored_; }
+
+    // Score of a posting with the given frequency, and the bound of postings with the given impact
+    static double bm25(double idf, double impact);
+
+private:
+    struct Cursor {
+        List list;
+        float max_score;  // Bound of the whole list
+        uint32_t block;   // Block of the last shallow seek
+        data::docid_t doc() const { return list.reader->currentDocID(); }
+    };
+
+    std::vector<Cursor> cursors_;
+    std::vector<Cursor> followers_;
+    const DocumentMapReader& documents_;
+    const double avg_body_length_;
+    IndexStreamReader* filter_;
+    size_t scored_{0};
+
+    float blockBound(Cursor& cursor, data::docid_t target);
+    // Score of a presence list's posting with the given field mask
+    static float presence(const List& list, uint8_t field_mask);
+    float score(const Cursor& cursor, data::docid_t doc) const;
+    // Score of the followers that hold doc, moving them to it
+    float scoreFollowers(data::docid_t doc);
+    // Moves every cursor below target to it, dropping exhausted ones
+    void advanceTo(size_t end, data::docid_t target);
+    void sortCursors();
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_BLOCKMAXWAND_H
@@ -0,0 +1,80 @@
+#ifndef INDEX_BOUNDEDQUEUE_H
+#define INDEX_BOUNDEDQUEUE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace mithril {
+
+// Blocking multi-producer multi-consumer queue with a fixed capacity. Producers wait while it is full, which is
+// how a slow stage pushes back on the stages feeding it.
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    // Waits for room, returns false without queueing if the queue was closed
+    bool push(T value) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+            if (closed_) {
+                return false;
+            }
+            items_.push_back(std::move(value));
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Waits for an item, returns nullopt once the queue is closed and drained
+    std::optional<T> pop() {
+        std::optional<T> value;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+            if (items_.empty()) {
+                return std::nullopt;
+            }
+            value.emplace(std::move(items_.front()));
+            items_.pop_front();
+        }
+        not_full_.notify_one();
+        return value;
+    }
+
+    // Wakes every waiter. Pushes fail from now on, pops drain what is left.
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+private:
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<T> items_;
+    bool closed_{false};
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_BOUNDEDQUEUE_H
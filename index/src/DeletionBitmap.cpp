@@ -0,0 +1,176 @@
+#include "DeletionBitmap.h"
+
+#include "DocumentMapReader.h"
+
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <utility>
+#include <spdlog/spdlog.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace mithril {
+
+namespace {
+size_t WordCount(uint32_t slot_count) {
+    return (static_cast<size_t>(slot_count) + 63) / 64;
+}
+
+size_t FileSize(uint32_t slot_count) {
+    return DeletionBitmap::HEADER_SIZE + WordCount(slot_count) * sizeof(uint64_t);
+}
+}  // namespace
+
+DeletionBitmap::DeletionBitmap(std::string index_dir) : index_dir_(std::move(index_dir)) {
+    refresh();
+}
+
+DeletionBitmap::~DeletionBitmap() {
+    if (data_ != nullptr) {
+        munmap(data_, size_);
+    }
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+bool DeletionBitmap::refresh() {
+    if (words_ != nullptr) {
+        return true;
+    }
+
+    const std::string path = index_dir_ + "/" + FILE_NAME;
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;  // Nothing deleted yet
+    }
+
+    // markDeleted() holds an exclusive lock while it creates the file, a shared one waits for it to finish
+    struct stat sb;
+    if (flock(fd, LOCK_SH) == -1 || fstat(fd, &sb) == -1) {
+        spdlog::error("Failed to read deletion bitmap {}: {}", path, std::strerror(errno));
+        close(fd);
+        return false;
+    }
+    flock(fd, LOCK_UN);
+
+    const size_t size = sb.st_size;
+    if (size < HEADER_SIZE) {
+        spdlog::error("Deletion bitmap is truncated: {}", path);
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        spdlog::error("Failed to memory map deletion bitmap: {}", path);
+        close(fd);
+        return false;
+    }
+
+    const auto* header = static_cast<const uint32_t*>(data);
+    if (header[0] != MAGIC || header[1] != VERSION || size < FileSize(header[3])) {
+        spdlog::error("Unsupported deletion bitmap format in {}", path);
+        munmap(data, size);
+        close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    data_ = data;
+    size_ = size;
+    base_doc_id_ = header[2];
+    slot_count_ = header[3];
+    words_ = reinterpret_cast<uint64_t*>(static_cast<char*>(data) + HEADER_SIZE);
+
+    spdlog::info("Memory mapped deletion bitmap of {} with {} deleted documents", index_dir_, deletedCount());
+    return true;
+}
+
+size_t DeletionBitmap::deletedCount() const {
+    size_t count = 0;
+    for (size_t i = 0; words_ != nullptr && i < WordCount(slot_count_); ++i) {
+        count += std::popcount(std::atomic_ref<uint64_t>(words_[i]).load(std::memory_order_relaxed));
+    }
+    return count;
+}
+
+std::vector<data::docid_t> DeletionBitmap::deletedIds() const {
+    std::vector<data::docid_t> ids;
+    for (size_t i = 0; words_ != nullptr && i < WordCount(slot_count_); ++i) {
+        for (uint64_t word = std::atomic_ref<uint64_t>(words_[i]).load(std::memory_order_relaxed); word != 0;
+             word &= word - 1) {
+            ids.push_back(base_doc_id_ + static_cast<data::docid_t>(i * 64 + std::countr_zero(word)));
+        }
+    }
+    return ids;
+}
+
+size_t DeletionBitmap::markDeleted(const std::string& index_dir, std::span<const data::docid_t> ids) {
+    const std::string path = index_dir + "/" + FILE_NAME;
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        throw std::runtime_error("Failed to open deletion bitmap " + path + ": " + std::strerror(errno));
+    }
+    if (flock(fd, LOCK_EX) == -1) {
+        close(fd);
+        throw std::runtime_error("Failed to lock deletion bitmap " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) == -1) {
+        close(fd);
+        throw std::runtime_error("Failed to read deletion bitmap " + path + ": " + std::strerror(errno));
+    }
+
+    // The bitmap covers every slot of the document map, which never changes once the index is built
+    uint32_t header[4];
+    if (sb.st_size == 0) {
+        DocumentMapReader documents(index_dir);
+        header[0] = MAGIC;
+        header[1] = VERSION;
+        header[2] = documents.baseDocID();
+        header[3] = static_cast<uint32_t>(documents.slotCount());
+        if (ftruncate(fd, static_cast<off_t>(FileSize(header[3]))) == -1 ||
+            pwrite(fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            close(fd);
+            throw std::runtime_error("Failed to create deletion bitmap " + path + ": " + std::strerror(errno));
+        }
+    } else if (pread(fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) || header[0] != MAGIC ||
+               header[1] != VERSION || static_cast<size_t>(sb.st_size) < FileSize(header[3])) {
+        close(fd);
+        throw std::runtime_error("Unsupported deletion bitmap format in " + path);
+    }
+
+    const size_t size = FileSize(header[3]);
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Failed to memory map deletion bitmap " + path + ": " + std::strerror(errno));
+    }
+
+    auto* words = reinterpret_cast<uint64_t*>(static_cast<char*>(data) + HEADER_SIZE);
+    size_t deleted = 0;
+    for (const data::docid_t id : ids) {
+        const uint32_t slot = id - header[2];
+        if (slot >= header[3]) {
+            continue;
+        }
+        const uint64_t bit = uint64_t{1} << (slot & 63);
+        const uint64_t previous = std::atomic_ref<uint64_t>(words[slot >> 6]).fetch_or(bit, std::memory_order_relaxed);
+        deleted += (previous & bit) == 0;
+    }
+
+    msync(data, size, MS_SYNC);
+    munmap(data, size);
+    flock(fd, LOCK_UN);
+    close(fd);
+    return deleted;
+}
+
+}  // namespace mithril
@@ -0,0 +1,74 @@
+#ifndef INDEX_DELETIONBITMAP_H
+#define INDEX_DELETIONBITMAP_H
+
+#include "data/Document.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace mithril {
+
+// deleted_docs.data marks documents that were removed from an index after it was built, one bit per slot of the
+// document map. It is created on the first deletion and only ever has bits set. Readers and writers map it
+// shared, so a deletion is visible to every open reader as soon as its bit is set.
+//
+// Layout:
+//   u32 magic, u32 version, u32 base_doc_id, u32 slot_count
+//   ceil(slot_count / 64) u64 words, bit (id - base_doc_id) % 64 of word (id - base_doc_id) / 64 is set once id
+//   is deleted
+class DeletionBitmap {
+public:
+    static constexpr uint32_t MAGIC = 0x4D44454C;  // "MDEL"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 4 * sizeof(uint32_t);
+    static constexpr const char* FILE_NAME = "deleted_docs.data";
+
+    explicit DeletionBitmap(std::string index_dir);
+    ~DeletionBitmap();
+
+    DeletionBitmap(const DeletionBitmap&) = delete;
+    DeletionBitmap& operator=(const DeletionBitmap&) = delete;
+
+    // Maps the bitmap if it was created since the last call, returns whether one is mapped. Cheap once mapped.
+    bool refresh();
+
+    // Whether nothing was ever deleted from this index, readers skip their checks then
+    bool empty() const { return words_ == nullptr; }
+
+    bool isDeleted(data::docid_t id) const {
+        if (words_ == nullptr) {
+            return false;
+        }
+        // Wraps around for ids below the base, which then fail the range check like ids past the end
+        const uint32_t slot = id - base_doc_id_;
+        if (slot >= slot_count_) {
+            return false;
+        }
+        return (std::atomic_ref<uint64_t>(words_[slot >> 6]).load(std::memory_order_relaxed) >> (slot & 63)) & 1;
+    }
+
+    // Number of deleted documents, counts every word
+    size_t deletedCount() const;
+    std::vector<data::docid_t> deletedIds() const;
+
+    // Marks documents of the index in index_dir deleted, creating the bitmap if needed. Ids outside the index are
+    // ignored, so the same list can be applied to every shard. Returns the number of newly deleted documents.
+    static size_t markDeleted(const std::string& index_dir, std::span<const data::docid_t> ids);
+
+private:
+    const std::string index_dir_;
+    int fd_{-1};
+    void* data_{nullptr};
+    size_t size_{0};
+    uint64_t* words_{nullptr};  // Mapped read only, never written through
+    uint32_t base_doc_id_{0};
+    uint32_t slot_count_{0};
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_DELETIONBITMAP_H
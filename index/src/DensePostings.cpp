@@ -0,0 +1,289 @@
+#include "DensePostings.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace mithril {
+
+namespace {
+
+constexpr size_t HEADER_SIZE = 4 * sizeof(uint32_t);
+constexpr size_t TERM_HEADER_SIZE = 4 * sizeof(uint32_t);
+
+size_t Padded(size_t bytes) {
+    return (bytes + 7) & ~size_t{7};
+}
+
+data::docid_t DocID(uint16_t key, uint32_t low) {
+    return (static_cast<data::docid_t>(key) << 16) | low;
+}
+
+}  // namespace
+
+uint32_t DenseDocSet::findContainer(uint16_t key) const {
+    const Container* it = std::lower_bound(
+        containers_, containers_ + container_count_, key, [](const Container& c, uint16_t k) { return c.key < k; });
+    return static_cast<uint32_t>(it - containers_);
+}
+
+bool DenseDocSet::contains(data::docid_t id) const {
+    const uint16_t key = id >> 16;
+    const uint16_t low = id & 0xFFFF;
+    const uint32_t c = findContainer(key);
+    if (c == container_count_ || containers_[c].key != key) {
+        return false;
+    }
+    if (isBitmap(c)) {
+        return (bitmap(c)[low / 64] >> (low % 64)) & 1;
+    }
+    const uint16_t* values = array(c);
+    return std::binary_search(values, values + containers_[c].cardinality_m1 + 1, low);
+}
+
+std::optional<data::docid_t> DenseDocSet::nextPresent(data::docid_t id) const {
+    const uint16_t key = id >> 16;
+    uint32_t low = id & 0xFFFF;
+    for (uint32_t c = findContainer(key); c < container_count_; ++c) {
+        // Containers after the one of id start from their first doc ID
+        if (containers_[c].key != key) {
+            low = 0;
+        }
+        if (isBitmap(c)) {
+            const uint64_t* words = bitmap(c);
+            size_t word = low / 64;
+            uint64_t bits = words[word] & (~uint64_t{0} << (low % 64));
+            while (bits == 0 && ++word < BITMAP_WORDS) {
+                bits = words[word];
+            }
+            if (bits != 0) {
+                return DocID(containers_[c].key, static_cast<uint32_t>(word * 64 + std::countr_zero(bits)));
+            }
+        } else {
+            const uint16_t* values = array(c);
+            const uint16_t* end = values + containers_[c].cardinality_m1 + 1;
+            const uint16_t* it = std::lower_bound(values, end, low);
+            if (it != end) {
+                return DocID(containers_[c].key, *it);
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<data::docid_t> DenseDocSet::nextAbsent(data::docid_t id) const {
+    while (true) {
+        const uint16_t key = id >> 16;
+        const uint32_t low = id & 0xFFFF;
+        const uint32_t c = findContainer(key);
+        if (c == container_count_ || containers_[c].key != key) {
+            return id;
+        }
+
+        uint32_t absent = 65536;
+        if (isBitmap(c)) {
+            const uint64_t* words = bitmap(c);
+            size_t word = low / 64;
+            uint64_t bits = ~words[word] & (~uint64_t{0} << (low % 64));
+            while (bits == 0 && ++word < BITMAP_WORDS) {
+                bits = ~words[word];
+            }
+            if (bits != 0) {
+                absent = static_cast<uint32_t>(word * 64 + std::countr_zero(bits));
+            }
+        } else {
+            // Runs of consecutive values from low on are present, the value after the run is not
+            const uint16_t* values = array(c);
+            const uint16_t* end = values + containers_[c].cardinality_m1 + 1;
+            const uint16_t* it = std::lower_bound(values, end, low);
+            absent = low;
+            for (; it != end && *it == absent; ++it) {
+                ++absent;
+            }
+        }
+        if (absent < 65536) {
+            return DocID(key, absent);
+        }
+        if (key == std::numeric_limits<uint16_t>::max()) {
+            return std::nullopt;
+        }
+        id = DocID(key + 1, 0);
+    }
+}
+
+DensePostings::DensePostings(const std::string& index_dir) {
+    const std::string path = index_dir + "/" + FILE_NAME;
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return;  // Built without dense postings, readers use the posting lists
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) == -1 || static_cast<size_t>(sb.st_size) < HEADER_SIZE) {
+        spdlog::error("Failed to read dense postings {}", path);
+        close(fd);
+        return;
+    }
+    const size_t size = sb.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        spdlog::error("Failed to memory map dense postings {}: {}", path, std::strerror(errno));
+        return;
+    }
+    data_ = data;
+    size_ = size;
+
+    const char* base = static_cast<const char*>(data);
+    uint32_t header[4];
+    std::memcpy(header, base, sizeof(header));
+    if (header[0] != MAGIC || header[1] != VERSION) {
+        spdlog::error("Unsupported dense postings format in {}", path);
+        return;
+    }
+
+    size_t pos = HEADER_SIZE;
+    terms_.reserve(header[2]);
+    for (uint32_t t = 0; t < header[2]; ++t) {
+        uint32_t term_header[4];
+        if (pos + TERM_HEADER_SIZE > size) {
+            break;
+        }
+        std::memcpy(term_header, base + pos, sizeof(term_header));
+        const auto [term_length, container_count, doc_count, data_bytes] = term_header;
+        const size_t containers_pos = pos + TERM_HEADER_SIZE + Padded(term_length);
+        const size_t data_pos = containers_pos + Padded(container_count * sizeof(DenseDocSet::Container));
+        if (data_pos + data_bytes > size) {
+            break;
+        }
+        terms_.emplace(std::string_view(base + pos + TERM_HEADER_SIZE, term_length),
+                       DenseDocSet(reinterpret_cast<const DenseDocSet::Container*>(base + containers_pos),
+                                   container_count,
+                                   base + data_pos,
+                                   doc_count));
+        pos = data_pos + data_bytes;
+    }
+    if (terms_.size() != header[2]) {
+        spdlog::error("Dense postings {} are truncated, read {} of {} terms", path, terms_.size(), header[2]);
+    }
+    spdlog::info("Memory mapped dense postings of {} terms from {}", terms_.size(), index_dir);
+}
+
+DensePostings::~DensePostings() {
+    if (data_ != nullptr) {
+        munmap(data_, size_);
+    }
+}
+
+std::optional<DenseDocSet> DensePostings::lookup(std::string_view term) const {
+    const auto it = terms_.find(term);
+    if (it == terms_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+DensePostingsWriter::DensePostingsWriter(const std::string& index_dir)
+    : out_((index_dir + "/" + DensePostings::FILE_NAME).c_str()) {
+    // Term count filled in by finish()
+    const uint32_t header[4] = {DensePostings::MAGIC, DensePostings::VERSION, 0, 0};
+    out_.Write(header, sizeof(header));
+}
+
+void DensePostingsWriter::add_term(const std::string& term, const std::vector<Posting>& postings) {
+    std::vector<DenseDocSet::Container> containers;
+    std::vector<char> data;
+    for (size_t start = 0; start < postings.size();) {
+        const uint16_t key = postings[start].doc_id >> 16;
+        size_t end = start;
+        while (end < postings.size() && (postings[end].doc_id >> 16) == key) {
+            ++end;
+        }
+
+        const size_t cardinality = end - start;
+        containers.push_back({key, static_cast<uint16_t>(cardinality - 1), static_cast<uint32_t>(data.size())});
+        if (cardinality > DenseDocSet::ARRAY_MAX_SIZE) {
+            uint64_t words[DenseDocSet::BITMAP_WORDS] = {};
+            for (size_t i = start; i < end; ++i) {
+                const uint32_t low = postings[i].doc_id & 0xFFFF;
+                words[low / 64] |= uint64_t{1} << (low % 64);
+            }
+            const auto* bytes = reinterpret_cast<const char*>(words);
+            data.insert(data.end(), bytes, bytes + sizeof(words));
+        } else {
+            for (size_t i = start; i < end; ++i) {
+                const uint16_t low = postings[i].doc_id & 0xFFFF;
+                data.insert(data.end(), reinterpret_cast<const char*>(&low), reinterpret_cast<const char*>(&low + 1));
+            }
+            data.resize(Padded(data.size()));
+        }
+        start = end;
+    }
+
+    const uint32_t term_header[4] = {static_cast<uint32_t>(term.size()),
+                                     static_cast<uint32_t>(containers.size()),
+                                     static_cast<uint32_t>(postings.size()),
+                                     static_cast<uint32_t>(data.size())};
+    buffer_.assign(reinterpret_cast<const char*>(term_header), reinterpret_cast<const char*>(term_header + 4));
+    buffer_.insert(buffer_.end(), term.begin(), term.end());
+    buffer_.resize(TERM_HEADER_SIZE + Padded(term.size()));
+    buffer_.insert(buffer_.end(),
+                   reinterpret_cast<const char*>(containers.data()),
+                   reinterpret_cast<const char*>(containers.data() + containers.size()));
+    buffer_.resize(Padded(buffer_.size()));
+    buffer_.insert(buffer_.end(), data.begin(), data.end());
+
+    out_.Write(buffer_.data(), buffer_.size());
+    term_count_++;
+}
+
+void DensePostingsWriter::finish() {
+    out_.Fseek(2 * sizeof(uint32_t));
+    out_.Write(&term_count_, sizeof(term_count_));
+    out_.Close();
+}
+
+DenseTermReader::DenseTermReader(DenseDocSet docs, const DeletionBitmap* deleted)
+    : docs_(docs),
+      deleted_(deleted != nullptr && !deleted->empty() ? deleted : nullptr),
+      current_(docs_.nextPresent(0)) {
+    skipDeleted();
+}
+
+void DenseTermReader::moveNext() {
+    if (!current_) {
+        return;
+    }
+    current_ = nextAfter(*current_);
+    skipDeleted();
+}
+
+void DenseTermReader::seekToDocID(data::docid_t target_doc_id) {
+    if (!current_ || *current_ >= target_doc_id) {
+        return;
+    }
+    current_ = docs_.nextPresent(target_doc_id);
+    skipDeleted();
+}
+
+void DenseTermReader::skipDeleted() {
+    while (deleted_ != nullptr && current_ && deleted_->isDeleted(*current_)) {
+        current_ = nextAfter(*current_);
+    }
+}
+
+std::optional<data::docid_t> DenseTermReader::nextAfter(data::docid_t id) const {
+    if (id == std::numeric_limits<data::docid_t>::max()) {
+        return std::nullopt;
+    }
+    return docs_.nextPresent(id + 1);
+}
+
+}  // namespace mithril
@@ -0,0 +1,145 @@
+#ifndef INDEX_DENSEPOSTINGS_H
+#define INDEX_DENSEPOSTINGS_H
+
+#include "DeletionBitmap.h"
+#include "IndexStreamReader.h"
+#include "PostingBlock.h"
+#include "data/Document.h"
+#include "data/Writer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mithril {
+
+// Terms in at least one in DEFAULT_DENSE_TERM_FRACTION documents also get a bitmap of their doc IDs, one in 16 is
+// where a Roaring bitmap container gets smaller than an array of the container's doc IDs
+constexpr uint32_t DEFAULT_DENSE_TERM_FRACTION = 16;
+
+// Doc IDs of one dense term as a Roaring bitmap (Chambi et al.): doc IDs are split into containers by their high
+// 16 bits. A container of at most ARRAY_MAX_SIZE doc IDs stores their low 16 bits as a sorted array, a fuller one
+// stores a bitmap of all 65536. Views point into the mapped dense_postings.data.
+class DenseDocSet {
+public:
+    static constexpr uint32_t ARRAY_MAX_SIZE = 4096;
+    static constexpr size_t BITMAP_WORDS = 65536 / 64;
+
+    struct Container {
+        uint16_t key;             // High 16 bits of the container's doc IDs
+        uint16_t cardinality_m1;  // Number of doc IDs minus one
+        uint32_t offset;          // Of the array or bitmap from the start of the term's container data
+    };
+    static_assert(sizeof(Container) == 8, "containers are written as is");
+
+    DenseDocSet(const Container* containers, uint32_t container_count, const char* data, uint32_t doc_count)
+        : containers_(containers), container_count_(container_count), data_(data), doc_count_(doc_count) {}
+
+    uint32_t docCount() const { return doc_count_; }
+
+    bool contains(data::docid_t id) const;
+    // First doc ID of the set at or after id, nullopt when there is none
+    std::optional<data::docid_t> nextPresent(data::docid_t id) const;
+    // First doc ID at or after id that is not in the set, nullopt when the set holds every one up to the largest
+    std::optional<data::docid_t> nextAbsent(data::docid_t id) const;
+
+private:
+    const Container* containers_;
+    uint32_t container_count_;
+    const char* data_;
+    uint32_t doc_count_;
+
+    // First container whose key is at least key
+    uint32_t findContainer(uint16_t key) const;
+    bool isBitmap(uint32_t c) const { return containers_[c].cardinality_m1 >= ARRAY_MAX_SIZE; }
+    const uint16_t* array(uint32_t c) const {
+        return reinterpret_cast<const uint16_t*>(data_ + containers_[c].offset);
+    }
+    const uint64_t* bitmap(uint32_t c) const {
+        return reinterpret_cast<const uint64_t*>(data_ + containers_[c].offset);
+    }
+};
+
+// dense_postings.data holds a DenseDocSet for every term of the final index whose postings reach the density set
+// with IndexBuilder::set_dense_postings. The term's regular posting list stays in final_index.data, ranking reads
+// its frequencies and block impacts; matching only needs the doc IDs and reads them from the bitmap instead. The
+// file is optional, indexes without it match from the posting lists.
+//
+// Layout (containers and their data are 8 byte aligned):
+//   u32 magic, u32 version, u32 term count, u32 padding
+//   per term in term order: u32 term length, u32 container count, u32 doc count, u32 data bytes,
+//     term bytes, padding, containers, padding, container data
+class DensePostings {
+public:
+    static constexpr uint32_t MAGIC = 0x4D444E53;  // "MDNS"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr const char* FILE_NAME = "dense_postings.data";
+
+    explicit DensePostings(const std::string& index_dir);
+    ~DensePostings();
+
+    DensePostings(const DensePostings&) = delete;
+    DensePostings& operator=(const DensePostings&) = delete;
+
+    bool empty() const { return terms_.empty(); }
+    size_t termCount() const { return terms_.size(); }
+    std::optional<DenseDocSet> lookup(std::string_view term) const;
+
+private:
+    void* data_{nullptr};
+    size_t size_{0};
+    std::unordered_map<std::string_view, DenseDocSet> terms_;
+};
+
+// Writes dense_postings.data during the final merge, terms must be added in term order
+class DensePostingsWriter {
+public:
+    explicit DensePostingsWriter(const std::string& index_dir);
+
+    void add_term(const std::string& term, const std::vector<Posting>& postings);
+    // Writes the term count header and closes the file
+    void finish();
+
+    uint32_t term_count() const { return term_count_; }
+
+private:
+    data::FileWriter out_;
+    std::vector<char> buffer_;
+    uint32_t term_count_{0};
+};
+
+// ISR over a dense term's bitmap. Seeks are a container lookup and a scan of the target's bitmap words, so an
+// intersection led by a sparse list probes it for about the cost of a bit test.
+class DenseTermReader : public IndexStreamReader {
+public:
+    explicit DenseTermReader(DenseDocSet docs, const DeletionBitmap* deleted = nullptr);
+
+    bool hasNext() const override { return current_.has_value(); }
+    void moveNext() override;
+    data::docid_t currentDocID() const override {
+        return current_ ? *current_ : std::numeric_limits<data::docid_t>::max();
+    }
+    void seekToDocID(data::docid_t target_doc_id) override;
+    const DenseDocSet* denseDocs() const override { return &docs_; }
+    size_t estimatedDocCount() const override { return docs_.docCount(); }
+
+    uint32_t getDocumentCount() const { return docs_.docCount(); }
+    const DenseDocSet& docs() const { return docs_; }
+
+private:
+    DenseDocSet docs_;
+    const DeletionBitmap* deleted_;
+    std::optional<data::docid_t> current_;
+
+    void skipDeleted();
+    std::optional<data::docid_t> nextAfter(data::docid_t id) const;
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_DENSEPOSTINGS_H
@@ -0,0 +1,33 @@
+#ifndef INDEX_DOCIDMAP_H
+#define INDEX_DOCIDMAP_H
+
+#include "data/Document.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace mithril {
+
+// Renumbering of doc IDs, ids[id - base] is the new ID of id. IDs outside the map, and every ID of an empty map,
+// keep their ID.
+class DocIdMap {
+public:
+    DocIdMap() = default;
+    DocIdMap(data::docid_t base, std::vector<data::docid_t> ids) : base_(base), ids_(std::move(ids)) {}
+
+    bool empty() const { return ids_.empty(); }
+
+    data::docid_t operator()(data::docid_t id) const {
+        const size_t slot = id - base_;
+        return id >= base_ && slot < ids_.size() ? ids_[slot] : id;
+    }
+
+private:
+    data::docid_t base_{0};
+    std::vector<data::docid_t> ids_;
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_DOCIDMAP_H
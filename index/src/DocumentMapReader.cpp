@@ -1,137 +1,158 @@
 #include "DocumentMapReader.h"
 
-#include <fstream>
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <stdexcept>
 #include <spdlog/spdlog.h>
 
 namespace mithril {
 
+namespace {
+size_t AlignUp(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
 DocumentMapReader::DocumentMapReader(const std::string& index_dir) {
     loadDocumentMap(index_dir + "/document_map.data");
 }
 
 void DocumentMapReader::loadDocumentMap(const std::string& path) {
-    std::ifstream in(path, std::ios::binary);
     spdlog::info("loading document map {}", path);
 
-    if (!in) {
+    if (!std::filesystem::exists(path)) {
         throw std::runtime_error("Failed to open document map: " + path);
     }
+    file_ = std::make_unique<core::MemMapFile>(path);
 
-    // Read document count
-    in.read(reinterpret_cast<char*>(&doc_count_), sizeof(uint32_t));
-    doc_infos_.reserve(doc_count_);
+    if (file_->size() < sizeof(DocumentMapHeader)) {
+        throw std::runtime_error("Document map is truncated: " + path);
+    }
+    DocumentMapHeader header;
+    std::memcpy(&header, file_->data(), sizeof(header));
+    if (header.magic != MAGIC || header.version != VERSION) {
+        throw std::runtime_error("Unsupported document map format, rebuild the index: " + path);
+    }
 
-    // Temp buffers
-    std::vector<char> url_buffer;
-    std::vector<char> title_buffer;
+    const size_t slots_size = static_cast<size_t>(header.slot_count) * sizeof(DocInfo);
+    const size_t heaps_end = sizeof(DocumentMapHeader) + slots_size + header.url_heap_size + header.title_heap_size;
+    const size_t tables_start = AlignUp(heaps_end, alignof(uint32_t));
+    const size_t expected_size = tables_start + (static_cast<size_t>(header.slot_count) + 1) * sizeof(uint32_t) +
+                                 static_cast<size_t>(header.title_token_count) * sizeof(TitleToken) +
+                                 static_cast<size_t>(header.doc_count) * sizeof(uint32_t) +
+                                 static_cast<size_t>(header.slot_count) * sizeof(uint32_t) +
+                                 static_cast<size_t>(header.doc_count) * sizeof(uint32_t);
+    if (file_->size() < expected_size) {
+        throw std::runtime_error("Document map is truncated: " + path);
+    }
 
-    // First pass: calculate total string sizes
-    size_t total_url_size = 0;
-    size_t total_title_size = 0;
-    std::streampos start_pos = in.tellg();
+    const char* base = file_->data();
+    const char* ptr = base + sizeof(DocumentMapHeader);
+    slots_ = reinterpret_cast<const DocInfo*>(ptr);
+    ptr += slots_size;
+    urls_ = ptr;
+    ptr += header.url_heap_size;
+    titles_ = ptr;
+    ptr = base + tables_start;
+    title_token_starts_ = reinterpret_cast<const uint32_t*>(ptr);
+    ptr += (static_cast<size_t>(header.slot_count) + 1) * sizeof(uint32_t);
+    title_tokens_ = reinterpret_cast<const TitleToken*>(ptr);
+    ptr += static_cast<size_t>(header.title_token_count) * sizeof(TitleToken);
+    url_index_ = reinterpret_cast<const uint32_t*>(ptr);
+    ptr += static_cast<size_t>(header.doc_count) * sizeof(uint32_t);
+    crawl_ids_ = reinterpret_cast<const uint32_t*>(ptr);
+    ptr += static_cast<size_t>(header.slot_count) * sizeof(uint32_t);
+    crawl_index_ = reinterpret_cast<const uint32_t*>(ptr);
+
+    base_doc_id_ = header.base_doc_id;
+    slot_count_ = header.slot_count;
+    doc_count_ = header.doc_count;
+    reset();
+}
 
-    for (size_t i = 0; i < doc_count_; ++i) {
-        data::docid_t doc_id;
-        uint32_t url_len, title_len;
+const DocInfo* DocumentMapReader::findDocInfo(data::docid_t id) const {
+    if (id < base_doc_id_ || id - base_doc_id_ >= slot_count_) {
+        return nullptr;
+    }
 
-        in.read(reinterpret_cast<char*>(&doc_id), sizeof(doc_id));
-        in.read(reinterpret_cast<char*>(&url_len), sizeof(url_len));
-        in.seekg(url_len, std::ios::cur);
-        in.read(reinterpret_cast<char*>(&title_len), sizeof(title_len));
-        in.seekg(title_len, std::ios::cur);
+    const DocInfo& info = slots_[id - base_doc_id_];
+    return info.id == HOLE_DOC_ID ? nullptr : &info;
+}
 
-        // Skip BM25F stats in first pass
-        in.seekg(sizeof(uint32_t) * 4 + sizeof(float), std::ios::cur);
+DocView DocumentMapReader::makeView(const DocInfo& info) const {
+    const size_t slot = &info - slots_;
+    const uint32_t first_token = title_token_starts_[slot];
+    const uint32_t end_token = title_token_starts_[slot + 1];
+    return DocView{&info, getURL(info), getTitle(info), {title_tokens_ + first_token, end_token - first_token}};
+}
 
-        total_url_size += url_len;
-        total_title_size += title_len;
-    }
+data::Document DocumentMapReader::makeDocument(const DocInfo& info) const {
+    const DocView view = makeView(info);
 
-    // Pre-allocate string pools
-    urls_.reserve(total_url_size);
-    titles_.reserve(total_title_size);
-    in.seekg(start_pos);
-
-    // Second pass: actual loading
-    for (size_t i = 0; i < doc_count_; ++i) {
-        DocInfo info;
-        uint32_t url_str_len, title_str_len;
-
-        // Read ID and URL string
-        in.read(reinterpret_cast<char*>(&info.id), sizeof(info.id));
-        in.read(reinterpret_cast<char*>(&url_str_len), sizeof(url_str_len));
-        url_buffer.resize(url_str_len);
-        in.read(url_buffer.data(), url_str_len);
-        info.url_offset = urls_.size();
-        info.url_length = url_str_len;  // Store actual string length
-        urls_.append(url_buffer.data(), url_str_len);
-
-        // Read title string
-        in.read(reinterpret_cast<char*>(&title_str_len), sizeof(title_str_len));
-        title_buffer.resize(title_str_len);
-        in.read(title_buffer.data(), title_str_len);
-        info.title_offset = titles_.size();
-        info.title_length = title_str_len;  // Store actual string length
-        titles_.append(title_buffer.data(), title_str_len);
-
-        // Read BM25F stats (but don't overwrite string lengths)
-        uint32_t body_tokens, title_tokens, url_tokens, desc_tokens;
-        in.read(reinterpret_cast<char*>(&body_tokens), sizeof(body_tokens));
-        in.read(reinterpret_cast<char*>(&title_tokens), sizeof(title_tokens));
-        in.read(reinterpret_cast<char*>(&url_tokens), sizeof(url_tokens));
-        in.read(reinterpret_cast<char*>(&desc_tokens), sizeof(desc_tokens));
-        in.read(reinterpret_cast<char*>(&info.pagerank_score), sizeof(info.pagerank_score));
-
-        // Store token counts separately
-        info.body_length = body_tokens;
-        // Note: We preserve title_str_len for the actual string length
-        info.desc_length = desc_tokens;
-
-        doc_infos_.push_back(info);
-        std::string_view url_view(urls_.data() + info.url_offset, info.url_length);
-        url_to_id_[url_view] = info.id;
-    }
-    for (size_t i = 0; i < doc_infos_.size(); ++i) {
-        id_to_index_[doc_infos_[i].id] = i;
+    data::Document doc;
+    doc.id = info.id;
+    doc.url = std::string(view.url);
+    doc.title.reserve(view.titleTokenCount());
+    for (size_t i = 0; i < view.titleTokenCount(); ++i) {
+        doc.title.emplace_back(view.titleToken(i));
     }
+
+    return doc;
 }
 
 std::optional<data::Document> DocumentMapReader::getDocument(data::docid_t id) const {
-    auto it = id_to_index_.find(id);
-    if (it == id_to_index_.end()) {
+    const DocInfo* info = findDocInfo(id);
+    if (info == nullptr) {
         return std::nullopt;
     }
 
-    const DocInfo& info = doc_infos_[it->second];
+    return makeDocument(*info);
+}
 
-    data::Document doc;
-    doc.id = info.id;
-    doc.url = std::string(urls_.data() + info.url_offset, info.url_length);
-
-    // Parse title into words (space-separated)
-    std::string title_str(titles_.data() + info.title_offset, info.title_length);
-    std::istringstream title_stream(title_str);
-    std::string word;
-    while (title_stream >> word) {
-        doc.title.push_back(word);
+std::optional<DocView> DocumentMapReader::getDocumentView(data::docid_t id) const {
+    const DocInfo* info = findDocInfo(id);
+    if (info == nullptr) {
+        return std::nullopt;
     }
 
-    return doc;
+    return makeView(*info);
 }
 
 std::optional<data::docid_t> DocumentMapReader::lookupDocID(const std::string& url) const {
-    auto it = url_to_id_.find(url);
-    if (it != url_to_id_.end()) {
-        return it->second;
+    // Binary search the slot indices sorted by URL
+    size_t left = 0;
+    size_t right = doc_count_;
+    while (left < right) {
+        const size_t mid = left + (right - left) / 2;
+        const uint32_t slot = url_index_[mid];
+
+        const int comparison = getURL(slots_[slot]).compare(url);
+        if (comparison == 0) {
+            return slots_[slot].id;
+        }
+        if (comparison < 0) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
     }
     return std::nullopt;
 }
 
+std::optional<data::docid_t> DocumentMapReader::lookupCrawlDocID(data::docid_t crawl_id) const {
+    // Binary search the slot indices sorted by crawl doc ID
+    const uint32_t* end = crawl_index_ + doc_count_;
+    const uint32_t* it = std::lower_bound(
+        crawl_index_, end, crawl_id, [&](uint32_t slot, data::docid_t id) { return crawl_ids_[slot] < id; });
+    if (it == end || crawl_ids_[*it] != crawl_id) {
+        return std::nullopt;
+    }
+    return slots_[*it].id;
+}
+
 bool DocumentMapReader::hasNext() const {
-    return current_position_ < doc_infos_.size();
+    return current_position_ < slot_count_;
 }
 
 data::Document DocumentMapReader::next() {
@@ -139,25 +160,20 @@ data::Document DocumentMapReader::next() {
         throw std::runtime_error("No more documents");
     }
 
-    const DocInfo& info = doc_infos_[current_position_++];
-
-    data::Document doc;
-    doc.id = info.id;
-    doc.url = std::string(urls_.data() + info.url_offset, info.url_length);
-
-    // Parse title into words
-    std::string title_str(titles_.data() + info.title_offset, info.title_length);
-    std::istringstream title_stream(title_str);
-    std::string word;
-    while (title_stream >> word) {
-        doc.title.push_back(word);
-    }
-
-    return doc;
+    const DocInfo& info = slots_[current_position_++];
+    skipHoles();
+    return makeDocument(info);
 }
 
 void DocumentMapReader::reset() {
     current_position_ = 0;
+    skipHoles();
+}
+
+void DocumentMapReader::skipHoles() {
+    while (current_position_ < slot_count_ && slots_[current_position_].id == HOLE_DOC_ID) {
+        ++current_position_;
+    }
 }
 
 }  // namespace mithril
@@ -2,25 +2,87 @@
 #define INDEX_DOCUMENTMAPREADER_H
 
 #include "TextPreprocessor.h"
+#include "core/mem_map_file.h"
 #include "data/Document.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
-#include <unordered_map>
-#include <vector>
+#include <string_view>
 
 
 namespace mithril {
 
 using DocInfo = data::DocInfo;
 
+// document_map.data is memory mapped and never parsed. DocInfo records sit in a fixed-stride array with one slot
+// per doc ID in [base_doc_id, base_doc_id + slot_count), so looking up a document is an array index.
+//
+// Layout:
+//   DocumentMapHeader
+//   slot_count DocInfo, slots without a document have id == HOLE_DOC_ID
+//   URL heap and title heap, DocInfo::url_offset/title_offset point into them, padded to 4 bytes
+//   slot_count + 1 u32 indices into the title token array, slot i owns tokens [start[i], start[i + 1])
+//   title_token_count TitleToken, the words of each title split at index time
+//   doc_count u32 slot indices sorted by URL, for lookupDocID
+//   slot_count u32 crawl doc IDs, the ID the crawler gave the document in each slot
+//   doc_count u32 slot indices sorted by crawl doc ID, for lookupCrawlDocID
+//
+// Doc IDs are the crawler's unless the index was built with a doc order other than DocOrder::Crawl, which
+// renumbers the documents. Document files and results handed out of the index keep the crawl IDs.
+struct DocumentMapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t doc_count;
+    uint32_t base_doc_id;
+    uint32_t slot_count;
+    uint32_t title_token_count;
+    uint64_t url_heap_size;
+    uint64_t title_heap_size;
+};
+static_assert(sizeof(DocumentMapHeader) == 40, "document map header is fixed size");
+static_assert(sizeof(DocInfo) == 32, "document map slots are fixed size");
+
+// A title word, relative to the start of the document's title
+struct TitleToken {
+    uint16_t offset;
+    uint16_t length;
+};
+
+// Non-owning view of a document in the mapped document map, valid as long as the reader. Reading a document
+// through a view copies nothing.
+struct DocView {
+    const DocInfo* info{nullptr};
+    std::string_view url;
+    std::string_view title;  // Title words joined by single spaces
+    std::span<const TitleToken> title_tokens;
+
+    data::docid_t id() const { return info->id; }
+    size_t titleTokenCount() const { return title_tokens.size(); }
+    std::string_view titleToken(size_t i) const {
+        return title.substr(title_tokens[i].offset, title_tokens[i].length);
+    }
+};
+
 class DocumentMapReader {
 public:
+    static constexpr uint32_t MAGIC = 0x4D444F43;  // "MDOC"
+    static constexpr uint32_t VERSION = 4;
+    static constexpr data::docid_t HOLE_DOC_ID = UINT32_MAX;
+
     explicit DocumentMapReader(const std::string& index_dir);
 
     // core func
     std::optional<data::Document> getDocument(data::docid_t id) const;
+    std::optional<DocView> getDocumentView(data::docid_t id) const;
     std::optional<data::docid_t> lookupDocID(const std::string& url) const;
+    // ID the crawler gave the document with this doc ID, the document must exist
+    data::docid_t crawlDocID(data::docid_t id) const { return crawl_ids_[id - base_doc_id_]; }
+    // Doc ID of the document the crawler gave this ID
+    std::optional<data::docid_t> lookupCrawlDocID(data::docid_t crawl_id) const;
 
     // iterator func
     bool hasNext() const;
@@ -29,21 +91,36 @@ public:
 
     // utils func
     size_t documentCount() const { return doc_count_; }
-    const std::vector<DocInfo>& getDocInfos() const { return doc_infos_; }
-    const DocInfo& getDocInfo(data::docid_t id) const { return doc_infos_[id_to_index_.at(id)]; }
+    data::docid_t baseDocID() const { return base_doc_id_; }
+    size_t slotCount() const { return slot_count_; }
 
-private:
-    std::vector<DocInfo> doc_infos_;
-    std::string urls_;
-    std::string titles_;
+    // nullptr if the map has no document with this ID
+    const DocInfo* findDocInfo(data::docid_t id) const;
+    // The document must exist, see findDocInfo
+    const DocInfo& getDocInfo(data::docid_t id) const { return slots_[id - base_doc_id_]; }
+    std::string_view getURL(const DocInfo& info) const { return {urls_ + info.url_offset, info.url_length}; }
+    std::string_view getTitle(const DocInfo& info) const { return {titles_ + info.title_offset, info.title_length}; }
 
-    std::unordered_map<std::string_view, data::docid_t> url_to_id_;
-    std::unordered_map<data::docid_t, size_t> id_to_index_;  // doc_id: index in doc_infos_
+private:
+    std::unique_ptr<core::MemMapFile> file_;
+    const DocInfo* slots_{nullptr};
+    const char* urls_{nullptr};
+    const char* titles_{nullptr};
+    const uint32_t* title_token_starts_{nullptr};
+    const TitleToken* title_tokens_{nullptr};
+    const uint32_t* url_index_{nullptr};
+    const uint32_t* crawl_ids_{nullptr};
+    const uint32_t* crawl_index_{nullptr};
 
-    size_t current_position_{0};
+    data::docid_t base_doc_id_{0};
+    size_t slot_count_{0};
     size_t doc_count_{0};
+    size_t current_position_{0};  // Slot of the next document returned by next()
 
     void loadDocumentMap(const std::string& path);
+    DocView makeView(const DocInfo& info) const;
+    data::Document makeDocument(const DocInfo& info) const;
+    void skipHoles();
 };
 
 }  // namespace mithril
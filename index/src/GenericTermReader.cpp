@@ -16,16 +16,55 @@ namespace mithril {
 GenericTermReader::GenericTermReader(const std::string& term,
                                      const core::MemMapFile& index_file,
                                      TermDictionary& term_dict,
-                                     PositionIndex& position_index)
+                                     PositionIndex& position_index,
+                                     const DeletionBitmap* deleted,
+                                     const DensePostings* dense)
     : term_(term), index_file_(index_file), term_dict_(term_dict), position_index_(position_index)
 {
-    std::vector<std::unique_ptr<IndexStreamReader>> readers;
-    for (const auto& decorator: kDecorators) {
-        const auto decorated_term = std::string(decorator) + term; // TODO: don't use operator+
-        auto ptr = new TermReader(/*TODO: remove path*/"", decorated_term, index_file_, term_dict_, position_index_);
-        readers.emplace_back(reinterpret_cast<IndexStreamReader*>(ptr));
+    const auto make_reader = [&](const std::string& list_term) -> std::unique_ptr<IndexStreamReader> {
+        if (const auto docs = dense != nullptr ? dense->lookup(list_term) : std::nullopt) {
+            return std::make_unique<DenseTermReader>(*docs, deleted);
+        }
+        return std::make_unique<TermReader>("", list_term, index_file_, term_dict_, position_index_, deleted);
+    };
+
+    if (term_dict_.has_any_field_entries()) {
+        // The reader's dictionary lookup is the only one, a term of a single field has an any-field entry pointing
+        // at that field's list and a term of no field has none
+        const auto any_field = any_field_term(term);
+        if (const auto docs = dense != nullptr ? dense->lookup(any_field) : std::nullopt) {
+            term_reader_ = std::make_unique<DenseTermReader>(*docs, deleted);
+            return;
+        }
+        auto reader = std::make_unique<TermReader>("", any_field, index_file_, term_dict_, position_index_, deleted);
+        const auto list_term = reader->listTerm();
+        if (const auto docs = dense != nullptr && list_term != any_field ? dense->lookup(list_term) : std::nullopt) {
+            term_reader_ = std::make_unique<DenseTermReader>(*docs, deleted);
+            return;
+        }
+        term_reader_ = std::move(reader);
+        return;
     }
 
+    // An index without any-field lists
+    std::vector<std::string> decorated_terms;
+    for (const auto& decorator : kDecorators) {
+        auto decorated_term = std::string(decorator);
+        decorated_term.append(term);
+        if (term_dict_.lookup(decorated_term)) {
+            decorated_terms.push_back(std::move(decorated_term));
+        }
+    }
+    if (decorated_terms.size() <= 1) {
+        // The bare term's reader is empty when no field has the term
+        term_reader_ = make_reader(decorated_terms.empty() ? term : decorated_terms.front());
+        return;
+    }
+
+    std::vector<std::unique_ptr<IndexStreamReader>> readers;
+    for (const auto& decorated_term : decorated_terms) {
+        readers.push_back(make_reader(decorated_term));
+    }
     term_reader_ = std::make_unique<TermOR>(std::move(readers));
 }
 
@@ -45,4 +84,16 @@ void GenericTermReader::seekToDocID(data::docid_t target_doc_id) {
     return term_reader_->seekToDocID(target_doc_id);
 }
 
+size_t GenericTermReader::bufferedDocIDs(const data::docid_t*& doc_ids) const {
+    return term_reader_->bufferedDocIDs(doc_ids);
+}
+
+const DenseDocSet* GenericTermReader::denseDocs() const {
+    return term_reader_->denseDocs();
+}
+
+size_t GenericTermReader::estimatedDocCount() const {
+    return term_reader_->estimatedDocCount();
+}
+
 }  // namespace mithril
\ No newline at end of file
@@ -1,23 +1,32 @@
 #ifndef INDEX_GENERIC_TERMREADER
 #define INDEX_GENERIC_TERMREADER
 
+#include "DeletionBitmap.h"
+#include "DensePostings.h"
 #include "IndexStreamReader.h"
 #include "core/mem_map_file.h"
 #include "TermDictionary.h"
 #include "PositionIndex.h"
 #include "TermOR.h"
+#include "TermReader.h"
 
 #include <string>
 #include <memory>
 
 namespace mithril {
 
+// Reader of a plain query term over every field. A term found in several fields is read from its any-field list
+// (see any_field_term), one list whose postings carry the fields of each document. The any-field entry of a term of
+// a single field points at that field's list, so either takes a single dictionary lookup. Indexes built without
+// any-field lists fall back to a union of the decorated lists.
 class GenericTermReader : public IndexStreamReader {
 public:
     GenericTermReader(const std::string& term,
                       const core::MemMapFile& index_file,
                       TermDictionary& term_dict,
-                      PositionIndex& position_index);
+                      PositionIndex& position_index,
+                      const DeletionBitmap* deleted = nullptr,
+                      const DensePostings* dense = nullptr);
 
     ~GenericTermReader() override = default;
 
@@ -26,19 +35,20 @@ public:
 
     data::docid_t currentDocID() const override;
     void seekToDocID(data::docid_t target_doc_id) override;
+    size_t bufferedDocIDs(const data::docid_t*& doc_ids) const override;
+    const DenseDocSet* denseDocs() const override;
+    size_t estimatedDocCount() const override;
 
     // Need to do these to make phrases work
     // TODO: hasPositions() const;
     // TODO: currentPositions() const;
-    // TODO: currentFrequency() const;
 
 private:
     std::string term_;
     const core::MemMapFile& index_file_;
     TermDictionary& term_dict_;
     PositionIndex& position_index_;
-    std::unique_ptr<TermOR> term_reader_;
-    // TODO: make this custom instead of relying on TermOR
+    std::unique_ptr<IndexStreamReader> term_reader_;
 };
 
 }  // namespace mithril
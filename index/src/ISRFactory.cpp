@@ -13,8 +13,14 @@ namespace mithril {
 
 TermReaderFactory::TermReaderFactory(const core::MemMapFile& index_file,
                                      TermDictionary& term_dict,
-                                     PositionIndex& position_index)
-    : index_file_(index_file), term_dict_(term_dict), position_index_(position_index) {}
+                                     PositionIndex& position_index,
+                                     const DeletionBitmap* deleted,
+                                     const DensePostings* dense)
+    : index_file_(index_file),
+      term_dict_(term_dict),
+      position_index_(position_index),
+      deleted_(deleted),
+      dense_(dense) {}
 
 std::unique_ptr<IndexStreamReader> TermReaderFactory::CreateISR(const std::string& term,
                                                                 FieldType field)
@@ -23,9 +29,12 @@ std::unique_ptr<IndexStreamReader> TermReaderFactory::CreateISR(const std::strin
     if (normalized_term == "" || StopwordFilter::isStopword(term)) {
         return std::make_unique<IdentityISR>();
     } else if (field == FieldType::ALL) {
-        return std::make_unique<GenericTermReader>(normalized_term, index_file_, term_dict_, position_index_);
+        return std::make_unique<GenericTermReader>(
+            normalized_term, index_file_, term_dict_, position_index_, deleted_, dense_);
+    } else if (const auto docs = dense_ != nullptr ? dense_->lookup(normalized_term) : std::nullopt) {
+        return std::make_unique<DenseTermReader>(*docs, deleted_);
     } else {
-        return std::make_unique<TermReader>("", normalized_term, index_file_, term_dict_, position_index_);
+        return std::make_unique<TermReader>("", normalized_term, index_file_, term_dict_, position_index_, deleted_);
     }
 }
 
@@ -1,6 +1,8 @@
 #ifndef INDEX_ISRFACTORY_H
 #define INDEX_ISRFACTORY_H
 
+#include "DeletionBitmap.h"
+#include "DensePostings.h"
 #include "IndexStreamReader.h"
 #include "core/mem_map_file.h"
 #include "TermDictionary.h"
@@ -16,7 +18,9 @@ class TermReaderFactory {
 public:
     TermReaderFactory(const core::MemMapFile& index_file,
                       TermDictionary& term_dict,
-                      PositionIndex& position_index);
+                      PositionIndex& position_index,
+                      const DeletionBitmap* deleted = nullptr,
+                      const DensePostings* dense = nullptr);
 
     TermReaderFactory(const TermReaderFactory&) = delete;
     TermReaderFactory& operator=(const TermReaderFactory&) = delete;
@@ -35,6 +39,9 @@ private:
     const core::MemMapFile& index_file_;
     TermDictionary& term_dict_;
     PositionIndex& position_index_;
+    const DeletionBitmap* deleted_;
+    // Terms with a bitmap are matched from it instead of their posting list
+    const DensePostings* dense_;
 };
 
 }  // namespace mithril
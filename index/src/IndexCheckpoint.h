@@ -0,0 +1,113 @@
+#ifndef INDEX_INDEXCHECKPOINT_H
+#define INDEX_INDEXCHECKPOINT_H
+
+#include "InvertedIndex.h"
+#include "data/Deserialize.h"
+#include "data/Serialize.h"
+
+#include <bit>
+#include <cstdint>
+#include <string>
+
+namespace mithril {
+
+// checkpoint/manifest.data describes everything an index build has made durable. Files it does not list are
+// leftovers from after the checkpoint and are deleted on resume.
+//   blocks/block_0 .. block_{block_count - 1}                   flushed posting blocks
+//   positions/buffer_0 .. buffer_{position_buffer_count - 1}    flushed position buffers
+//   checkpoint/docs_0 .. docs_{document_fragment_count - 1}     document metadata added between checkpoints
+// The manifest is written to a temporary file and renamed over the old one, so it is always the old or the new
+// checkpoint, never a mix.
+struct IndexCheckpoint {
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t version{VERSION};
+    uint32_t block_count{0};
+    uint32_t position_buffer_count{0};
+    uint32_t document_fragment_count{0};
+    uint64_t document_count{0};
+    IndexStatistics stats;
+    std::string last_document;  // Path of the last document ingested before the checkpoint, for the log
+};
+
+namespace data {
+
+template<>
+struct Serialize<DocumentMetadata> {
+    template<Writer W>
+    static void Write(const DocumentMetadata& meta, W& w) {
+        SerializeValue(meta.id, w);
+        SerializeValue(meta.url, w);
+        SerializeValue(meta.title, w);
+        SerializeValue(meta.body_length, w);
+        SerializeValue(meta.title_length, w);
+        SerializeValue(meta.url_length, w);
+        SerializeValue(meta.desc_length, w);
+        SerializeValue(std::bit_cast<uint32_t>(meta.pagerank_score), w);
+    }
+};
+
+template<>
+struct Deserialize<DocumentMetadata> {
+    template<Reader R>
+    static bool Read(DocumentMetadata& meta, R& r) {
+        uint32_t pagerank_bits = 0;
+        // clang-format off
+        bool ok = DeserializeValue(meta.id, r)
+            && DeserializeValue(meta.url, r)
+            && DeserializeValue(meta.title, r)
+            && DeserializeValue(meta.body_length, r)
+            && DeserializeValue(meta.title_length, r)
+            && DeserializeValue(meta.url_length, r)
+            && DeserializeValue(meta.desc_length, r)
+            && DeserializeValue(pagerank_bits, r);
+        // clang-format on
+        meta.pagerank_score = std::bit_cast<float>(pagerank_bits);
+        return ok;
+    }
+};
+
+template<>
+struct Serialize<IndexCheckpoint> {
+    template<Writer W>
+    static void Write(const IndexCheckpoint& checkpoint, W& w) {
+        SerializeValue(checkpoint.version, w);
+        SerializeValue(checkpoint.block_count, w);
+        SerializeValue(checkpoint.position_buffer_count, w);
+        SerializeValue(checkpoint.document_fragment_count, w);
+        SerializeValue(checkpoint.document_count, w);
+        SerializeValue(checkpoint.stats.doc_count, w);
+        SerializeValue(checkpoint.stats.total_title_length, w);
+        SerializeValue(checkpoint.stats.total_body_length, w);
+        SerializeValue(checkpoint.stats.total_url_length, w);
+        SerializeValue(checkpoint.stats.total_desc_length, w);
+        SerializeValue(checkpoint.last_document, w);
+    }
+};
+
+template<>
+struct Deserialize<IndexCheckpoint> {
+    template<Reader R>
+    static bool Read(IndexCheckpoint& checkpoint, R& r) {
+        // clang-format off
+        return DeserializeValue(checkpoint.version, r)
+            && checkpoint.version == IndexCheckpoint::VERSION
+            && DeserializeValue(checkpoint.block_count, r)
+            && DeserializeValue(checkpoint.position_buffer_count, r)
+            && DeserializeValue(checkpoint.document_fragment_count, r)
+            && DeserializeValue(checkpoint.document_count, r)
+            && DeserializeValue(checkpoint.stats.doc_count, r)
+            && DeserializeValue(checkpoint.stats.total_title_length, r)
+            && DeserializeValue(checkpoint.stats.total_body_length, r)
+            && DeserializeValue(checkpoint.stats.total_url_length, r)
+            && DeserializeValue(checkpoint.stats.total_desc_length, r)
+            && DeserializeValue(checkpoint.last_document, r);
+        // clang-format on
+    }
+};
+
+}  // namespace data
+
+}  // namespace mithril
+
+#endif  // INDEX_INDEXCHECKPOINT_H
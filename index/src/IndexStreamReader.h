@@ -3,10 +3,14 @@
 
 #include "data/Document.h"
 
+#include <cstddef>
+#include <limits>
 #include <optional>
 
 namespace mithril {
 
+class DenseDocSet;
+
 class IndexStreamReader {
 public:
     virtual ~IndexStreamReader() = default;
@@ -18,6 +22,18 @@ public:
     virtual void seekToDocID(data::docid_t target_doc_id) = 0;
 
     virtual bool isIdentity() const { return false; }
+
+    // Doc IDs already decoded from the current one to the end of the reader's current block, which intersections
+    // can compare in bulk. They may include documents the reader skips. Readers without such a block return 0.
+    virtual size_t bufferedDocIDs(const data::docid_t*& /*doc_ids*/) const { return 0; }
+
+    // Bitmap of every document the reader matches when it reads a dense term (see DensePostings.h), nullptr
+    // otherwise. NOT takes the complement off it.
+    virtual const DenseDocSet* denseDocs() const { return nullptr; }
+
+    // Upper bound on the documents the reader matches, taken from list metadata without decoding anything. TermAND
+    // orders its readers on it, readers that cannot tell return the maximum and go last.
+    virtual size_t estimatedDocCount() const { return std::numeric_limits<size_t>::max(); }
 };
 
 }  // namespace mithril
@@ -0,0 +1,270 @@
+#include "IngestPipeline.h"
+
+#include "data/Deserialize.h"
+#include "data/Gzip.h"
+#include "data/Reader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <spdlog/spdlog.h>
+
+namespace mithril {
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+uint64_t ElapsedNs(Clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+}
+
+double Percent(uint64_t part, uint64_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(whole);
+}
+}  // namespace
+
+IngestPipeline::IngestPipeline(IndexBuilder& builder, std::string input_dir, Options options)
+    : builder_(builder), input_dir_(std::move(input_dir)), options_(options), paths_(options.path_queue_capacity) {
+    options_.enumerate_threads = std::max<size_t>(options_.enumerate_threads, 1);
+    if (options_.decode_threads == 0) {
+        options_.decode_threads = std::max<size_t>(std::thread::hardware_concurrency() / 2, 1);
+    }
+}
+
+size_t IngestPipeline::run(const std::function<bool()>& should_stop,
+                           const std::function<void(const Stats&)>& on_progress) {
+    start_ = Clock::now();
+
+    // Crawls are split into chunk directories, those are the units the enumerate threads share
+    const auto options = std::filesystem::directory_options::follow_directory_symlink;
+    for (const auto& entry : std::filesystem::directory_iterator(input_dir_, options)) {
+        directories_.push_back(entry.path());
+    }
+
+    spdlog::info("Ingesting {} top level entries with {} enumerate and {} decode threads",
+                 directories_.size(),
+                 options_.enumerate_threads,
+                 options_.decode_threads);
+
+    running_enumerators_ = options_.enumerate_threads;
+    running_decoders_ = options_.decode_threads;
+    std::vector<std::thread> threads;
+    threads.reserve(options_.enumerate_threads + options_.decode_threads);
+    for (size_t i = 0; i < options_.enumerate_threads; ++i) {
+        threads.emplace_back(&IngestPipeline::enumerateLoop, this);
+    }
+    for (size_t i = 0; i < options_.decode_threads; ++i) {
+        threads.emplace_back(&IngestPipeline::decodeLoop, this);
+    }
+
+    auto last_progress = Clock::now();
+    size_t next_checkpoint = options_.checkpoint_interval;
+    std::exception_ptr checkpoint_error;
+    while (running_decoders_.load() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (!stop_ && should_stop && should_stop()) {
+            stop_ = true;
+            paths_.close();
+        }
+        if (on_progress && Clock::now() - last_progress >= std::chrono::seconds(1)) {
+            on_progress(stats_);
+            last_progress = Clock::now();
+        }
+        if (next_checkpoint != 0 && stats_.decode.items.load() >= next_checkpoint) {
+            try {
+                builder_.checkpoint(lastDocument());
+            } catch (...) {
+                // Stop ingesting and let the caller see the failure once the threads are joined
+                checkpoint_error = std::current_exception();
+                stop_ = true;
+                paths_.close();
+                next_checkpoint = 0;
+                continue;
+            }
+            next_checkpoint = stats_.decode.items.load() + options_.checkpoint_interval;
+        }
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (checkpoint_error) {
+        std::rethrow_exception(checkpoint_error);
+    }
+    end_ = Clock::now();
+
+    if (on_progress) {
+        on_progress(stats_);
+    }
+    return stats_.decode.items.load();
+}
+
+bool IngestPipeline::queuePath(std::filesystem::path path, uint64_t& blocked_ns) {
+    const auto wait_start = Clock::now();
+    const bool queued = paths_.push(std::move(path));
+    blocked_ns += ElapsedNs(wait_start);
+    if (queued) {
+        stats_.enumerate.items++;
+    }
+    return queued;
+}
+
+void IngestPipeline::enumerateLoop() {
+    const auto thread_start = Clock::now();
+    uint64_t blocked = 0;
+
+    const auto options = std::filesystem::directory_options::follow_directory_symlink;
+    for (size_t i = next_directory_++; i < directories_.size() && !stop_; i = next_directory_++) {
+        const std::filesystem::path& root = directories_[i];
+        try {
+            if (!std::filesystem::is_directory(root)) {
+                if (std::filesystem::is_regular_file(root) && !queuePath(root, blocked)) {
+                    break;
+                }
+                continue;
+            }
+
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(root, options)) {
+                if (stop_) {
+                    break;
+                }
+                if (!entry.is_regular_file()) {
+                    continue;  // skip chunk dir
+                }
+                if (!queuePath(entry.path(), blocked)) {
+                    break;
+                }
+            }
+        } catch (const std::exception& e) {
+            spdlog::error("Error enumerating {}: {}", root.string(), e.what());
+        }
+    }
+
+    stats_.enumerate.blocked_ns += blocked;
+    stats_.enumerate.busy_ns += ElapsedNs(thread_start) - blocked;
+
+    // The last enumerator lets the decoders drain the queue and finish
+    if (--running_enumerators_ == 0) {
+        paths_.close();
+    }
+}
+
+void IngestPipeline::decodeLoop() {
+    const auto thread_start = Clock::now();
+    uint64_t starved = 0;
+    uint64_t blocked = 0;
+
+    while (!stop_) {
+        auto wait_start = Clock::now();
+        auto path = paths_.pop();
+        starved += ElapsedNs(wait_start);
+        if (!path) {
+            break;
+        }
+        if (alreadyIndexed(*path)) {
+            stats_.skipped++;
+            continue;
+        }
+
+        Document doc;
+        try {
+            data::FileReader file{path->c_str()};
+            data::GzipReader gzip{file};
+            if (!data::DeserializeValue(doc, gzip)) {
+                spdlog::error("Failed to deserialize document: {}", path->string());
+                stats_.failed++;
+                continue;
+            }
+        } catch (const std::exception& e) {
+            spdlog::error("Error reading document {}: {}", path->string(), e.what());
+            stats_.failed++;
+            continue;
+        }
+
+        if (builder_.has_document(doc.id)) {
+            stats_.skipped++;
+            continue;
+        }
+
+        std::error_code ec;
+        const auto file_size = std::filesystem::file_size(*path, ec);
+        if (!ec) {
+            stats_.decode.bytes += file_size;
+        }
+
+        // Blocks while the builder's task queue is full
+        wait_start = Clock::now();
+        builder_.add_document(std::move(doc));
+        blocked += ElapsedNs(wait_start);
+        stats_.decode.items++;
+        {
+            std::lock_guard<std::mutex> lock(last_document_mutex_);
+            last_document_ = path->string();
+        }
+    }
+
+    stats_.decode.starved_ns += starved;
+    stats_.decode.blocked_ns += blocked;
+    stats_.decode.busy_ns += ElapsedNs(thread_start) - starved - blocked;
+    running_decoders_--;
+}
+
+bool IngestPipeline::alreadyIndexed(const std::filesystem::path& path) const {
+    // The crawler names documents doc_<id>, which lets a resumed build skip them without decoding
+    const std::string name = path.filename().string();
+    if (!name.starts_with("doc_")) {
+        return false;
+    }
+    data::docid_t id = 0;
+    const char* end = name.data() + name.size();
+    auto [ptr, ec] = std::from_chars(name.data() + 4, end, id);
+    return ec == std::errc{} && ptr == end && builder_.has_document(id);
+}
+
+std::string IngestPipeline::lastDocument() const {
+    std::lock_guard<std::mutex> lock(last_document_mutex_);
+    return last_document_;
+}
+
+void IngestPipeline::logSummary() const {
+    const uint64_t wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end_ - start_).count();
+    const double wall_sec = std::max(static_cast<double>(wall_ns) / 1e9, 1e-9);
+    const uint64_t enumerate_thread_ns = wall_ns * options_.enumerate_threads;
+    const uint64_t decode_thread_ns = wall_ns * options_.decode_threads;
+
+    const uint64_t files = stats_.enumerate.items.load();
+    const uint64_t decoded = stats_.decode.items.load();
+    const uint64_t indexed = builder_.documents_indexed();
+
+    spdlog::info("Ingest finished in {:.1f}s", wall_sec);
+    spdlog::info("  enumerate: {} files, {:.1f} files/sec, {:.1f}% busy, {:.1f}% blocked on decode",
+                 files,
+                 files / wall_sec,
+                 Percent(stats_.enumerate.busy_ns, enumerate_thread_ns),
+                 Percent(stats_.enumerate.blocked_ns, enumerate_thread_ns));
+    spdlog::info("  decode:    {} docs ({} failed, {} already indexed), {:.1f} docs/sec, {:.1f} MB/sec, {:.1f}% busy, "
+                 "{:.1f}% starved, {:.1f}% blocked on index",
+                 decoded,
+                 stats_.failed.load(),
+                 stats_.skipped.load(),
+                 decoded / wall_sec,
+                 static_cast<double>(stats_.decode.bytes.load()) / (1024.0 * 1024.0) / wall_sec,
+                 Percent(stats_.decode.busy_ns, decode_thread_ns),
+                 Percent(stats_.decode.starved_ns, decode_thread_ns),
+                 Percent(stats_.decode.blocked_ns, decode_thread_ns));
+    spdlog::info("  index:     {} docs, {:.1f} docs/sec, {} still queued",
+                 indexed,
+                 indexed / wall_sec,
+                 decoded > indexed ? decoded - indexed : 0);
+
+    // Decoders sit between the other two stages, where they spend their time points at the slowest stage
+    const double blocked = Percent(stats_.decode.blocked_ns, decode_thread_ns);
+    const double starved = Percent(stats_.decode.starved_ns, decode_thread_ns);
+    const char* bottleneck = blocked > 50.0 ? "index" : starved > 50.0 ? "enumerate" : "decode";
+    spdlog::info("  bottleneck: {}", bottleneck);
+}
+
+}  // namespace mithril
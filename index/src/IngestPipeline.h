@@ -0,0 +1,91 @@
+#ifndef INDEX_INGESTPIPELINE_H
+#define INDEX_INGESTPIPELINE_H
+
+#include "BoundedQueue.h"
+#include "InvertedIndex.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mithril {
+
+// Feeds a crawl directory into an IndexBuilder in three stages connected by bounded queues:
+//   enumerate: threads walk the chunk directories of the crawl in parallel and queue document paths
+//   decode:    threads read, inflate and deserialize documents and hand them to the builder
+//   index:     the builder's worker pool tokenizes and indexes, its task queue is bounded too
+// Every stage records how long it spent working and how long it waited on its neighbours, so the summary shows
+// which stage limits throughput.
+class IngestPipeline {
+public:
+    struct Options {
+        size_t enumerate_threads{4};
+        size_t decode_threads{0};  // 0 uses half the hardware threads
+        size_t path_queue_capacity{4096};
+        size_t checkpoint_interval{0};  // Documents between builder checkpoints, 0 never checkpoints
+    };
+
+    struct StageStats {
+        std::atomic<uint64_t> items{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> busy_ns{0};
+        std::atomic<uint64_t> starved_ns{0};  // Waiting for input
+        std::atomic<uint64_t> blocked_ns{0};  // Waiting for room downstream
+    };
+
+    struct Stats {
+        StageStats enumerate;
+        StageStats decode;
+        std::atomic<uint64_t> failed{0};
+        std::atomic<uint64_t> skipped{0};  // Already indexed before a resume
+    };
+
+    IngestPipeline(IndexBuilder& builder, std::string input_dir, Options options);
+
+    // Runs until every document is queued in the builder or should_stop returns true. on_progress is called
+    // from the calling thread about once a second. Returns the number of documents handed to the builder. Throws
+    // what a failed checkpoint threw once every thread has stopped.
+    size_t run(const std::function<bool()>& should_stop,
+               const std::function<void(const Stats&)>& on_progress = nullptr);
+
+    const Stats& stats() const { return stats_; }
+    // Path of the document most recently handed to the builder
+    std::string lastDocument() const;
+    void logSummary() const;
+
+    IngestPipeline(const IngestPipeline&) = delete;
+    IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+private:
+    IndexBuilder& builder_;
+    const std::string input_dir_;
+    Options options_;
+    Stats stats_;
+
+    BoundedQueue<std::filesystem::path> paths_;
+    std::vector<std::filesystem::path> directories_;  // Walked by the enumerate stage
+    std::atomic<size_t> next_directory_{0};
+    std::atomic<size_t> running_enumerators_{0};
+    std::atomic<size_t> running_decoders_{0};
+    std::atomic<bool> stop_{false};
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point end_;
+
+    mutable std::mutex last_document_mutex_;
+    std::string last_document_;
+
+    void enumerateLoop();
+    void decodeLoop();
+    bool queuePath(std::filesystem::path path, uint64_t& blocked_ns);
+    bool alreadyIndexed(const std::filesystem::path& path) const;
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_INGESTPIPELINE_H
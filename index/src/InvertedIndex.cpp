@@ -1,21 +1,41 @@
 #include "InvertedIndex.h"
 
+#include "DocumentMapReader.h"
+#include "IndexCheckpoint.h"
 #include "PositionIndex.h"
+#include "PostingCodec.h"
+#include "TermDictionary.h"
+#include "TermReader.h"
 #include "TextPreprocessor.h"
 #include "Utils.h"
+#include "core/mem_map_file.h"
 #include "data/Deserialize.h"
 #include "data/Gzip.h"
 #include "data/Reader.h"
 #include "data/Writer.h"
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
 #include <fcntl.h>
 #include <filesystem>
 #include <fstream>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <semaphore>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <utility>
 #include <vector>
 #include <spdlog/spdlog.h>
 #include <sys/mman.h>
@@ -85,17 +105,58 @@ public:
 };
 
 
-IndexBuilder::IndexBuilder(const std::string& output_dir, size_t num_threads, size_t max_terms_per_block)
+IndexBuilder::IndexBuilder(const std::string& output_dir,
+                           size_t num_threads,
+                           size_t max_terms_per_block,
+                           size_t memory_budget)
     : output_dir_(output_dir),
-      max_terms_per_block_(max_terms_per_block == 0 ? DEFAULT_MAX_TERMS_PER_BLOCK : max_terms_per_block) {
-    spdlog::info("Initializing IndexBuilder: Output='{}', Threads={}, MaxTermsPerBlock={}",
-                 output_dir_,
-                 num_threads,
-                 max_terms_per_block_);
+      max_terms_per_block_(max_terms_per_block),
+      position_builder_(output_dir,
+                        std::max<size_t>(num_threads, 1),
+                        (memory_budget == 0 ? DEFAULT_MEMORY_BUDGET : memory_budget) / 4) {
+    num_threads = std::max<size_t>(num_threads, 1);
+    if (memory_budget == 0) {
+        memory_budget = DEFAULT_MEMORY_BUDGET;
+    }
+    // Decoded documents are large, bound how many wait for a worker
+    max_queued_documents_ = num_threads * QUEUED_DOCUMENTS_PER_WORKER;
     std::filesystem::create_directories(output_dir);
     std::filesystem::create_directories(output_dir + "/blocks");
+
+    // Unique terms grow sublinearly with documents, so each worker block holds nearly as many terms as one shared
+    // block would. Size the buckets for a full block at a load factor of one, every worker keeps its own.
+    const size_t bucket_size_hint =
+        std::bit_ceil(max_terms_per_block_ == 0 ? DEFAULT_MAX_TERMS_PER_BLOCK : max_terms_per_block_);
+    worker_blocks_.reserve(num_threads);
     for (size_t i = 0; i < num_threads; ++i) {
-        workers_.emplace_back(&IndexBuilder::worker_thread, this);
+        worker_blocks_.push_back(std::make_unique<WorkerBlock>(i, bucket_size_hint));
+        // The bucket array stays allocated across flushes, count it once
+        posting_bytes_ += worker_blocks_.back()->dictionary.base_memory_usage();
+    }
+
+    // Blocks flush once their postings reach the worker's share of what the bucket arrays leave of the posting
+    // budget, the term limit only caps the dictionary of a block made of many rare terms
+    const size_t posting_budget = memory_budget - memory_budget / 4;
+    const size_t bucket_bytes = posting_bytes_.load();
+    if (bucket_bytes >= posting_budget) {
+        spdlog::warn("The bucket arrays of {} workers take {} MB, more than the {} MB posting budget",
+                     num_threads,
+                     bucket_bytes >> 20,
+                     posting_budget >> 20);
+    }
+    max_bytes_per_worker_block_ =
+        std::max<size_t>((posting_budget - std::min(bucket_bytes, posting_budget)) / num_threads, 1);
+
+    spdlog::info("Initializing IndexBuilder: Output='{}', Threads={}, MaxTermsPerBlock={}, "
+                 "MemoryBudget={} MB ({} MB postings per worker)",
+                 output_dir_,
+                 num_threads,
+                 max_terms_per_block_,
+                 memory_budget >> 20,
+                 max_bytes_per_worker_block_ >> 20);
+    peak_posting_bytes_ = posting_bytes_.load();
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers_.emplace_back(&IndexBuilder::worker_thread, this, i);
     }
 }
 
@@ -105,6 +166,7 @@ IndexBuilder::~IndexBuilder() {
         stop_ = true;
     }
     condition_.notify_all();
+    queue_not_full_.notify_all();
     for (std::thread& worker : workers_) {
         if (worker.joinable()) {
             worker.join();
@@ -112,9 +174,10 @@ IndexBuilder::~IndexBuilder() {
     }
 }
 
-void IndexBuilder::worker_thread() {
+void IndexBuilder::worker_thread(size_t worker_id) {
+    WorkerBlock& block = *worker_blocks_[worker_id];
     while (true) {
-        std::function<void()> task;
+        std::function<void(WorkerBlock&)> task;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
             condition_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
@@ -124,28 +187,137 @@ void IndexBuilder::worker_thread() {
             task = std::move(tasks_.front());
             tasks_.pop();
         }
+        queue_not_full_.notify_one();
 
         try {
-            task();
+            task(block);
+
+            // Each worker flushes its own block, the others keep indexing meanwhile
+            if (block.bytes >= max_bytes_per_worker_block_) {
+                block_flushes_by_bytes_++;
+                flush_block(block);
+            } else if (max_terms_per_block_ > 0 && block.term_count >= max_terms_per_block_) {
+                flush_block(block);
+            }
         } catch (const std::exception& e) {
             spdlog::error("Exception caught in worker thread task: {}", e.what());
         } catch (...) {
             spdlog::error("Unknown exception caught in worker thread task.");
         }
 
-        active_tasks_--;
+        {
+            // Under the lock so wait_for_tasks() can't miss the last task finishing
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            active_tasks_--;
+        }
         condition_.notify_all();  // Notify finalize() thread potentially waiting
     }
 }
 
-bool IndexBuilder::should_flush() {
-    // Flush based on number of unique terms added to the block's dictionary instead of previous mem size estimate
-    // approach flush_block will re-verify state under lock.
-    return current_block_term_count_ >= max_terms_per_block_;
+void IndexBuilder::enqueue_task(std::function<void(WorkerBlock&)> task) {
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        tasks_.emplace(std::move(task));
+    }
+    condition_.notify_one();
+}
+
+void IndexBuilder::wait_for_tasks() {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    condition_.wait(lock, [this] { return tasks_.empty() && active_tasks_.load() == 0; });
 }
 
 namespace {  // anon namespace for helpers
 
+bool posting_doc_id_less(const Posting& a, const Posting& b) {
+    return a.doc_id < b.doc_id;
+}
+
+uint64_t total_file_size(const std::vector<std::string>& paths) {
+    uint64_t total = 0;
+    for (const auto& path : paths) {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(path, ec);
+        if (!ec) {
+            total += size;
+        }
+    }
+    return total;
+}
+
+// Sort key that clusters a URL with the rest of its site: the host's labels reversed, so subdomains sort next to
+// their domain, then the path. "https://www.example.com/a/b" gives "com.example.www/a/b".
+std::string url_order_key(std::string_view url) {
+    const auto scheme_end = url.find("://");
+    if (scheme_end != std::string_view::npos) {
+        url.remove_prefix(scheme_end + 3);
+    }
+    const size_t host_end = std::min(url.find_first_of("/?#"), url.size());
+    std::string_view host = url.substr(0, std::min(url.find(':'), host_end));
+
+    std::string key;
+    key.reserve(url.size());
+    while (!host.empty()) {
+        const size_t dot = host.rfind('.');
+        const std::string_view label = dot == std::string_view::npos ? host : host.substr(dot + 1);
+        for (const char c : label) {
+            key += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        host = dot == std::string_view::npos ? std::string_view{} : host.substr(0, dot);
+        if (!host.empty()) {
+            key += '.';
+        }
+    }
+    key.append(url.substr(host_end));
+    return key;
+}
+
+// Folds postings of the same document, which an any-field list gets from each field the term occurs in, into one
+// holding the summed frequency and the fields of both
+void coalesce_any_field(std::vector<Posting>& postings) {
+    size_t out = 0;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        if (out > 0 && postings[out - 1].doc_id == postings[i].doc_id) {
+            const uint32_t prev = postings[out - 1].freq;
+            const uint32_t cur = postings[i].freq;
+            postings[out - 1].freq = pack_any_field(any_field_frequency(prev) + any_field_frequency(cur),
+                                                    any_field_mask(prev) | any_field_mask(cur));
+        } else {
+            postings[out++] = postings[i];
+        }
+    }
+    postings.resize(out);
+}
+
+// Time to decode every block of an encoded posting list, used to compare doc orders
+std::chrono::nanoseconds time_decode(const std::vector<BlockSyncPoint>& sync_points,
+                                     const std::vector<char>& encoded,
+                                     size_t postings_count) {
+    uint32_t doc_ids[PostingBlockCodec::BLOCK_SIZE];
+    uint32_t freqs[PostingBlockCodec::BLOCK_SIZE];
+    uint64_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < sync_points.size(); ++b) {
+        const size_t count =
+            std::min(PostingBlockCodec::BLOCK_SIZE, postings_count - b * PostingBlockCodec::BLOCK_SIZE);
+        const char* end = b + 1 < sync_points.size() ? encoded.data() + sync_points[b + 1].byte_offset
+                                                      : encoded.data() + encoded.size();
+        PostingBlockCodec::decode_block(FINAL_POSTING_CODEC,
+                                        encoded.data() + sync_points[b].byte_offset,
+                                        end,
+                                        count,
+                                        sync_points[b].base_doc_id,
+                                        doc_ids,
+                                        freqs);
+        checksum += doc_ids[count - 1] + freqs[0];
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    // Keeps the decode from being optimized away
+    volatile uint64_t sink = checksum;
+    static_cast<void>(sink);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+}
+
 std::vector<std::string> tokenizeUrl(std::string_view url) {
     std::vector<std::string> tokens;
     const char* delims = "/.-_?&=";
@@ -213,14 +385,7 @@ void processField(const std::vector<std::string>& words,
 }  // namespace
 
 void IndexBuilder::process_document(Document doc) {
-    if (should_flush()) {
-        auto future = flush_block();
-        if (future.valid()) {
-            future.wait();
-        }
-    }
-
-    auto task = [this, doc = std::move(doc)]() {
+    auto task = [this, doc = std::move(doc)](WorkerBlock& block) {
         const size_t estimated_unique_terms =
             doc.words.size() / 4 + doc.title.size() + doc.description.size() + doc.url.size() / 5 + 10;
         std::unordered_map<std::string, uint32_t> term_freqs;
@@ -282,25 +447,32 @@ void IndexBuilder::process_document(Document doc) {
         }
 
         if (!position_batch.empty()) {
-            PositionIndex::addPositionsBatch(output_dir_, doc.id, std::move(position_batch));  // Move the batch
+            position_builder_.addPositionsBatch(block.id, doc.id, std::move(position_batch));  // Move the batch
         }
 
-        {
-            std::lock_guard<std::mutex> lock(block_mutex_);
-            for (const auto& [term, freq] : term_freqs) {
-                auto& postings = dictionary_.get_or_create(term);
-                bool term_was_new_to_block = postings.empty();
-                postings.add(doc.id, freq);
-                if (term_was_new_to_block) {
-                    current_block_term_count_++;
-                }
+        // The block belongs to the worker running this task, no locking needed
+        size_t added_bytes = 0;
+        for (const auto& [term, freq] : term_freqs) {
+            auto& postings = block.dictionary.get_or_create(term);
+            const size_t bytes_before = postings.memory_usage();
+            bool term_was_new_to_block = postings.empty();
+            postings.add(doc.id, freq);
+            added_bytes += postings.memory_usage() - bytes_before;
+            if (term_was_new_to_block) {
+                block.term_count++;
+                added_bytes += Dictionary::term_memory_usage(term);
             }
         }
+        add_block_bytes(block, added_bytes);
+
+        documents_indexed_.fetch_add(1, std::memory_order_relaxed);
     };  // End of lambda task
 
-    // Enqueue the processing task
     {
+        // Waiting and queueing under one lock, so a checkpoint never sees a document slip in after it started
         std::unique_lock<std::mutex> lock(queue_mutex_);
+        queue_not_full_.wait(
+            lock, [this] { return stop_ || (!checkpointing_ && tasks_.size() < max_queued_documents_); });
         tasks_.emplace(std::move(task));
     }
     condition_.notify_one();
@@ -334,81 +506,328 @@ void IndexBuilder::add_document(const std::string& doc_path) {
     process_document(std::move(doc));
 }
 
-std::future<void> IndexBuilder::flush_block() {
-    if (current_block_term_count_ == 0) {
-        return std::future<void>();
+void IndexBuilder::add_document(Document doc) {
+    process_document(std::move(doc));
+}
+
+void IndexBuilder::add_block_bytes(WorkerBlock& block, size_t bytes) {
+    block.bytes += bytes;
+    const size_t total = posting_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peak_posting_bytes_.load(std::memory_order_relaxed);
+    while (total > peak && !peak_posting_bytes_.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {
     }
+}
 
-    std::vector<std::tuple<std::string, std::vector<Posting>>> sorted_terms;
-    sorted_terms.reserve(current_block_term_count_);
+void IndexBuilder::checkpoint(const std::string& last_document) {
+    const auto start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        checkpointing_ = true;
+    }
+    wait_for_tasks();
 
-    bool dictionary_was_empty = false;
+    // Workers are idle and new documents wait on checkpointing_, every block can be flushed from here
+    for (auto& block : worker_blocks_) {
+        flush_block(*block);
+    }
+    const auto resume_documents = [this] {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            checkpointing_ = false;
+        }
+        queue_not_full_.notify_all();
+    };
+    size_t position_buffers = 0;
+    try {
+        position_buffers = position_builder_.checkpoint();
+    } catch (...) {
+        // A position buffer failed to write, the previous checkpoint stays the one to resume from
+        resume_documents();
+        throw;
+    }
+    write_checkpoint(last_document, position_buffers);
+    resume_documents();
+
+    spdlog::info("Checkpoint: {} documents, {} blocks, {} position buffers in {} ms",
+                 checkpointed_documents_,
+                 block_count_.load(),
+                 position_buffers,
+                 std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+                     .count());
+}
+
+void IndexBuilder::write_checkpoint(const std::string& last_document, size_t position_buffers) {
+    const std::string dir = checkpoint_dir();
+    std::filesystem::create_directories(dir);
+
+    IndexCheckpoint manifest;
     {
-        std::lock_guard<std::mutex> lock(block_mutex_);
-        if (current_block_term_count_ == 0) {
-            dictionary_was_empty = true;
-        } else {
-            dictionary_.iterate_terms([&](const std::string& term, const PostingList& postings) {
-                if (!postings.empty()) {
-                    sorted_terms.emplace_back(term, postings.postings());
-                }
-            });
+        std::lock_guard<std::mutex> lock(document_mutex_);
+        if (document_metadata_.size() > checkpointed_documents_) {
+            // A fragment numbered past the manifest is a leftover of a failed checkpoint, overwriting it is fine
+            const std::string path = dir + "/docs_" + std::to_string(document_fragments_) + ".data";
+            data::FileWriter out(path.c_str());
+            data::SerializeValue(static_cast<uint32_t>(document_metadata_.size() - checkpointed_documents_), out);
+            for (size_t i = checkpointed_documents_; i < document_metadata_.size(); ++i) {
+                data::SerializeValue(document_metadata_[i], out);
+            }
+            out.Close();
+            document_fragments_++;
+            checkpointed_documents_ = document_metadata_.size();
+        }
+        manifest.document_count = checkpointed_documents_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        manifest.stats = stats_;
+    }
+    manifest.block_count = static_cast<uint32_t>(block_count_.load());
+    manifest.position_buffer_count = static_cast<uint32_t>(position_buffers);
+    manifest.document_fragment_count = document_fragments_;
+    manifest.last_document = last_document;
+
+    const std::string manifest_path = dir + "/manifest.data";
+    const std::string temp_path = manifest_path + ".tmp";
+    {
+        data::FileWriter out(temp_path.c_str());
+        data::SerializeValue(manifest, out);
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp_path, manifest_path, ec);
+    if (ec) {
+        spdlog::error("Failed to write checkpoint manifest {}: {}", manifest_path, ec.message());
+    }
+}
+
+bool IndexBuilder::resume() {
+    const std::string manifest_path = checkpoint_dir() + "/manifest.data";
+    if (!std::filesystem::exists(manifest_path)) {
+        return false;
+    }
 
-            dictionary_.clear_postings();
-            current_block_term_count_ = 0;
+    IndexCheckpoint manifest;
+    {
+        data::FileReader in(manifest_path.c_str());
+        if (!data::DeserializeValue(manifest, in)) {
+            throw std::runtime_error("Unreadable checkpoint manifest, rebuild with --force: " + manifest_path);
         }
     }
 
-    // If dictionary was actually empty when lock was acquired, or no terms with postings found
-    if (dictionary_was_empty || sorted_terms.empty()) {
-        // Reset block count just in case if we thought we were flushing but weren't
-        // increment block_count_ only when successfully launching the async task
-        return std::future<void>();
+    std::lock_guard<std::mutex> lock(document_mutex_);
+    document_metadata_.clear();
+    document_metadata_.reserve(manifest.document_count);
+    for (uint32_t i = 0; i < manifest.document_fragment_count; ++i) {
+        const std::string path = checkpoint_dir() + "/docs_" + std::to_string(i) + ".data";
+        data::FileReader in(path.c_str());
+        uint32_t count = 0;
+        if (!data::DeserializeValue(count, in)) {
+            throw std::runtime_error("Unreadable checkpoint fragment: " + path);
+        }
+        for (uint32_t j = 0; j < count; ++j) {
+            DocumentMetadata meta;
+            if (!data::DeserializeValue(meta, in)) {
+                throw std::runtime_error("Unreadable checkpoint fragment: " + path);
+            }
+            url_to_id_[meta.url] = meta.id;
+            document_metadata_.push_back(std::move(meta));
+        }
+    }
+    if (document_metadata_.size() != manifest.document_count) {
+        throw std::runtime_error("Checkpoint fragments don't match the manifest: " + manifest_path);
     }
 
-    // Prepare path and launch async write task
-    std::string block_path = this->block_path(block_count_++);
+    checkpointed_documents_ = document_metadata_.size();
+    document_fragments_ = manifest.document_fragment_count;
+    {
+        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+        stats_ = manifest.stats;
+    }
 
-    return std::async(std::launch::async, [sorted_terms = std::move(sorted_terms), block_path]() {
-        // Use ofstream for RAII file handling
-        std::ofstream out(block_path, std::ios::binary | std::ios::trunc);
-        if (!out) {
-            spdlog::error("Failed to open block file for writing: {}", block_path);
-            return;
+    resumed_doc_ids_.reserve(document_metadata_.size());
+    for (const auto& meta : document_metadata_) {
+        resumed_doc_ids_.push_back(meta.id);
+    }
+    std::sort(resumed_doc_ids_.begin(), resumed_doc_ids_.end());
+
+    // Blocks and position buffers past the checkpoint hold documents that will be indexed again
+    block_count_ = static_cast<int>(manifest.block_count);
+    for (const auto& entry : std::filesystem::directory_iterator(output_dir_ + "/blocks")) {
+        int block_num = -1;
+        if (std::sscanf(entry.path().filename().c_str(), "block_%d.data", &block_num) == 1 && block_num >= 0 &&
+            block_num < block_count_) {
+            continue;
         }
+        spdlog::info("Removing block written after the checkpoint: {}", entry.path().string());
+        std::filesystem::remove(entry.path());
+    }
+    position_builder_.resume(manifest.position_buffer_count);
+
+    spdlog::info("Resuming from checkpoint: {} documents, {} blocks, {} position buffers, last document {}",
+                 document_metadata_.size(),
+                 block_count_.load(),
+                 manifest.position_buffer_count,
+                 manifest.last_document.empty() ? "unknown" : manifest.last_document);
+    return true;
+}
 
-        uint32_t num_terms = sorted_terms.size();
-        out.write(reinterpret_cast<const char*>(&num_terms), sizeof(num_terms));
+bool IndexBuilder::has_document(docid_t id) const {
+    return std::binary_search(resumed_doc_ids_.begin(), resumed_doc_ids_.end(), id);
+}
 
-        for (const auto& [term, postings] : sorted_terms) {
-            uint32_t term_len = term.size();
-            out.write(reinterpret_cast<const char*>(&term_len), sizeof(term_len));
-            out.write(term.c_str(), term_len);
+void IndexBuilder::import_segment(const std::string& segment_dir) {
+    const auto start = std::chrono::steady_clock::now();
+    spdlog::info("Importing segment {}", segment_dir);
+
+    TermDictionary term_dict(segment_dir);
+    PositionIndex position_index(segment_dir);
+    core::MemMapFile index_file(segment_dir + "/final_index.data");
+    // Compaction is where deleted documents finally leave the index
+    const DeletionBitmap deleted(segment_dir);
+    if (!term_dict.is_loaded()) {
+        throw std::runtime_error("Segment has no term dictionary: " + segment_dir);
+    }
 
-            uint32_t postings_size = postings.size();
-            out.write(reinterpret_cast<const char*>(&postings_size), sizeof(postings_size));
+    // A segment built with another doc order is brought back to crawl IDs, finalize() applies this builder's order
+    DocumentMapReader documents(segment_dir);
+    std::vector<docid_t> crawl_ids(documents.slotCount(), DocumentMapReader::HOLE_DOC_ID);
+    for (size_t slot = 0; slot < documents.slotCount(); ++slot) {
+        if (documents.findDocInfo(documents.baseDocID() + slot) != nullptr) {
+            crawl_ids[slot] = documents.crawlDocID(documents.baseDocID() + slot);
+        }
+    }
+    const DocIdMap to_crawl_ids(documents.baseDocID(), std::move(crawl_ids));
+
+    // The dictionary is sorted, so its terms go straight into a block
+    BlockWriter out(block_path(block_count_++));
+    std::vector<Posting> postings;
+    term_dict.for_each_term([&](const TermDictionary::TermEntry& entry) {
+        // finalize() picks the champions and unions the fields of the merged lists anew
+        if (is_champion_term(entry.term) || is_any_field_term(entry.term)) {
+            return;
+        }
+        postings.clear();
+        postings.reserve(entry.postings_count);
+        TermReader reader(segment_dir, entry.term, index_file, term_dict, position_index, &deleted);
+        for (; reader.hasNext(); reader.moveNext()) {
+            postings.push_back({to_crawl_ids(reader.currentDocID()), reader.currentFrequency()});
+        }
+        if (!std::is_sorted(postings.begin(), postings.end(), posting_doc_id_less)) {
+            std::sort(postings.begin(), postings.end(), posting_doc_id_less);
+        }
+        if (!postings.empty()) {
+            out.add_term(entry.term, postings);
+        }
+    });
+    out.finish();
 
-            // Calculate and write sync points
-            std::vector<SyncPoint> sync_points;
-            sync_points.reserve(postings_size / PostingList::SYNC_INTERVAL + 1);
-            for (uint32_t i = 0; i < postings.size(); i += PostingList::SYNC_INTERVAL) {
-                SyncPoint sp{postings[i].doc_id, i};
-                sync_points.push_back(sp);
-            }
+    const size_t position_terms = position_builder_.importPositions(position_index, &deleted, to_crawl_ids);
 
-            uint32_t sync_points_size = sync_points.size();
-            out.write(reinterpret_cast<const char*>(&sync_points_size), sizeof(sync_points_size));
-            if (sync_points_size > 0) {
-                out.write(reinterpret_cast<const char*>(sync_points.data()), sync_points_size * sizeof(SyncPoint));
+    IndexStatistics deleted_stats;
+    {
+        std::lock_guard<std::mutex> lock(document_mutex_);
+        document_metadata_.reserve(document_metadata_.size() + documents.documentCount());
+        for (size_t slot = 0; slot < documents.slotCount(); ++slot) {
+            const auto view = documents.getDocumentView(documents.baseDocID() + slot);
+            if (!view) {
+                continue;
+            }
+            if (deleted.isDeleted(view->id())) {
+                deleted_stats.doc_count++;
+                deleted_stats.total_body_length += view->info->body_length;
+                deleted_stats.total_title_length += view->titleTokenCount();
+                deleted_stats.total_url_length += tokenizeUrl(view->url).size();
+                deleted_stats.total_desc_length += view->info->desc_length;
+                continue;
             }
 
-            // Write the actual postings
-            if (postings_size > 0) {
-                out.write(reinterpret_cast<const char*>(postings.data()), postings_size * sizeof(Posting));
+            DocumentMetadata meta{to_crawl_ids(view->id()), std::string(view->url), {}};
+            meta.title.reserve(view->titleTokenCount());
+            for (size_t i = 0; i < view->titleTokenCount(); ++i) {
+                meta.title.emplace_back(view->titleToken(i));
             }
+            meta.body_length = view->info->body_length;
+            meta.title_length = view->titleTokenCount();
+            meta.desc_length = view->info->desc_length;
+            meta.pagerank_score = view->info->pagerank_score;
+            url_to_id_[meta.url] = meta.id;
+            document_metadata_.push_back(std::move(meta));
+        }
+    }
+
+    // Same layout save_index_stats() writes
+    IndexStatistics segment_stats;
+    std::ifstream stats_file(segment_dir + "/index_stats.data", std::ios::binary);
+    stats_file.read(reinterpret_cast<char*>(&segment_stats.doc_count), sizeof(segment_stats.doc_count));
+    stats_file.read(reinterpret_cast<char*>(&segment_stats.total_body_length), sizeof(segment_stats.total_body_length));
+    stats_file.read(reinterpret_cast<char*>(&segment_stats.total_title_length),
+                    sizeof(segment_stats.total_title_length));
+    stats_file.read(reinterpret_cast<char*>(&segment_stats.total_url_length), sizeof(segment_stats.total_url_length));
+    stats_file.read(reinterpret_cast<char*>(&segment_stats.total_desc_length), sizeof(segment_stats.total_desc_length));
+    if (!stats_file) {
+        spdlog::warn("Segment {} has no readable index stats, its documents won't count towards them", segment_dir);
+    } else {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.doc_count += segment_stats.doc_count - deleted_stats.doc_count;
+        stats_.total_body_length += segment_stats.total_body_length - deleted_stats.total_body_length;
+        stats_.total_title_length += segment_stats.total_title_length - deleted_stats.total_title_length;
+        stats_.total_url_length += segment_stats.total_url_length - deleted_stats.total_url_length;
+        stats_.total_desc_length += segment_stats.total_desc_length - deleted_stats.total_desc_length;
+    }
+
+    spdlog::info("Imported segment {}: {} terms, {} position terms, {} documents ({} deleted dropped) in {} ms",
+                 segment_dir,
+                 term_dict.size(),
+                 position_terms,
+                 documents.documentCount() - deleted_stats.doc_count,
+                 deleted_stats.doc_count,
+                 std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+                     .count());
+}
+
+IndexBuilder::MemoryStats IndexBuilder::memory_stats() const {
+    const PositionIndexBuilder::MemoryStats positions = position_builder_.memoryStats();
+    return MemoryStats{posting_bytes_.load(),
+                       positions.buffered_bytes,
+                       positions.pending_flush_bytes,
+                       peak_posting_bytes_.load(),
+                       block_flushes_.load(),
+                       block_flushes_by_bytes_.load(),
+                       flushed_posting_bytes_.load(),
+                       positions.flushes};
+}
+
+void IndexBuilder::flush_block(WorkerBlock& block) {
+    if (block.term_count == 0) {
+        return;
+    }
+
+    std::string block_path = this->block_path(block_count_++);
+
+    // Write straight from the dictionary, copying every posting list first would double the block's footprint at
+    // the moment it is largest
+    BlockWriter out(block_path);
+    std::vector<Posting> unsorted;
+    block.dictionary.iterate_terms([&](const std::string& term, const PostingList& postings) {
+        const std::vector<Posting>& list = postings.postings();
+        // Workers see documents roughly in doc ID order, only sort the lists that aren't
+        if (std::is_sorted(list.begin(), list.end(), posting_doc_id_less)) {
+            out.add_term(term, list);
+            return;
         }
-        // ofstream destructor handles closing
+        unsorted.assign(list.begin(), list.end());
+        std::sort(unsorted.begin(), unsorted.end(), posting_doc_id_less);
+        out.add_term(term, unsorted);
     });
+    out.finish();
+
+    // Drop the block's terms too, a worker's vocabulary would otherwise only ever grow
+    block.dictionary.clear();
+    block.term_count = 0;
+
+    posting_bytes_.fetch_sub(block.bytes, std::memory_order_relaxed);
+    flushed_posting_bytes_ += block.bytes;
+    block_flushes_++;
+    block.bytes = 0;
 }
 
 std::string IndexBuilder::merge_block_subset(
@@ -421,10 +840,40 @@ std::string IndexBuilder::merge_block_subset(
                       std::to_string(start_idx) + "_" + std::to_string(end_idx) + ".data";
     }
 
-    data::FileWriter out(output_path.c_str());
-
+    // The final index gets the block-structured layout read by TermReader, intermediate tiers the compact block
+    // format read back by BlockReader
+    std::optional<data::FileWriter> final_out;
+    std::optional<BlockWriter> block_out;
     uint32_t total_terms = 0;
-    out.Write(reinterpret_cast<const char*>(&total_terms), sizeof(total_terms));
+    // A term's champion list is written right after it, create_term_dictionary() sorts the entries into term order
+    std::vector<Posting> champion_postings;
+    uint32_t champion_terms = 0;
+    // Every list is also set aside under its bare term in one intermediate block per field, each sorted by bare
+    // term, which are merged into the any-field lists once the regular terms are written
+    constexpr size_t field_count = static_cast<size_t>(FieldType::ALL);
+    const auto any_field_path = [&](size_t field) {
+        return output_dir_ + "/blocks/any_field_" + std::to_string(field) + ".data";
+    };
+    std::array<std::optional<BlockWriter>, field_count> any_field_out;
+    std::vector<Posting> any_field_postings;
+    // Bitmaps of the dense terms, a stale file from an earlier build of the directory goes either way
+    std::optional<DensePostingsWriter> dense_out;
+    if (is_final_output) {
+        final_out.emplace(output_path.c_str());
+        final_out->Write(reinterpret_cast<const char*>(&total_terms), sizeof(total_terms));
+        if (any_field_lists_) {
+            for (size_t field = 0; field < field_count; ++field) {
+                any_field_out[field].emplace(any_field_path(field));
+            }
+        }
+        std::error_code dense_ec;
+        std::filesystem::remove(output_dir_ + "/" + DensePostings::FILE_NAME, dense_ec);
+        if (dense_term_fraction_ > 0) {
+            dense_out.emplace(output_dir_);
+        }
+    } else {
+        block_out.emplace(output_path);
+    }
 
     using BlockReaderPtr = std::unique_ptr<BlockReader>;
     auto cmp = [](const BlockReaderPtr& a, const BlockReaderPtr& b) {
@@ -455,6 +904,61 @@ std::string IndexBuilder::merge_block_subset(
     }
 
     std::vector<Posting> merged_postings;
+    std::vector<BlockSyncPoint> block_sync_points;
+    std::vector<char> encoded_postings;
+    // Posting bytes and decode time of the final index in its doc order and in crawl order, see set_doc_order_report
+    struct {
+        uint64_t postings{0};
+        uint64_t bytes{0};
+        uint64_t crawl_bytes{0};
+        std::chrono::nanoseconds decode{0};
+        std::chrono::nanoseconds crawl_decode{0};
+    } reorder_report;
+    // Writes a term of the final index, leaving its encoded postings in encoded_postings
+    const auto write_final_term = [&](const std::string& term, const std::vector<Posting>& postings) {
+        data::FileWriter& out = *final_out;
+
+        // Write term string
+        uint32_t term_len = term.size();
+        out.Write(reinterpret_cast<const char*>(&term_len), sizeof(term_len));
+        out.Write(term.c_str(), term_len);
+
+        // Write postings count
+        uint32_t postings_size = postings.size();
+        out.Write(reinterpret_cast<const char*>(&postings_size), sizeof(postings_size));
+
+        // Block-structured postings so readers can decode one block at a time
+        PostingBlockCodec::encode_postings(FINAL_POSTING_CODEC, postings, block_sync_points, encoded_postings);
+        set_block_impacts(postings, block_sync_points, is_any_field_term(term));
+
+        uint32_t sync_points_size = block_sync_points.size();
+        uint32_t postings_bytes = encoded_postings.size();
+        out.Write(reinterpret_cast<const char*>(&sync_points_size), sizeof(sync_points_size));
+        out.Write(reinterpret_cast<const char*>(&postings_bytes), sizeof(postings_bytes));
+        if (sync_points_size > 0) {
+            out.Write(reinterpret_cast<const char*>(block_sync_points.data()),
+                      sync_points_size * sizeof(BlockSyncPoint));
+        }
+        if (postings_bytes > 0) {
+            out.Write(encoded_postings.data(), postings_bytes);
+        }
+
+        total_terms++;
+    };
+    // Writes a term of the final index and, unless it is a champion list, its bitmap if it is dense
+    const auto emit_final_term = [&](const std::string& term, const std::vector<Posting>& postings) {
+        write_final_term(term, postings);
+        if (doc_order_report_ && !doc_ids_.empty() && !is_champion_term(term) && !is_any_field_term(term)) {
+            reorder_report.bytes += encoded_postings.size();
+            reorder_report.decode += time_decode(block_sync_points, encoded_postings, postings.size());
+        }
+        encoded_postings.clear();
+
+        if (dense_out && !is_champion_term(term) &&
+            static_cast<uint64_t>(postings.size()) * dense_term_fraction_ >= stats_.doc_count) {
+            dense_out->add_term(term, postings);
+        }
+    };
     while (!pq.empty()) {
         std::string current_term = pq.top()->current_term;
         merged_postings.clear();
@@ -479,63 +983,150 @@ std::string IndexBuilder::merge_block_subset(
             }
         }
 
-        std::sort(merged_postings.begin(), merged_postings.end(), [](const Posting& a, const Posting& b) {
-            return a.doc_id < b.doc_id;
-        });
+        // Each block's list is sorted, so the merged list usually only needs sorting when blocks overlap
+        if (!std::is_sorted(merged_postings.begin(), merged_postings.end(), posting_doc_id_less)) {
+            std::sort(merged_postings.begin(), merged_postings.end(), posting_doc_id_less);
+        }
 
-        // Write term string
-        uint32_t term_len = current_term.size();
-        out.Write(reinterpret_cast<const char*>(&term_len), sizeof(term_len));
-        out.Write(current_term.c_str(), term_len);
+        if (is_final_output && !doc_ids_.empty()) {
+            if (doc_order_report_) {
+                // Encode the list in crawl order as well, so the report shows what the doc order bought
+                PostingBlockCodec::encode_postings(
+                    FINAL_POSTING_CODEC, merged_postings, block_sync_points, encoded_postings);
+                reorder_report.postings += merged_postings.size();
+                reorder_report.crawl_bytes += encoded_postings.size();
+                reorder_report.crawl_decode +=
+                    time_decode(block_sync_points, encoded_postings, merged_postings.size());
+                encoded_postings.clear();
+            }
 
-        // Write postings count
-        uint32_t postings_size = merged_postings.size();
-        out.Write(reinterpret_cast<const char*>(&postings_size), sizeof(postings_size));
+            for (auto& posting : merged_postings) {
+                posting.doc_id = doc_ids_(posting.doc_id);
+            }
+            std::sort(merged_postings.begin(), merged_postings.end(), posting_doc_id_less);
+        }
+
+        if (!is_final_output) {
+            block_out->add_term(current_term, merged_postings);
+            total_terms++;
+            continue;
+        }
+
+        emit_final_term(current_term, merged_postings);
 
-        // Calculate and write sync points for postings
-        std::vector<SyncPoint> sync_points;
-        if (postings_size > 0) {
-            sync_points.reserve(postings_size / PostingList::SYNC_INTERVAL + 1);
-            for (uint32_t i = 0; i < postings_size; i += PostingList::SYNC_INTERVAL) {
-                SyncPoint sp{merged_postings[i].doc_id, i};
-                sync_points.push_back(sp);
+        if (champion_list_size_ > 0 && merged_postings.size() >= champion_min_postings_) {
+            select_champions(merged_postings, champion_postings);
+            emit_final_term(champion_term(current_term), champion_postings);
+            champion_terms++;
+        }
+
+        if (any_field_lists_) {
+            const auto [field, bare_term] = TokenNormalizer::splitDecoratedToken(current_term);
+            const uint8_t flag = fieldTypeToFlag(field);
+            any_field_postings.assign(merged_postings.begin(), merged_postings.end());
+            for (auto& posting : any_field_postings) {
+                posting.freq = pack_any_field(posting.freq, flag);
             }
+            any_field_out[static_cast<size_t>(field)]->add_term(std::string(bare_term), any_field_postings);
         }
+    }
 
-        uint32_t sync_points_size = sync_points.size();
-        out.Write(reinterpret_cast<const char*>(&sync_points_size), sizeof(sync_points_size));
-        if (sync_points_size > 0) {
-            out.Write(reinterpret_cast<const char*>(sync_points.data()), sync_points_size * sizeof(SyncPoint));
-        }
-
-        if (!merged_postings.empty()) {
-            if (is_final_output) {
-                // Use VByte encoding for doc_id deltas and frequencies (final format)
-                uint32_t last_doc_id = 0;
-                std::vector<uint32_t> doc_id_deltas;
-                std::vector<uint32_t> freqs;
-                doc_id_deltas.reserve(postings_size);
-                freqs.reserve(postings_size);
-
-                for (const auto& posting : merged_postings) {
-                    doc_id_deltas.push_back(posting.doc_id - last_doc_id);
-                    freqs.push_back(posting.freq);
-                    last_doc_id = posting.doc_id;
+    if (is_final_output && any_field_lists_) {
+        // Any-field lists need every field's list of the term, they are written after the regular terms
+        std::vector<std::unique_ptr<BlockReader>> fields;
+        for (size_t field = 0; field < field_count; ++field) {
+            any_field_out[field]->finish();
+            auto reader = std::make_unique<BlockReader>(any_field_path(field));
+            if (reader->has_next) {
+                fields.push_back(std::move(reader));
+            }
+        }
+
+        uint32_t any_field_terms = 0;
+        while (!fields.empty()) {
+            std::string bare_term = fields.front()->current_term;
+            for (const auto& reader : fields) {
+                bare_term = std::min(bare_term, reader->current_term);
+            }
+
+            merged_postings.clear();
+            size_t term_fields = 0;
+            for (const auto& reader : fields) {
+                if (reader->current_term != bare_term) {
+                    continue;
                 }
-                VByteCodec::encodeBatch(doc_id_deltas, out);
-                VByteCodec::encodeBatch(freqs, out);
-            } else {
-                out.Write(reinterpret_cast<const char*>(merged_postings.data()), postings_size * sizeof(Posting));
+                const auto middle = static_cast<std::ptrdiff_t>(merged_postings.size());
+                merged_postings.insert(merged_postings.end(),
+                                       std::make_move_iterator(reader->current_postings.begin()),
+                                       std::make_move_iterator(reader->current_postings.end()));
+                std::inplace_merge(merged_postings.begin(),
+                                   merged_postings.begin() + middle,
+                                   merged_postings.end(),
+                                   posting_doc_id_less);
+                reader->current_postings.clear();
+                reader->read_next();
+                term_fields++;
             }
+            std::erase_if(fields, [](const auto& reader) { return !reader->has_next; });
+
+            // A term of a single field is matched from its own list, which holds the same documents
+            if (term_fields < 2) {
+                continue;
+            }
+            coalesce_any_field(merged_postings);
+            const std::string term = any_field_term(bare_term);
+            emit_final_term(term, merged_postings);
+            any_field_terms++;
         }
+        spdlog::info("Wrote any-field lists of {} terms", any_field_terms);
 
-        total_terms++;
+        for (size_t field = 0; field < field_count; ++field) {
+            std::error_code any_field_ec;
+            std::filesystem::remove(any_field_path(field), any_field_ec);
+        }
     }
 
-    // Update total terms count at the beginning of the file
-    out.Fseek(0);
-    out.Write(reinterpret_cast<const char*>(&total_terms), sizeof(total_terms));
-    out.Close();
+    if (is_final_output) {
+        if (champion_terms > 0) {
+            spdlog::info("Wrote champion lists of {} terms", champion_terms);
+        }
+
+        if (dense_out) {
+            dense_out->finish();
+            spdlog::info("Wrote dense postings of {} terms", dense_out->term_count());
+        }
+
+        // Update total terms count at the beginning of the file
+        final_out->Fseek(0);
+        final_out->Write(reinterpret_cast<const char*>(&total_terms), sizeof(total_terms));
+        final_out->Close();
+
+        if (reorder_report.postings > 0) {
+            const auto bytes_per_posting = [&](uint64_t bytes) {
+                return static_cast<double>(bytes) / static_cast<double>(reorder_report.postings);
+            };
+            const auto mpostings_per_sec = [&](std::chrono::nanoseconds elapsed) {
+                return elapsed.count() > 0 ? static_cast<double>(reorder_report.postings) * 1e3 /
+                                                 static_cast<double>(elapsed.count())
+                                           : 0.0;
+            };
+            spdlog::info("Doc order: postings take {} bytes ({:.3f} bytes/posting, {:.1f} Mpostings/s decode), {} "
+                         "bytes in crawl order ({:.3f} bytes/posting, {:.1f} Mpostings/s decode), {:+.1f}% size",
+                         reorder_report.bytes,
+                         bytes_per_posting(reorder_report.bytes),
+                         mpostings_per_sec(reorder_report.decode),
+                         reorder_report.crawl_bytes,
+                         bytes_per_posting(reorder_report.crawl_bytes),
+                         mpostings_per_sec(reorder_report.crawl_decode),
+                         reorder_report.crawl_bytes > 0
+                             ? 100.0 * (static_cast<double>(reorder_report.bytes) /
+                                            static_cast<double>(reorder_report.crawl_bytes) -
+                                        1.0)
+                             : 0.0);
+        }
+    } else {
+        block_out->finish();
+    }
 
     for (size_t i = start_idx; i < end_idx && i < block_paths.size(); i++) {
         std::error_code ec;
@@ -548,6 +1139,136 @@ std::string IndexBuilder::merge_block_subset(
     return output_path;
 }
 
+void IndexBuilder::compute_doc_ids() {
+    std::lock_guard<std::mutex> lock(document_mutex_);
+    doc_ids_ = {};
+    if (doc_order_ == DocOrder::Crawl || document_metadata_.empty()) {
+        return;
+    }
+    if (doc_order_ == DocOrder::StaticRank && !static_rank_) {
+        spdlog::warn("No static rank to order documents by, keeping crawl order");
+        return;
+    }
+
+    data::docid_t min_id = DocumentMapReader::HOLE_DOC_ID;
+    data::docid_t max_id = 0;
+    for (const auto& meta : document_metadata_) {
+        min_id = std::min(min_id, meta.id);
+        max_id = std::max(max_id, meta.id);
+    }
+
+    // Crawl IDs in the order they are renumbered in, ties keep crawl order
+    std::vector<docid_t> order;
+    order.reserve(document_metadata_.size());
+    if (doc_order_ == DocOrder::StaticRank) {
+        std::vector<std::pair<double, docid_t>> scored;
+        scored.reserve(document_metadata_.size());
+        for (const auto& meta : document_metadata_) {
+            scored.emplace_back(static_rank_(meta), meta.id);
+        }
+        // Highest score first
+        std::sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+        for (const auto& [score, id] : scored) {
+            order.push_back(id);
+        }
+    } else {
+        std::vector<std::pair<std::string, docid_t>> keyed;
+        keyed.reserve(document_metadata_.size());
+        for (const auto& meta : document_metadata_) {
+            keyed.emplace_back(url_order_key(meta.url), meta.id);
+        }
+        std::sort(keyed.begin(), keyed.end());
+        for (const auto& [key, id] : keyed) {
+            order.push_back(id);
+        }
+    }
+
+    std::vector<docid_t> ids(static_cast<size_t>(max_id - min_id) + 1, DocumentMapReader::HOLE_DOC_ID);
+    for (size_t rank = 0; rank < order.size(); ++rank) {
+        ids[order[rank] - min_id] = min_id + static_cast<docid_t>(rank);
+    }
+    doc_ids_ = DocIdMap(min_id, std::move(ids));
+    spdlog::info(
+        "Renumbered {} documents by {}", order.size(), doc_order_ == DocOrder::StaticRank ? "static rank" : "URL");
+}
+
+void IndexBuilder::compute_length_norms() {
+    std::lock_guard<std::mutex> lock(document_mutex_);
+    length_norms_.clear();
+    if (document_metadata_.empty()) {
+        return;
+    }
+
+    data::docid_t min_id = DocumentMapReader::HOLE_DOC_ID;
+    data::docid_t max_id = 0;
+    for (const auto& meta : document_metadata_) {
+        min_id = std::min(min_id, doc_ids_(meta.id));
+        max_id = std::max(max_id, doc_ids_(meta.id));
+    }
+
+    // Same average ranking::BM25 derives from index_stats.data
+    const double avg_body_length =
+        stats_.doc_count > 0 ? static_cast<double>(stats_.total_body_length) / stats_.doc_count : 0.0;
+    length_norm_base_ = min_id;
+    length_norms_.assign(static_cast<size_t>(max_id - min_id) + 1, 1.0F);
+    static_scores_.clear();
+    if (champion_list_size_ > 0 && static_rank_) {
+        static_scores_.assign(length_norms_.size(), 0.0F);
+        for (const auto& meta : document_metadata_) {
+            static_scores_[doc_ids_(meta.id) - min_id] = static_cast<float>(static_rank_(meta));
+        }
+    }
+    if (avg_body_length <= 0) {
+        return;
+    }
+    for (const auto& meta : document_metadata_) {
+        length_norms_[doc_ids_(meta.id) - min_id] =
+            static_cast<float>((1.0 - BM25_B) + BM25_B * (static_cast<double>(meta.body_length) / avg_body_length));
+    }
+}
+
+void IndexBuilder::select_champions(const std::vector<Posting>& postings, std::vector<Posting>& champions) const {
+    // BM25 of the posting per unit of IDF, which is the same for the whole list, plus the weighted static score
+    const auto score = [&](const Posting& posting) {
+        const size_t slot = posting.doc_id - length_norm_base_;
+        const double norm = slot < length_norms_.size() ? length_norms_[slot] : 1.0;
+        const double impact = posting.freq / norm;
+        const double static_score = slot < static_scores_.size() ? static_scores_[slot] : 0.0;
+        return impact * (BM25_K1 + 1) / (impact + BM25_K1) + champion_static_weight_ * static_score;
+    };
+
+    champions.assign(postings.begin(), postings.end());
+    if (champions.size() > champion_list_size_) {
+        std::nth_element(champions.begin(),
+                         champions.begin() + static_cast<std::ptrdiff_t>(champion_list_size_),
+                         champions.end(),
+                         [&](const Posting& a, const Posting& b) { return score(a) > score(b); });
+        champions.resize(champion_list_size_);
+    }
+    std::sort(champions.begin(), champions.end(), posting_doc_id_less);
+}
+
+void IndexBuilder::set_block_impacts(const std::vector<Posting>& postings,
+                                     std::vector<BlockSyncPoint>& sync_points,
+                                     bool any_field) const {
+    for (size_t block = 0; block < sync_points.size(); ++block) {
+        const size_t start = block * PostingBlockCodec::BLOCK_SIZE;
+        const size_t end = std::min(start + PostingBlockCodec::BLOCK_SIZE, postings.size());
+        double max_impact = 0.0;
+        for (size_t i = start; i < end; ++i) {
+            const size_t slot = postings[i].doc_id - length_norm_base_;
+            const double norm = slot < length_norms_.size() ? length_norms_[slot] : 1.0;
+            const uint32_t freq = any_field ? any_field_frequency(postings[i].freq) : postings[i].freq;
+            max_impact = std::max(max_impact, freq / norm);
+        }
+        // Rounded up so the bound still holds once readers redo the division in double
+        sync_points[block].max_impact =
+            std::nextafter(static_cast<float>(max_impact), std::numeric_limits<float>::infinity());
+    }
+}
+
 void IndexBuilder::merge_blocks_tiered() {
     if (block_count_ <= 0) {
         spdlog::info("No blocks generated, skipping merge.");
@@ -565,40 +1286,78 @@ void IndexBuilder::merge_blocks_tiered() {
         current_tier.push_back(block_path(i));
     }
 
+    // Groups within a tier are independent, run them on the worker pool. The semaphore bounds how many merges
+    // read and write at the same time.
+    const size_t merge_slots =
+        max_concurrent_merges_ == 0 ? workers_.size() : std::min(max_concurrent_merges_, workers_.size());
+    std::counting_semaphore<> merge_semaphore(static_cast<std::ptrdiff_t>(merge_slots));
+    // worker_thread only logs what a task throws, the first failed group is kept to fail the build with
+    std::exception_ptr merge_error;
+    std::mutex merge_error_mutex;
+
     int tier_number = 0;
-    while (current_tier.size() > 1) {
+    // The last tier is merged straight into the final format instead of producing one more intermediate block
+    while (current_tier.size() > MERGE_FACTOR) {
         tier_number++;
-        spdlog::info("Processing merge tier {}: merging {} blocks with factor {}",
+        const size_t num_groups = (current_tier.size() + MERGE_FACTOR - 1) / MERGE_FACTOR;
+        spdlog::info("Processing merge tier {}: merging {} blocks with factor {} ({} groups, {} concurrent)",
                      tier_number,
                      current_tier.size(),
-                     MERGE_FACTOR);
-
-        std::vector<std::string> next_tier;
-        const size_t num_groups = (current_tier.size() + MERGE_FACTOR - 1) / MERGE_FACTOR;
-        next_tier.reserve(num_groups);
-
-        for (size_t i = 0; i < current_tier.size(); i += MERGE_FACTOR) {
-            const size_t end_idx = std::min(i + MERGE_FACTOR, current_tier.size());
-            std::string merged_block = merge_block_subset(current_tier,
-                                                          i,
+                     MERGE_FACTOR,
+                     num_groups,
+                     std::min(merge_slots, num_groups));
+
+        const auto tier_start = std::chrono::steady_clock::now();
+        const uint64_t tier_input_bytes = total_file_size(current_tier);
+
+        std::vector<std::string> next_tier(num_groups);
+        for (size_t group = 0; group < num_groups; ++group) {
+            enqueue_task([&, group, tier_number](WorkerBlock&) {
+                const size_t start_idx = group * MERGE_FACTOR;
+                const size_t end_idx = std::min(start_idx + MERGE_FACTOR, current_tier.size());
+                merge_semaphore.acquire();
+                try {
+                    next_tier[group] = merge_block_subset(current_tier,
+                                                          start_idx,
                                                           end_idx,
                                                           tier_number,
                                                           /*is_final_output=*/false);
-            next_tier.emplace_back(std::move(merged_block));
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(merge_error_mutex);
+                    if (!merge_error) {
+                        merge_error = std::current_exception();
+                    }
+                }
+                merge_semaphore.release();
+            });
+        }
+        wait_for_tasks();
+        // A failed group left its slot of next_tier empty, the next tier would merge without its blocks
+        if (merge_error) {
+            spdlog::error("Merge tier {} failed, abandoning the build", tier_number);
+            std::rethrow_exception(merge_error);
         }
 
+        const double tier_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - tier_start).count();
         current_tier = std::move(next_tier);
-        spdlog::info("Tier {} complete, produced {} blocks", tier_number, current_tier.size());
+        spdlog::info("Tier {} complete, produced {} blocks in {:.2f}s ({:.1f} MB read, {:.1f} MB/s)",
+                     tier_number,
+                     current_tier.size(),
+                     tier_seconds,
+                     tier_input_bytes / (1024.0 * 1024.0),
+                     tier_input_bytes / (1024.0 * 1024.0) / std::max(tier_seconds, 1e-9));
     }
 
-    if (current_tier.size() == 1) {
-        spdlog::info("Finalizing index format...");
-        merge_block_subset(current_tier,
-                           0,
-                           1,
-                           tier_number + 1,  // Final tier number
-                           /*is_final_output=*/true);
-    }
+    spdlog::info("Finalizing index format from {} blocks...", current_tier.size());
+    const auto final_start = std::chrono::steady_clock::now();
+    merge_block_subset(current_tier,
+                       0,
+                       current_tier.size(),
+                       tier_number + 1,  // Final tier number
+                       /*is_final_output=*/true);
+    spdlog::info("Final merge complete in {:.2f}s",
+                 std::chrono::duration<double>(std::chrono::steady_clock::now() - final_start).count());
 }
 
 void IndexBuilder::save_document_map() {
@@ -609,33 +1368,126 @@ void IndexBuilder::save_document_map() {
         return;
     }
 
-    uint32_t num_docs = 0;
-    {
-        std::lock_guard<std::mutex> lock(document_mutex_);
-        num_docs = document_metadata_.size();
-        out.write(reinterpret_cast<const char*>(&num_docs), sizeof(num_docs));
+    std::lock_guard<std::mutex> lock(document_mutex_);
 
-        for (const auto& meta : document_metadata_) {
-            out.write(reinterpret_cast<const char*>(&meta.id), sizeof(meta.id));
+    // One slot per written doc ID between the smallest and largest ID, IDs without a document are holes
+    data::docid_t min_id = DocumentMapReader::HOLE_DOC_ID;
+    data::docid_t max_id = 0;
+    for (const auto& meta : document_metadata_) {
+        min_id = std::min(min_id, doc_ids_(meta.id));
+        max_id = std::max(max_id, doc_ids_(meta.id));
+    }
+    const uint32_t slot_count = document_metadata_.empty() ? 0 : max_id - min_id + 1;
+    if (document_metadata_.empty()) {
+        min_id = 0;
+    }
+
+    DocInfo hole{};
+    hole.id = DocumentMapReader::HOLE_DOC_ID;
+    std::vector<DocInfo> slots(slot_count, hole);
+    std::vector<uint32_t> crawl_ids(slot_count, DocumentMapReader::HOLE_DOC_ID);
+    std::string urls;
+    std::string titles;
+    uint32_t num_docs = 0;
 
-            uint32_t url_len = meta.url.size();
-            out.write(reinterpret_cast<const char*>(&url_len), sizeof(url_len));
-            out.write(meta.url.c_str(), url_len);
+    for (const auto& meta : document_metadata_) {
+        const docid_t id = doc_ids_(meta.id);
+        DocInfo& info = slots[id - min_id];
+        if (info.id != DocumentMapReader::HOLE_DOC_ID) {
+            spdlog::warn("Duplicate document id {} in document map, keeping the last one", meta.id);
+        } else {
+            ++num_docs;
+        }
+        crawl_ids[id - min_id] = meta.id;
+
+        std::string joined_title = join_title(meta.title);
+        info.id = id;
+        info.url_offset = urls.size();
+        info.url_length = meta.url.size();  // String lengths, as the reader always exposed them
+        info.title_offset = titles.size();
+        info.title_length = joined_title.size();
+        info.body_length = meta.body_length;
+        info.desc_length = meta.desc_length;
+        info.pagerank_score = meta.pagerank_score;
+        urls += meta.url;
+        titles += joined_title;
+    }
 
-            std::string joined_title = join_title(meta.title);
-            uint32_t title_len = joined_title.size();
-            out.write(reinterpret_cast<const char*>(&title_len), sizeof(title_len));
-            out.write(joined_title.c_str(), title_len);
+    // Split titles into words once here, so readers never tokenize them
+    std::vector<uint32_t> title_token_starts;
+    title_token_starts.reserve(static_cast<size_t>(slot_count) + 1);
+    std::vector<TitleToken> title_tokens;
+    for (uint32_t slot = 0; slot < slot_count; ++slot) {
+        title_token_starts.push_back(title_tokens.size());
+        if (slots[slot].id == DocumentMapReader::HOLE_DOC_ID) {
+            continue;
+        }
 
-            // bm25f
-            out.write(reinterpret_cast<const char*>(&meta.body_length), sizeof(meta.body_length));
-            out.write(reinterpret_cast<const char*>(&meta.title_length), sizeof(meta.title_length));
-            out.write(reinterpret_cast<const char*>(&meta.url_length), sizeof(meta.url_length));
-            out.write(reinterpret_cast<const char*>(&meta.desc_length), sizeof(meta.desc_length));
-            out.write(reinterpret_cast<const char*>(&meta.pagerank_score), sizeof(meta.pagerank_score));
+        std::string_view title{titles.data() + slots[slot].title_offset, slots[slot].title_length};
+        size_t pos = 0;
+        while (pos < title.size()) {
+            while (pos < title.size() && std::isspace(static_cast<unsigned char>(title[pos]))) {
+                ++pos;
+            }
+            size_t end = pos;
+            while (end < title.size() && !std::isspace(static_cast<unsigned char>(title[end]))) {
+                ++end;
+            }
+            if (end > pos && end <= UINT16_MAX) {  // Words past 64KiB of title are not addressable
+                title_tokens.push_back(TitleToken{static_cast<uint16_t>(pos), static_cast<uint16_t>(end - pos)});
+            }
+            pos = end;
+        }
+    }
+    title_token_starts.push_back(title_tokens.size());
+
+    // Slot indices ordered by URL for lookupDocID
+    std::vector<uint32_t> url_index;
+    url_index.reserve(num_docs);
+    for (uint32_t slot = 0; slot < slot_count; ++slot) {
+        if (slots[slot].id != DocumentMapReader::HOLE_DOC_ID) {
+            url_index.push_back(slot);
         }
     }
-    spdlog::info("Saved document map with {} entries to {}", num_docs, map_path);
+    auto url_of = [&](uint32_t slot) {
+        return std::string_view{urls.data() + slots[slot].url_offset, slots[slot].url_length};
+    };
+    std::sort(url_index.begin(), url_index.end(), [&](uint32_t a, uint32_t b) { return url_of(a) < url_of(b); });
+
+    // The same slots ordered by crawl ID for lookupCrawlDocID
+    std::vector<uint32_t> crawl_index = url_index;
+    std::sort(crawl_index.begin(), crawl_index.end(), [&](uint32_t a, uint32_t b) {
+        return crawl_ids[a] < crawl_ids[b];
+    });
+
+    DocumentMapHeader header{};
+    header.magic = DocumentMapReader::MAGIC;
+    header.version = DocumentMapReader::VERSION;
+    header.doc_count = num_docs;
+    header.base_doc_id = min_id;
+    header.slot_count = slot_count;
+    header.title_token_count = title_tokens.size();
+    header.url_heap_size = urls.size();
+    header.title_heap_size = titles.size();
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(DocInfo));
+    out.write(urls.data(), urls.size());
+    out.write(titles.data(), titles.size());
+    const size_t heaps_end = sizeof(header) + slots.size() * sizeof(DocInfo) + urls.size() + titles.size();
+    const char padding[alignof(uint32_t)] = {};
+    out.write(padding, (alignof(uint32_t) - heaps_end % alignof(uint32_t)) % alignof(uint32_t));
+    out.write(reinterpret_cast<const char*>(title_token_starts.data()), title_token_starts.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(title_tokens.data()), title_tokens.size() * sizeof(TitleToken));
+    out.write(reinterpret_cast<const char*>(url_index.data()), url_index.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(crawl_ids.data()), crawl_ids.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(crawl_index.data()), crawl_index.size() * sizeof(uint32_t));
+
+    spdlog::info("Saved document map with {} entries in {} slots (base id {}) to {}",
+                 num_docs,
+                 slot_count,
+                 min_id,
+                 map_path);
 }
 
 void IndexBuilder::save_index_stats() {
@@ -681,13 +1533,6 @@ void IndexBuilder::create_term_dictionary() {
     size_t index_size = index_reader->size();
 
 
-    // Use ofstream for RAII dictionary file writing
-    std::ofstream dict_stream(dict_path, std::ios::binary | std::ios::trunc);
-    if (!dict_stream) {
-        spdlog::error("Failed to create dictionary file: {}", dict_path);
-        return;
-    }
-
     const char* ptr = data;
     const char* end_ptr = data + index_size;
 
@@ -700,7 +1545,7 @@ void IndexBuilder::create_term_dictionary() {
         return;
     }
 
-    std::vector<std::pair<std::string, uint64_t>> term_entries;
+    std::vector<TermDictionary::TermEntry> term_entries;
     if (term_count > 0) {
         try {
             term_entries.reserve(term_count);
@@ -745,46 +1590,29 @@ void IndexBuilder::create_term_dictionary() {
         uint32_t sync_points_size = *reinterpret_cast<const uint32_t*>(current_read_ptr);
         current_read_ptr += sizeof(uint32_t);
 
-        size_t sync_points_bytes = static_cast<size_t>(sync_points_size) * sizeof(SyncPoint);
-        if (current_read_ptr + sync_points_bytes > end_ptr) {
-            spdlog::error("Index file ended unexpectedly while reading sync points data ({} bytes) for term '{}' at "
+        if (current_read_ptr + sizeof(uint32_t) > end_ptr) {
+            spdlog::error(
+                "Index file ended unexpectedly while reading postings bytes for term '{}' at term index {}", term, i);
+            return;
+        }
+        uint32_t postings_bytes = *reinterpret_cast<const uint32_t*>(current_read_ptr);
+        current_read_ptr += sizeof(uint32_t);
+
+        // Skip sync points and the block-encoded postings in one step
+        size_t skip_bytes = static_cast<size_t>(sync_points_size) * sizeof(BlockSyncPoint) + postings_bytes;
+        if (current_read_ptr + skip_bytes > end_ptr) {
+            spdlog::error("Index file ended unexpectedly while skipping postings data ({} bytes) for term '{}' at "
                           "term index {}",
-                          sync_points_bytes,
+                          skip_bytes,
                           term,
                           i);
             return;
         }
-        current_read_ptr += sync_points_bytes;  // Skip sync points data
-
-        // Skip VByte-encoded postings
-        const char* postings_start_ptr = current_read_ptr;
-        for (uint32_t j = 0; j < postings_size; j++) {
-            // Skip doc_id delta
-            while (current_read_ptr < end_ptr && (*current_read_ptr & 0x80))
-                current_read_ptr++;
-            if (current_read_ptr >= end_ptr) {
-                spdlog::error("Index file ended unexpectedly skipping docID delta (term {}, posting {})", i, j);
-                return;
-            }
-            current_read_ptr++;
-
-            // Skip frequency
-            while (current_read_ptr < end_ptr && (*current_read_ptr & 0x80))
-                current_read_ptr++;
-            if (current_read_ptr >= end_ptr) {
-                spdlog::error("Index file ended unexpectedly skipping freq (term {}, posting {})", i, j);
-                return;
-            }
-            current_read_ptr++;                // Skip final byte of freq
-            if (current_read_ptr > end_ptr) {  // Should be caught by checks above, but good safety net
-                spdlog::error("Index file pointer went past end after skipping postings (term {}, posting {})", i, j);
-                return;
-            }
-        }
+        current_read_ptr += skip_bytes;
         // const char* postings_end_ptr = current_read_ptr; // Mark end if needed
 
         // Store term with its offset relative to the start of the term data section
-        term_entries.emplace_back(term, current_entry_start_offset);
+        term_entries.push_back(TermDictionary::TermEntry{std::move(term), current_entry_start_offset, postings_size});
 
         // Update the offset for the *start* of the next term's entry
         current_entry_start_offset = current_read_ptr - term_data_start_ptr;
@@ -800,51 +1628,41 @@ void IndexBuilder::create_term_dictionary() {
         return;
     }
 
+    // The final merge writes champion lists next to their terms and any-field lists after the regular terms
     spdlog::info("Sorting {} term entries...", term_entries.size());
-    std::sort(term_entries.begin(), term_entries.end());
-
-    // Write dict heade
-    uint32_t magic = 0x4D495448;  // "MITH"
-    uint32_t version = 1;
-    dict_stream.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
-    dict_stream.write(reinterpret_cast<const char*>(&version), sizeof(version));
-    // Write the actual number of entries we sorted (might differ from header if file was truncated)
-    uint32_t actual_term_count = term_entries.size();
-    dict_stream.write(reinterpret_cast<const char*>(&actual_term_count), sizeof(actual_term_count));
-
-    spdlog::info("Writing dictionary with {} entries...", actual_term_count);
-
-    // Write dictionary entries (simple format: len, term, offset, postings_count)
-    uint64_t last_logged_count = 0;
-    for (uint32_t i = 0; i < actual_term_count; ++i) {
-        const auto& [term, offset] = term_entries[i];
-
-        // Read postings count directly from the mapped index data using the stored offset
-        uint32_t postings_count = 0;
-        const char* entry_ptr = term_data_start_ptr + offset;
-        // Bounds check before reading postings count
-        // Need offset + term_len_bytes + term_bytes to get to postings count field
-        const char* count_ptr = entry_ptr + sizeof(uint32_t) + term.length();
-        if (count_ptr + sizeof(uint32_t) <= end_ptr) {
-            postings_count = *reinterpret_cast<const uint32_t*>(count_ptr);
-        } else {
-            spdlog::warn(
-                "Could not read postings count for term '{}' at offset {}: index bounds exceeded.", term, offset);
+    const auto term_less = [](const auto& a, const auto& b) { return a.term < b.term; };
+    std::sort(term_entries.begin(), term_entries.end(), term_less);
+
+    // A term of a single field has no any-field list, its any-field entry points at that field's list instead. Every
+    // term then has an any-field entry and a plain query term takes a single lookup.
+    uint32_t dict_flags = 0;
+    if (any_field_lists_) {
+        std::vector<TermDictionary::TermEntry> aliases;
+        for (const auto& entry : term_entries) {
+            if (is_champion_term(entry.term) || is_any_field_term(entry.term)) {
+                continue;
+            }
+            const auto bare_term = TokenNormalizer::splitDecoratedToken(entry.term).second;
+            TermDictionary::TermEntry alias{any_field_term(bare_term), 0, 0};
+            if (!std::binary_search(term_entries.begin(), term_entries.end(), alias, term_less)) {
+                alias.index_offset = entry.index_offset;
+                alias.postings_count = entry.postings_count;
+                aliases.push_back(std::move(alias));
+            }
         }
+        std::sort(aliases.begin(), aliases.end(), term_less);
+        spdlog::info("Adding any-field entries of {} single field terms...", aliases.size());
+        const auto middle = static_cast<std::ptrdiff_t>(term_entries.size());
+        term_entries.insert(
+            term_entries.end(), std::make_move_iterator(aliases.begin()), std::make_move_iterator(aliases.end()));
+        std::inplace_merge(term_entries.begin(), term_entries.begin() + middle, term_entries.end(), term_less);
+        dict_flags |= TermDictionary::FLAG_ANY_FIELD;
+    }
 
-
-        // Write term length and data
-        uint32_t term_len = term.length();
-        dict_stream.write(reinterpret_cast<const char*>(&term_len), sizeof(term_len));
-        dict_stream.write(term.data(), term_len);
-
-        // Write offset (absolute offset within the term data section of final_index.data)
-        dict_stream.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
-        // Write postings count
-        dict_stream.write(reinterpret_cast<const char*>(&postings_count), sizeof(postings_count));
-        if (i > 0 && (i % 500000 == 0 || i == actual_term_count - 1)) {
-            spdlog::info("Wrote {}/{} dictionary entries...", i + 1, actual_term_count);
-        }
+    spdlog::info("Writing dictionary with {} entries...", term_entries.size());
+    if (!TermDictionary::write(dict_path, term_entries, FINAL_POSTING_CODEC, dict_flags)) {
+        spdlog::error("Failed to write term dictionary: {}", dict_path);
+        return;
     }
 
     spdlog::info("Term dictionary creation complete: {}", dict_path);
@@ -858,30 +1676,34 @@ std::string IndexBuilder::block_path(int block_num) const {
 void IndexBuilder::finalize() {
     spdlog::info("Finalizing index build...");
     // Wait for doc processing tasks to complete
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
-        spdlog::info("Waiting for {} active tasks and task queue to empty...", active_tasks_.load());
-        condition_.wait(lock, [this] { return tasks_.empty() && active_tasks_.load() == 0; });
-    }
+    spdlog::info("Waiting for {} active tasks and task queue to empty...", active_tasks_.load());
+    wait_for_tasks();
     spdlog::info("All document processing tasks completed.");
 
-    // Flush any remaining terms in the last block
-    if (current_block_term_count_ > 0) {
-        spdlog::info("Flushing final block ({} unique terms)...", current_block_term_count_);
-        auto flush_future = flush_block();
-        if (flush_future.valid()) {
-            try {
-                flush_future.wait();
-                spdlog::info("Final block flush completed.");
-            } catch (const std::exception& e) {
-                spdlog::error("Exception waiting for final block flush: {}", e.what());
-            }
+    // Flush the terms remaining in every worker's block
+    for (size_t i = 0; i < worker_blocks_.size(); ++i) {
+        if (worker_blocks_[i]->term_count > 0) {
+            spdlog::info("Flushing final block of worker {} ({} unique terms)...", i, worker_blocks_[i]->term_count);
+            flush_block(*worker_blocks_[i]);
         }
-    } else {
-        spdlog::info("No final block to flush (term count was 0).");
     }
 
-    spdlog::info("Starting block merge process with {} blocks...", block_count_);
+    const MemoryStats memory = memory_stats();
+    spdlog::info("Flushed {} posting blocks ({} by memory budget, {} MB total, peak {} MB in memory) and {} position "
+                 "buffers",
+                 memory.block_flushes,
+                 memory.block_flushes_by_bytes,
+                 memory.flushed_posting_bytes >> 20,
+                 memory.peak_posting_bytes >> 20,
+                 memory.position_flushes);
+
+    // Merging consumes the blocks a checkpoint refers to, from here on a failed build has to start over
+    std::error_code checkpoint_ec;
+    std::filesystem::remove_all(checkpoint_dir(), checkpoint_ec);
+
+    compute_doc_ids();
+    compute_length_norms();
+    spdlog::info("Starting block merge process with {} blocks...", block_count_.load());
     merge_blocks_tiered();  // Handles 0, 1, or N blocks
 
     spdlog::info("Saving document map (approx {} documents)...", document_metadata_.size());
@@ -892,7 +1714,7 @@ void IndexBuilder::finalize() {
     // quick_stats_check(output_dir_ + "/index_stats.data");
 
     spdlog::info("Finalizing position index...");
-    PositionIndex::finalizeIndex(output_dir_);
+    position_builder_.finalize(doc_ids_);
 
     // Only create dictionary if a final index was actually created
     std::string final_index_path = output_dir_ + "/final_index.data";
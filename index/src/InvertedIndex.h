@@ -1,6 +1,10 @@
 #ifndef INDEX_INVERTEDINDEX_H
 #define INDEX_INVERTEDINDEX_H
 
+#include "DensePostings.h"
+#include "DocIdMap.h"
+#include "PositionIndexBuilder.h"
+#include "PostingCodec.h"
 #include "TermStore.h"
 #include "TextPreprocessor.h"
 #include "data/Document.h"
@@ -9,7 +13,8 @@
 #include <atomic>
 #include <condition_variable>
 #include <filesystem>
-#include <future>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
@@ -24,8 +29,16 @@ using Document = data::Document;
 using docid_t = data::docid_t;
 
 // Constants
+// Cap on the terms of a worker's in-memory block, which otherwise flushes against the memory budget. 0 disables it.
 constexpr size_t DEFAULT_MAX_TERMS_PER_BLOCK = 500000;
 constexpr size_t DEFAULT_MERGE_FACTOR = 32;
+constexpr size_t QUEUED_DOCUMENTS_PER_WORKER = 32;
+// Bytes the in-memory posting blocks and position buffers may hold before flushing, a quarter goes to positions
+constexpr size_t DEFAULT_MEMORY_BUDGET = size_t{4} << 30;
+constexpr PostingCodec FINAL_POSTING_CODEC = PostingCodec::StreamVByte;
+// Terms in at least this many documents get a champion list of their best DEFAULT_CHAMPION_LIST_SIZE documents
+constexpr size_t DEFAULT_CHAMPION_MIN_POSTINGS = 20000;
+constexpr size_t DEFAULT_CHAMPION_LIST_SIZE = 2000;
 
 struct DocumentMetadata {
     data::docid_t id;
@@ -38,6 +51,16 @@ struct DocumentMetadata {
     float pagerank_score{0.0F};
 };
 
+// Order finalize() numbers documents in. Crawl keeps the IDs documents were added with, the others renumber them
+// from the smallest of those IDs on, so the documents that come first in the order come first in every posting
+// list. The document map keeps each document's crawl ID.
+enum class DocOrder {
+    Crawl,
+    StaticRank,  // Descending static score, see IndexBuilder::set_static_rank
+    Url,         // Clustered by host, subdomains next to their domain, then by path. Neighbouring documents share
+                 // terms, so posting gaps shrink and the index compresses better
+};
+
 struct IndexStatistics {
     uint32_t doc_count{0};
     uint64_t total_title_length{0};
@@ -71,12 +94,75 @@ class IndexBuilder {
 public:
     explicit IndexBuilder(const std::string& output_dir,
                           size_t num_threads = std::thread::hardware_concurrency(),
-                          size_t max_terms_per_block = DEFAULT_MAX_TERMS_PER_BLOCK);
+                          size_t max_terms_per_block = DEFAULT_MAX_TERMS_PER_BLOCK,
+                          size_t memory_budget = DEFAULT_MEMORY_BUDGET);
 
     ~IndexBuilder();
 
     void add_document(const std::string& doc_path);
+    // Queues an already decoded document. Blocks while max_queued_documents() are waiting for a worker.
+    void add_document(Document doc);
+    // Merges the blocks into the final index, throws if any merge fails
     void finalize();
+
+    // Makes everything indexed so far durable in output_dir/checkpoint: waits for queued documents, flushes every
+    // worker block and position buffer, and writes the metadata of the documents added since the last checkpoint.
+    // Documents added meanwhile wait for the checkpoint to finish. Throws without writing it if a position buffer
+    // could not be written.
+    void checkpoint(const std::string& last_document = "");
+    // Restores the last checkpoint in output_dir, returns false if there is none. Call before adding documents.
+    bool resume();
+    // Whether the document was restored by resume(), such documents must not be added again
+    bool has_document(docid_t id) const;
+
+    // Adds every document of a finished index: its postings become a block, its positions a position buffer, and
+    // its document map and statistics are merged into this builder's. finalize() then merges them like any other
+    // block, which is how segments are compacted. Call before adding documents.
+    void import_segment(const std::string& segment_dir);
+
+    size_t documents_indexed() const { return documents_indexed_.load(std::memory_order_relaxed); }
+    size_t max_queued_documents() const { return max_queued_documents_; }
+
+    struct MemoryStats {
+        size_t posting_bytes;           // Held by the workers' in-memory blocks
+        size_t position_bytes;          // Held by position buffers being filled
+        size_t position_pending_bytes;  // Held by full position buffers waiting to be written
+        size_t peak_posting_bytes;
+        size_t block_flushes;
+        size_t block_flushes_by_bytes;  // Flushes forced by the memory budget rather than the term limit
+        uint64_t flushed_posting_bytes;
+        size_t position_flushes;
+
+        size_t total_bytes() const { return posting_bytes + position_bytes + position_pending_bytes; }
+    };
+    // Estimated heap bytes and flush counts, safe to call while indexing
+    MemoryStats memory_stats() const;
+
+    // Bounds how many merges of a tier run at once so they don't thrash the disk, 0 runs one per worker
+    void set_max_concurrent_merges(size_t max_merges) { max_concurrent_merges_ = max_merges; }
+    void set_doc_order(DocOrder order) { doc_order_ = order; }
+    // Logs the posting bytes and decode speed of a renumbered index next to crawl order's. Every list is encoded
+    // and decoded once more to measure them, so this is off by default.
+    void set_doc_order_report(bool enabled) { doc_order_report_ = enabled; }
+    // Score DocOrder::StaticRank sorts documents by, the index can't depend on the ranking library that computes it
+    void set_static_rank(std::function<double(const DocumentMetadata&)> static_rank) {
+        static_rank_ = std::move(static_rank);
+    }
+    // Champion lists: every term with at least min_postings postings also gets a list of its list_size best
+    // documents under champion_term(term), scored by the posting's BM25 per unit of IDF plus static_weight times
+    // the document's static rank. A list_size of 0 writes none.
+    void set_champion_lists(size_t min_postings, size_t list_size, double static_weight) {
+        champion_min_postings_ = min_postings;
+        champion_list_size_ = list_size;
+        champion_static_weight_ = static_weight;
+    }
+    // Terms in at least one in fraction documents also get a bitmap of their doc IDs in dense_postings.data, which
+    // queries match them from. 0 writes none.
+    void set_dense_postings(uint32_t fraction) { dense_term_fraction_ = fraction; }
+    // Terms found in more than one field also get an any-field list under any_field_term(term), the union of their
+    // body and decorated lists with the fields of each document, which plain query terms are matched from. Terms of
+    // a single field get a dictionary entry under the same name pointing at their field's list.
+    void set_any_field_lists(bool enabled) { any_field_lists_ = enabled; }
     void save_index_stats();
 
 private:
@@ -88,41 +174,95 @@ private:
     std::unordered_map<std::string, uint32_t> url_to_id_;
     std::mutex document_mutex_;
 
-    // In-Memory Block State
-    Dictionary dictionary_;
-    size_t current_block_term_count_{0};
-    int block_count_{0};
-    std::mutex block_mutex_;
+    // In-Memory Block State, one inverted block per worker thread
+    struct WorkerBlock {
+        WorkerBlock(size_t id, size_t bucket_size_hint) : id(id), dictionary(bucket_size_hint) {}
+        const size_t id;  // Also selects the worker's position buffer
+        Dictionary dictionary;
+        size_t term_count{0};
+        size_t bytes{0};  // Estimated heap bytes of the dictionary and its postings
+    };
+    std::vector<std::unique_ptr<WorkerBlock>> worker_blocks_;
+    std::atomic<int> block_count_{0};
 
     // Config
     const std::string output_dir_;
     const size_t max_terms_per_block_;
+    size_t max_bytes_per_worker_block_;
+    size_t max_concurrent_merges_{0};
+    size_t max_queued_documents_;
     static constexpr size_t MERGE_FACTOR = DEFAULT_MERGE_FACTOR;
 
+    // Position index, one position buffer per worker
+    PositionIndexBuilder position_builder_;
+
     // Core Indexing Methods
-    std::future<void> flush_block();
+    void flush_block(WorkerBlock& block);
     std::string merge_block_subset(const std::vector<std::string>& block_paths,
                                    size_t start_idx,
                                    size_t end_idx,
                                    int tier_num,
                                    bool is_final_output);
     void merge_blocks_tiered();
+    // Crawl ID to written ID of every document, empty when the doc order keeps crawl IDs. Computed by finalize()
+    // before the final merge renumbers the postings.
+    DocOrder doc_order_{DocOrder::Crawl};
+    bool doc_order_report_{false};
+    std::function<double(const DocumentMetadata&)> static_rank_;
+    DocIdMap doc_ids_;
+    void compute_doc_ids();
+    // BM25 length normalization of every document, by written doc ID from length_norm_base_, read by the final
+    // merge to compute block impacts
+    std::vector<float> length_norms_;
+    docid_t length_norm_base_{0};
+    void compute_length_norms();
+    // Impacts of an any-field list come from the frequency packed in its postings
+    void set_block_impacts(const std::vector<Posting>& postings,
+                           std::vector<BlockSyncPoint>& sync_points,
+                           bool any_field = false) const;
+    size_t champion_min_postings_{DEFAULT_CHAMPION_MIN_POSTINGS};
+    size_t champion_list_size_{DEFAULT_CHAMPION_LIST_SIZE};
+    double champion_static_weight_{0.0};
+    // Static rank of every document by written doc ID from length_norm_base_, only kept for champion lists
+    std::vector<float> static_scores_;
+    void select_champions(const std::vector<Posting>& postings, std::vector<Posting>& champions) const;
+    uint32_t dense_term_fraction_{DEFAULT_DENSE_TERM_FRACTION};
+    bool any_field_lists_{true};
     void save_document_map();
     void create_term_dictionary();
     void process_document(Document doc);
-    bool should_flush();
 
     std::string block_path(int block_num) const;
     std::string join_title(const std::vector<std::string>& title_words);
 
     // Thread Pool
     std::vector<std::thread> workers_;
-    std::queue<std::function<void()>> tasks_;
+    std::queue<std::function<void(WorkerBlock&)>> tasks_;
     std::mutex queue_mutex_;
     std::condition_variable condition_;
+    std::condition_variable queue_not_full_;  // Signalled when a worker takes a task
     bool stop_{false};
     std::atomic<int> active_tasks_{0};
-    void worker_thread();
+    std::atomic<size_t> documents_indexed_{0};
+    bool checkpointing_{false};  // Guarded by queue_mutex_, holds new documents back
+
+    // Checkpoints
+    size_t checkpointed_documents_{0};  // Prefix of document_metadata_ already written to fragments
+    uint32_t document_fragments_{0};
+    std::vector<docid_t> resumed_doc_ids_;  // Sorted
+    std::string checkpoint_dir() const { return output_dir_ + "/checkpoint"; }
+    void write_checkpoint(const std::string& last_document, size_t position_buffers);
+
+    // Memory accounting, summed over the workers' blocks
+    std::atomic<size_t> posting_bytes_{0};
+    std::atomic<size_t> peak_posting_bytes_{0};
+    std::atomic<size_t> block_flushes_{0};
+    std::atomic<size_t> block_flushes_by_bytes_{0};
+    std::atomic<uint64_t> flushed_posting_bytes_{0};
+    void add_block_bytes(WorkerBlock& block, size_t bytes);
+    void worker_thread(size_t worker_id);
+    void enqueue_task(std::function<void(WorkerBlock&)> task);
+    void wait_for_tasks();
 
     // size_t current_block_size_{0};
     IndexStatistics stats_;
@@ -1,25 +1,33 @@
 #ifndef INDEX_NOTISR_H
 #define INDEX_NOTISR_H
 
+#include "DeletionBitmap.h"
+#include "DensePostings.h"
 #include "IndexStreamReader.h"
+#include <algorithm>
 #include <memory>
 
 namespace mithril {
 
+// Doc IDs [begin, end) one index's documents take, what a NOT query is the complement within
+struct DocIDRange {
+    data::docid_t begin;
+    data::docid_t end;
+};
+
 class NotISR : public IndexStreamReader {
 public:
-    explicit NotISR(std::unique_ptr<IndexStreamReader> reader_in, size_t document_count_in)
-        : reader_(std::move(reader_in)), doc_count_(document_count_in) {
-        // Start at document ID 0 (before first document)
-        current_doc_id_ = 0;
-        
-        // If reader is empty, all documents are included
-        if (!reader_->hasNext()) {
-            return;
-        }
-        
-        // Find first valid document
-        moveNext();
+    explicit NotISR(std::unique_ptr<IndexStreamReader> reader_in,
+                    size_t document_count_in,
+                    const DeletionBitmap* deleted = nullptr,
+                    data::docid_t first_doc_id = 0)
+        : reader_(std::move(reader_in)),
+          first_doc_id_(first_doc_id),
+          doc_count_(document_count_in),
+          deleted_(deleted != nullptr && !deleted->empty() ? deleted : nullptr),
+          dense_(reader_->denseDocs()) {
+        // The index's first document is a candidate like any other
+        advanceFrom(first_doc_id_);
     }
 
     ~NotISR() override = default;
@@ -29,28 +37,8 @@ public:
     }
 
     void moveNext() override {
-        if (!hasNext()) {
-            return;
-        }
-
-        current_doc_id_++;
-
-        // Skip over any document IDs that exist in the underlying reader
-        while (current_doc_id_ <= doc_count_ && 
-               reader_->hasNext() && 
-               reader_->currentDocID() <= current_doc_id_) {
-            
-            if (reader_->currentDocID() == current_doc_id_) {
-                // This document ID exists in reader, so skip it
-                current_doc_id_++;
-                // Reset from the beginning if we need to
-                if (current_doc_id_ <= doc_count_) {
-                    reader_->seekToDocID(current_doc_id_);
-                }
-            } else if (reader_->currentDocID() < current_doc_id_) {
-                // Advance the reader until we catch up
-                reader_->moveNext();
-            }
+        if (hasNext()) {
+            advanceFrom(current_doc_id_ + 1);
         }
     }
 
@@ -58,28 +46,46 @@ public:
         return current_doc_id_;
     }
 
+    // Seeks only move forward, the reader cannot go back over documents it skipped
     void seekToDocID(data::docid_t target_doc_id) override {
-        if (target_doc_id < current_doc_id_) {
-            // If seeking backwards, reset to the beginning
-            reader_->seekToDocID(1);
-            current_doc_id_ = 0;
+        if (hasNext() && target_doc_id > current_doc_id_) {
+            advanceFrom(target_doc_id);
         }
-        
-        // Skip to just before the target
-        current_doc_id_ = target_doc_id - 1;
-        
-        // Then use moveNext to find the next valid document ID
-        moveNext();
-        
-        // If we didn't land exactly on target_doc_id, the target must be
-        // in the excluded set, so we don't need to do anything else
     }
 
-    
 private:
     std::unique_ptr<IndexStreamReader> reader_;
-    data::docid_t current_doc_id_;
-    size_t doc_count_;
+    data::docid_t current_doc_id_{0};
+    data::docid_t first_doc_id_;
+    size_t doc_count_;  // One past the last document ID
+    const DeletionBitmap* deleted_;
+    const DenseDocSet* dense_;
+
+    // Moves to the first document from doc on that the reader does not have and that is not deleted
+    void advanceFrom(data::docid_t doc) {
+        while (doc < doc_count_) {
+            // The complement of a dense term is read off its bitmap a word at a time instead of walking the reader
+            if (dense_ != nullptr) {
+                const auto absent = dense_->nextAbsent(doc);
+                doc = absent && *absent < doc_count_ ? *absent : static_cast<data::docid_t>(doc_count_);
+            } else {
+                if (reader_->hasNext() && reader_->currentDocID() < doc) {
+                    reader_->seekToDocID(doc);
+                }
+                if (reader_->hasNext() && reader_->currentDocID() == doc) {
+                    ++doc;
+                    continue;
+                }
+            }
+            // Deleted documents match nothing, so they are skipped like the reader's documents
+            if (doc < doc_count_ && deleted_ != nullptr && deleted_->isDeleted(doc)) {
+                ++doc;
+                continue;
+            }
+            break;
+        }
+        current_doc_id_ = static_cast<data::docid_t>(std::min<size_t>(doc, doc_count_));
+    }
 };
 
 }  // namespace mithril
@@ -0,0 +1,123 @@
+#include "PositionDictionary.h"
+
+#include "data/Writer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace mithril {
+
+PositionDictionary::PositionDictionary(const std::string& index_dir) {
+    std::string dict_path = index_dir + "/positions.dict";
+
+    dict_fd_ = open(dict_path.c_str(), O_RDONLY);
+    if (dict_fd_ == -1) {
+        spdlog::warn("No position dict file found: {}", dict_path);
+        return;
+    }
+
+    struct stat sb;
+    if (fstat(dict_fd_, &sb) == -1) {
+        spdlog::error("Failed to get position dict file size: {}", dict_path);
+        return;
+    }
+    dict_size_ = sb.st_size;
+    if (dict_size_ < HEADER_SIZE) {
+        spdlog::error("Position dict file is truncated: {}", dict_path);
+        return;
+    }
+
+    dict_data_ = static_cast<const char*>(mmap(nullptr, dict_size_, PROT_READ, MAP_PRIVATE, dict_fd_, 0));
+    if (dict_data_ == MAP_FAILED) {
+        spdlog::error("Failed to memory map position dict file: {}", dict_path);
+        dict_data_ = nullptr;
+        return;
+    }
+
+    const auto* header = reinterpret_cast<const uint32_t*>(dict_data_);
+    const uint32_t magic = header[0];
+    const uint32_t version = header[1];
+    term_count_ = header[2];
+
+    if (magic != MAGIC || version != VERSION) {
+        spdlog::error("Unsupported position dict format in {}, rebuild the index", dict_path);
+        term_count_ = 0;
+        return;
+    }
+
+    const size_t heap_start = HEADER_SIZE + static_cast<size_t>(term_count_) * sizeof(Entry);
+    if (heap_start > dict_size_) {
+        spdlog::error("Position dict file is truncated: {}", dict_path);
+        term_count_ = 0;
+        return;
+    }
+
+    // Header keeps the entries 8-byte aligned within the page aligned mapping
+    entries_ = reinterpret_cast<const Entry*>(dict_data_ + HEADER_SIZE);
+    term_heap_ = dict_data_ + heap_start;
+    loaded_ = true;
+
+    spdlog::info("Memory mapped position dict with {} terms", term_count_);
+}
+
+PositionDictionary::~PositionDictionary() {
+    if (dict_data_ != nullptr) {
+        munmap(const_cast<char*>(dict_data_), dict_size_);
+    }
+
+    if (dict_fd_ != -1) {
+        close(dict_fd_);
+    }
+}
+
+std::optional<PositionMetadata> PositionDictionary::lookup(std::string_view term) const {
+    if (!loaded_ || term_count_ == 0) {
+        return std::nullopt;
+    }
+
+    const Entry* end = entries_ + term_count_;
+    const Entry* it = std::lower_bound(
+        entries_, end, term, [this](const Entry& entry, std::string_view value) { return entry_term(entry) < value; });
+    if (it == end || entry_term(*it) != term) {
+        return std::nullopt;
+    }
+
+    return PositionMetadata{it->data_offset, it->doc_count, it->total_positions};
+}
+
+void PositionDictionary::for_each_term(
+    const std::function<void(std::string_view, const PositionMetadata&)>& fn) const {
+    if (!loaded_) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < term_count_; ++i) {
+        const Entry& entry = entries_[i];
+        fn(entry_term(entry), PositionMetadata{entry.data_offset, entry.doc_count, entry.total_positions});
+    }
+}
+
+void PositionDictionary::write(const std::string& path,
+                               const std::vector<Entry>& entries,
+                               const std::string& term_heap) {
+    data::FileWriter out(path.c_str());
+
+    const uint32_t header[4] = {MAGIC, VERSION, static_cast<uint32_t>(entries.size()), 0};
+    out.Write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.Write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+    out.Write(term_heap.data(), term_heap.size());
+    out.Close();
+}
+
+}  // namespace mithril
@@ -0,0 +1,70 @@
+#ifndef INDEX_POSITIONDICTIONARY_H
+#define INDEX_POSITIONDICTIONARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mithril {
+
+struct PositionMetadata {
+    uint64_t data_offset;
+    uint32_t doc_count;
+    uint32_t total_positions;
+};
+
+// positions.dict maps a term to its entry in positions.data. The file is memory mapped and searched in place,
+// opening it parses nothing but the header.
+//
+// Layout: header {u32 magic, u32 version, u32 term_count, u32 reserved}, then term_count Entry sorted by term,
+// then the term string heap that Entry::term_offset points into.
+class PositionDictionary {
+public:
+    struct Entry {
+        uint64_t data_offset;
+        uint32_t doc_count;
+        uint32_t total_positions;
+        uint32_t term_offset;  // Into the string heap
+        uint32_t term_len;
+    };
+    static_assert(sizeof(Entry) == 24, "positions.dict entries are fixed size");
+
+    static constexpr uint32_t MAGIC = 0x4D504F53;  // "MPOS"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 4 * sizeof(uint32_t);
+
+    explicit PositionDictionary(const std::string& index_dir);
+    ~PositionDictionary();
+
+    std::optional<PositionMetadata> lookup(std::string_view term) const;
+    // Visits every term in sorted order
+    void for_each_term(const std::function<void(std::string_view, const PositionMetadata&)>& fn) const;
+    size_t size() const { return term_count_; }
+    bool is_loaded() const { return loaded_; }
+
+    // Writes a dictionary file. Entries must be sorted by term and point into term_heap.
+    static void write(const std::string& path, const std::vector<Entry>& entries, const std::string& term_heap);
+
+    PositionDictionary(const PositionDictionary&) = delete;
+    PositionDictionary& operator=(const PositionDictionary&) = delete;
+
+private:
+    int dict_fd_ = -1;
+    const char* dict_data_ = nullptr;
+    size_t dict_size_ = 0;
+
+    uint32_t term_count_ = 0;
+    const Entry* entries_ = nullptr;
+    const char* term_heap_ = nullptr;
+    bool loaded_ = false;
+
+    std::string_view entry_term(const Entry& entry) const { return {term_heap_ + entry.term_offset, entry.term_len}; }
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_POSITIONDICTIONARY_H
@@ -1,6 +1,7 @@
 #ifndef POSITION_INDEX_H
 #define POSITION_INDEX_H
 
+#include "PositionDictionary.h"
 #include "TextPreprocessor.h"
 #include "Utils.h"
 #include "core/mem_map_file.h"
@@ -8,8 +9,10 @@
 
 #include <array>
 #include <fstream>
+#include <functional>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -17,10 +20,18 @@ namespace mithril {
 
 using TermPositions = std::vector<std::pair<uint32_t, std::pair<uint8_t, std::vector<uint16_t>>>>;
 
-struct PositionMetadata {
-    uint64_t data_offset;
-    uint32_t doc_count;
-    uint32_t total_positions;
+// Every term's entry in positions.data, starting at PositionMetadata::data_offset:
+//   u32 skip_count, then skip_count PositionSkipEntry
+//   doc_count records sorted by doc ID: u32 doc_id, u8 field_flags, u32 pos_count, u32 pos_bytes, then pos_bytes
+//   of VByte position deltas
+// Skip entry i describes record i * POSITION_SKIP_INTERVAL, its offset is relative to the term's first record.
+static constexpr uint32_t POSITION_SKIP_INTERVAL = 16;
+static constexpr size_t POSITION_RECORD_HEADER_SIZE =
+    sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t);
+
+struct PositionSkipEntry {
+    uint32_t doc_id;
+    uint32_t offset;
 };
 
 struct PositionEntry {
@@ -37,55 +48,68 @@ struct FieldPositions {
     uint8_t field_flags{0};
 };
 
+// Cursor over one term's position records. Seeks binary search the term's skip table and then hop over at most
+// POSITION_SKIP_INTERVAL record headers, positions are only decoded when asked for.
+class PositionCursor {
+public:
+    PositionCursor() = default;  // Cursor for a term without positions, never finds a document
+    PositionCursor(const char* term_data, uint32_t doc_count);
+
+    bool atEnd() const { return index_ >= doc_count_; }
+    uint32_t docId() const { return doc_id_; }
+    uint8_t fieldFlags() const { return field_flags_; }
+    uint32_t positionCount() const { return pos_count_; }
+
+    // Moves to the first record with a doc ID >= doc_id, returns whether that record is doc_id. Seeking
+    // forward continues from the current record, seeking backward restarts from the skip table.
+    bool seekTo(uint32_t doc_id);
+
+    // Positions of the current record, decoded on first access. Valid until the cursor moves.
+    const std::vector<uint16_t>& positions();
+
+private:
+    const char* skips_{nullptr};
+    const char* records_{nullptr};
+    uint32_t skip_count_{0};
+    uint32_t doc_count_{0};
+
+    // Current record
+    uint32_t index_{0};
+    const char* record_{nullptr};
+    uint32_t doc_id_{0};
+    uint8_t field_flags_{0};
+    uint32_t pos_count_{0};
+    uint32_t pos_bytes_{0};
+
+    std::vector<uint16_t> positions_;
+    bool positions_decoded_{false};
+
+    uint32_t skipDocId(uint32_t skip) const;
+    void jumpToSkip(uint32_t skip);
+    void readRecord();
+};
+
 class PositionIndex {
 public:
     PositionIndex(const std::string& index_dir);
     ~PositionIndex();
 
-    std::pair<bool, const char*> hasPositionsFromByte(const std::string& term, uint32_t doc_id, const char* data) const;
-    bool hasPositions(const std::string& term, uint32_t doc_id) const;
-
-    std::pair<std::vector<uint16_t>, const char*>
-    getPositionsFromByte(const char* data_ptr, const std::string& term, uint32_t doc_id) const;
+    // Cursor over the term's position records, a default cursor if the term has none
+    PositionCursor cursor(const std::string& term) const;
+    // Visits every term with positions in sorted order, with a cursor on its first record
+    void forEachTerm(const std::function<void(std::string_view, PositionCursor&)>& fn) const;
 
+    bool hasPositions(const std::string& term, uint32_t doc_id) const;
     std::vector<uint16_t> getPositions(const std::string& term, uint32_t doc_id) const;
     uint8_t getFieldFlags(const std::string& term, uint32_t doc_id) const;
     bool checkPhrase(const std::string& term1, const std::string& term2, uint32_t doc_id, int distance = 1) const;
 
-    static void addPositions(const std::string& output_dir,
-                             const std::string& term,
-                             uint32_t doc_id,
-                             uint8_t field_flags,
-                             const std::vector<uint16_t>& positions);
-
-    static void addPositionsBatch(const std::string& output_dir,
-                                  uint32_t doc_id,
-                                  const std::vector<std::pair<std::string, FieldPositions>>& term_positions);
-
-    static void finalizeIndex(const std::string& output_dir);
     static bool shouldStorePositions(const std::string& term, uint32_t freq, size_t total_terms);
 
-    mutable core::MemMapFile data_file_;
-    std::unordered_map<std::string, PositionMetadata> posDict_;
-
 private:
     std::string index_dir_;
-
-    bool loadPosDict();
-    uint32_t decodeVByte(const char*& ptr) const;
-
-    static std::mutex buffer_mutex_;
-    static std::unordered_map<std::string, std::vector<PositionEntry>> position_buffer_;
-    static size_t buffer_size_;
-    static int buffer_counter_;
-    static constexpr size_t MAX_BUFFER_SIZE = 512 * 1024 * 1024;
-
-    static void flushBuffer(const std::string& output_dir);
-    static void mergePositionBuffers(const std::string& output_dir);
-    static bool writeTerm(const std::string& term,
-                          const TermPositions& docs_positions,
-                          data::FileWriter& data_out,
-                          data::FileWriter& posDict_out);
+    mutable core::MemMapFile data_file_;
+    PositionDictionary pos_dict_;
 };
 
 }  // namespace mithril
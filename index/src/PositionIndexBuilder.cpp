@@ -0,0 +1,625 @@
+#include "PositionIndexBuilder.h"
+
+#include "Utils.h"
+#include "data/Writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+namespace mithril {
+
+PositionIndexBuilder::PositionIndexBuilder(const std::string& output_dir, size_t num_buffers, size_t max_buffer_bytes)
+    : output_dir_(output_dir),
+      pos_dir_(output_dir + "/positions"),
+      max_bytes_per_buffer_(std::max<size_t>(max_buffer_bytes / std::max<size_t>(num_buffers, 1), 1)),
+      buffers_(std::max<size_t>(num_buffers, 1)) {
+    flusher_ = std::thread(&PositionIndexBuilder::flusherLoop, this);
+}
+
+PositionIndexBuilder::~PositionIndexBuilder() {
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        stop_ = true;
+    }
+    flush_cv_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+}
+
+void PositionIndexBuilder::addPositionsBatch(size_t buffer_idx,
+                                             uint32_t doc_id,
+                                             std::vector<std::pair<std::string, FieldPositions>>&& term_positions) {
+    if (term_positions.empty())
+        return;
+
+    Buffer& buffer = buffers_[buffer_idx];
+    size_t added_bytes = 0;
+    for (auto& [term, field_pos] : term_positions) {
+        // Flatten positions while maintaining order
+        std::vector<uint16_t> flat_positions;
+        size_t total_positions = 0;
+        for (const auto& pos_vec : field_pos.positions) {
+            total_positions += pos_vec.size();
+        }
+        if (total_positions == 0) {
+            continue;
+        }
+        flat_positions.reserve(total_positions);
+
+        for (const auto& pos_vec : field_pos.positions) {
+            flat_positions.insert(flat_positions.end(), pos_vec.begin(), pos_vec.end());
+        }
+
+        auto [it, inserted] = buffer.terms.try_emplace(std::move(term));
+        if (inserted) {
+            // Hash node holding the term and its entry vector
+            added_bytes += sizeof(TermBuffer::value_type) + sizeof(void*) + it->first.capacity();
+        }
+        const size_t entries_capacity = it->second.capacity();
+        it->second.push_back(PositionEntry{doc_id, field_pos.field_flags, std::move(flat_positions)});
+        added_bytes += (it->second.capacity() - entries_capacity) * sizeof(PositionEntry) +
+                       it->second.back().positions.capacity() * sizeof(uint16_t);
+    }
+
+    buffer.bytes += added_bytes;
+    buffered_bytes_ += added_bytes;
+    if (buffer.bytes >= max_bytes_per_buffer_) {
+        flushBuffer(buffer);
+    }
+}
+
+void PositionIndexBuilder::flushBuffer(Buffer& buffer) {
+    if (buffer.terms.empty()) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(flush_mutex_);
+        // Backpressure: don't let full buffers pile up faster than the flusher writes them
+        flush_cv_.wait(lock, [this] { return flush_queue_.size() < MAX_PENDING_FLUSHES; });
+        buffered_bytes_ -= buffer.bytes;
+        pending_bytes_ += buffer.bytes;
+        flush_queue_.push_back(std::move(buffer));
+        flushes_in_flight_++;
+    }
+    flush_cv_.notify_all();
+
+    buffer.terms = TermBuffer{};
+    buffer.bytes = 0;
+}
+
+PositionIndexBuilder::MemoryStats PositionIndexBuilder::memoryStats() const {
+    return MemoryStats{buffered_bytes_.load(), pending_bytes_.load(), flush_count_.load(), flushed_bytes_.load()};
+}
+
+void PositionIndexBuilder::waitForFlushes() {
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    flush_cv_.wait(lock, [this] { return flushes_in_flight_ == 0; });
+}
+
+void PositionIndexBuilder::flusherLoop() {
+    while (true) {
+        Buffer buffer;
+        int buffer_num = 0;
+        {
+            std::unique_lock<std::mutex> lock(flush_mutex_);
+            flush_cv_.wait(lock, [this] { return stop_ || !flush_queue_.empty(); });
+            if (flush_queue_.empty()) {
+                return;  // Stopping with nothing left to write
+            }
+            buffer = std::move(flush_queue_.front());
+            flush_queue_.pop_front();
+            buffer_num = buffer_counter_++;
+        }
+        flush_cv_.notify_all();  // Wake threads waiting on a full queue
+
+        std::exception_ptr error;
+        try {
+            writeBufferFile(buffer.terms, buffer_num);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        buffer.terms.clear();
+        pending_bytes_ -= buffer.bytes;
+        flushed_bytes_ += buffer.bytes;
+        flush_count_++;
+
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            if (error && !flush_error_) {
+                flush_error_ = error;
+            }
+            flushes_in_flight_--;
+        }
+        flush_cv_.notify_all();
+    }
+}
+
+void PositionIndexBuilder::writeBufferFile(const TermBuffer& terms, int buffer_num) const {
+    try {
+        // Create positions dir if needed
+        if (!fs::exists(pos_dir_)) {
+            fs::create_directories(pos_dir_);
+        }
+
+        // The merge expects every buffer file's terms in sorted order
+        std::vector<const TermBuffer::value_type*> sorted_terms;
+        sorted_terms.reserve(terms.size());
+        for (const auto& entry : terms) {
+            sorted_terms.push_back(&entry);
+        }
+        std::sort(sorted_terms.begin(), sorted_terms.end(), [](const auto* a, const auto* b) {
+            return a->first < b->first;
+        });
+
+        std::string buffer_file = pos_dir_ + "/buffer_" + std::to_string(buffer_num) + ".data";
+        auto out = data::FileWriter{buffer_file.c_str()};
+
+        // Write number of terms
+        uint32_t term_count = sorted_terms.size();
+        out.Write(reinterpret_cast<const char*>(&term_count), sizeof(term_count));
+
+        // Write each term's data
+        for (const auto* term_entry : sorted_terms) {
+            const auto& [term, entries] = *term_entry;
+
+            // Write term length and term
+            uint32_t term_len = term.length();
+            out.Write(reinterpret_cast<const char*>(&term_len), sizeof(term_len));
+            out.Write(term.data(), term_len);
+
+            // Write doc count
+            uint32_t doc_count = entries.size();
+            out.Write(reinterpret_cast<const char*>(&doc_count), sizeof(doc_count));
+
+            // Write each doc's positions
+            for (const auto& entry : entries) {
+                // Write doc ID and position count
+                out.Write(reinterpret_cast<const char*>(&entry.doc_id), sizeof(entry.doc_id));
+                out.Write(reinterpret_cast<const char*>(&entry.field_flags), sizeof(entry.field_flags));
+
+                uint32_t pos_count = entry.positions.size();
+                out.Write(reinterpret_cast<const char*>(&pos_count), sizeof(pos_count));
+
+                // Write delta-encoded positions
+                uint16_t prev_pos = 0;
+                for (uint16_t pos : entry.positions) {
+                    uint16_t delta = pos - prev_pos;
+                    VByteCodec::encode(delta, out);
+                    prev_pos = pos;
+                }
+            }
+        }
+        out.Close();
+    } catch (const std::exception& e) {
+        spdlog::error("Error flushing position buffer {}: {}", buffer_num, e.what());
+        throw;
+    }
+}
+
+size_t PositionIndexBuilder::importPositions(const PositionIndex& source,
+                                             const DeletionBitmap* deleted,
+                                             const DocIdMap& doc_ids) {
+    int buffer_num = 0;
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        buffer_num = buffer_counter_++;
+    }
+
+    if (!fs::exists(pos_dir_)) {
+        fs::create_directories(pos_dir_);
+    }
+    const std::string buffer_file = pos_dir_ + "/buffer_" + std::to_string(buffer_num) + ".data";
+    auto out = data::FileWriter{buffer_file.c_str()};
+
+    // Same layout as writeBufferFile, the term count is patched in once known
+    uint32_t term_count = 0;
+    out.Write(reinterpret_cast<const char*>(&term_count), sizeof(term_count));
+
+    std::vector<char> encoded;
+    source.forEachTerm([&](std::string_view term, PositionCursor& cursor) {
+        uint32_t doc_count = 0;
+        encoded.clear();
+        for (; !cursor.atEnd(); cursor.seekTo(cursor.docId() + 1)) {
+            if (deleted != nullptr && deleted->isDeleted(cursor.docId())) {
+                continue;
+            }
+            const uint32_t doc_id = doc_ids(cursor.docId());
+            const std::vector<uint16_t>& positions = cursor.positions();
+            const uint32_t pos_count = positions.size();
+            encoded.insert(encoded.end(),
+                           reinterpret_cast<const char*>(&doc_id),
+                           reinterpret_cast<const char*>(&doc_id) + sizeof(doc_id));
+            encoded.push_back(static_cast<char>(cursor.fieldFlags()));
+            encoded.insert(encoded.end(),
+                           reinterpret_cast<const char*>(&pos_count),
+                           reinterpret_cast<const char*>(&pos_count) + sizeof(pos_count));
+
+            uint16_t prev_pos = 0;
+            for (uint16_t pos : positions) {
+                VByteCodec::encode_to_vector(static_cast<uint16_t>(pos - prev_pos), encoded);
+                prev_pos = pos;
+            }
+            doc_count++;
+        }
+        if (doc_count == 0) {
+            return;
+        }
+
+        const uint32_t term_len = term.size();
+        out.Write(reinterpret_cast<const char*>(&term_len), sizeof(term_len));
+        out.Write(term.data(), term_len);
+        out.Write(reinterpret_cast<const char*>(&doc_count), sizeof(doc_count));
+        out.Write(encoded.data(), encoded.size());
+        term_count++;
+    });
+    out.Close();
+
+    std::fstream patch(buffer_file, std::ios::binary | std::ios::in | std::ios::out);
+    patch.write(reinterpret_cast<const char*>(&term_count), sizeof(term_count));
+    return term_count;
+}
+
+size_t PositionIndexBuilder::checkpoint() {
+    for (auto& buffer : buffers_) {
+        flushBuffer(buffer);
+    }
+    waitForFlushes();
+
+    // buffer_counter_ counts the failed write's file too, a checkpoint over it would lose its positions
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    if (flush_error_) {
+        std::rethrow_exception(flush_error_);
+    }
+    return static_cast<size_t>(buffer_counter_);
+}
+
+void PositionIndexBuilder::resume(size_t buffer_count) {
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        buffer_counter_ = static_cast<int>(buffer_count);
+    }
+
+    std::error_code ec;
+    if (!fs::exists(pos_dir_, ec)) {
+        return;
+    }
+    for (const auto& entry : fs::directory_iterator(pos_dir_)) {
+        const std::string name = entry.path().filename().string();
+        int buffer_num = -1;
+        if (std::sscanf(name.c_str(), "buffer_%d.data", &buffer_num) == 1 && buffer_num >= 0 &&
+            static_cast<size_t>(buffer_num) < buffer_count) {
+            continue;
+        }
+        spdlog::info("Removing position buffer written after the checkpoint: {}", entry.path().string());
+        fs::remove(entry.path(), ec);
+    }
+}
+
+void PositionIndexBuilder::finalize(const DocIdMap& doc_ids) {
+    try {
+        checkpoint();
+
+        // Merge buffer files
+        mergePositionBuffers(doc_ids);
+    } catch (const std::exception& e) {
+        spdlog::error("Error finalizing position index: {}", e.what());
+        throw;
+    }
+}
+
+void PositionIndexBuilder::mergePositionBuffers(const DocIdMap& doc_ids) {
+    const std::string& output_dir = output_dir_;
+    const std::string& pos_dir = pos_dir_;
+
+    try {
+        if (buffer_counter_ == 0) {
+            spdlog::info("No position data to merge");
+            return;
+        }
+
+        // Get all buffer files
+        std::vector<std::string> buffer_files;
+        for (int i = 0; i < buffer_counter_; i++) {
+            std::string buffer_file = pos_dir + "/buffer_" + std::to_string(i) + ".data";
+            if (fs::exists(buffer_file)) {
+                buffer_files.push_back(buffer_file);
+            }
+        }
+
+        spdlog::info("Merging {} position buffer files", buffer_files.size());
+
+        // Open output files
+        std::string data_file = output_dir + "/positions.data";
+        data::FileWriter data_out(data_file.c_str());
+        std::string posDict_file = output_dir + "/positions.dict";
+        std::vector<PositionDictionary::Entry> dict_entries;
+        std::string term_heap;
+
+        // Structure to track a term being processed from a file
+        struct TermInfo {
+            std::string term;
+            uint32_t doc_count;
+            size_t stream_index;  // Index into streams vector
+
+            bool operator<(const TermInfo& other) const {
+                return term > other.term;  // Reverse for min-heap
+            }
+        };
+
+        // Open input streams - keeping them in a vector for stable addresses
+        std::vector<std::ifstream> streams;
+        streams.reserve(buffer_files.size());
+
+        // pqueue for merge
+        std::priority_queue<TermInfo> queue;
+
+        // init with first term from each file
+        for (size_t i = 0; i < buffer_files.size(); i++) {
+            streams.emplace_back(buffer_files[i], std::ios::binary);
+            std::ifstream& stream = streams.back();
+
+            if (!stream) {
+                spdlog::warn("Failed to open buffer file: {}", buffer_files[i]);
+                continue;
+            }
+
+            // Read term count
+            uint32_t term_count;
+            if (!stream.read(reinterpret_cast<char*>(&term_count), sizeof(term_count))) {
+                spdlog::warn("Failed to read term count from file: {}", buffer_files[i]);
+                continue;
+            }
+
+            if (term_count > 0) {
+                // Read first term
+                uint32_t term_len;
+                if (!stream.read(reinterpret_cast<char*>(&term_len), sizeof(term_len))) {
+                    spdlog::warn("Failed to read term length from file: {}", buffer_files[i]);
+                    continue;
+                }
+
+                std::string term(term_len, ' ');
+                if (!stream.read(&term[0], term_len)) {
+                    spdlog::warn("Failed to read term string from file: {}", buffer_files[i]);
+                    continue;
+                }
+
+                // Read doc count
+                uint32_t doc_count;
+                if (!stream.read(reinterpret_cast<char*>(&doc_count), sizeof(doc_count))) {
+                    spdlog::warn("Failed to read doc count from file: {}", buffer_files[i]);
+                    continue;
+                }
+
+                // Add to priority queue
+                queue.push({term, doc_count, i});
+            }
+        }
+
+        uint32_t total_terms = 0;
+
+        // Process all terms
+        std::string current_term;
+        TermPositions current_positions;
+
+        while (!queue.empty()) {
+            // Get next term from queue
+            TermInfo info = queue.top();
+            queue.pop();
+
+            // Safety check for stream index
+            if (info.stream_index >= streams.size() || !streams[info.stream_index]) {
+                spdlog::error("Invalid stream index or bad stream: {}", info.stream_index);
+                continue;
+            }
+
+            std::ifstream& stream = streams[info.stream_index];
+
+            // If new term, write previous term data
+            if (current_term != info.term) {
+                if (!current_term.empty()) {
+                    // Write previous term
+                    if (!writeTerm(current_term, current_positions, data_out, dict_entries, term_heap)) {
+                        throw std::runtime_error("Failed to write term: " + current_term);
+                    }
+                    total_terms++;
+                }
+
+                // Start new term
+                current_term = info.term;
+                current_positions.clear();
+            }
+
+            // Read all docs for this term
+            for (uint32_t i = 0; i < info.doc_count && stream.good(); i++) {
+                // Read doc ID
+                uint32_t doc_id;
+                if (!stream.read(reinterpret_cast<char*>(&doc_id), sizeof(doc_id))) {
+                    spdlog::error("Failed to read doc ID for term: {}", info.term);
+                    break;
+                }
+
+                // Read field flags
+                uint8_t field_flags;
+                if (!stream.read(reinterpret_cast<char*>(&field_flags), sizeof(field_flags))) {
+                    spdlog::error("Failed to read field flags for doc: {}", doc_id);
+                    break;
+                }
+
+                // Read position count
+                uint32_t pos_count;
+                if (!stream.read(reinterpret_cast<char*>(&pos_count), sizeof(pos_count))) {
+                    spdlog::error("Failed to read position count for doc: {}", doc_id);
+                    break;
+                }
+
+                // Read positions
+                std::vector<uint16_t> positions;
+                positions.reserve(pos_count);
+
+                uint16_t prev_pos = 0;
+                bool read_success = true;
+
+                for (uint32_t j = 0; j < pos_count; j++) {
+                    try {
+                        uint16_t delta = VByteCodec::decode(stream);
+                        prev_pos += delta;
+                        positions.push_back(prev_pos);
+                    } catch (const std::exception& e) {
+                        spdlog::error("Error decoding position: {}", e.what());
+                        read_success = false;
+                        break;
+                    }
+                }
+
+                if (read_success) {
+                    current_positions.emplace_back(doc_ids(doc_id),
+                                                   std::make_pair(field_flags, std::move(positions)));
+                }
+            }
+
+            // Try to read next term from this file
+            if (stream.good()) {
+                // Read next term length
+                uint32_t term_len;
+                if (!stream.read(reinterpret_cast<char*>(&term_len), sizeof(term_len))) {
+                    // End of file or error, continue to next stream
+                    continue;
+                }
+
+                // Read term
+                std::string term(term_len, ' ');
+                if (!stream.read(&term[0], term_len)) {
+                    continue;
+                }
+
+                // Read doc count
+                uint32_t doc_count;
+                if (!stream.read(reinterpret_cast<char*>(&doc_count), sizeof(doc_count))) {
+                    continue;
+                }
+
+                // Add to queue
+                queue.push({term, doc_count, info.stream_index});
+            }
+        }
+
+        // Write final term if any
+        if (!current_term.empty()) {
+            if (!writeTerm(current_term, current_positions, data_out, dict_entries, term_heap)) {
+                throw std::runtime_error("Failed to write final term: " + current_term);
+            }
+            total_terms++;
+        }
+
+        // Close files, the merge produced the dictionary entries in term order
+        data_out.Close();
+        PositionDictionary::write(posDict_file, dict_entries, term_heap);
+
+        // Clean up
+        for (const auto& buffer_file : buffer_files) {
+            fs::remove(buffer_file);
+        }
+        fs::remove_all(pos_dir);
+
+        spdlog::info("Position index merge complete. Total terms: {}", total_terms);
+    } catch (const std::exception& e) {
+        spdlog::error("Error merging position buffers: {}", e.what());
+    }
+}
+
+bool PositionIndexBuilder::writeTerm(const std::string& term,
+                                     const TermPositions& docs_positions,
+                                     data::FileWriter& data_out,
+                                     std::vector<PositionDictionary::Entry>& dict_entries,
+                                     std::string& term_heap) {
+    try {
+        // Sort docs by ID
+        TermPositions sorted_docs = docs_positions;
+        std::sort(
+            sorted_docs.begin(), sorted_docs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        // Prepare metadata
+        PositionMetadata metadata;
+        metadata.data_offset = static_cast<uint64_t>(data_out.Ftell());
+        metadata.doc_count = sorted_docs.size();
+        metadata.total_positions = 0;
+
+        for (const auto& [doc_id, data] : sorted_docs) {
+            metadata.total_positions += data.second.size();
+        }
+
+        // Add term to dictionary
+        dict_entries.push_back(PositionDictionary::Entry{metadata.data_offset,
+                                                         metadata.doc_count,
+                                                         metadata.total_positions,
+                                                         static_cast<uint32_t>(term_heap.size()),
+                                                         static_cast<uint32_t>(term.size())});
+        term_heap += term;
+
+        // Encode the doc records, remembering where every POSITION_SKIP_INTERVAL-th record starts
+        std::vector<PositionSkipEntry> skips;
+        skips.reserve((sorted_docs.size() + POSITION_SKIP_INTERVAL - 1) / POSITION_SKIP_INTERVAL);
+        std::vector<char> records;
+        std::vector<char> encoded_positions;
+        auto append = [&records](const auto& value) {
+            const auto* bytes = reinterpret_cast<const char*>(&value);
+            records.insert(records.end(), bytes, bytes + sizeof(value));
+        };
+        for (size_t i = 0; i < sorted_docs.size(); ++i) {
+            const auto& [doc_id, data] = sorted_docs[i];
+            const auto& [field_flags, positions] = data;
+
+            if (i % POSITION_SKIP_INTERVAL == 0) {
+                skips.push_back(PositionSkipEntry{doc_id, static_cast<uint32_t>(records.size())});
+            }
+
+            encoded_positions.clear();
+            uint16_t prev_pos = 0;
+            for (uint16_t pos : positions) {
+                uint16_t delta = pos - prev_pos;
+                VByteCodec::encode_to_vector(delta, encoded_positions);
+                prev_pos = pos;
+            }
+
+            const uint32_t pos_count = positions.size();
+            const uint32_t pos_bytes = encoded_positions.size();
+            append(doc_id);
+            append(field_flags);
+            append(pos_count);
+            append(pos_bytes);
+            records.insert(records.end(), encoded_positions.begin(), encoded_positions.end());
+        }
+
+        // Write skip table, then the records
+        uint32_t skip_count = skips.size();
+        data_out.Write(reinterpret_cast<const char*>(&skip_count), sizeof(skip_count));
+        for (const auto& skip : skips) {
+            data_out.Write(reinterpret_cast<const char*>(&skip.doc_id), sizeof(skip.doc_id));
+            data_out.Write(reinterpret_cast<const char*>(&skip.offset), sizeof(skip.offset));
+        }
+        data_out.Write(records.data(), records.size());
+
+        return true;
+    } catch (const std::exception& e) {
+        spdlog::error("Error writing term {}: {}", term, e.what());
+        return false;
+    }
+}
+
+}  // namespace mithril
@@ -0,0 +1,120 @@
+#ifndef INDEX_POSITIONINDEXBUILDER_H
+#define INDEX_POSITIONINDEXBUILDER_H
+
+#include "DeletionBitmap.h"
+#include "DocIdMap.h"
+#include "PositionDictionary.h"
+#include "PositionIndex.h"
+#include "data/Writer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mithril {
+
+// Builds positions.data and positions.dict for one index. Every indexing thread appends to its own buffer, so
+// accumulating positions takes no shared lock. Full buffers are handed to a background thread that writes them
+// to positions/buffer_N.data, and finalize() merges those files.
+class PositionIndexBuilder {
+public:
+    static constexpr size_t DEFAULT_MAX_BUFFER_BYTES = 512 * 1024 * 1024;  // Shared by all buffers
+
+    struct MemoryStats {
+        size_t buffered_bytes;       // Held by buffers still being filled
+        size_t pending_flush_bytes;  // Held by full buffers waiting for or being written by the flusher
+        size_t flushes;
+        uint64_t flushed_bytes;
+    };
+
+    PositionIndexBuilder(const std::string& output_dir,
+                         size_t num_buffers,
+                         size_t max_buffer_bytes = DEFAULT_MAX_BUFFER_BYTES);
+    ~PositionIndexBuilder();
+
+    // Adds one document's positions to buffer buffer_idx. A buffer must only be used by one thread at a time.
+    void addPositionsBatch(size_t buffer_idx,
+                           uint32_t doc_id,
+                           std::vector<std::pair<std::string, FieldPositions>>&& term_positions);
+
+    // Flushes every buffer, waits for pending writes and merges the buffer files into the final position index,
+    // renumbering documents by doc_ids. Throws what a failed buffer write threw. No thread may add positions
+    // concurrently.
+    void finalize(const DocIdMap& doc_ids = {});
+
+    // Copies every term of an existing position index into a buffer file of its own, so finalize() merges it with
+    // the positions added here. Documents marked in deleted are left out, the others are renumbered by doc_ids.
+    // Returns the number of terms copied.
+    size_t importPositions(const PositionIndex& source,
+                           const DeletionBitmap* deleted = nullptr,
+                           const DocIdMap& doc_ids = {});
+
+    // Flushes every buffer and waits until the buffer files are written. Returns the number of buffer files, all
+    // of them complete, or throws what the first failed write threw. No thread may add positions concurrently.
+    size_t checkpoint();
+    // Continues after a checkpoint of buffer_count files, deleting buffer files written after it
+    void resume(size_t buffer_count);
+
+    // Estimated heap bytes, safe to call from any thread
+    MemoryStats memoryStats() const;
+
+    PositionIndexBuilder(const PositionIndexBuilder&) = delete;
+    PositionIndexBuilder& operator=(const PositionIndexBuilder&) = delete;
+
+private:
+    using TermBuffer = std::unordered_map<std::string, std::vector<PositionEntry>>;
+
+    struct Buffer {
+        TermBuffer terms;
+        size_t bytes{0};
+    };
+
+    // Pending flushes beyond which indexing threads wait for the flusher, bounds memory held by full buffers
+    static constexpr size_t MAX_PENDING_FLUSHES = 2;
+
+    const std::string output_dir_;
+    const std::string pos_dir_;
+    const size_t max_bytes_per_buffer_;
+    std::vector<Buffer> buffers_;
+
+    // Background flusher
+    std::thread flusher_;
+    std::mutex flush_mutex_;
+    std::condition_variable flush_cv_;
+    std::deque<Buffer> flush_queue_;
+    size_t flushes_in_flight_{0};
+    int buffer_counter_{0};
+    bool stop_{false};
+    // First exception a buffer write threw, its file is missing or truncated
+    std::exception_ptr flush_error_;
+
+    std::atomic<size_t> buffered_bytes_{0};
+    std::atomic<size_t> pending_bytes_{0};
+    std::atomic<size_t> flush_count_{0};
+    std::atomic<uint64_t> flushed_bytes_{0};
+
+    void flushBuffer(Buffer& buffer);
+    void waitForFlushes();
+    void flusherLoop();
+    void writeBufferFile(const TermBuffer& terms, int buffer_num) const;
+    void mergePositionBuffers(const DocIdMap& doc_ids);
+
+    static bool writeTerm(const std::string& term,
+                          const TermPositions& docs_positions,
+                          data::FileWriter& data_out,
+                          std::vector<PositionDictionary::Entry>& dict_entries,
+                          std::string& term_heap);
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_POSITIONINDEXBUILDER_H
@@ -1,9 +1,9 @@
 #include "PostingBlock.h"
 
-#include "InvertedIndex.h"
 #include "Utils.h"
 
 #include <cerrno>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <unistd.h>
@@ -12,6 +12,35 @@
 
 namespace mithril {
 
+BlockWriter::BlockWriter(const std::string& path) : out_(path.c_str()) {
+    // Placeholder for the term count, filled in by finish()
+    uint32_t num_terms = 0;
+    out_.Write(reinterpret_cast<const char*>(&num_terms), sizeof(num_terms));
+}
+
+void BlockWriter::add_term(const std::string& term, const std::vector<Posting>& postings) {
+    buffer_.clear();
+    VByteCodec::encode_to_vector(term.size(), buffer_);
+    buffer_.insert(buffer_.end(), term.begin(), term.end());
+    VByteCodec::encode_to_vector(postings.size(), buffer_);
+
+    uint32_t last_doc_id = 0;
+    for (const auto& posting : postings) {
+        VByteCodec::encode_to_vector(posting.doc_id - last_doc_id, buffer_);
+        VByteCodec::encode_to_vector(posting.freq, buffer_);
+        last_doc_id = posting.doc_id;
+    }
+
+    out_.Write(buffer_.data(), buffer_.size());
+    term_count_++;
+}
+
+void BlockWriter::finish() {
+    out_.Fseek(0);
+    out_.Write(reinterpret_cast<const char*>(&term_count_), sizeof(term_count_));
+    out_.Close();
+}
+
 BlockReader::BlockReader(const std::string& path) : file_path_(path) {
     fd = open(path.c_str(), O_RDONLY);
     if (fd == -1) {
@@ -36,9 +65,17 @@ BlockReader::BlockReader(const std::string& path) : file_path_(path) {
         throw std::runtime_error("Memory mapping failed: " + std::string(strerror(errno)));
     }
 
-    current = data;
+    // Blocks are consumed front to back exactly once
+    if (size > 0) {
+        madvise(const_cast<char*>(data), size, MADV_SEQUENTIAL);
+    }
 
-    // Skip initial term count
+    current = data;
+    if (!validate_remaining(sizeof(uint32_t))) {
+        has_next = false;
+        return;
+    }
+    std::memcpy(&terms_remaining_, current, sizeof(terms_remaining_));
     current += sizeof(uint32_t);
 
     read_next();
@@ -56,12 +93,12 @@ BlockReader::~BlockReader() {
 BlockReader::BlockReader(BlockReader&& other) noexcept
     : current_term(std::move(other.current_term)),
       current_postings(std::move(other.current_postings)),
-      current_sync_points(std::move(other.current_sync_points)),
+      has_next(other.has_next),
       data(other.data),
       size(other.size),
       fd(other.fd),
       current(other.current),
-      has_next(other.has_next),
+      terms_remaining_(other.terms_remaining_),
       file_path_(std::move(other.file_path_)) {
     other.data = nullptr;
     other.size = 0;
@@ -83,11 +120,11 @@ BlockReader& BlockReader::operator=(BlockReader&& other) noexcept {
         // Move from other
         current_term = std::move(other.current_term);
         current_postings = std::move(other.current_postings);
-        current_sync_points = std::move(other.current_sync_points);
         data = other.data;
         size = other.size;
         fd = other.fd;
         current = other.current;
+        terms_remaining_ = other.terms_remaining_;
         has_next = other.has_next;
         file_path_ = std::move(other.file_path_);
 
@@ -101,17 +138,30 @@ BlockReader& BlockReader::operator=(BlockReader&& other) noexcept {
     return *this;
 }
 
+bool BlockReader::read_varint(uint32_t& value) {
+    value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        if (!validate_remaining(1)) {
+            return false;
+        }
+        const uint8_t byte = *reinterpret_cast<const uint8_t*>(current++);
+        value |= static_cast<uint32_t>(byte & 127) << shift;
+        if (!(byte & 128)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void BlockReader::read_next() {
-    if (!validate_remaining(sizeof(uint32_t))) {
+    if (terms_remaining_ == 0) {
         has_next = false;
         return;
     }
 
     // Read term length and validate
     uint32_t term_len;
-    std::memcpy(&term_len, current, sizeof(term_len));
-    current += sizeof(term_len);
-    if (!validate_remaining(term_len + sizeof(uint32_t))) {
+    if (!read_varint(term_len) || !validate_remaining(term_len)) {
         has_next = false;
         return;
     }
@@ -120,74 +170,29 @@ void BlockReader::read_next() {
     current_term.assign(current, term_len);
     current += term_len;
 
-    // Read postings size and validate
+    // Read postings size
     uint32_t postings_size;
-    std::memcpy(&postings_size, current, sizeof(postings_size));
-    current += sizeof(postings_size);
-
-    // Read sync points size
-    uint32_t sync_points_size;
-    std::memcpy(&sync_points_size, current, sizeof(sync_points_size));
-    current += sizeof(sync_points_size);
-
-    // Read sync points if any
-    current_sync_points.resize(sync_points_size);
-    if (sync_points_size > 0) {
-        if (!validate_remaining(sync_points_size * sizeof(SyncPoint))) {
-            has_next = false;
-            return;
-        }
-        std::memcpy(current_sync_points.data(), current, sync_points_size * sizeof(SyncPoint));
-        current += sync_points_size * sizeof(SyncPoint);
-    }
-
-    if (!validate_remaining(postings_size * sizeof(Posting))) {
+    if (!read_varint(postings_size)) {
         has_next = false;
         return;
     }
 
+    // Decode the (doc ID delta, freq) pairs
     current_postings.resize(postings_size);
-    std::memcpy(current_postings.data(), current, postings_size * sizeof(Posting));
-    current += postings_size * sizeof(Posting);
-}
-
-Posting* BlockReader::find_posting(uint32_t target_doc_id) const {
-    if (current_postings.empty() || target_doc_id < current_postings.front().doc_id ||
-        target_doc_id > current_postings.back().doc_id) {
-        return nullptr;
-    }
-
-    // Use sync points to find starting position for search
-    size_t start_pos = 0;
-    if (!current_sync_points.empty()) {
-        int left = 0;
-        int right = current_sync_points.size() - 1;
-
-        while (left <= right) {
-            // binary search for sync point
-            int mid = left + (right - left) / 2;
-            if (current_sync_points[mid].doc_id <= target_doc_id &&
-                (mid == right || current_sync_points[mid + 1].doc_id > target_doc_id)) {
-                start_pos = current_sync_points[mid].plist_offset;
-                break;
-            } else if (current_sync_points[mid].doc_id > target_doc_id) {
-                right = mid - 1;
-            } else {
-                left = mid + 1;
-            }
-        }
-    }
-
-    // Linear search from selected sync point
-    for (size_t i = start_pos; i < current_postings.size(); i++) {
-        if (current_postings[i].doc_id == target_doc_id) {
-            return const_cast<Posting*>(&current_postings[i]);
-        } else if (current_postings[i].doc_id > target_doc_id) {
-            break;
+    uint32_t doc_id = 0;
+    for (uint32_t i = 0; i < postings_size; ++i) {
+        uint32_t delta;
+        uint32_t freq;
+        if (!read_varint(delta) || !read_varint(freq)) {
+            has_next = false;
+            return;
         }
+        doc_id += delta;
+        current_postings[i].doc_id = doc_id;
+        current_postings[i].freq = freq;
     }
 
-    return nullptr;
+    terms_remaining_--;
 }
 
 }  // namespace mithril
@@ -1,6 +1,8 @@
 #ifndef INDEX_POSTINGBLOCK_H
 #define INDEX_POSTINGBLOCK_H
 
+#include "data/Writer.h"
+
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -24,19 +26,56 @@ struct SyncPoint {
     uint32_t plist_offset;  // Offset from start of postings list
 };
 
+// BM25 parameters shared by the block impacts written at index time and BM25 scoring at query time
+inline constexpr double BM25_K1 = 1.2;
+inline constexpr double BM25_B = 0.75;
+
+// Sync point of a final index posting block (see PostingCodec.h)
+struct BlockSyncPoint {
+    uint32_t base_doc_id;  // Doc ID the block's deltas start from (last doc ID of the previous block)
+    uint32_t last_doc_id;  // Last doc ID in the block, lets seeks skip the block without decoding it
+    uint32_t byte_offset;  // Offset of the block from the start of the term's encoded postings
+    // Largest length normalized frequency freq / ((1 - b) + b * body_length / avg_body_length) in the block, rounded
+    // up. BM25 grows with it, so it bounds the score of every posting in the block (see BlockMaxWand.h).
+    float max_impact;
+};
+static_assert(sizeof(BlockSyncPoint) == 16, "block sync points are written as is");
+
+// Intermediate blocks (flushed worker blocks and non-final merge tiers) are written compactly:
+//   u32 term count
+//   per term: varint term length, term bytes, varint postings count,
+//             then one (doc ID delta, freq) varint pair per posting
+// Postings of a term must be sorted by doc ID.
+class BlockWriter {
+public:
+    explicit BlockWriter(const std::string& path);
+
+    void add_term(const std::string& term, const std::vector<Posting>& postings);
+    // Writes the term count header and closes the file
+    void finish();
+
+    uint32_t term_count() const { return term_count_; }
+
+    BlockWriter(const BlockWriter&) = delete;
+    BlockWriter& operator=(const BlockWriter&) = delete;
+
+private:
+    data::FileWriter out_;
+    std::vector<char> buffer_;
+    uint32_t term_count_{0};
+};
+
+// Streams an intermediate block term by term, decoding each term's postings as it is reached
 class BlockReader {
 public:
     std::string current_term;
     std::vector<Posting> current_postings;
-    std::vector<SyncPoint> current_sync_points;
     bool has_next{true};
 
     explicit BlockReader(const std::string& path);
     ~BlockReader();
     void read_next();
 
-    Posting* find_posting(uint32_t target_doc_id) const;
-
     // Move support for priority queue
     BlockReader(BlockReader&& other) noexcept;
     BlockReader& operator=(BlockReader&& other) noexcept;
@@ -51,10 +90,11 @@ private:
     size_t size{0};
     int fd{-1};
     const char* current{nullptr};
+    uint32_t terms_remaining_{0};
     std::string file_path_;
-    // std::vector<char> file_buffer_;
 
     bool validate_remaining(size_t needed) const { return (current + needed <= data + size); }
+    bool read_varint(uint32_t& value);
 };
 }  // namespace mithril
 
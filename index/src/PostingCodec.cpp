@@ -0,0 +1,335 @@
+#include "PostingCodec.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    include <immintrin.h>
+#    define MITHRIL_X86_KERNELS 1
+#endif
+
+namespace mithril {
+
+namespace {
+
+constexpr uint8_t EncodedLength(uint32_t value) {
+    if (value < (1U << 8)) {
+        return 1;
+    }
+    if (value < (1U << 16)) {
+        return 2;
+    }
+    if (value < (1U << 24)) {
+        return 3;
+    }
+    return 4;
+}
+
+// Total data bytes of a group of four values, indexed by control byte
+constexpr std::array<uint8_t, 256> MakeGroupLengths() {
+    std::array<uint8_t, 256> lengths{};
+    for (int c = 0; c < 256; ++c) {
+        lengths[c] = ((c & 3) + 1) + (((c >> 2) & 3) + 1) + (((c >> 4) & 3) + 1) + (((c >> 6) & 3) + 1);
+    }
+    return lengths;
+}
+
+// pshufb masks moving the data bytes of a group into four little-endian uint32 lanes, indexed by control byte.
+// 0xFF entries zero the unused high bytes of each lane.
+constexpr std::array<std::array<uint8_t, 16>, 256> MakeShuffleTable() {
+    std::array<std::array<uint8_t, 16>, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        uint8_t src = 0;
+        for (int lane = 0; lane < 4; ++lane) {
+            const int len = ((c >> (2 * lane)) & 3) + 1;
+            for (int b = 0; b < 4; ++b) {
+                table[c][lane * 4 + b] = b < len ? src++ : 0xFF;
+            }
+        }
+    }
+    return table;
+}
+
+constexpr auto GroupLengths = MakeGroupLengths();
+alignas(16) constexpr auto ShuffleTable = MakeShuffleTable();
+
+template<bool Delta>
+void EncodeImpl(const uint32_t* in, size_t count, uint32_t base, std::vector<char>& out) {
+    const size_t ctrl_start = out.size();
+    const size_t ctrl_len = StreamVByte::control_bytes(count);
+    out.resize(ctrl_start + ctrl_len + count * sizeof(uint32_t));
+
+    auto* ctrl = reinterpret_cast<uint8_t*>(out.data() + ctrl_start);
+    auto* data = ctrl + ctrl_len;
+    // ctrl is null when count is 0 and out was empty
+    if (ctrl_len > 0) {
+        std::memset(ctrl, 0, ctrl_len);
+    }
+
+    uint32_t prev = base;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value = in[i];
+        if constexpr (Delta) {
+            value -= prev;
+            prev = in[i];
+        }
+        const uint8_t len = EncodedLength(value);
+        ctrl[i / 4] |= (len - 1) << (2 * (i % 4));
+        for (uint8_t b = 0; b < len; ++b) {
+            *data++ = static_cast<uint8_t>(value >> (8 * b));
+        }
+    }
+
+    out.resize(reinterpret_cast<char*>(data) - out.data());
+}
+
+// Decodes values [first, count) one at a time
+template<bool Delta>
+const uint8_t*
+DecodeScalar(const uint8_t* ctrl, const uint8_t* data, size_t first, size_t count, uint32_t prev, uint32_t* out) {
+    for (size_t i = first; i < count; ++i) {
+        const int len = ((ctrl[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        for (int b = 0; b < len; ++b) {
+            value |= static_cast<uint32_t>(data[b]) << (8 * b);
+        }
+        data += len;
+        if constexpr (Delta) {
+            prev += value;
+            value = prev;
+        }
+        out[i] = value;
+    }
+    return data;
+}
+
+#ifdef MITHRIL_X86_KERNELS
+
+// Decodes whole groups while a 16 byte load stays inside [data, end), returns the number of values decoded
+template<bool Delta>
+__attribute__((target("sse4.1"))) size_t
+DecodeSSE4(const uint8_t* ctrl, const uint8_t*& data, const uint8_t* end, size_t count, uint32_t base, uint32_t* out) {
+    const size_t groups = count / 4;
+    __m128i prev = _mm_set1_epi32(static_cast<int>(base));
+
+    size_t g = 0;
+    for (; g < groups && data + 16 <= end; ++g) {
+        const uint8_t c = ctrl[g];
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        v = _mm_shuffle_epi8(v, _mm_load_si128(reinterpret_cast<const __m128i*>(ShuffleTable[c].data())));
+        data += GroupLengths[c];
+
+        if constexpr (Delta) {
+            // Inclusive prefix sum of the four deltas, then add the previous group's last value
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi32(v, prev);
+            prev = _mm_shuffle_epi32(v, 0xFF);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * g), v);
+    }
+    return 4 * g;
+}
+
+// Same as DecodeSSE4 but decodes two groups per 256 bit shuffle
+template<bool Delta>
+__attribute__((target("avx2"))) size_t
+DecodeAVX2(const uint8_t* ctrl, const uint8_t*& data, const uint8_t* end, size_t count, uint32_t base, uint32_t* out) {
+    const size_t groups = count / 4;
+    __m256i prev = _mm256_set1_epi32(static_cast<int>(base));
+
+    size_t g = 0;
+    while (g + 2 <= groups) {
+        const uint8_t c0 = ctrl[g];
+        const uint8_t c1 = ctrl[g + 1];
+        const uint8_t len0 = GroupLengths[c0];
+        if (data + len0 + 16 > end) {
+            break;
+        }
+
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + len0));
+        const __m128i shuf_lo = _mm_load_si128(reinterpret_cast<const __m128i*>(ShuffleTable[c0].data()));
+        const __m128i shuf_hi = _mm_load_si128(reinterpret_cast<const __m128i*>(ShuffleTable[c1].data()));
+        __m256i v = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1),
+                                        _mm256_inserti128_si256(_mm256_castsi128_si256(shuf_lo), shuf_hi, 1));
+        data += len0 + GroupLengths[c1];
+
+        if constexpr (Delta) {
+            // Prefix sum inside each 128 bit lane, carry the low lane's total into the high lane
+            v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+            v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+            const __m256i carry = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3));
+            v = _mm256_add_epi32(v, _mm256_blend_epi32(_mm256_setzero_si256(), carry, 0xF0));
+            v = _mm256_add_epi32(v, prev);
+            prev = _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(7));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * g), v);
+        g += 2;
+    }
+    return 4 * g;
+}
+
+#endif  // MITHRIL_X86_KERNELS
+
+template<bool Delta>
+const char*
+DecodeImpl(const char* in, const char* end, size_t count, uint32_t base, uint32_t* out, DecodeKernel kernel) {
+    const auto* ctrl = reinterpret_cast<const uint8_t*>(in);
+    const auto* data = ctrl + StreamVByte::control_bytes(count);
+    const auto* data_end = reinterpret_cast<const uint8_t*>(end);
+
+    size_t decoded = 0;
+#ifdef MITHRIL_X86_KERNELS
+    if (kernel == DecodeKernel::AVX2) {
+        decoded = DecodeAVX2<Delta>(ctrl, data, data_end, count, base, out);
+    } else if (kernel == DecodeKernel::SSE4) {
+        decoded = DecodeSSE4<Delta>(ctrl, data, data_end, count, base, out);
+    }
+#else
+    (void)kernel;
+    (void)data_end;
+#endif
+
+    const uint32_t prev = decoded > 0 ? out[decoded - 1] : base;
+    return reinterpret_cast<const char*>(DecodeScalar<Delta>(ctrl, data, decoded, count, prev, out));
+}
+
+}  // namespace
+
+const char* DecodeKernelName(DecodeKernel kernel) {
+    switch (kernel) {
+    case DecodeKernel::Scalar:
+        return "scalar";
+    case DecodeKernel::SSE4:
+        return "sse4";
+    case DecodeKernel::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+void StreamVByte::encode(const uint32_t* in, size_t count, std::vector<char>& out) {
+    EncodeImpl<false>(in, count, 0, out);
+}
+
+void StreamVByte::encode_deltas(const uint32_t* in, size_t count, uint32_t base, std::vector<char>& out) {
+    EncodeImpl<true>(in, count, base, out);
+}
+
+const char*
+StreamVByte::decode(const char* in, const char* end, size_t count, uint32_t* out, DecodeKernel kernel) {
+    return DecodeImpl<false>(in, end, count, 0, out, kernel);
+}
+
+const char* StreamVByte::decode_deltas(
+    const char* in, const char* end, size_t count, uint32_t base, uint32_t* out, DecodeKernel kernel) {
+    return DecodeImpl<true>(in, end, count, base, out, kernel);
+}
+
+bool StreamVByte::kernel_supported(DecodeKernel kernel) {
+    switch (kernel) {
+    case DecodeKernel::Scalar:
+        return true;
+#ifdef MITHRIL_X86_KERNELS
+    case DecodeKernel::SSE4:
+        return __builtin_cpu_supports("sse4.1");
+    case DecodeKernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+DecodeKernel StreamVByte::best_kernel() {
+    static const DecodeKernel best = [] {
+        if (kernel_supported(DecodeKernel::AVX2)) {
+            return DecodeKernel::AVX2;
+        }
+        if (kernel_supported(DecodeKernel::SSE4)) {
+            return DecodeKernel::SSE4;
+        }
+        return DecodeKernel::Scalar;
+    }();
+    return best;
+}
+
+void PostingBlockCodec::encode_postings(PostingCodec codec,
+                                        const std::vector<Posting>& postings,
+                                        std::vector<BlockSyncPoint>& sync_points,
+                                        std::vector<char>& out) {
+    sync_points.clear();
+    sync_points.reserve(num_blocks(postings.size()));
+
+    std::array<uint32_t, BLOCK_SIZE> doc_ids;
+    std::array<uint32_t, BLOCK_SIZE> freqs;
+
+    const size_t out_start = out.size();
+    uint32_t base_doc_id = 0;
+    for (size_t start = 0; start < postings.size(); start += BLOCK_SIZE) {
+        const size_t count = std::min(BLOCK_SIZE, postings.size() - start);
+
+        BlockSyncPoint sp{};
+        sp.base_doc_id = base_doc_id;
+        sp.last_doc_id = postings[start + count - 1].doc_id;
+        sp.byte_offset = static_cast<uint32_t>(out.size() - out_start);
+        sync_points.push_back(sp);
+
+        for (size_t i = 0; i < count; ++i) {
+            doc_ids[i] = postings[start + i].doc_id;
+            freqs[i] = postings[start + i].freq;
+        }
+        encode_block(codec, doc_ids.data(), freqs.data(), count, base_doc_id, out);
+
+        base_doc_id = sp.last_doc_id;
+    }
+}
+
+void PostingBlockCodec::encode_block(PostingCodec codec,
+                                     const uint32_t* doc_ids,
+                                     const uint32_t* freqs,
+                                     size_t count,
+                                     uint32_t base_doc_id,
+                                     std::vector<char>& out) {
+    if (codec == PostingCodec::StreamVByte) {
+        StreamVByte::encode_deltas(doc_ids, count, base_doc_id, out);
+        StreamVByte::encode(freqs, count, out);
+        return;
+    }
+
+    uint32_t last_doc_id = base_doc_id;
+    for (size_t i = 0; i < count; ++i) {
+        VByteCodec::encode_to_vector(doc_ids[i] - last_doc_id, out);
+        last_doc_id = doc_ids[i];
+    }
+    for (size_t i = 0; i < count; ++i) {
+        VByteCodec::encode_to_vector(freqs[i], out);
+    }
+}
+
+const char* PostingBlockCodec::decode_block(PostingCodec codec,
+                                            const char* in,
+                                            const char* end,
+                                            size_t count,
+                                            uint32_t base_doc_id,
+                                            uint32_t* doc_ids,
+                                            uint32_t* freqs,
+                                            DecodeKernel kernel) {
+    if (codec == PostingCodec::StreamVByte) {
+        in = StreamVByte::decode_deltas(in, end, count, base_doc_id, doc_ids, kernel);
+        return StreamVByte::decode(in, end, count, freqs, kernel);
+    }
+
+    uint32_t doc_id = base_doc_id;
+    for (size_t i = 0; i < count; ++i) {
+        doc_id += VByteCodec::decode_from_memory(in);
+        doc_ids[i] = doc_id;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        freqs[i] = VByteCodec::decode_from_memory(in);
+    }
+    return in;
+}
+
+}  // namespace mithril
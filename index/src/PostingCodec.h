@@ -0,0 +1,88 @@
+#ifndef INDEX_POSTINGCODEC_H
+#define INDEX_POSTINGCODEC_H
+
+#include "PostingBlock.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mithril {
+
+// Encoding of the blocks inside final index posting lists, recorded through the term dictionary version
+enum class PostingCodec : uint32_t {
+    VByte,        // Scalar VByte doc ID deltas followed by VByte freqs (dictionary version 2)
+    StreamVByte,  // StreamVByte doc ID deltas followed by StreamVByte freqs (dictionary version 3)
+};
+
+// Decoder implementation used for StreamVByte data
+enum class DecodeKernel {
+    Scalar,
+    SSE4,
+    AVX2,
+};
+
+const char* DecodeKernelName(DecodeKernel kernel);
+
+// StreamVByte (Lemire et al.): values are grouped by four, one control byte holds the byte length (1-4) of each
+// value in the group and all control bytes precede the data bytes. Separating lengths from data lets a group be
+// decoded with a single byte shuffle.
+class StreamVByte {
+public:
+    static size_t control_bytes(size_t count) { return (count + 3) / 4; }
+    static size_t max_encoded_bytes(size_t count) { return control_bytes(count) + count * sizeof(uint32_t); }
+
+    static void encode(const uint32_t* in, size_t count, std::vector<char>& out);
+    // Encodes the differences between consecutive values, starting from base
+    static void encode_deltas(const uint32_t* in, size_t count, uint32_t base, std::vector<char>& out);
+
+    // Decoders return a pointer past the last byte they consumed. Vector kernels only load 16 bytes at a time
+    // while those bytes lie before end, the remaining groups are decoded by the scalar loop.
+    static const char* decode(const char* in, const char* end, size_t count, uint32_t* out, DecodeKernel kernel);
+    static const char*
+    decode_deltas(const char* in, const char* end, size_t count, uint32_t base, uint32_t* out, DecodeKernel kernel);
+
+    // Fastest kernel supported by the running CPU
+    static DecodeKernel best_kernel();
+    static bool kernel_supported(DecodeKernel kernel);
+};
+
+// Final index posting lists are split into blocks of BLOCK_SIZE postings. Each block stores its doc ID
+// deltas followed by its frequencies, and is described by a BlockSyncPoint so a reader can locate and decode
+// any block on its own.
+class PostingBlockCodec {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    static size_t num_blocks(size_t postings_count) { return (postings_count + BLOCK_SIZE - 1) / BLOCK_SIZE; }
+
+    // Encodes sorted postings into blocks, filling sync_points and appending the encoded bytes to out
+    static void encode_postings(PostingCodec codec,
+                                const std::vector<Posting>& postings,
+                                std::vector<BlockSyncPoint>& sync_points,
+                                std::vector<char>& out);
+
+    // Encodes one block of count postings whose doc ID deltas start from base_doc_id, appending it to out
+    static void encode_block(PostingCodec codec,
+                             const uint32_t* doc_ids,
+                             const uint32_t* freqs,
+                             size_t count,
+                             uint32_t base_doc_id,
+                             std::vector<char>& out);
+
+    // Decodes count postings of the block stored in [in, end), returns a pointer past the block's last byte
+    static const char* decode_block(PostingCodec codec,
+                                    const char* in,
+                                    const char* end,
+                                    size_t count,
+                                    uint32_t base_doc_id,
+                                    uint32_t* doc_ids,
+                                    uint32_t* freqs,
+                                    DecodeKernel kernel = StreamVByte::best_kernel());
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_POSTINGCODEC_H
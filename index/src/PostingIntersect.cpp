@@ -0,0 +1,123 @@
+#include "PostingIntersect.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    include <immintrin.h>
+#    define MITHRIL_X86_KERNELS 1
+#endif
+
+namespace mithril {
+
+namespace {
+
+size_t IntersectScalar(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+    while (i < a_size && j < b_size) {
+        if (a[i] == b[j]) {
+            out[count++] = a[i];
+            ++i;
+            ++j;
+        } else if (a[i] < b[j]) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return count;
+}
+
+#ifdef MITHRIL_X86_KERNELS
+
+// Compares four doc IDs of a against four of b at once: a against b and its three rotations, so every pair meets
+// once. The group whose last doc ID is smaller can't match anything further and is replaced. Stops when either
+// array has fewer than four doc IDs left, i and j tell the caller where.
+__attribute__((target("sse4.1"))) size_t
+IntersectSSE4(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, size_t& i, size_t& j, uint32_t* out) {
+    size_t count = 0;
+    while (i + 4 <= a_size && j + 4 <= b_size) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        __m128i eq = _mm_cmpeq_epi32(va, vb);
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39)));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4E)));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93)));
+
+        for (int mask = _mm_movemask_ps(_mm_castsi128_ps(eq)); mask != 0; mask &= mask - 1) {
+            out[count++] = a[i + __builtin_ctz(mask)];
+        }
+
+        const uint32_t a_last = a[i + 3];
+        const uint32_t b_last = b[j + 3];
+        i += a_last <= b_last ? 4 : 0;
+        j += b_last <= a_last ? 4 : 0;
+    }
+    return count;
+}
+
+// Same as IntersectSSE4 with groups of eight, b is rotated by a lane permute
+__attribute__((target("avx2"))) size_t
+IntersectAVX2(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, size_t& i, size_t& j, uint32_t* out) {
+    size_t count = 0;
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while (i + 8 <= a_size && j + 8 <= b_size) {
+        const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i eq = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; ++r) {
+            vb = _mm256_permutevar8x32_epi32(vb, rotate);
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(va, vb));
+        }
+
+        for (int mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq)); mask != 0; mask &= mask - 1) {
+            out[count++] = a[i + __builtin_ctz(mask)];
+        }
+
+        const uint32_t a_last = a[i + 7];
+        const uint32_t b_last = b[j + 7];
+        i += a_last <= b_last ? 8 : 0;
+        j += b_last <= a_last ? 8 : 0;
+    }
+    return count;
+}
+
+#endif  // MITHRIL_X86_KERNELS
+
+}  // namespace
+
+size_t PostingIntersect::intersect(
+    const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out, DecodeKernel kernel) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+#ifdef MITHRIL_X86_KERNELS
+    if (kernel == DecodeKernel::AVX2) {
+        count = IntersectAVX2(a, a_size, b, b_size, i, j, out);
+    }
+    if (kernel == DecodeKernel::AVX2 || kernel == DecodeKernel::SSE4) {
+        count += IntersectSSE4(a, a_size, b, b_size, i, j, out + count);
+    }
+#else
+    (void)kernel;
+#endif
+    return count + IntersectScalar(a + i, a_size - i, b + j, b_size - j, out + count);
+}
+
+size_t
+PostingIntersect::intersect_gallop(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out) {
+    if (a_size > b_size) {
+        return intersect_gallop(b, b_size, a, a_size, out);
+    }
+    const uint32_t* b_end = b + b_size;
+    size_t count = 0;
+    for (size_t i = 0; i < a_size && b != b_end; ++i) {
+        b = gallop(b, b_end, a[i]);
+        if (b != b_end && *b == a[i]) {
+            out[count++] = a[i];
+            ++b;
+        }
+    }
+    return count;
+}
+
+}  // namespace mithril
@@ -0,0 +1,46 @@
+#ifndef INDEX_POSTINGINTERSECT_H
+#define INDEX_POSTINGINTERSECT_H
+
+#include "PostingCodec.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace mithril {
+
+// Intersection of sorted doc ID arrays without duplicates, such as the decoded blocks of two posting lists. The
+// vector kernels need the same CPU features as the StreamVByte decoders, so they are picked with DecodeKernel too.
+class PostingIntersect {
+public:
+    // First element of [begin, end) not less than target. Probes 1, 2, 4... elements ahead before binary searching
+    // the last step, so a target close to begin costs a few comparisons however long the range is.
+    static const uint32_t* gallop(const uint32_t* begin, const uint32_t* end, uint32_t target) {
+        if (begin == end || *begin >= target) {
+            return begin;
+        }
+        size_t step = 1;
+        const size_t size = static_cast<size_t>(end - begin);
+        while (step < size && begin[step] < target) {
+            step *= 2;
+        }
+        return std::lower_bound(begin + step / 2 + 1, begin + std::min(step + 1, size), target);
+    }
+
+    // Writes the doc IDs in both arrays to out, which must hold min(a_size, b_size) of them, returns how many
+    static size_t intersect(const uint32_t* a,
+                            size_t a_size,
+                            const uint32_t* b,
+                            size_t b_size,
+                            uint32_t* out,
+                            DecodeKernel kernel = StreamVByte::best_kernel());
+
+    // Same result as intersect(), galloping through the longer array for every element of the shorter one, which
+    // wins when their lengths are far apart
+    static size_t
+    intersect_gallop(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out);
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_POSTINGINTERSECT_H
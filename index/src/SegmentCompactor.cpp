@@ -0,0 +1,198 @@
+#include "SegmentCompactor.h"
+
+#include "DeletionBitmap.h"
+#include "DocumentMapReader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <spdlog/spdlog.h>
+#include <sys/file.h>
+
+namespace mithril {
+
+SegmentCompactor::SegmentCompactor(std::string index_dir, size_t merge_factor, size_t memory_budget)
+    : index_dir_(std::move(index_dir)),
+      merge_factor_(std::max<size_t>(merge_factor, 2)),
+      memory_budget_(memory_budget) {}
+
+SegmentCompactor::~SegmentCompactor() {
+    if (lock_fd_ != -1) {
+        flock(lock_fd_, LOCK_UN);
+        close(lock_fd_);
+    }
+}
+
+bool SegmentCompactor::tryLock() {
+    if (lock_fd_ != -1) {
+        return true;
+    }
+
+    const std::string path = index_dir_ + "/compact.lock";
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        throw std::runtime_error("Failed to open compaction lock " + path + ": " + std::strerror(errno));
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        close(fd);
+        return false;
+    }
+    lock_fd_ = fd;
+    return true;
+}
+
+std::optional<std::vector<SegmentInfo>> SegmentCompactor::pickSegments(const SegmentManifest& manifest) const {
+    // Manifest order is publish order, so each level lists its oldest segments first
+    std::map<uint32_t, std::vector<SegmentInfo>> levels;
+    for (const auto& segment : manifest.segments) {
+        if (segment.level != SegmentManifest::BASE_LEVEL) {
+            levels[segment.level].push_back(segment);
+        }
+    }
+
+    for (auto& [level, segments] : levels) {
+        if (segments.size() >= merge_factor_) {
+            segments.resize(merge_factor_);
+            return std::move(segments);
+        }
+    }
+    return std::nullopt;
+}
+
+bool SegmentCompactor::compactOnce() {
+    if (!tryLock()) {
+        throw std::runtime_error("Another compactor is running in " + index_dir_);
+    }
+
+    std::vector<SegmentInfo> inputs;
+    SegmentInfo output;
+    {
+        SegmentManifest::Lock lock(index_dir_);
+        auto manifest = SegmentManifest::load(index_dir_);
+        if (!manifest) {
+            return false;
+        }
+        auto picked = pickSegments(*manifest);
+        if (!picked) {
+            return false;
+        }
+        inputs = std::move(*picked);
+        output.name = manifest->allocateSegmentName();
+        output.level = inputs.front().level + 1;
+        manifest->save(index_dir_);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::string output_dir = index_dir_ + "/" + output.name;
+    spdlog::info("Compacting {} level {} segments into {}", inputs.size(), inputs.front().level, output_dir);
+
+    try {
+        IndexBuilder builder(
+            output_dir, std::thread::hardware_concurrency(), DEFAULT_MAX_TERMS_PER_BLOCK, memory_budget_);
+        for (const auto& input : inputs) {
+            builder.import_segment(index_dir_ + "/" + input.name);
+        }
+        builder.finalize();
+        // Deleted documents of the inputs are dropped, so count what was written
+        output.doc_count = DocumentMapReader(output_dir).documentCount();
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to compact into {}: {}", output_dir, e.what());
+        std::error_code ec;
+        std::filesystem::remove_all(output_dir, ec);
+        throw;
+    }
+
+    if (!publish(inputs, output)) {
+        std::error_code ec;
+        std::filesystem::remove_all(output_dir, ec);
+        return false;
+    }
+
+    // Queries that still have the inputs open keep their mappings, unlinking only drops the names
+    for (const auto& input : inputs) {
+        std::error_code ec;
+        std::filesystem::remove_all(index_dir_ + "/" + input.name, ec);
+        if (ec) {
+            spdlog::warn("Failed to remove compacted segment {}: {}", input.name, ec.message());
+        }
+    }
+
+    spdlog::info("Compacted {} documents into {} in {} ms",
+                 output.doc_count,
+                 output.name,
+                 std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+                     .count());
+    return true;
+}
+
+bool SegmentCompactor::publish(const std::vector<SegmentInfo>& inputs, const SegmentInfo& output) {
+    SegmentManifest::Lock lock(index_dir_);
+    auto manifest = SegmentManifest::load(index_dir_);
+    if (!manifest) {
+        spdlog::error("Segment manifest of {} disappeared during compaction", index_dir_);
+        return false;
+    }
+
+    // The merged segment takes the place of its first input, which keeps the manifest in publish order
+    auto& segments = manifest->segments;
+    auto first = segments.end();
+    for (const auto& input : inputs) {
+        auto it = std::find_if(
+            segments.begin(), segments.end(), [&](const SegmentInfo& segment) { return segment.name == input.name; });
+        if (it == segments.end()) {
+            spdlog::error("Segment {} disappeared during compaction", input.name);
+            return false;
+        }
+        first = std::min(first, it);
+    }
+    // Documents deleted after their segment was imported are still in the output, the manifest lock keeps
+    // mithril_delete from marking more until the inputs are gone. Segments may number documents differently, the
+    // crawl ID is what they share.
+    const DocumentMapReader documents(index_dir_ + "/" + output.name);
+    std::vector<data::docid_t> late_deletions;
+    for (const auto& input : inputs) {
+        const DocumentMapReader input_documents(index_dir_ + "/" + input.name);
+        for (const data::docid_t id : DeletionBitmap(index_dir_ + "/" + input.name).deletedIds()) {
+            if (!input_documents.findDocInfo(id)) {
+                continue;
+            }
+            if (const auto output_id = documents.lookupCrawlDocID(input_documents.crawlDocID(id))) {
+                late_deletions.push_back(*output_id);
+            }
+        }
+    }
+    if (!late_deletions.empty()) {
+        DeletionBitmap::markDeleted(index_dir_ + "/" + output.name, late_deletions);
+    }
+
+    *first = output;
+    std::erase_if(segments, [&](const SegmentInfo& segment) {
+        return std::any_of(
+            inputs.begin(), inputs.end(), [&](const SegmentInfo& input) { return input.name == segment.name; });
+    });
+
+    if (!manifest->save(index_dir_)) {
+        return false;
+    }
+    spdlog::info("Published {} ({} segments, generation {})", output.name, segments.size(), manifest->generation);
+    return true;
+}
+
+size_t SegmentCompactor::compactAll() {
+    size_t merges = 0;
+    while (compactOnce()) {
+        ++merges;
+    }
+    return merges;
+}
+
+}  // namespace mithril
@@ -0,0 +1,53 @@
+#ifndef INDEX_SEGMENTCOMPACTOR_H
+#define INDEX_SEGMENTCOMPACTOR_H
+
+#include "InvertedIndex.h"
+#include "SegmentManifest.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mithril {
+
+constexpr size_t DEFAULT_SEGMENT_MERGE_FACTOR = 4;
+
+// Merges the segments of a segmented index directory into larger ones. Segments are tiered by level like the
+// blocks of an index build: once a level holds merge_factor segments they are imported into an IndexBuilder,
+// whose tiered block merge writes a single segment one level up. Appends and queries continue meanwhile, the
+// merged segment replaces its inputs in the manifest only once it is complete.
+//
+// Only one compactor runs per directory at a time, enforced by an flock on compact.lock.
+class SegmentCompactor {
+public:
+    explicit SegmentCompactor(std::string index_dir,
+                              size_t merge_factor = DEFAULT_SEGMENT_MERGE_FACTOR,
+                              size_t memory_budget = DEFAULT_MEMORY_BUDGET);
+    ~SegmentCompactor();
+
+    // Returns false if another compactor holds the directory
+    bool tryLock();
+
+    // Merges one group of segments, returns false if no level had enough of them
+    bool compactOnce();
+    // Merges until no level has enough segments left, returns the number of merges
+    size_t compactAll();
+
+    SegmentCompactor(const SegmentCompactor&) = delete;
+    SegmentCompactor& operator=(const SegmentCompactor&) = delete;
+
+private:
+    const std::string index_dir_;
+    const size_t merge_factor_;
+    const size_t memory_budget_;
+    int lock_fd_{-1};
+
+    // The oldest merge_factor segments of the lowest level that has that many
+    std::optional<std::vector<SegmentInfo>> pickSegments(const SegmentManifest& manifest) const;
+    bool publish(const std::vector<SegmentInfo>& inputs, const SegmentInfo& output);
+};
+
+}  // namespace mithril
+
+#endif  // INDEX_SEGMENTCOMPACTOR_H
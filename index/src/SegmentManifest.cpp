@@ -0,0 +1,123 @@
+#include "SegmentManifest.h"
+
+#include "DocumentMapReader.h"
+#include "data/Reader.h"
+#include "data/Writer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include <sys/file.h>
+
+namespace mithril {
+
+namespace {
+std::string ManifestPath(const std::string& index_dir) {
+    return index_dir + "/" + SegmentManifest::FILE_NAME;
+}
+}  // namespace
+
+std::optional<SegmentManifest> SegmentManifest::load(const std::string& index_dir) {
+    const std::string path = ManifestPath(index_dir);
+    if (!std::filesystem::exists(path)) {
+        return std::nullopt;
+    }
+
+    data::FileReader in(path.c_str());
+    SegmentManifest manifest;
+    uint32_t version = 0;
+    // clang-format off
+    const bool ok = data::DeserializeValue(version, in)
+        && version == VERSION
+        && data::DeserializeValue(manifest.generation, in)
+        && data::DeserializeValue(manifest.next_segment, in)
+        && data::DeserializeValue(manifest.segments, in);
+    // clang-format on
+    if (!ok) {
+        throw std::runtime_error("Unreadable segment manifest: " + path);
+    }
+    return manifest;
+}
+
+SegmentManifest SegmentManifest::loadOrCreate(const std::string& index_dir) {
+    if (auto manifest = load(index_dir)) {
+        return std::move(*manifest);
+    }
+
+    SegmentManifest manifest;
+    if (std::filesystem::exists(index_dir + "/final_index.data")) {
+        DocumentMapReader documents(index_dir);
+        manifest.segments.push_back(SegmentInfo{".", BASE_LEVEL, documents.documentCount()});
+    }
+    return manifest;
+}
+
+bool SegmentManifest::save(const std::string& index_dir) {
+    generation++;
+
+    const std::string path = ManifestPath(index_dir);
+    const std::string temp_path = path + ".tmp";
+    {
+        data::FileWriter out(temp_path.c_str());
+        data::SerializeValue(VERSION, out);
+        data::SerializeValue(generation, out);
+        data::SerializeValue(next_segment, out);
+        data::SerializeValue(segments, out);
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        spdlog::error("Failed to publish segment manifest {}: {}", path, ec.message());
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> SegmentManifest::segmentDirs(const std::string& index_dir) {
+    auto manifest = load(index_dir);
+    if (!manifest) {
+        return {index_dir};
+    }
+
+    std::vector<std::string> dirs;
+    dirs.reserve(manifest->segments.size());
+    for (const auto& segment : manifest->segments) {
+        dirs.push_back(segment.name == "." ? index_dir : index_dir + "/" + segment.name);
+    }
+    return dirs;
+}
+
+uint64_t SegmentManifest::currentGeneration(const std::string& index_dir) {
+    try {
+        auto manifest = load(index_dir);
+        return manifest ? manifest->generation : 0;
+    } catch (const std::exception& e) {
+        spdlog::warn("Failed to read segment manifest of {}: {}", index_dir, e.what());
+        return 0;
+    }
+}
+
+SegmentManifest::Lock::Lock(const std::string& index_dir) {
+    const std::string path = index_dir + "/segments.lock";
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ == -1) {
+        throw std::runtime_error("Failed to open segment lock " + path + ": " + std::strerror(errno));
+    }
+    if (flock(fd_, LOCK_EX) == -1) {
+        close(fd_);
+        throw std::runtime_error("Failed to lock " + path + ": " + std::strerror(errno));
+    }
+}
+
+SegmentManifest::Lock::~Lock() {
+    flock(fd_, LOCK_UN);
+    close(fd_);
+}
+
+}  // namespace mithril
@@ -0,0 +1,94 @@
+#ifndef INDEX_SEGMENTMANIFEST_H
+#define INDEX_SEGMENTMANIFEST_H
+
+#include "data/Deserialize.h"
+#include "data/Serialize.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mithril {
+
+struct SegmentInfo {
+    std::string name;  // Directory relative to the index directory, "." for the index directory itself
+    uint32_t level{0};  // 0 for appended segments, compaction merges a level into the next one
+    uint64_t doc_count{0};
+};
+
+// A segmented index directory holds complete indexes (segments) in subdirectories and lists the live ones in
+// segments.manifest. Appends build a new segment and compaction merges segments, both publish their result by
+// atomically replacing the manifest, so readers see the old or the new set of segments. A directory without a
+// manifest is a single segment.
+//
+// Manifest changes are serialized by lock(), which holds an flock on segments.lock. It is only held to read,
+// modify and save the manifest, never while building a segment.
+class SegmentManifest {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr const char* FILE_NAME = "segments.manifest";
+    // The index a directory held before it had a manifest, compaction leaves it alone
+    static constexpr uint32_t BASE_LEVEL = UINT32_MAX;
+
+    uint64_t generation{0};  // Bumped by every save
+    uint32_t next_segment{0};
+    std::vector<SegmentInfo> segments;
+
+    // nullopt if the directory has no manifest
+    static std::optional<SegmentManifest> load(const std::string& index_dir);
+    // Loads the manifest, or describes a plain index directory as a single base segment
+    static SegmentManifest loadOrCreate(const std::string& index_dir);
+    // Writes to a temporary file and renames it over the manifest, bumping the generation
+    bool save(const std::string& index_dir);
+
+    // Directories of the live segments, just index_dir for a directory without a manifest
+    static std::vector<std::string> segmentDirs(const std::string& index_dir);
+    // Generation of the manifest on disk, 0 if there is none
+    static uint64_t currentGeneration(const std::string& index_dir);
+
+    // Reserves a directory name for a new segment
+    std::string allocateSegmentName() { return "seg_" + std::to_string(next_segment++); }
+
+    // RAII exclusive lock on the manifest of index_dir
+    class Lock {
+    public:
+        explicit Lock(const std::string& index_dir);
+        ~Lock();
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+
+    private:
+        int fd_{-1};
+    };
+};
+
+namespace data {
+
+template<>
+struct Serialize<SegmentInfo> {
+    template<Writer W>
+    static void Write(const SegmentInfo& segment, W& w) {
+        SerializeValue(segment.name, w);
+        SerializeValue(segment.level, w);
+        SerializeValue(segment.doc_count, w);
+    }
+};
+
+template<>
+struct Deserialize<SegmentInfo> {
+    template<Reader R>
+    static bool Read(SegmentInfo& segment, R& r) {
+        // clang-format off
+        return DeserializeValue(segment.name, r)
+            && DeserializeValue(segment.level, r)
+            && DeserializeValue(segment.doc_count, r);
+        // clang-format on
+    }
+};
+
+}  // namespace data
+
+}  // namespace mithril
+
+#endif  // INDEX_SEGMENTMANIFEST_H
@@ -1,7 +1,8 @@
 #include "TermAND.h"
 
-#include "TermReader.h"
+#include "PostingIntersect.h"
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 
@@ -45,7 +46,8 @@ data::docid_t TermAND::currentDocID() const {
 }
 
 void TermAND::seekToDocID(data::docid_t target_doc_id) {
-    if (at_end_) {
+    // findNextMatch() has already moved past the current match, seeking again from it would skip it
+    if (at_end_ || target_doc_id <= current_doc_id_) {
         return;
     }
 
@@ -64,7 +66,91 @@ bool TermAND::findNextMatch() {
             return false;
         }
     }
+    if (readers_.size() < 2) {
+        current_doc_id_ = readers_[0]->currentDocID();
+        return true;
+    }
+
+    while (true) {
+        // Candidates the first reader has moved past were passed over by moveNext() or seekToDocID()
+        while (candidate_pos_ < candidates_.size()) {
+            const data::docid_t candidate = candidates_[candidate_pos_++];
+            if (candidate < readers_[0]->currentDocID()) {
+                continue;
+            }
+            switch (checkCandidate(candidate)) {
+            case Candidate::Match:
+                current_doc_id_ = candidate;
+                return true;
+            case Candidate::Exhausted:
+                return false;
+            case Candidate::Miss:
+                break;
+            }
+        }
+
+        // Every match up to the bound was a candidate, continue after it
+        if (have_candidates_) {
+            have_candidates_ = false;
+            if (candidates_bound_ == std::numeric_limits<data::docid_t>::max()) {
+                return false;
+            }
+            for (size_t i = 0; i < 2; ++i) {
+                readers_[i]->seekToDocID(candidates_bound_ + 1);
+                if (!readers_[i]->hasNext()) {
+                    return false;
+                }
+            }
+        }
+
+        if (!fillCandidates()) {
+            return findNextMatchBySeeking();
+        }
+    }
+}
 
+bool TermAND::fillCandidates() {
+    const data::docid_t* a = nullptr;
+    const data::docid_t* b = nullptr;
+    const size_t a_size = readers_[0]->bufferedDocIDs(a);
+    const size_t b_size = readers_[1]->bufferedDocIDs(b);
+    if (a_size == 0 || b_size == 0) {
+        return false;
+    }
+
+    // Compare the densities a_size / a_span and b_size / b_span without dividing
+    const uint64_t a_span = static_cast<uint64_t>(a[a_size - 1] - a[0]) + 1;
+    const uint64_t b_span = static_cast<uint64_t>(b[b_size - 1] - b[0]) + 1;
+    if (a_size * b_span > MAX_BLOCK_DENSITY_RATIO * b_size * a_span ||
+        b_size * a_span > MAX_BLOCK_DENSITY_RATIO * a_size * b_span) {
+        return false;
+    }
+
+    candidates_.resize(std::min(a_size, b_size));
+    candidates_.resize(PostingIntersect::intersect(a, a_size, b, b_size, candidates_.data()));
+    candidate_pos_ = 0;
+    candidates_bound_ = std::min(a[a_size - 1], b[b_size - 1]);
+    have_candidates_ = true;
+    return true;
+}
+
+TermAND::Candidate TermAND::checkCandidate(data::docid_t candidate) {
+    for (const auto& reader : readers_) {
+        reader->seekToDocID(candidate);
+        if (!reader->hasNext()) {
+            return Candidate::Exhausted;
+        }
+        // Past the candidate when it is deleted or missing from a later reader, candidates the first reader is
+        // brought past are skipped
+        if (reader->currentDocID() > candidate) {
+            readers_[0]->seekToDocID(reader->currentDocID());
+            return readers_[0]->hasNext() ? Candidate::Miss : Candidate::Exhausted;
+        }
+    }
+    return Candidate::Match;
+}
+
+bool TermAND::findNextMatchBySeeking() {
     // impl of the efficient AND algorithm from sldies
     // Skip as much as possible by always advancing to the highest docID
     while (true) {
@@ -113,37 +199,22 @@ bool TermAND::findNextMatch() {
 }
 
 void TermAND::sortReadersByFrequency() {
+    // Rarest first, equal estimates keep their query order
     std::stable_sort(readers_.begin(),
                      readers_.end(),
                      [](const std::unique_ptr<IndexStreamReader>& a, const std::unique_ptr<IndexStreamReader>& b) {
-                         const TermReader* term_reader_a = dynamic_cast<const TermReader*>(a.get());
-                         const TermReader* term_reader_b = dynamic_cast<const TermReader*>(b.get());
-
-                         // If both are TermReaders, use document count and frequency
-                         if (term_reader_a && term_reader_b) {
-                             // Sort by document count primarily
-                             uint32_t count_a = term_reader_a->getDocumentCount();
-                             uint32_t count_b = term_reader_b->getDocumentCount();
-
-                             if (count_a != count_b) {
-                                 return count_a < count_b;  // Smaller first
-                             }
-
-                             // Secondary sort by average frequency for better cache locality
-                             return term_reader_a->getAverageFrequency() < term_reader_b->getAverageFrequency();
-                         }
-
-                         // If only one is a TermReader, prioritize it
-                         if (term_reader_a)
-                             return true;
-                         if (term_reader_b)
-                             return false;
-
-                         // Default case - compare pointers for stable sort
-                         return a.get() < b.get();
+                         return a->estimatedDocCount() < b->estimatedDocCount();
                      });
 }
 
+size_t TermAND::estimatedDocCount() const {
+    size_t smallest = std::numeric_limits<size_t>::max();
+    for (const auto& reader : readers_) {
+        smallest = std::min(smallest, reader->estimatedDocCount());
+    }
+    return smallest;
+}
+
 IndexStreamReader* TermAND::get(std::size_t i) {
     return i < readers_.size() ? readers_[i].get() : nullptr;
 }
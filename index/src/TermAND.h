@@ -4,6 +4,7 @@
 #include "IndexStreamReader.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -18,18 +19,35 @@ public:
     void moveNext() override;
     data::docid_t currentDocID() const override;
     void seekToDocID(data::docid_t target_doc_id) override;
+    size_t estimatedDocCount() const override;
     IndexStreamReader* get(std::size_t i);
     std::size_t numReaders() const;
 
+    // The two sparsest readers' decoded blocks are intersected in bulk while their densities are within this
+    // factor of each other, further apart the sparser one leads and the denser one gallops to it
+    static constexpr size_t MAX_BLOCK_DENSITY_RATIO = 8;
+
 private:
     std::vector<std::unique_ptr<IndexStreamReader>> readers_;
     // Cached document ID for the current match
     data::docid_t current_doc_id_{0};
     // Flag indicating if we've reached the end
     bool at_end_{false};
+    // Doc IDs in the blocks of the first two readers, every match up to candidates_bound_ is among them
+    std::vector<data::docid_t> candidates_;
+    size_t candidate_pos_{0};
+    data::docid_t candidates_bound_{0};
+    bool have_candidates_{false};
+
+    enum class Candidate { Match, Miss, Exhausted };
     // Finds the next document where all terms appear
     bool findNextMatch();
-    // Sort readers by ascending document frequency (optimization)
+    // Leapfrogs the readers to the next match one seek at a time
+    bool findNextMatchBySeeking();
+    // Intersects the first two readers' blocks into candidates_, false when they have none or differ in density
+    bool fillCandidates();
+    Candidate checkCandidate(data::docid_t candidate);
+    // Sort readers by ascending estimatedDocCount(), so the block intersection gets the two rarest lists
     void sortReadersByFrequency();
 };
 
@@ -3,13 +3,17 @@
 #include "spdlog/spdlog.h"
 
 #include <algorithm>
+#include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <fcntl.h>
+#include <fstream>
 #include <iostream>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <unistd.h>
 #include <sys/fcntl.h>
 #include <sys/mman.h>
@@ -17,6 +21,36 @@
 
 namespace mithril {
 
+template<std::integral T>
+static inline T CopyFromBytes(const char* ptr) {
+    T val;
+    std::memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+// Offset deltas are zigzag coded, so an entry may point before its predecessor's list
+static void EncodeOffsetDelta(uint64_t offset, uint64_t prev_offset, std::vector<char>& out) {
+    const auto delta = static_cast<int64_t>(offset - prev_offset);
+    uint64_t value = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+    while (value >= 128) {
+        out.push_back(static_cast<char>((value & 127) | 128));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static uint64_t DecodeOffset(uint64_t prev_offset, const char*& ptr) {
+    uint64_t value = 0;
+    uint32_t shift = 0;
+    uint8_t byte;
+    do {
+        byte = *reinterpret_cast<const uint8_t*>(ptr++);
+        value |= static_cast<uint64_t>(byte & 127) << shift;
+        shift += 7;
+    } while (byte & 128);
+    return prev_offset + ((value >> 1) ^ (0 - (value & 1)));
+}
+
 TermDictionary::TermDictionary(const std::string& index_dir) {
     std::string dict_path = index_dir + "/term_dictionary.data";
     spdlog::info("constructing term dictionary for {}", index_dir);
@@ -36,6 +70,10 @@ TermDictionary::TermDictionary(const std::string& index_dir) {
     }
 
     dict_size_ = sb.st_size;
+    if (dict_size_ < 3 * sizeof(uint32_t)) {
+        std::cerr << "Dictionary file is truncated" << std::endl;
+        return;
+    }
 
     dict_data_ = static_cast<const char*>(mmap(nullptr, dict_size_, PROT_READ, MAP_PRIVATE, dict_fd_, 0));
     if (dict_data_ == MAP_FAILED) {
@@ -46,67 +84,60 @@ TermDictionary::TermDictionary(const std::string& index_dir) {
         return;
     }
 
-    // Force in memory
-    if (mlock(dict_data_, dict_size_) != 0) {
-        spdlog::warn("Failed to lock into memory dictionary file");
-    }
-
-    // Touch all pages to force in memory
-    volatile char tmp;
-    for (size_t i = 0; i < dict_size_; i += 4096) {
-        tmp = *((char*)dict_data_ + i);
-    }
-
     const char* ptr = dict_data_;
-    uint32_t magic = *reinterpret_cast<const uint32_t*>(ptr);
-    ptr += sizeof(uint32_t);
-
-    version_ = *reinterpret_cast<const uint32_t*>(ptr);
+    uint32_t magic = CopyFromBytes<uint32_t>(ptr);
     ptr += sizeof(uint32_t);
 
-    term_count_ = *reinterpret_cast<const uint32_t*>(ptr);
+    version_ = CopyFromBytes<uint32_t>(ptr);
     ptr += sizeof(uint32_t);
 
-    if (magic != 0x4D495448) {
+    if (magic != MAGIC) {
         std::cerr << "Invalid dictionary file format" << std::endl;
         return;
     }
 
-    if (version_ != 1) {
-        std::cerr << "Unsupported dictionary version: " << version_ << std::endl;
+    if (version_ != VERSION || dict_size_ < HEADER_SIZE) {
+        std::cerr << "Unsupported dictionary version: " << version_ << " (expected " << VERSION
+                  << "), rebuild the index" << std::endl;
         return;
     }
 
-    // Build simple first-char index for faster lookups
-    std::fill(first_char_index_.begin(), first_char_index_.end(), UINT32_MAX);
+    term_count_ = CopyFromBytes<uint32_t>(ptr);
+    ptr += sizeof(uint32_t);
+    codec_ = static_cast<PostingCodec>(CopyFromBytes<uint32_t>(ptr));
+    ptr += sizeof(uint32_t);
+    block_count_ = CopyFromBytes<uint32_t>(ptr);
+    ptr += sizeof(uint32_t);
+    const uint32_t terms_per_block = CopyFromBytes<uint32_t>(ptr);
+    ptr += sizeof(uint32_t);
+    flags_ = CopyFromBytes<uint32_t>(ptr);
+    ptr += sizeof(uint32_t);
 
-    const char* entry_ptr = ptr;
-    for (uint32_t i = 0; i < term_count_; i++) {
-        uint32_t term_len = *reinterpret_cast<const uint32_t*>(entry_ptr);
-        entry_ptr += sizeof(uint32_t);
+    if (terms_per_block != TERMS_PER_BLOCK ||
+        block_count_ != (term_count_ + TERMS_PER_BLOCK - 1) / TERMS_PER_BLOCK) {
+        std::cerr << "Dictionary block layout does not match this build, rebuild the index" << std::endl;
+        return;
+    }
 
-        // Record the first occurrence of each starting char
-        if (term_len > 0) {
-            unsigned char first_char = static_cast<unsigned char>(entry_ptr[0]);
-            if (first_char_index_[first_char] == UINT32_MAX) {
-                first_char_index_[first_char] = i;
-            }
+    // Head heap size is the end of the last head
+    block_index_ = ptr;
+    head_heap_ = block_index_ + static_cast<size_t>(block_count_) * sizeof(BlockIndexEntry);
+    size_t head_heap_size = 0;
+    if (block_count_ > 0) {
+        if (static_cast<size_t>(head_heap_ - dict_data_) > dict_size_) {
+            std::cerr << "Dictionary file is truncated" << std::endl;
+            return;
         }
-
-        // Skip to next entry
-        entry_ptr += term_len + sizeof(uint64_t) + sizeof(uint32_t);
+        const auto last = blockIndexEntry(block_count_ - 1);
+        head_heap_size = static_cast<size_t>(last.head_offset) + last.head_len;
     }
-
-    entry_offsets_.reserve(term_count_);
-    const auto* const base_data_ptr = dict_data_ + (3 * sizeof(uint32_t));  // Skip header
-    uint32_t offset = 0;
-    for (uint32_t i = 0; i < term_count_; i++) {
-        entry_offsets_.push_back(offset);
-        uint32_t term_len = *reinterpret_cast<const uint32_t*>(base_data_ptr + offset);
-        offset += sizeof(uint32_t) + term_len + sizeof(uint64_t) + sizeof(uint32_t);
+    blocks_ = head_heap_ + head_heap_size;
+    if (static_cast<size_t>(blocks_ - dict_data_) > dict_size_) {
+        std::cerr << "Dictionary file is truncated" << std::endl;
+        return;
     }
 
-    spdlog::info("Memory mapped term dictionary with {} terms", term_count_);
+    spdlog::info("Memory mapped term dictionary with {} terms in {} blocks", term_count_, block_count_);
     loaded_ = true;
 }
 
@@ -124,67 +155,152 @@ std::optional<TermDictionary::TermEntry> TermDictionary::lookup(const std::strin
     return search(term);
 }
 
+TermDictionary::BlockIndexEntry TermDictionary::blockIndexEntry(uint32_t block) const {
+    BlockIndexEntry entry;
+    std::memcpy(&entry, block_index_ + static_cast<size_t>(block) * sizeof(BlockIndexEntry), sizeof(entry));
+    return entry;
+}
+
 std::optional<TermDictionary::TermEntry> TermDictionary::search(const std::string& term) const {
     if (!loaded_ || term_count_ == 0 || term.empty()) {
         return std::nullopt;
     }
 
-    // Use first char index to narrow search range
-    unsigned char first_char = static_cast<unsigned char>(term[0]);
-    uint32_t start_idx = first_char_index_[first_char];
-
-    // If no terms start with this char, return null
-    if (start_idx == UINT32_MAX) {
-        return std::nullopt;
+    // Binary search for the last block whose head is <= term
+    uint32_t left = 0;
+    uint32_t right = block_count_;
+    while (left < right) {
+        uint32_t mid = left + (right - left) / 2;
+        if (blockHead(blockIndexEntry(mid)) <= term) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    if (left == 0) {
+        return std::nullopt;  // term sorts before the first term
     }
 
-    // Find the end of this char's range
-    uint32_t end_idx = term_count_;
-    for (size_t c = first_char + 1; c < 256; c++) {
-        if (first_char_index_[c] != UINT32_MAX) {
-            end_idx = first_char_index_[c];
-            break;
+    // Scan the block, rebuilding each term from its predecessor
+    const uint32_t block = left - 1;
+    const BlockIndexEntry entry = blockIndexEntry(block);
+    const uint32_t block_terms = std::min(TERMS_PER_BLOCK, term_count_ - block * TERMS_PER_BLOCK);
+    const char* ptr = blocks_ + entry.block_offset;
+
+    std::string current(blockHead(entry));
+    uint64_t index_offset = entry.base_index_offset;
+    for (uint32_t i = 0; i < block_terms; i++) {
+        if (i > 0) {
+            const uint32_t shared = VByteCodec::decode_from_memory(ptr);
+            const uint32_t suffix_len = VByteCodec::decode_from_memory(ptr);
+            current.resize(shared);
+            current.append(ptr, suffix_len);
+            ptr += suffix_len;
         }
-    }
+        index_offset = DecodeOffset(index_offset, ptr);
+        const uint32_t postings_count = VByteCodec::decode_from_memory(ptr);
 
-    // ptr to the start of entries section
-    const char* entries_start = dict_data_ + 3 * sizeof(uint32_t);  // Skip header
-    // binary search within char range
-    uint32_t left = start_idx;
-    uint32_t right = end_idx - 1;
+        const int comparison = term.compare(current);
+        if (comparison == 0) {
+            return TermEntry{std::move(current), index_offset, postings_count};
+        }
+        if (comparison < 0) {
+            break;  // Passed the spot where term would be
+        }
+    }
 
-    while (left <= right) {
-        uint32_t mid = left + (right - left) / 2;
+    return std::nullopt;
+}
 
-        // Read term at mid
-        const char* entry_ptr = entries_start + entry_offsets_[mid];
-        uint32_t term_len = *reinterpret_cast<const uint32_t*>(entry_ptr);
-        entry_ptr += sizeof(uint32_t);
+void TermDictionary::for_each_term(const std::function<void(const TermEntry&)>& fn) const {
+    if (!loaded_) {
+        return;
+    }
 
-        auto mid_term = std::string_view{entry_ptr, term_len};
-        int comparison = term.compare(mid_term);
+    TermEntry entry;
+    for (uint32_t block = 0; block < block_count_; block++) {
+        const BlockIndexEntry index_entry = blockIndexEntry(block);
+        const uint32_t block_terms = std::min(TERMS_PER_BLOCK, term_count_ - block * TERMS_PER_BLOCK);
+        const char* ptr = blocks_ + index_entry.block_offset;
+
+        entry.term.assign(blockHead(index_entry));
+        entry.index_offset = index_entry.base_index_offset;
+        for (uint32_t i = 0; i < block_terms; i++) {
+            if (i > 0) {
+                const uint32_t shared = VByteCodec::decode_from_memory(ptr);
+                const uint32_t suffix_len = VByteCodec::decode_from_memory(ptr);
+                entry.term.resize(shared);
+                entry.term.append(ptr, suffix_len);
+                ptr += suffix_len;
+            }
+            entry.index_offset = DecodeOffset(entry.index_offset, ptr);
+            entry.postings_count = VByteCodec::decode_from_memory(ptr);
+            fn(entry);
+        }
+    }
+}
 
-        if (comparison == 0) {
-            // Found the term!
-            entry_ptr += term_len;
-
-            TermEntry entry;
-            entry.term = mid_term;
-            entry.index_offset = *reinterpret_cast<const uint64_t*>(entry_ptr);
-            entry_ptr += sizeof(uint64_t);
-            entry.postings_count = *reinterpret_cast<const uint32_t*>(entry_ptr);
-
-            return entry;
-        } else if (comparison < 0) {
-            if (mid == 0)
-                break;
-            right = mid - 1;
+bool TermDictionary::write(const std::string& path,
+                           const std::vector<TermEntry>& entries,
+                           PostingCodec codec,
+                           uint32_t flags) {
+    const uint32_t term_count = entries.size();
+    const uint32_t block_count = (term_count + TERMS_PER_BLOCK - 1) / TERMS_PER_BLOCK;
+
+    std::vector<BlockIndexEntry> block_index;
+    block_index.reserve(block_count);
+    std::string head_heap;
+    std::vector<char> blocks;
+
+    for (uint32_t i = 0; i < term_count; i++) {
+        const TermEntry& entry = entries[i];
+        if (i % TERMS_PER_BLOCK == 0) {
+            block_index.push_back(BlockIndexEntry{entry.index_offset,
+                                                  blocks.size(),
+                                                  static_cast<uint32_t>(head_heap.size()),
+                                                  static_cast<uint32_t>(entry.term.size())});
+            head_heap += entry.term;
+            VByteCodec::encode_to_vector(0, blocks);
         } else {
-            left = mid + 1;
+            const TermEntry& prev = entries[i - 1];
+            if (entry.term <= prev.term) {
+                spdlog::error("Dictionary entries out of order at '{}', not writing {}", entry.term, path);
+                return false;
+            }
+
+            const auto mismatch =
+                std::mismatch(prev.term.begin(), prev.term.end(), entry.term.begin(), entry.term.end());
+            const uint32_t shared = mismatch.first - prev.term.begin();
+            VByteCodec::encode_to_vector(shared, blocks);
+            VByteCodec::encode_to_vector(entry.term.size() - shared, blocks);
+            blocks.insert(blocks.end(), entry.term.begin() + shared, entry.term.end());
+            EncodeOffsetDelta(entry.index_offset, prev.index_offset, blocks);
         }
+        VByteCodec::encode_to_vector(entry.postings_count, blocks);
     }
 
-    return std::nullopt;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        spdlog::error("Failed to create dictionary file: {}", path);
+        return false;
+    }
+
+    const uint32_t header[7] = {
+        MAGIC, VERSION, term_count, static_cast<uint32_t>(codec), block_count, TERMS_PER_BLOCK, flags};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(block_index.data()), block_index.size() * sizeof(BlockIndexEntry));
+    out.write(head_heap.data(), head_heap.size());
+    out.write(blocks.data(), blocks.size());
+    if (!out) {
+        spdlog::error("Failed to write dictionary file: {}", path);
+        return false;
+    }
+
+    spdlog::info("Wrote term dictionary with {} terms in {} blocks ({} bytes)",
+                 term_count,
+                 block_count,
+                 HEADER_SIZE + block_index.size() * sizeof(BlockIndexEntry) + head_heap.size() + blocks.size());
+    return true;
 }
 
 }  // namespace mithril
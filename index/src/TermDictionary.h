@@ -1,14 +1,85 @@
 #ifndef INDEX_TERMDICTIONARY_H
 #define INDEX_TERMDICTIONARY_H
 
-#include <array>
+#include "PostingCodec.h"
+
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <limits>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace mithril {
 
+// A term's champion list holds its highest scoring documents (see IndexBuilder::set_champion_lists). It is stored
+// as a term of its own. The prefix sorts after every ASCII character a normalized term can hold, but before the
+// lead bytes of non-ASCII ones, the final merge interleaves the two in term order.
+inline constexpr char CHAMPION_TERM_PREFIX = '~';
+
+inline std::string champion_term(std::string_view term) {
+    std::string champion;
+    champion.reserve(term.size() + 1);
+    champion += CHAMPION_TERM_PREFIX;
+    champion.append(term);
+    return champion;
+}
+
+inline bool is_champion_term(std::string_view term) {
+    return !term.empty() && term.front() == CHAMPION_TERM_PREFIX;
+}
+
+// A term found in more than one field also gets an any-field list, the union of its body and decorated lists (see
+// IndexBuilder::set_any_field_lists). Its prefix sorts after every character a normalized term can hold and before
+// CHAMPION_TERM_PREFIX. A posting's frequency packs the term's frequency summed over the fields above the
+// FIELD_FLAG_* mask of the fields it occurs in, see any_field_frequency() and any_field_mask(). A term of a single
+// field gets no list, its any-field entry in the dictionary points at that field's list instead. A dense any-field
+// list's bitmap holds its doc IDs only.
+inline constexpr char ANY_FIELD_TERM_PREFIX = '|';
+inline constexpr uint32_t ANY_FIELD_MASK_BITS = 5;
+
+inline std::string any_field_term(std::string_view term) {
+    std::string any_field;
+    any_field.reserve(term.size() + 1);
+    any_field += ANY_FIELD_TERM_PREFIX;
+    any_field.append(term);
+    return any_field;
+}
+
+inline bool is_any_field_term(std::string_view term) {
+    return !term.empty() && term.front() == ANY_FIELD_TERM_PREFIX;
+}
+
+inline uint32_t pack_any_field(uint32_t freq, uint8_t field_mask) {
+    constexpr uint32_t max_freq = std::numeric_limits<uint32_t>::max() >> ANY_FIELD_MASK_BITS;
+    return (std::min(freq, max_freq) << ANY_FIELD_MASK_BITS) | field_mask;
+}
+
+inline uint32_t any_field_frequency(uint32_t packed) {
+    return packed >> ANY_FIELD_MASK_BITS;
+}
+
+inline uint8_t any_field_mask(uint32_t packed) {
+    return packed & ((1U << ANY_FIELD_MASK_BITS) - 1);
+}
+
+// term_dictionary.data maps a term to its posting list in final_index.data. Terms are sorted and grouped into
+// blocks of TERMS_PER_BLOCK. Every block stores its first term (the head) in full and front codes the others
+// against their predecessor. A lookup binary searches the block heads, then decodes a single block.
+//
+// Layout:
+//   header: u32 magic, u32 version, u32 term_count, u32 codec (PostingCodec), u32 block_count, u32 terms_per_block,
+//           u32 flags
+//   block index: block_count BlockIndexEntry
+//   head heap: the head terms of all blocks, back to back
+//   blocks, one per BlockIndexEntry. Per term:
+//     varint shared prefix length, varint suffix length, suffix bytes (all omitted for the head)
+//     zigzag varint index offset delta from the previous term (from BlockIndexEntry::base_index_offset for the
+//     head), negative after an any-field entry that points back at a field's list
+//     varint postings count
 class TermDictionary {
 public:
     struct TermEntry {
@@ -17,12 +88,39 @@ public:
         uint32_t postings_count;
     };
 
+    struct BlockIndexEntry {
+        uint64_t base_index_offset;  // Index offset of the head term
+        uint64_t block_offset;       // From the start of the blocks section
+        uint32_t head_offset;        // Into the head heap
+        uint32_t head_len;
+    };
+    static_assert(sizeof(BlockIndexEntry) == 24, "term dictionary block index entries are fixed size");
+
+    static constexpr uint32_t MAGIC = 0x4D495448;  // "MITH"
+    // Versions 2 and 3 stored one flat entry per term and encoded the posting codec in the version, version 4
+    // indexes have no block impacts in their sync points, version 5 had no flags and ascending offsets only
+    static constexpr uint32_t VERSION = 6;
+    static constexpr uint32_t TERMS_PER_BLOCK = 32;
+    static constexpr size_t HEADER_SIZE = 7 * sizeof(uint32_t);
+
+    // Every term of the index has an any-field entry, so a plain query term takes one lookup
+    static constexpr uint32_t FLAG_ANY_FIELD = 1U << 0;
+
     explicit TermDictionary(const std::string& index_dir);
     ~TermDictionary();
 
     std::optional<TermEntry> lookup(const std::string& term) const;
+    // Visits every term in sorted order
+    void for_each_term(const std::function<void(const TermEntry&)>& fn) const;
     size_t size() const { return term_count_; }
     bool is_loaded() const { return loaded_; }
+    uint32_t version() const { return version_; }
+    PostingCodec posting_codec() const { return codec_; }
+    bool has_any_field_entries() const { return (flags_ & FLAG_ANY_FIELD) != 0; }
+
+    // Writes a dictionary file, entries must be sorted by term
+    static bool
+    write(const std::string& path, const std::vector<TermEntry>& entries, PostingCodec codec, uint32_t flags = 0);
 
 private:
     int dict_fd_ = -1;
@@ -31,12 +129,19 @@ private:
 
     uint32_t term_count_ = 0;
     uint32_t version_ = 0;
+    PostingCodec codec_{PostingCodec::StreamVByte};
+    uint32_t flags_ = 0;
 
-    // simple first-letter index to speed up lookups
-    std::array<uint32_t, 256> first_char_index_{};
-    std::vector<uint32_t> entry_offsets_;
+    uint32_t block_count_ = 0;
+    const char* block_index_ = nullptr;
+    const char* head_heap_ = nullptr;
+    const char* blocks_ = nullptr;
     bool loaded_ = false;
 
+    BlockIndexEntry blockIndexEntry(uint32_t block) const;
+    std::string_view blockHead(const BlockIndexEntry& entry) const {
+        return {head_heap_ + entry.head_offset, entry.head_len};
+    }
     std::optional<TermEntry> search(const std::string& term) const;
 
     TermDictionary(const TermDictionary&) = delete;
@@ -5,12 +5,22 @@
 
 namespace mithril {
 
-TermOR::TermOR(std::vector<std::unique_ptr<IndexStreamReader>> readers) : readers_(std::move(readers)) {
-    if (readers_.empty()) {
-        at_end_ = true;
-        return;
+TermOR::TermOR(std::vector<std::unique_ptr<IndexStreamReader>> readers) {
+    // OR(OR(a, b), c) is one union over a, b and c, a nested TermOR still in heap mode hands over its readers
+    for (auto& reader : readers) {
+        auto* nested = dynamic_cast<TermOR*>(reader.get());
+        if (nested != nullptr && !nested->dense_) {
+            for (auto& nested_reader : nested->readers_) {
+                readers_.push_back(std::move(nested_reader));
+            }
+        } else {
+            readers_.push_back(std::move(reader));
+        }
     }
-    findMinimumReader();
+
+    rebuildHeap();
+    settleHeap();
+    probe_start_ = current_doc_id_;
 }
 
 bool TermOR::hasNext() const {
@@ -22,53 +32,198 @@ void TermOR::moveNext() {
         return;
     }
 
-    // Get the current document ID before moving
-    data::docid_t current_doc_id = readers_[current_min_index_]->currentDocID();
-
-    // Advance all readers that point to the current document ID
-    for (auto& reader : readers_) {
-        if (reader->hasNext() && reader->currentDocID() == current_doc_id) {
-            reader->moveNext();
+    if (dense_) {
+        const size_t next = nextInWindow(current_doc_id_ - window_base_ + 1);
+        if (next < WINDOW_SIZE) {
+            current_doc_id_ = window_base_ + static_cast<data::docid_t>(next);
+        } else {
+            nextWindow();
         }
+        return;
     }
 
-    // Find the new minimum
-    findMinimumReader();
+    // Advance all readers that point to the current document ID, they are at the top of the heap
+    while (!heap_.empty() && heapDocID(0) == current_doc_id_) {
+        readers_[heap_[0]]->moveNext();
+        fixTop();
+    }
+    settleHeap();
+    probeDensity();
 }
 
 data::docid_t TermOR::currentDocID() const {
     if (at_end_) {
         return std::numeric_limits<data::docid_t>::max();
     }
-    return readers_[current_min_index_]->currentDocID();
+    return current_doc_id_;
 }
 
 void TermOR::seekToDocID(data::docid_t target_doc_id) {
-    if (at_end_) {
+    if (at_end_ || target_doc_id <= current_doc_id_) {
         return;
     }
-    // Seek all readers to the target
-    for (auto& reader : readers_) {
-        reader->seekToDocID(target_doc_id);
+
+    if (dense_) {
+        if (target_doc_id - window_base_ < WINDOW_SIZE) {
+            const size_t next = nextInWindow(target_doc_id - window_base_);
+            if (next < WINDOW_SIZE) {
+                current_doc_id_ = window_base_ + static_cast<data::docid_t>(next);
+                return;
+            }
+        } else {
+            for (auto& reader : readers_) {
+                reader->seekToDocID(target_doc_id);
+            }
+        }
+        nextWindow();
+        return;
     }
-    // Find the new minimum
-    findMinimumReader();
+
+    // Only the readers behind the target need to seek, they are at the top of the heap
+    while (!heap_.empty() && heapDocID(0) < target_doc_id) {
+        readers_[heap_[0]]->seekToDocID(target_doc_id);
+        fixTop();
+    }
+    settleHeap();
+    probe_start_ = current_doc_id_;
+    probe_count_ = 0;
+}
+
+size_t TermOR::estimatedDocCount() const {
+    size_t total = 0;
+    for (const auto& reader : readers_) {
+        total += std::min(reader->estimatedDocCount(), std::numeric_limits<size_t>::max() - total);
+    }
+    return total;
 }
 
-void TermOR::findMinimumReader() {
-    at_end_ = true;  // Assume we're at the end until we find a valid reader
-    data::docid_t min_doc_id = std::numeric_limits<data::docid_t>::max();
+data::docid_t TermOR::heapDocID(size_t pos) const {
+    return readers_[heap_[pos]]->currentDocID();
+}
 
+void TermOR::siftDown(size_t pos) {
+    const size_t size = heap_.size();
+    const size_t moving = heap_[pos];
+    const data::docid_t doc_id = readers_[moving]->currentDocID();
+    while (true) {
+        size_t child = 2 * pos + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && heapDocID(child + 1) < heapDocID(child)) {
+            ++child;
+        }
+        if (heapDocID(child) >= doc_id) {
+            break;
+        }
+        heap_[pos] = heap_[child];
+        pos = child;
+    }
+    heap_[pos] = moving;
+}
+
+void TermOR::rebuildHeap() {
+    heap_.clear();
     for (size_t i = 0; i < readers_.size(); ++i) {
         if (readers_[i]->hasNext()) {
-            data::docid_t doc_id = readers_[i]->currentDocID();
-            if (doc_id < min_doc_id) {
-                min_doc_id = doc_id;
-                current_min_index_ = i;
-                at_end_ = false;
-            }
+            heap_.push_back(i);
+        }
+    }
+    for (size_t pos = heap_.size() / 2; pos-- > 0;) {
+        siftDown(pos);
+    }
+}
+
+void TermOR::fixTop() {
+    if (!readers_[heap_[0]]->hasNext()) {
+        heap_[0] = heap_.back();
+        heap_.pop_back();
+        if (heap_.empty()) {
+            return;
+        }
+    }
+    siftDown(0);
+}
+
+void TermOR::settleHeap() {
+    at_end_ = heap_.empty();
+    if (!at_end_) {
+        current_doc_id_ = heapDocID(0);
+    }
+}
+
+void TermOR::probeDensity() {
+    if (at_end_ || readers_.size() < DENSE_MIN_READERS) {
+        return;
+    }
+    ++probe_count_;
+    if (current_doc_id_ - probe_start_ < WINDOW_SIZE) {
+        return;
+    }
+    if (probe_count_ * DENSE_FRACTION >= WINDOW_SIZE) {
+        // Every reader is at or past the current doc ID, so the window can start there
+        dense_ = true;
+        fillWindow(current_doc_id_);
+        return;
+    }
+    probe_start_ = current_doc_id_;
+    probe_count_ = 0;
+}
+
+void TermOR::nextWindow() {
+    if (window_count_ * DENSE_FRACTION < WINDOW_SIZE) {
+        dense_ = false;
+        rebuildHeap();
+        settleHeap();
+        probe_start_ = current_doc_id_;
+        probe_count_ = 0;
+        return;
+    }
+
+    at_end_ = true;
+    data::docid_t base = std::numeric_limits<data::docid_t>::max();
+    for (const auto& reader : readers_) {
+        if (reader->hasNext()) {
+            base = std::min(base, reader->currentDocID());
+            at_end_ = false;
+        }
+    }
+    if (!at_end_) {
+        fillWindow(base);
+    }
+}
+
+void TermOR::fillWindow(data::docid_t base) {
+    window_.fill(0);
+    window_base_ = base;
+    window_count_ = 0;
+    // Widened so a window at the top of the doc ID range doesn't wrap
+    const uint64_t end = static_cast<uint64_t>(base) + WINDOW_SIZE;
+    for (auto& reader : readers_) {
+        for (; reader->hasNext() && reader->currentDocID() < end; reader->moveNext()) {
+            const size_t offset = reader->currentDocID() - base;
+            const uint64_t bit = uint64_t{1} << (offset % 64);
+            window_count_ += (window_[offset / 64] & bit) == 0;
+            window_[offset / 64] |= bit;
+        }
+    }
+    // The first reader to reach base set its bit
+    current_doc_id_ = base;
+}
+
+size_t TermOR::nextInWindow(size_t offset) const {
+    if (offset >= WINDOW_SIZE) {
+        return WINDOW_SIZE;
+    }
+    size_t word = offset / 64;
+    uint64_t bits = window_[word] & (~uint64_t{0} << (offset % 64));
+    while (bits == 0) {
+        if (++word == WINDOW_WORDS) {
+            return WINDOW_SIZE;
         }
+        bits = window_[word];
     }
+    return word * 64 + static_cast<size_t>(__builtin_ctzll(bits));
 }
 
-}  // namespace mithril
\ No newline at end of file
+}  // namespace mithril
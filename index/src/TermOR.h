@@ -3,6 +3,9 @@
 
 #include "IndexStreamReader.h"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -17,15 +20,50 @@ public:
     void moveNext() override;
     data::docid_t currentDocID() const override;
     void seekToDocID(data::docid_t target_doc_id) override;
+    size_t estimatedDocCount() const override;
+
+    // Doc IDs covered by one bitmap window in dense mode
+    static constexpr data::docid_t WINDOW_SIZE = 4096;
+    // Dense mode needs at least this many readers, and a run of moveNext() calls that found at least
+    // WINDOW_SIZE / DENSE_FRACTION matches (one per bitmap word) in WINDOW_SIZE doc IDs; a window with fewer goes
+    // back to the heap. Seeks restart the count, so a TermOR that a sparse AND seeks through stays on the heap.
+    static constexpr size_t DENSE_MIN_READERS = 2;
+    static constexpr size_t DENSE_FRACTION = 64;
 
 private:
+    static constexpr size_t WINDOW_WORDS = WINDOW_SIZE / 64;
+
     std::vector<std::unique_ptr<IndexStreamReader>> readers_;
-    // Index of the reader with the current minimum docID
-    size_t current_min_index_{0};
+    // Cached document ID for the current match
+    data::docid_t current_doc_id_{0};
     // Flag indicating if we've reached the end of all readers
     bool at_end_{false};
-    // Helper to find the reader with the minimum docID
-    void findMinimumReader();
+
+    // Heap mode: indexes of the readers with documents left, a min-heap on their current doc ID
+    std::vector<size_t> heap_;
+    // Matches since probe_start_, to notice a union dense enough for the bitmap
+    data::docid_t probe_start_{0};
+    size_t probe_count_{0};
+
+    // Dense mode: every reader has been drained past the window, whose matches are the set bits
+    bool dense_{false};
+    data::docid_t window_base_{0};
+    size_t window_count_{0};
+    std::array<uint64_t, WINDOW_WORDS> window_{};
+
+    data::docid_t heapDocID(size_t pos) const;
+    void siftDown(size_t pos);
+    void rebuildHeap();
+    // Restores the heap after the top reader moved
+    void fixTop();
+    void settleHeap();
+    void probeDensity();
+
+    // Fills the window starting at the smallest doc ID left in the readers, or goes back to the heap
+    void nextWindow();
+    void fillWindow(data::docid_t base);
+    // First set bit at or after offset in the window, WINDOW_SIZE when there is none
+    size_t nextInWindow(size_t offset) const;
 };
 
 }  // namespace mithril
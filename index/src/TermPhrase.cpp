@@ -15,7 +15,8 @@ TermPhrase::TermPhrase(const std::string& index_path,
                        const std::vector<std::string>& phrase,
                        const core::MemMapFile& index_file,
                        TermDictionary& term_dict,
-                       PositionIndex& position_index)
+                       PositionIndex& position_index,
+                       const DeletionBitmap* deleted)
     : index_path_(index_path),
       phrase_(phrase),
       index_file_(index_file),
@@ -23,18 +24,13 @@ TermPhrase::TermPhrase(const std::string& index_path,
       position_index_(position_index) {
     std::vector<std::unique_ptr<IndexStreamReader>> term_readers;
     for (const auto& term : phrase) {
-        auto ptr = new TermReader(index_path_, term, index_file_, term_dict_, position_index_);
+        auto ptr = new TermReader(index_path_, term, index_file_, term_dict_, position_index_, deleted);
         term_readers_.push_back(ptr);                                          // maintain for ourselves
         term_readers.emplace_back(reinterpret_cast<IndexStreamReader*>(ptr));  // what we pass to TermAND
     }
     stream_reader_ = std::make_unique<TermAND>(std::move(term_readers));
 
-    // set into valid initial state
-    findNextMatch();
-    if (hasNext()) {
-        current_doc_id_ = next_doc_id_;
-        findNextMatch();
-    }
+    findMatch();
 }
 
 bool TermPhrase::hasNext() const {
@@ -43,8 +39,8 @@ bool TermPhrase::hasNext() const {
 
 void TermPhrase::moveNext() {
     if (hasNext()) {
-        current_doc_id_ = next_doc_id_;
-        findNextMatch();
+        stream_reader_->moveNext();
+        findMatch();
     }
 }
 
@@ -53,37 +49,58 @@ data::docid_t TermPhrase::currentDocID() const {
 }
 
 void TermPhrase::seekToDocID(data::docid_t target_doc_id) {
-    while (hasNext() && current_doc_id_ != target_doc_id)
-        moveNext();
+    if (!hasNext() || current_doc_id_ >= target_doc_id) {
+        return;
+    }
+    stream_reader_->seekToDocID(target_doc_id);
+    findMatch();
 }
 
-bool TermPhrase::findNextMatch() {
-    while (stream_reader_->hasNext()) {
-        stream_reader_->moveNext();
-        const auto& base_positions = term_readers_[0]->currentPositions();
-        for (auto base_pos : base_positions) {
-            bool all_match = true;
-            auto last_pos = base_pos;
+size_t TermPhrase::estimatedDocCount() const {
+    return stream_reader_->estimatedDocCount();
+}
 
-            for (size_t i = 1; i < term_readers_.size(); ++i) {
-                const auto& positions = term_readers_[i]->currentPositions();
+bool TermPhrase::findMatch() {
+    for (; stream_reader_->hasNext(); stream_reader_->moveNext()) {
+        if (positionsMatch()) {
+            current_doc_id_ = stream_reader_->currentDocID();
+            return true;
+        }
+    }
+    at_end_ = true;
+    return false;
+}
 
-                auto it = std::lower_bound(positions.begin(), positions.end(), last_pos);
-                if (it == positions.end() || *it - base_pos > kMaxSpanSize) {
-                    all_match = false;
-                    break;
-                }
+bool TermPhrase::positionsMatch() {
+    // Every reader is on the TermAND's document, decode each term's positions once for all base positions
+    positions_.clear();
+    for (const auto* reader : term_readers_) {
+        positions_.push_back(&reader->currentPositionsRef());
+        if (positions_.back()->empty()) {
+            return false;
+        }
+    }
 
-                last_pos = *it;
-            }
+    for (auto base_pos : *positions_[0]) {
+        bool all_match = true;
+        auto last_pos = base_pos;
+
+        for (size_t i = 1; i < positions_.size(); ++i) {
+            const auto& positions = *positions_[i];
 
-            if (all_match && last_pos - base_pos <= kMaxSpanSize) {
-                next_doc_id_ = stream_reader_->currentDocID();
-                return true;
+            auto it = std::lower_bound(positions.begin(), positions.end(), last_pos);
+            if (it == positions.end() || *it - base_pos > kMaxSpanSize) {
+                all_match = false;
+                break;
             }
+
+            last_pos = *it;
+        }
+
+        if (all_match && last_pos - base_pos <= kMaxSpanSize) {
+            return true;
         }
     }
-    at_end_ = true;
     return false;
 }
 
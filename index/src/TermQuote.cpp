@@ -12,7 +12,8 @@ TermQuote::TermQuote(const std::string& index_path,
                      const std::vector<std::string>& quote,
                      const core::MemMapFile& index_file,
                      TermDictionary& term_dict,
-                     PositionIndex& position_index)
+                     PositionIndex& position_index,
+                     const DeletionBitmap* deleted)
     : index_path_(index_path),
       quote_(quote),
       index_file_(index_file),
@@ -20,18 +21,13 @@ TermQuote::TermQuote(const std::string& index_path,
       position_index_(position_index) {
     std::vector<std::unique_ptr<IndexStreamReader>> term_readers;
     for (const auto& term : quote) {
-        auto ptr = new TermReader(index_path_, term, index_file_, term_dict_, position_index_);
+        auto ptr = new TermReader(index_path_, term, index_file_, term_dict_, position_index_, deleted);
         term_readers_.push_back(ptr);                                          // maintain for ourselves
         term_readers.emplace_back(reinterpret_cast<IndexStreamReader*>(ptr));  // what we pass to TermAND
     }
     stream_reader_ = std::make_unique<TermAND>(std::move(term_readers));
 
-    // set into valid initial state
-    findNextMatch();
-    if (hasNext()) {
-        current_doc_id_ = next_doc_id_;
-        findNextMatch();
-    }
+    findMatch();
 }
 
 bool TermQuote::hasNext() const {
@@ -40,8 +36,8 @@ bool TermQuote::hasNext() const {
 
 void TermQuote::moveNext() {
     if (hasNext()) {
-        current_doc_id_ = next_doc_id_;
-        findNextMatch();
+        stream_reader_->moveNext();
+        findMatch();
     }
 }
 
@@ -50,32 +46,50 @@ data::docid_t TermQuote::currentDocID() const {
 }
 
 void TermQuote::seekToDocID(data::docid_t target_doc_id) {
-    while (hasNext() && current_doc_id_ != target_doc_id)
-        moveNext();
+    if (!hasNext() || current_doc_id_ >= target_doc_id) {
+        return;
+    }
+    stream_reader_->seekToDocID(target_doc_id);
+    findMatch();
 }
 
-bool TermQuote::findNextMatch() {
-    while (stream_reader_->hasNext()) {
-        stream_reader_->moveNext();
-        const auto& base_positions = term_readers_[0]->currentPositions();
-        for (auto x : base_positions) {
-            bool all_match = true;
-            for (size_t i = 1; i < term_readers_.size(); ++i) {
-                const auto& positions = term_readers_[i]->currentPositions();
-                if (!std::binary_search(positions.begin(), positions.end(), x + i)) {
-                    all_match = false;
-                    break;
-                }
-            }
-            if (all_match) {
-                next_doc_id_ = stream_reader_->currentDocID();
-                return true;
-            }
+size_t TermQuote::estimatedDocCount() const {
+    return stream_reader_->estimatedDocCount();
+}
+
+bool TermQuote::findMatch() {
+    for (; stream_reader_->hasNext(); stream_reader_->moveNext()) {
+        if (positionsMatch()) {
+            current_doc_id_ = stream_reader_->currentDocID();
+            return true;
         }
     }
     at_end_ = true;
     return false;
 }
 
+bool TermQuote::positionsMatch() {
+    // Every reader is on the TermAND's document, term i must be at start + i. Both lists are sorted, so each
+    // term's positions are searched from where the previous start's search ended.
+    const auto& first = term_readers_[0]->currentPositionsRef();
+    starts_.assign(first.begin(), first.end());
+    for (size_t i = 1; i < term_readers_.size() && !starts_.empty(); ++i) {
+        const auto& positions = term_readers_[i]->currentPositionsRef();
+        auto it = positions.begin();
+        size_t kept = 0;
+        for (const uint32_t start : starts_) {
+            it = std::lower_bound(it, positions.end(), start + i);
+            if (it == positions.end()) {
+                break;
+            }
+            if (*it == start + i) {
+                starts_[kept++] = start;
+            }
+        }
+        starts_.resize(kept);
+    }
+    return !starts_.empty();
+}
+
 
 }  // namespace mithril
@@ -22,7 +22,8 @@ public:
                        const std::vector<std::string>& quote,
                        const core::MemMapFile& index_file,
                        TermDictionary& term_dict,
-                       PositionIndex& postion_index);
+                       PositionIndex& postion_index,
+                       const DeletionBitmap* deleted = nullptr);
 
     TermQuote(const TermQuote&) = delete;
     TermQuote& operator=(const TermQuote&) = delete;
@@ -33,10 +34,15 @@ public:
     void moveNext() override;
 
     data::docid_t currentDocID() const override;
+    // Seeks the underlying TermAND, positions are only checked on documents that have every term
     void seekToDocID(data::docid_t target_doc_id) override;
+    // The TermAND's estimate, position matching only drops documents from it
+    size_t estimatedDocCount() const override;
 
 private:
-    bool findNextMatch();
+    // Moves the TermAND to the first of its documents from the current one on where the positions match
+    bool findMatch();
+    bool positionsMatch();
 
 private:
     const std::string& index_path_;
@@ -47,8 +53,9 @@ private:
     std::vector<TermReader*> term_readers_;  // sketchy
     std::unique_ptr<TermAND> stream_reader_;
     data::docid_t current_doc_id_{0};
-    data::docid_t next_doc_id_{0};
     bool at_end_{false};
+    // Start positions of the quote that the terms checked so far follow, reused across documents
+    std::vector<uint32_t> starts_;
 };
 
 }  // namespace mithril
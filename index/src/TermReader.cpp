@@ -1,10 +1,14 @@
 #include "TermReader.h"
 
 #include "PostingBlock.h"
+#include "PostingIntersect.h"
+#include "TextPreprocessor.h"
 #include "core/mem_map_file.h"
 
+#include <algorithm>
 #include <concepts>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
@@ -21,13 +25,15 @@ TermReader::TermReader(const std::string& index_path,
                        const std::string& term,
                        const core::MemMapFile& index_file,
                        TermDictionary& term_dict,
-                       PositionIndex& position_index)
+                       PositionIndex& position_index,
+                       const DeletionBitmap* deleted)
     : term_dict_(term_dict),
       term_(term),
       index_path_(index_path + "/final_index.data"),
       index_dir_(index_path),
       index_file_(index_file),
-      position_index_(position_index) {
+      position_index_(position_index),
+      deleted_(deleted != nullptr && !deleted->empty() ? deleted : nullptr) {
 
     if (term_dict_.is_loaded()) {
         found_term_ = findTermWithDict(term, term_dict_);
@@ -40,6 +46,7 @@ TermReader::TermReader(const std::string& index_path,
     if (!found_term_) {
         at_end_ = true;
     }
+    skipDeleted();
 }
 
 TermReader::~TermReader() {}
@@ -56,93 +63,116 @@ bool TermReader::findTermWithDict(const std::string& term, const TermDictionary&
     // Seek directly to the term position
     auto file_ptr = index_file_.data() + list_offset;
 
-    // Read term length and verify
+    // Read the list's term and verify, an any-field entry may point at the list of the term's only field
     const uint32_t term_len = CopyFromBytes<uint32_t>(file_ptr);
     file_ptr += sizeof(uint32_t);
-    if (term_len != term.length()) {
-        std::cerr << "Dictionary offset error: term length mismatch" << std::endl;
+    list_term_ = std::string_view(file_ptr, term_len);
+    file_ptr += term_len;
+    // A champion list is of its full list's field
+    const auto [field, bare_term] = TokenNormalizer::splitDecoratedToken(
+        is_champion_term(list_term_) ? list_term_.substr(1) : list_term_);
+    if (list_term_ != term &&
+        (!is_any_field_term(term) || is_any_field_term(list_term_) || bare_term != term.substr(1))) {
+        std::cerr << "Dictionary offset error: term mismatch" << std::endl;
         return false;
     }
-
-    // Skip term content since we already know it matches
-    file_ptr += term_len;
+    packed_fields_ = is_any_field_term(list_term_);
+    field_mask_ = packed_fields_ ? 0 : fieldTypeToFlag(field);
 
     // Read postings size
-    const uint32_t postings_size = CopyFromBytes<uint32_t>(file_ptr);
-    file_ptr += sizeof(postings_size);
-
-    // Read sync points
-    const uint32_t sync_points_size = CopyFromBytes<uint32_t>(file_ptr);
-    file_ptr += sizeof(sync_points_size);
+    postings_size_ = CopyFromBytes<uint32_t>(file_ptr);
+    file_ptr += sizeof(postings_size_);
+
+    // Read block layout
+    num_blocks_ = CopyFromBytes<uint32_t>(file_ptr);
+    file_ptr += sizeof(num_blocks_);
+    postings_bytes_ = CopyFromBytes<uint32_t>(file_ptr);
+    file_ptr += sizeof(postings_bytes_);
+    codec_ = dictionary.posting_codec();
+
+    sync_points_data_ = file_ptr;
+    postings_data_ = sync_points_data_ + static_cast<size_t>(num_blocks_) * sizeof(BlockSyncPoint);
+    if (postings_data_ + postings_bytes_ > index_file_.data() + index_file_.size()) {
+        std::cerr << "Posting list for term '" << term << "' extends past end of index file" << std::endl;
+        return false;
+    }
 
-    // Load sync points
-    sync_points_.resize(sync_points_size);
-    if (sync_points_size > 0) {
-        std::memcpy(sync_points_.data(), file_ptr, sync_points_size * sizeof(SyncPoint));
-        file_ptr += sync_points_size * sizeof(SyncPoint);
+    if (num_blocks_ == 0) {
+        return false;
     }
 
-    // Read postings
-    postings_.clear();
-    postings_.reserve(postings_size);
+    // Only the first block is decoded up front
+    loadBlock(0);
+    return true;
+}
 
-    // First read all doc ID deltas and calculate actual doc IDs
-    std::vector<uint32_t> doc_ids(postings_size);
-    uint32_t last_doc_id = 0;
-    for (uint32_t j = 0; j < postings_size; ++j) {
-        const uint32_t doc_id_delta = decodeVByte(file_ptr);
-        last_doc_id += doc_id_delta;
-        doc_ids[j] = last_doc_id;
-    }
+BlockSyncPoint TermReader::syncPoint(uint32_t block) const {
+    BlockSyncPoint sp;
+    std::memcpy(&sp, sync_points_data_ + static_cast<size_t>(block) * sizeof(BlockSyncPoint), sizeof(sp));
+    return sp;
+}
 
-    // Then read all frequencies
-    std::vector<uint32_t> freqs(postings_size);
-    for (uint32_t j = 0; j < postings_size; j++) {
-        freqs[j] = decodeVByte(file_ptr);
+uint32_t TermReader::blockLength(uint32_t block) const {
+    if (block + 1 < num_blocks_) {
+        return PostingBlockCodec::BLOCK_SIZE;
     }
+    return postings_size_ - block * PostingBlockCodec::BLOCK_SIZE;
+}
 
-    // Combine doc IDs and frequencies into postings
-    for (uint32_t j = 0; j < postings_size; j++) {
-        postings_.emplace_back(doc_ids[j], freqs[j]);
+const char* TermReader::blockEnd(uint32_t block) const {
+    if (block + 1 < num_blocks_) {
+        return postings_data_ + syncPoint(block + 1).byte_offset;
     }
+    return postings_data_ + postings_bytes_;
+}
 
-    // Set initial state
-    current_posting_index_ = 0;
-    std::cout << "Successfully loaded term '" << term << "' using dictionary lookup" << std::endl;
-    return true;
+void TermReader::loadBlock(uint32_t block) {
+    const BlockSyncPoint sp = syncPoint(block);
+    block_index_ = block;
+    block_length_ = blockLength(block);
+    block_pos_ = 0;
+    PostingBlockCodec::decode_block(codec_,
+                                    postings_data_ + sp.byte_offset,
+                                    blockEnd(block),
+                                    block_length_,
+                                    sp.base_doc_id,
+                                    block_doc_ids_.data(),
+                                    block_freqs_.data());
 }
 
-uint32_t TermReader::decodeVByte(const char*& ptr) {
-    uint32_t result = 0, shift = 0;
-    uint8_t byte;
+bool TermReader::hasNext() const {
+    return found_term_ && !at_end_;
+}
 
-    const auto end = index_file_.data() + index_file_.size();
-    while (ptr < end) [[likely]] {
-        uint8_t byte = *reinterpret_cast<const uint8_t*>(ptr++);
-        result |= (uint32_t)(byte & 0x7f) << shift;
-        if (!(byte & 0x80))
-            break;
-        shift += 7;
+void TermReader::moveNext() {
+    if (!hasNext()) {
+        return;
     }
 
-    return result;
+    advance();
+    skipDeleted();
 }
 
-bool TermReader::hasNext() const {
-    if (!found_term_ || at_end_) {
-        return false;
+void TermReader::skipDeleted() {
+    // One bit test per posting, only readers of an index with deletions get here
+    if (deleted_ == nullptr) {
+        return;
+    }
+    while (hasNext() && deleted_->isDeleted(block_doc_ids_[block_pos_])) {
+        advance();
     }
-
-    return current_posting_index_ < postings_.size();
 }
 
-void TermReader::moveNext() {
-    if (!hasNext()) {
-        at_end_ = true;
+void TermReader::advance() {
+    if (++block_pos_ < block_length_) {
         return;
     }
 
-    current_posting_index_++;
+    if (block_index_ + 1 < num_blocks_) {
+        loadBlock(block_index_ + 1);
+    } else {
+        at_end_ = true;
+    }
 }
 
 data::docid_t TermReader::currentDocID() const {
@@ -150,7 +180,7 @@ data::docid_t TermReader::currentDocID() const {
         throw std::runtime_error("No current posting");
     }
 
-    return postings_[current_posting_index_].first;
+    return block_doc_ids_[block_pos_];
 }
 
 uint32_t TermReader::currentFrequency() const {
@@ -158,7 +188,16 @@ uint32_t TermReader::currentFrequency() const {
         throw std::runtime_error("No current posting");
     }
 
-    return postings_[current_posting_index_].second;
+    const uint32_t freq = block_freqs_[block_pos_];
+    return packed_fields_ ? any_field_frequency(freq) : freq;
+}
+
+uint8_t TermReader::currentFieldMask() const {
+    if (!hasNext()) {
+        throw std::runtime_error("No current posting");
+    }
+
+    return packed_fields_ ? any_field_mask(block_freqs_[block_pos_]) : field_mask_;
 }
 
 void TermReader::seekToDocID(data::docid_t target_doc_id) {
@@ -167,50 +206,69 @@ void TermReader::seekToDocID(data::docid_t target_doc_id) {
     }
 
     // 1. Check if we're already at or past the target
-    if (current_posting_index_ < postings_.size() && postings_[current_posting_index_].first >= target_doc_id) {
-        return;  // Already at or past target
-    }
-
-    // 2. Check if we need to skip to the end
-    if (target_doc_id > postings_.back().first) {
-        current_posting_index_ = postings_.size();
-        at_end_ = true;
+    if (block_doc_ids_[block_pos_] >= target_doc_id) {
         return;
     }
 
-    // 3. Binary search using sync points if available
-    if (!sync_points_.empty()) {
-        // Find largest sync point with doc_id <= target_doc_id
-        size_t left = 0;
-        size_t right = sync_points_.size() - 1;
-        size_t best_idx = 0;
-
-        while (left <= right) {
-            size_t mid = left + (right - left) / 2;
-
-            if (sync_points_[mid].doc_id <= target_doc_id) {
-                best_idx = mid;
-                left = mid + 1;
-            } else {
-                if (mid == 0)
-                    break;
-                right = mid - 1;
-            }
+    // 2. If the target is past the current block, find the first block whose last doc ID reaches it using
+    // only the sync points, then decode just that block
+    if (block_doc_ids_[block_length_ - 1] < target_doc_id) {
+        const uint32_t block = findBlock(target_doc_id);
+        if (block == num_blocks_) {
+            at_end_ = true;
+            return;
         }
+        loadBlock(block);
+    }
+
+    // 3. Gallop inside the decoded block, the block's last doc ID is known to be >= target
+    const uint32_t* block = block_doc_ids_.data();
+    block_pos_ = PostingIntersect::gallop(block + block_pos_, block + block_length_, target_doc_id) - block;
+    skipDeleted();
+}
 
-        // Start from the closest sync point
-        current_posting_index_ = sync_points_[best_idx].plist_offset;
+uint32_t TermReader::findBlock(data::docid_t target) const {
+    if (!hasNext()) {
+        return numBlocks();
     }
 
-    // 4. Linear scan from current position to target
-    while (current_posting_index_ < postings_.size() && postings_[current_posting_index_].first < target_doc_id) {
-        current_posting_index_++;
+    // Gallop over the sync points first, seeks mostly land a few blocks ahead
+    uint32_t left = block_index_;
+    uint32_t right = num_blocks_;
+    for (uint32_t step = 1; left + step < num_blocks_; step *= 2) {
+        if (syncPoint(left + step).last_doc_id >= target) {
+            right = left + step + 1;
+            break;
+        }
+        left += step;
     }
+    while (left < right) {
+        uint32_t mid = left + (right - left) / 2;
+        if (syncPoint(mid).last_doc_id < target) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    return left;
+}
 
-    // 5. Check if we've reached the end
-    if (current_posting_index_ >= postings_.size()) {
-        at_end_ = true;
+size_t TermReader::bufferedDocIDs(const data::docid_t*& doc_ids) const {
+    if (!hasNext()) {
+        return 0;
     }
+    doc_ids = block_doc_ids_.data() + block_pos_;
+    return block_length_ - block_pos_;
+}
+
+float TermReader::maxImpact() const {
+    if (max_impact_ < 0) {
+        max_impact_ = 0;
+        for (uint32_t block = 0; block < numBlocks(); ++block) {
+            max_impact_ = std::max(max_impact_, blockMaxImpact(block));
+        }
+    }
+    return max_impact_;
 }
 
 bool TermReader::hasPositions() const {
@@ -218,7 +276,7 @@ bool TermReader::hasPositions() const {
         return false;
     }
 
-    return position_index_.hasPositions(term_, currentDocID());
+    return positionCursor().seekTo(currentDocID());
 }
 
 std::vector<uint16_t> TermReader::currentPositions() const {
@@ -226,27 +284,31 @@ std::vector<uint16_t> TermReader::currentPositions() const {
         return {};
     }
 
-    return position_index_.getPositions(term_, currentDocID());
+    auto& cursor = positionCursor();
+    if (!cursor.seekTo(currentDocID())) {
+        return {};
+    }
+    return cursor.positions();
 }
 
-double TermReader::getAverageFrequency() const {
-    if (avg_frequency_computed_) {
-        return avg_frequency_;
+const std::vector<uint16_t>& TermReader::currentPositionsRef() const {
+    static const std::vector<uint16_t> kNoPositions;
+    if (!found_term_ || at_end_) {
+        return kNoPositions;
     }
 
-    double total_freq = 0.0;
-    for (const auto& posting : postings_) {
-        total_freq += posting.second;
+    auto& cursor = positionCursor();
+    if (!cursor.seekTo(currentDocID())) {
+        return kNoPositions;
     }
+    return cursor.positions();
+}
 
-    if (!postings_.empty()) {
-        avg_frequency_ = total_freq / postings_.size();
-    } else {
-        avg_frequency_ = 0.0;
+PositionCursor& TermReader::positionCursor() const {
+    if (!position_cursor_) {
+        position_cursor_ = position_index_.cursor(term_);
     }
-
-    avg_frequency_computed_ = true;
-    return avg_frequency_;
+    return *position_cursor_;
 }
 
 }  // namespace mithril
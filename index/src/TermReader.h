@@ -1,16 +1,20 @@
 #ifndef INDEX_TERMREADER_H
 #define INDEX_TERMREADER_H
 
+#include "DeletionBitmap.h"
 #include "IndexStreamReader.h"
 #include "PositionIndex.h"
 #include "PostingBlock.h"
+#include "PostingCodec.h"
 #include "TermDictionary.h"
 #include "core/mem_map_file.h"
 
+#include <array>
 #include <fstream>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace mithril {
@@ -21,7 +25,8 @@ public:
                const std::string& term,
                const core::MemMapFile& index_file,
                TermDictionary& term_dict,
-               PositionIndex& position_index);
+               PositionIndex& position_index,
+               const DeletionBitmap* deleted = nullptr);
     ~TermReader();
 
     // ISR
@@ -29,17 +34,32 @@ public:
     void moveNext() override;
     data::docid_t currentDocID() const override;
     void seekToDocID(data::docid_t target_doc_id) override;
+    size_t bufferedDocIDs(const data::docid_t*& doc_ids) const override;
 
     // term specific funcs
     uint32_t currentFrequency() const;
+    // FIELD_FLAG_* bits of the fields the term occurs in for the current document. An any-field list stores them
+    // with each posting, every other list is of a single field.
+    uint8_t currentFieldMask() const;
     std::string getTerm() const { return term_; }
-    uint32_t getDocumentCount() const { return postings_.size(); }
+    // Term the list was written under, the field's term when an any-field entry points at a single field's list
+    std::string_view listTerm() const { return list_term_; }
+    uint32_t getDocumentCount() const { return postings_size_; }
+    size_t estimatedDocCount() const override { return postings_size_; }
 
-    double getAverageFrequency() const;
+    // Block-max metadata for dynamic pruning, read from the sync points without decoding any block
+    uint32_t numBlocks() const { return found_term_ ? num_blocks_ : 0; }
+    // First block from the current one on whose last doc ID reaches target, numBlocks() if there is none
+    uint32_t findBlock(data::docid_t target) const;
+    data::docid_t blockLastDocID(uint32_t block) const { return syncPoint(block).last_doc_id; }
+    float blockMaxImpact(uint32_t block) const { return syncPoint(block).max_impact; }
+    float maxImpact() const;
 
     // postion specific funcs
     bool hasPositions() const;
     std::vector<uint16_t> currentPositions() const;
+    // Same positions without the copy, the buffer is reused and only valid until the reader moves
+    const std::vector<uint16_t>& currentPositionsRef() const;
 
 private:
     TermDictionary& term_dict_;
@@ -50,19 +70,43 @@ private:
     bool found_term_{false};
     bool at_end_{false};
 
-    // Current posting state
-    std::vector<std::pair<uint32_t, uint32_t>> postings_;  // doc_id, freq pairs
-    size_t current_posting_index_{0};
-    std::vector<SyncPoint> sync_points_;
+    // Posting list layout, pointing into the mapped index file. Nothing is decoded up front: postings are
+    // decoded one block at a time as the reader advances or seeks.
+    PostingCodec codec_{PostingCodec::StreamVByte};
+    uint32_t postings_size_{0};
+    uint32_t postings_bytes_{0};
+    uint32_t num_blocks_{0};
+    const char* sync_points_data_{nullptr};
+    const char* postings_data_{nullptr};
+    std::string_view list_term_;
+    // Set for any-field lists, whose frequencies pack the field mask
+    bool packed_fields_{false};
+    uint8_t field_mask_{0};
+
+    // Currently decoded block
+    uint32_t block_index_{0};
+    uint32_t block_length_{0};
+    uint32_t block_pos_{0};
+    std::array<uint32_t, PostingBlockCodec::BLOCK_SIZE> block_doc_ids_{};
+    std::array<uint32_t, PostingBlockCodec::BLOCK_SIZE> block_freqs_{};
 
     PositionIndex& position_index_;
+    // Postings of deleted documents are skipped, nullptr or an empty bitmap skips nothing
+    const DeletionBitmap* deleted_;
+    // Created on first position access, advances with the reader
+    mutable std::optional<PositionCursor> position_cursor_;
 
-    mutable double avg_frequency_{0.0};
-    mutable bool avg_frequency_computed_{false};
+    mutable float max_impact_{-1.0F};
 
     bool findTerm(const std::string& term);
     bool findTermWithDict(const std::string& term, const TermDictionary& dictionary);
-    uint32_t decodeVByte(const char*& ptr);
+    BlockSyncPoint syncPoint(uint32_t block) const;
+    uint32_t blockLength(uint32_t block) const;
+    const char* blockEnd(uint32_t block) const;
+    void loadBlock(uint32_t block);
+    void advance();
+    void skipDeleted();
+    PositionCursor& positionCursor() const;
 };
 
 }  // namespace mithril
@@ -24,6 +24,10 @@ bool PostingList::empty() const {
     return postings_.empty();
 }
 
+size_t PostingList::memory_usage() const {
+    return postings_.capacity() * sizeof(Posting) + sync_points_.capacity() * sizeof(SyncPoint);
+}
+
 Dictionary::Dictionary(size_t bucket_size_hint) : buckets_(bucket_size_hint, nullptr) {
     entries_.reserve(bucket_size_hint / 2);
 }
@@ -76,6 +80,13 @@ PostingList& Dictionary::get_or_create(const std::string& term) {
     return entry_ptr->postings;
 }
 
+size_t Dictionary::term_memory_usage(const std::string& term) {
+    // Entry allocation, plus the term's heap buffer unless it fits in the SSO buffer
+    static const size_t sso_capacity = std::string().capacity();
+    const size_t heap_term = term.size() <= sso_capacity ? 0 : term.size() + 1;
+    return sizeof(Entry) + heap_term;
+}
+
 bool Dictionary::contains(const std::string& term) const {
     const size_t bucket = hash(term);
     std::lock_guard<std::mutex> lock(mutex_);
@@ -101,6 +112,13 @@ void Dictionary::clear_postings() {
     }
 }
 
+void Dictionary::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::fill(buckets_.begin(), buckets_.end(), nullptr);
+    entries_.clear();
+    size_ = 0;
+}
+
 void Dictionary::iterate_terms(const std::function<void(const std::string&, const PostingList&)>& fn) const {
     std::lock_guard<std::mutex> lock(mutex_);
 
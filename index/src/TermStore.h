@@ -19,6 +19,8 @@ public:
 
     void clear();
     bool empty() const;
+    // Heap bytes held by the list, grows in steps as its vectors reallocate
+    size_t memory_usage() const;
 
     static constexpr uint32_t SYNC_INTERVAL = 128;
 
@@ -36,8 +38,17 @@ public:
     size_t size() const;
 
     void clear_postings();
+    // Drops all terms and their postings, releasing their memory
+    void clear();
     void iterate_terms(const std::function<void(const std::string&, const PostingList&)>& fn) const;
 
+    // Bytes a new term costs the dictionary on top of its postings
+    static size_t term_memory_usage(const std::string& term);
+    // Bytes held by an empty dictionary, the bucket array and the reserved entry table
+    size_t base_memory_usage() const {
+        return buckets_.capacity() * sizeof(Entry*) + entries_.capacity() * sizeof(std::unique_ptr<Entry>);
+    }
+
     Dictionary(const Dictionary&) = delete;
     Dictionary& operator=(const Dictionary&) = delete;
     Dictionary(Dictionary&&) = delete;
@@ -7,6 +7,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_set>
+#include <utility>
 
 namespace mithril {
 
@@ -156,6 +157,22 @@ public:
         }
     }
 
+    // Field of a decorated token and the bare token, the inverse of decorateToken
+    static std::pair<FieldType, std::string_view> splitDecoratedToken(std::string_view token) {
+        switch (token.empty() ? '\0' : token.front()) {
+        case '#':
+            return {FieldType::TITLE, token.substr(1)};
+        case '@':
+            return {FieldType::URL, token.substr(1)};
+        case '$':
+            return {FieldType::ANCHOR, token.substr(1)};
+        case '%':
+            return {FieldType::DESC, token.substr(1)};
+        default:
+            return {FieldType::BODY, token};
+        }
+    }
+
 private:
     static bool isValidToken(const std::string& str) {
         // Must contain at least one letter and no non-ASCII chars
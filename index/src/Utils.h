@@ -20,6 +20,14 @@ public:
         out.Write(value);
     }
 
+    static void encode_to_vector(uint32_t value, std::vector<char>& out) {
+        while (value >= 128) {
+            out.push_back(static_cast<char>((value & 127) | 128));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
     static uint32_t decode(std::istream& in) {
         uint32_t result = 0;
         uint32_t shift = 0;
@@ -0,0 +1,82 @@
+#include "SegmentCompactor.h"
+
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <spdlog/spdlog.h>
+
+namespace {
+volatile sig_atomic_t shutdown_requested = 0;
+
+void signal_handler(int signal) {
+    shutdown_requested = signal;
+}
+
+void setup_signals() {
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <index_directory> [--merge-factor=<segments>] [--memory-budget=<MB>] [--watch=<seconds>]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string index_dir = argv[1];
+    size_t merge_factor = mithril::DEFAULT_SEGMENT_MERGE_FACTOR;
+    size_t memory_budget = mithril::DEFAULT_MEMORY_BUDGET;
+    size_t watch_seconds = 0;
+
+    for (int i = 2; i < argc; i++) {
+        std::string_view arg(argv[i]);
+        if (arg.starts_with("--merge-factor=")) {
+            merge_factor = std::stoul(std::string(arg.substr(15)));
+        } else if (arg.starts_with("--memory-budget=")) {
+            memory_budget = std::stoull(std::string(arg.substr(16))) << 20;
+        } else if (arg.starts_with("--watch=")) {
+            watch_seconds = std::stoul(std::string(arg.substr(8)));
+        }
+    }
+
+    if (!std::filesystem::is_directory(index_dir)) {
+        spdlog::error("Index directory does not exist: {}", index_dir);
+        return 1;
+    }
+
+    setup_signals();
+
+    try {
+        mithril::SegmentCompactor compactor(index_dir, merge_factor, memory_budget);
+        if (!compactor.tryLock()) {
+            spdlog::error("Another compactor is running in {}", index_dir);
+            return 1;
+        }
+
+        // A merge in progress always runs to completion, signals only stop the compactor between merges
+        do {
+            size_t merges = 0;
+            while (!shutdown_requested && compactor.compactOnce()) {
+                ++merges;
+            }
+            if (merges > 0) {
+                spdlog::info("Finished {} merges in {}", merges, index_dir);
+            }
+            for (size_t waited = 0; waited < watch_seconds && !shutdown_requested; ++waited) {
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+            }
+        } while (watch_seconds > 0 && !shutdown_requested);
+
+        return 0;
+
+    } catch (const std::exception& e) {
+        spdlog::error("Fatal error: {}", e.what());
+        return 1;
+    }
+}
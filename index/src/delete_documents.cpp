@@ -0,0 +1,132 @@
+#include "DeletionBitmap.h"
+#include "DocumentMapReader.h"
+#include "SegmentManifest.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+std::string_view UrlHost(std::string_view url) {
+    const auto scheme_end = url.find("://");
+    if (scheme_end != std::string_view::npos) {
+        url.remove_prefix(scheme_end + 3);
+    }
+    return url.substr(0, url.find_first_of(":/?#"));
+}
+
+std::string Lowercase(std::string_view s) {
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+    return out;
+}
+
+// Same rule as the crawler's host blacklist: a host covers itself and all of its subdomains
+bool MatchesHost(std::string_view host, const std::vector<std::string>& hosts) {
+    return std::any_of(hosts.begin(), hosts.end(), [&](const std::string& blocked) {
+        return host == blocked || (host.size() > blocked.size() && host.ends_with(blocked) &&
+                                   host[host.size() - blocked.size() - 1] == '.');
+    });
+}
+
+bool ReadHostFile(const std::string& path, std::vector<std::string>& hosts) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        hosts.push_back(Lowercase(line));
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <index_directory> [--host=<host>] [--host-file=<file>] [<doc id>...]" << std::endl
+                  << "Hosts cover their subdomains, host files use the format of blacklisted_hosts.conf" << std::endl;
+        return 1;
+    }
+
+    std::string index_dir = argv[1];
+    std::vector<std::string> hosts;
+    std::vector<mithril::data::docid_t> ids;
+
+    for (int i = 2; i < argc; i++) {
+        std::string_view arg(argv[i]);
+        if (arg.starts_with("--host=")) {
+            hosts.push_back(Lowercase(arg.substr(7)));
+        } else if (arg.starts_with("--host-file=")) {
+            const std::string path(arg.substr(12));
+            if (!ReadHostFile(path, hosts)) {
+                spdlog::error("Failed to read host file: {}", path);
+                return 1;
+            }
+        } else {
+            mithril::data::docid_t id = 0;
+            auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), id);
+            if (ec != std::errc{} || ptr != arg.data() + arg.size()) {
+                spdlog::error("Not a document id: {}", arg);
+                return 1;
+            }
+            ids.push_back(id);
+        }
+    }
+
+    if (!std::filesystem::is_directory(index_dir)) {
+        spdlog::error("Index directory does not exist: {}", index_dir);
+        return 1;
+    }
+
+    try {
+        // Holding the manifest lock keeps the compactor from replacing segments while they are marked
+        mithril::SegmentManifest::Lock lock(index_dir);
+        size_t total = 0;
+        for (const auto& segment_dir : mithril::SegmentManifest::segmentDirs(index_dir)) {
+            // Ids on the command line are the crawler's, a segment built with another doc order numbers them
+            // differently
+            mithril::DocumentMapReader documents(segment_dir);
+            std::vector<mithril::data::docid_t> segment_ids;
+            for (const mithril::data::docid_t id : ids) {
+                if (const auto segment_id = documents.lookupCrawlDocID(id)) {
+                    segment_ids.push_back(*segment_id);
+                }
+            }
+            if (!hosts.empty()) {
+                for (size_t slot = 0; slot < documents.slotCount(); ++slot) {
+                    const auto view = documents.getDocumentView(documents.baseDocID() + slot);
+                    if (view && MatchesHost(Lowercase(UrlHost(view->url)), hosts)) {
+                        segment_ids.push_back(view->id());
+                    }
+                }
+            }
+
+            if (segment_ids.empty()) {
+                continue;
+            }
+            const size_t deleted = mithril::DeletionBitmap::markDeleted(segment_dir, segment_ids);
+            spdlog::info("Deleted {} documents from {}", deleted, segment_dir);
+            total += deleted;
+        }
+        spdlog::info("Deleted {} documents in total", total);
+        return 0;
+
+    } catch (const std::exception& e) {
+        spdlog::error("Fatal error: {}", e.what());
+        return 1;
+    }
+}
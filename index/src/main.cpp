@@ -1,15 +1,22 @@
+#include "DynamicRanker.h"
+#include "IngestPipeline.h"
 #include "InvertedIndex.h"
+#include "SegmentManifest.h"
+#include "StaticRanker.h"
 
 #include <chrono>
 #include <csignal>
 #include <filesystem>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 #include <spdlog/spdlog.h>
 
 namespace {
 volatile sig_atomic_t shutdown_requested = 0;
 
+constexpr size_t DEFAULT_CHECKPOINT_INTERVAL = 250000;
+
 void signal_handler(int signal) {
     shutdown_requested = signal;
 }
@@ -20,7 +27,16 @@ void setup_signals() {
     signal(SIGTERM, signal_handler);
 }
 
-void print_progress(size_t processed, size_t start_time) {
+// The part of a document's ranking score that doesn't depend on the query, weighted the way
+// ranking::dynamic::GetUrlDynamicRank weighs it. The indexer doesn't read PageRank results yet, pagerank_score is
+// always 0, so this is the URL static rank alone.
+double static_score(const mithril::DocumentMetadata& doc) {
+    namespace dynamic = mithril::ranking::dynamic;
+    return dynamic::Weights.static_rank * mithril::ranking::GetUrlStaticRank(doc.url) +
+           dynamic::Weights.pagerank * doc.pagerank_score;
+}
+
+void print_progress(size_t processed, size_t start_time, size_t memory_bytes) {
     auto now = std::chrono::steady_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
                        now - std::chrono::steady_clock::time_point(std::chrono::seconds(start_time)))
@@ -32,16 +48,20 @@ void print_progress(size_t processed, size_t start_time) {
     double rate = static_cast<double>(processed) / elapsed;
 
     std::cout << "\rProcessed " << processed << " documents"
-              << " (" << std::fixed << std::setprecision(1) << rate << " docs/sec)" << std::flush;
+              << " (" << std::fixed << std::setprecision(1) << rate << " docs/sec, " << (memory_bytes >> 20)
+              << " MB buffered)" << std::flush;
 }
 
-bool validate_directories(const std::string& input_dir, const std::string& output_dir, bool force) {
+bool validate_directories(const std::string& input_dir, const std::string& output_dir, bool force, bool keep_output) {
     if (!std::filesystem::exists(input_dir)) {
         spdlog::error("Input directory does not exist: {}", input_dir);
         return false;
     }
 
-    if (std::filesystem::exists(output_dir)) {
+    if (keep_output) {
+        // Resuming keeps what the last run checkpointed, appending keeps the existing segments
+        spdlog::info("Keeping existing output directory: {}", output_dir);
+    } else if (std::filesystem::exists(output_dir)) {
         if (!force) {
             spdlog::error("Output directory exists. Use --force to overwrite: {}", output_dir);
             return false;
@@ -63,7 +83,14 @@ bool validate_directories(const std::string& input_dir, const std::string& outpu
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <crawl_directory> [--output=<dir>] [--force] [--quiet]" << std::endl;
+        std::cerr << "Usage: " << argv[0]
+                  << " <crawl_directory> [--output=<dir>] [--force] [--quiet] [--merge-io=<max concurrent merges>]"
+                     " [--decode-threads=<n>] [--enumerate-threads=<n>] [--memory-budget=<MB>]"
+                     " [--checkpoint-every=<docs>] [--resume] [--segment] [--doc-order=crawl|static-rank|url]"
+                     " [--doc-order-report]"
+                     " [--champion-min=<postings>] [--champion-size=<docs, 0 for none>]"
+                     " [--dense-fraction=<1 in n documents, 0 for none>] [--no-any-field]"
+                  << std::endl;
         return 1;
     }
 
@@ -72,6 +99,18 @@ int main(int argc, char* argv[]) {
     std::string output_dir = "index_output";
     bool force = false;
     bool quiet = false;
+    bool resume = false;
+    bool segment = false;
+    size_t max_concurrent_merges = 0;
+    size_t memory_budget = mithril::DEFAULT_MEMORY_BUDGET;
+    mithril::DocOrder doc_order = mithril::DocOrder::Crawl;
+    bool doc_order_report = false;
+    size_t champion_min_postings = mithril::DEFAULT_CHAMPION_MIN_POSTINGS;
+    size_t champion_list_size = mithril::DEFAULT_CHAMPION_LIST_SIZE;
+    uint32_t dense_term_fraction = mithril::DEFAULT_DENSE_TERM_FRACTION;
+    bool any_field_lists = true;
+    mithril::IngestPipeline::Options ingest_options;
+    ingest_options.checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;
 
     for (int i = 2; i < argc; i++) {
         std::string_view arg(argv[i]);
@@ -81,6 +120,39 @@ int main(int argc, char* argv[]) {
             force = true;
         } else if (arg == "--quiet") {
             quiet = true;
+        } else if (arg == "--resume") {
+            resume = true;
+        } else if (arg == "--segment") {
+            segment = true;
+        } else if (arg.starts_with("--checkpoint-every=")) {
+            ingest_options.checkpoint_interval = std::stoul(std::string(arg.substr(19)));
+        } else if (arg.starts_with("--merge-io=")) {
+            max_concurrent_merges = std::stoul(std::string(arg.substr(11)));
+        } else if (arg.starts_with("--memory-budget=")) {
+            memory_budget = std::stoull(std::string(arg.substr(16))) << 20;
+        } else if (arg.starts_with("--decode-threads=")) {
+            ingest_options.decode_threads = std::stoul(std::string(arg.substr(17)));
+        } else if (arg.starts_with("--enumerate-threads=")) {
+            ingest_options.enumerate_threads = std::stoul(std::string(arg.substr(20)));
+        } else if (arg == "--doc-order=crawl") {
+            doc_order = mithril::DocOrder::Crawl;
+        } else if (arg == "--doc-order=static-rank") {
+            doc_order = mithril::DocOrder::StaticRank;
+        } else if (arg == "--doc-order=url") {
+            doc_order = mithril::DocOrder::Url;
+        } else if (arg == "--doc-order-report") {
+            doc_order_report = true;
+        } else if (arg.starts_with("--doc-order=")) {
+            std::cerr << "Unknown doc order: " << arg.substr(12) << std::endl;
+            return 1;
+        } else if (arg.starts_with("--champion-min=")) {
+            champion_min_postings = std::stoul(std::string(arg.substr(15)));
+        } else if (arg.starts_with("--champion-size=")) {
+            champion_list_size = std::stoul(std::string(arg.substr(16)));
+        } else if (arg.starts_with("--dense-fraction=")) {
+            dense_term_fraction = std::stoul(std::string(arg.substr(17)));
+        } else if (arg == "--no-any-field") {
+            any_field_lists = false;
         }
     }
 
@@ -95,54 +167,91 @@ int main(int argc, char* argv[]) {
 #endif
     }
 
+    if (resume && segment) {
+        std::cerr << "--resume and --segment can't be combined" << std::endl;
+        return 1;
+    }
+
     setup_signals();
 
     try {
-        if (!validate_directories(input_dir, output_dir, force)) {
+        if (!validate_directories(input_dir, output_dir, force, resume || segment)) {
             return 1;
         }
 
+        // Appending builds a new segment next to the existing ones and publishes it once it is complete
+        std::string build_dir = output_dir;
+        std::string segment_name;
+        if (segment) {
+            mithril::SegmentManifest::Lock lock(output_dir);
+            auto manifest = mithril::SegmentManifest::loadOrCreate(output_dir);
+            segment_name = manifest.allocateSegmentName();
+            manifest.save(output_dir);
+            build_dir = output_dir + "/" + segment_name;
+            spdlog::info("Building segment {}", build_dir);
+        }
+
         spdlog::info("Starting index build...");
         spdlog::info("Input directory: {}", input_dir);
         spdlog::info("Output directory: {}", output_dir);
 
-        mithril::IndexBuilder builder(output_dir);
+        mithril::IndexBuilder builder(
+            build_dir, std::thread::hardware_concurrency(), mithril::DEFAULT_MAX_TERMS_PER_BLOCK, memory_budget);
+        builder.set_max_concurrent_merges(max_concurrent_merges);
+        builder.set_doc_order(doc_order);
+        builder.set_doc_order_report(doc_order_report);
+        builder.set_static_rank(static_score);
+        // Static scores are in ranker units, dividing by the BM25 weight puts them on the scale of BM25
+        const double bm25_weight = mithril::ranking::dynamic::Weights.bm25;
+        builder.set_champion_lists(
+            champion_min_postings, champion_list_size, bm25_weight > 0 ? 1.0 / bm25_weight : 0.0);
+        builder.set_dense_postings(dense_term_fraction);
+        builder.set_any_field_lists(any_field_lists);
+        if (resume && !builder.resume()) {
+            spdlog::info("No checkpoint found in {}, starting from scratch", output_dir);
+        }
 
-        size_t processed = 0;
         auto start_time = std::chrono::steady_clock::now();
-        std::filesystem::directory_options options = std::filesystem::directory_options::follow_directory_symlink;
-        // in the future for xM docs and multiple chunks i could also opt this more to build index per chunk, so one
-        // more layer of merging ig
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(input_dir, options)) {
-            if (shutdown_requested) {
-                spdlog::warn("\nShutdown requested. Cleaning up...");
-                break;
-            }
+        const auto start_seconds =
+            std::chrono::duration_cast<std::chrono::seconds>(start_time.time_since_epoch()).count();
 
-            if (!entry.is_regular_file()) {
-                continue;  // skip chunk dir
-            }
-            try {
-                builder.add_document(entry.path().string());
-                processed++;
-
-                if (!quiet && (processed % 1000 == 0 || processed == 1)) {
-                    print_progress(
-                        processed,
-                        std::chrono::duration_cast<std::chrono::seconds>(start_time.time_since_epoch()).count());
-                }
-            } catch (const std::exception& e) {
-                spdlog::error("\nError processing {}: {}", entry.path().string(), e.what());
-            }
+        // Enumerating, decoding and indexing run concurrently, see IngestPipeline
+        mithril::IngestPipeline pipeline(builder, input_dir, ingest_options);
+        size_t processed = pipeline.run([] { return shutdown_requested != 0; },
+                                        [&](const mithril::IngestPipeline::Stats& stats) {
+                                            if (!quiet) {
+                                                print_progress(stats.decode.items.load(),
+                                                               start_seconds,
+                                                               builder.memory_stats().total_bytes());
+                                            }
+                                        });
+        if (shutdown_requested && segment) {
+            // The segment was never published, so readers and the compactor don't see the partial build
+            spdlog::warn("\nShutdown requested. Abandoning unpublished segment {}", build_dir);
+        } else if (shutdown_requested) {
+            spdlog::warn("\nShutdown requested. Checkpointing, rerun with --resume to continue...");
+            builder.checkpoint(pipeline.lastDocument());
         }
 
         if (!quiet)
             std::cout << std::endl;
+        pipeline.logSummary();
 
         if (!shutdown_requested) {
             spdlog::info("Finalizing index...");
             builder.finalize();
 
+            if (segment) {
+                mithril::SegmentManifest::Lock lock(output_dir);
+                auto manifest = mithril::SegmentManifest::loadOrCreate(output_dir);
+                manifest.segments.push_back(mithril::SegmentInfo{segment_name, 0, processed});
+                manifest.save(output_dir);
+                spdlog::info("Published segment {} ({} segments, generation {})",
+                             segment_name,
+                             manifest.segments.size(),
+                             manifest.generation);
+            }
+
             auto end_time = std::chrono::steady_clock::now();
             auto elapsed =
 #if defined(__APPLE__)
@@ -0,0 +1,174 @@
+#include "PostingBlock.h"
+#include "PostingCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+using MsBetween = std::chrono::duration<double, std::milli>;
+
+namespace {
+
+struct EncodedList {
+    std::vector<mithril::BlockSyncPoint> sync_points;
+    std::vector<char> bytes;
+    size_t postings_count{0};
+};
+
+// Synthetic posting lists: geometric doc ID gaps (dense terms have small gaps) and mostly small frequencies
+std::vector<std::vector<mithril::Posting>> GenerateLists(size_t num_lists, size_t postings_per_list, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::vector<mithril::Posting>> lists(num_lists);
+    for (size_t l = 0; l < num_lists; ++l) {
+        const double density = 1.0 / (1 << (l % 12));  // from every doc down to 1 in 2048 docs
+        std::geometric_distribution<uint32_t> gap(density);
+        std::geometric_distribution<uint32_t> freq(0.4);
+
+        uint32_t doc_id = 0;
+        lists[l].reserve(postings_per_list);
+        for (size_t i = 0; i < postings_per_list; ++i) {
+            doc_id += 1 + gap(rng);
+            mithril::Posting p{};
+            p.doc_id = doc_id;
+            p.freq = 1 + freq(rng);
+            lists[l].push_back(p);
+        }
+    }
+    return lists;
+}
+
+// Decodes every block of every list, returns checksum so the work cannot be optimized out
+uint64_t DecodeAll(mithril::PostingCodec codec, const std::vector<EncodedList>& lists, mithril::DecodeKernel kernel) {
+    uint32_t doc_ids[mithril::PostingBlockCodec::BLOCK_SIZE];
+    uint32_t freqs[mithril::PostingBlockCodec::BLOCK_SIZE];
+    uint64_t checksum = 0;
+
+    for (const auto& list : lists) {
+        const char* data = list.bytes.data();
+        for (size_t b = 0; b < list.sync_points.size(); ++b) {
+            const auto& sp = list.sync_points[b];
+            const size_t count = std::min(mithril::PostingBlockCodec::BLOCK_SIZE,
+                                          list.postings_count - b * mithril::PostingBlockCodec::BLOCK_SIZE);
+            const char* end = b + 1 < list.sync_points.size() ? data + list.sync_points[b + 1].byte_offset
+                                                              : data + list.bytes.size();
+            mithril::PostingBlockCodec::decode_block(
+                codec, data + sp.byte_offset, end, count, sp.base_doc_id, doc_ids, freqs, kernel);
+            checksum += doc_ids[count - 1] + freqs[0];
+        }
+    }
+    return checksum;
+}
+
+bool Verify(mithril::PostingCodec codec,
+            const std::vector<std::vector<mithril::Posting>>& postings,
+            const std::vector<EncodedList>& lists,
+            mithril::DecodeKernel kernel) {
+    uint32_t doc_ids[mithril::PostingBlockCodec::BLOCK_SIZE];
+    uint32_t freqs[mithril::PostingBlockCodec::BLOCK_SIZE];
+
+    for (size_t l = 0; l < lists.size(); ++l) {
+        const auto& list = lists[l];
+        const char* data = list.bytes.data();
+        for (size_t b = 0; b < list.sync_points.size(); ++b) {
+            const auto& sp = list.sync_points[b];
+            const size_t first = b * mithril::PostingBlockCodec::BLOCK_SIZE;
+            const size_t count = std::min(mithril::PostingBlockCodec::BLOCK_SIZE, list.postings_count - first);
+            const char* end = b + 1 < list.sync_points.size() ? data + list.sync_points[b + 1].byte_offset
+                                                              : data + list.bytes.size();
+            const char* next = mithril::PostingBlockCodec::decode_block(
+                codec, data + sp.byte_offset, end, count, sp.base_doc_id, doc_ids, freqs, kernel);
+            if (next != end) {
+                return false;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (doc_ids[i] != postings[l][first + i].doc_id || freqs[i] != postings[l][first + i].freq) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    size_t num_lists = 48;
+    size_t postings_per_list = 200000;
+    int rounds = 10;
+    if (argc > 1) {
+        num_lists = std::stoul(argv[1]);
+    }
+    if (argc > 2) {
+        postings_per_list = std::stoul(argv[2]);
+    }
+    if (argc > 3) {
+        rounds = std::stoi(argv[3]);
+    }
+
+    std::cout << "Generating " << num_lists << " lists of " << postings_per_list << " postings" << std::endl;
+    const auto postings = GenerateLists(num_lists, postings_per_list, 498);
+    const double total_postings = static_cast<double>(num_lists * postings_per_list);
+
+    struct Config {
+        mithril::PostingCodec codec;
+        mithril::DecodeKernel kernel;
+        const char* name;
+    };
+    const std::vector<Config> configs = {
+        {mithril::PostingCodec::VByte, mithril::DecodeKernel::Scalar, "vbyte (dictionary v2)"},
+        {mithril::PostingCodec::StreamVByte, mithril::DecodeKernel::Scalar, "streamvbyte scalar"},
+        {mithril::PostingCodec::StreamVByte, mithril::DecodeKernel::SSE4, "streamvbyte sse4"},
+        {mithril::PostingCodec::StreamVByte, mithril::DecodeKernel::AVX2, "streamvbyte avx2"},
+    };
+
+    std::cout << std::left << std::setw(24) << "codec" << std::right << std::setw(12) << "bytes/post"
+              << std::setw(14) << "Mpostings/s" << std::setw(12) << "MB/s" << std::endl;
+
+    for (const auto& config : configs) {
+        if (!mithril::StreamVByte::kernel_supported(config.kernel)) {
+            std::cout << std::left << std::setw(24) << config.name << "  not supported on this CPU" << std::endl;
+            continue;
+        }
+
+        std::vector<EncodedList> lists(num_lists);
+        for (size_t l = 0; l < num_lists; ++l) {
+            lists[l].postings_count = postings[l].size();
+            mithril::PostingBlockCodec::encode_postings(
+                config.codec, postings[l], lists[l].sync_points, lists[l].bytes);
+        }
+
+        size_t total_bytes = 0;
+        for (const auto& list : lists) {
+            total_bytes += list.bytes.size();
+        }
+
+        if (!Verify(config.codec, postings, lists, config.kernel)) {
+            std::cerr << config.name << ": decoded postings do not match the input" << std::endl;
+            return 1;
+        }
+
+        // Warm up once, then time the decode rounds
+        uint64_t checksum = DecodeAll(config.codec, lists, config.kernel);
+        auto start = Clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            checksum += DecodeAll(config.codec, lists, config.kernel);
+        }
+        double ms = MsBetween(Clock::now() - start).count();
+
+        const double seconds = ms / 1000.0;
+        std::cout << std::left << std::setw(24) << config.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << total_bytes / total_postings << std::setprecision(1) << std::setw(14)
+                  << (total_postings * rounds) / seconds / 1e6 << std::setw(12)
+                  << (static_cast<double>(total_bytes) * rounds) / seconds / (1 << 20) << "   (checksum " << checksum
+                  << ")" << std::endl;
+    }
+
+    return 0;
+}
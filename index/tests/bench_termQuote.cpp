@@ -0,0 +1,124 @@
+#include "PositionIndex.h"
+#include "TermAND.h"
+#include "TermDictionary.h"
+#include "TermPhrase.h"
+#include "TermQuote.h"
+#include "TermReader.h"
+#include "core/mem_map_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+using MsBetween = std::chrono::duration<double, std::milli>;
+
+namespace {
+
+constexpr int kRounds = 5;
+
+std::vector<mithril::data::docid_t> Collect(mithril::IndexStreamReader& isr) {
+    std::vector<mithril::data::docid_t> doc_ids;
+    for (; isr.hasNext(); isr.moveNext()) {
+        doc_ids.push_back(isr.currentDocID());
+    }
+    return doc_ids;
+}
+
+// Best of kRounds, the ISR is built inside the timed region like a query would
+std::vector<mithril::data::docid_t> Time(const char* name,
+                                         const std::function<std::unique_ptr<mithril::IndexStreamReader>()>& make) {
+    std::vector<mithril::data::docid_t> doc_ids;
+    double best = 1e300;
+    for (int round = 0; round < kRounds; ++round) {
+        auto t0 = Clock::now();
+        doc_ids = Collect(*make());
+        best = std::min(best, MsBetween(Clock::now() - t0).count());
+    }
+    std::cout << std::left << std::setw(28) << name << std::right << std::setw(10) << std::fixed
+              << std::setprecision(3) << best << "ms" << std::setw(10) << doc_ids.size() << " docs" << std::endl;
+    return doc_ids;
+}
+
+}  // namespace
+
+// Latency of a quote and a phrase on their own and inside an AND with another term. The AND results are checked
+// against intersecting the full match lists, which exercises the quote's and phrase's seeks.
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <index_directory> <and_term> <quote_term1> [quote_term2...]"
+                  << std::endl;
+        return 1;
+    }
+
+    const std::string index_dir = argv[1];
+    const std::string and_term = argv[2];
+    const std::vector<std::string> quote(argv + 3, argv + argc);
+
+    try {
+        core::MemMapFile index_file(index_dir + "/final_index.data");
+        mithril::TermDictionary term_dict(index_dir);
+        mithril::PositionIndex position_index(index_dir);
+
+        const auto term = [&](const std::string& t) {
+            return std::make_unique<mithril::TermReader>(index_dir, t, index_file, term_dict, position_index);
+        };
+        const auto make_and = [](std::unique_ptr<mithril::IndexStreamReader> a,
+                                 std::unique_ptr<mithril::IndexStreamReader> b) {
+            std::vector<std::unique_ptr<mithril::IndexStreamReader>> readers;
+            readers.push_back(std::move(a));
+            readers.push_back(std::move(b));
+            return std::make_unique<mithril::TermAND>(std::move(readers));
+        };
+        const auto make_quote = [&] {
+            return std::make_unique<mithril::TermQuote>(
+                index_dir, quote, index_file, term_dict, position_index);
+        };
+        const auto make_phrase = [&] {
+            return std::make_unique<mithril::TermPhrase>(
+                index_dir, quote, index_file, term_dict, position_index);
+        };
+        // The quote's terms without the position check, the least an AND with the quote can cost
+        const auto make_terms = [&] {
+            std::vector<std::unique_ptr<mithril::IndexStreamReader>> readers;
+            for (const auto& t : quote) {
+                readers.push_back(term(t));
+            }
+            return std::make_unique<mithril::TermAND>(std::move(readers));
+        };
+
+        const auto and_docs = Time("term", [&] { return term(and_term); });
+        Time("AND(term, quote terms)", [&] { return make_and(term(and_term), make_terms()); });
+
+        bool ok = true;
+        const auto check = [&](const char* name,
+                               const std::vector<mithril::data::docid_t>& all,
+                               const std::vector<mithril::data::docid_t>& anded) {
+            std::vector<mithril::data::docid_t> expected;
+            std::set_intersection(
+                and_docs.begin(), and_docs.end(), all.begin(), all.end(), std::back_inserter(expected));
+            if (anded != expected) {
+                std::cout << "MISMATCH: " << name << " in an AND found " << anded.size() << " docs, expected "
+                          << expected.size() << std::endl;
+                ok = false;
+            }
+        };
+
+        const auto quote_docs = Time("quote", make_quote);
+        check("quote", quote_docs, Time("AND(term, quote)", [&] { return make_and(term(and_term), make_quote()); }));
+        const auto phrase_docs = Time("phrase", make_phrase);
+        check("phrase",
+              phrase_docs,
+              Time("AND(term, phrase)", [&] { return make_and(term(and_term), make_phrase()); }));
+        return ok ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
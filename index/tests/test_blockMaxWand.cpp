@@ -0,0 +1,108 @@
+#include "BlockMaxWand.h"
+#include "DocumentMapReader.h"
+#include "PositionIndex.h"
+#include "PostingBlock.h"
+#include "TermDictionary.h"
+#include "TermReader.h"
+#include "core/mem_map_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Checks the top k of Block-Max WAND against scoring every document of the terms' lists, for an OR of the terms
+// scored by body BM25
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <index_directory> <k> <term1> [term2...]" << std::endl;
+        return 1;
+    }
+
+    std::string index_dir = argv[1];
+    const size_t k = std::stoul(argv[2]);
+
+    try {
+        core::MemMapFile index_file(index_dir + "/final_index.data");
+        mithril::TermDictionary term_dict(index_dir);
+        mithril::PositionIndex position_index(index_dir);
+        mithril::DocumentMapReader doc_reader(index_dir);
+
+        uint32_t doc_count = 0;
+        uint64_t total_body_length = 0;
+        std::ifstream stats(index_dir + "/index_stats.data", std::ios::binary);
+        stats.read(reinterpret_cast<char*>(&doc_count), sizeof(doc_count));
+        stats.read(reinterpret_cast<char*>(&total_body_length), sizeof(total_body_length));
+        const double avg_body_length = doc_count > 0 ? static_cast<double>(total_body_length) / doc_count : 0.0;
+
+        auto make_lists = [&]() {
+            std::vector<mithril::BlockMaxWand::List> lists;
+            for (int i = 3; i < argc; ++i) {
+                auto reader =
+                    std::make_unique<mithril::TermReader>(index_dir, argv[i], index_file, term_dict, position_index);
+                const double n = reader->getDocumentCount();
+                const double idf = std::log((doc_count - n + 0.5) / (n + 0.5));
+                lists.push_back({std::move(reader), 1.0F, idf, true});
+            }
+            return lists;
+        };
+
+        // Exhaustive: score every posting of every list
+        const auto t0 = std::chrono::steady_clock::now();
+        std::map<mithril::data::docid_t, float> scores;
+        for (auto& list : make_lists()) {
+            for (auto& reader = *list.reader; reader.hasNext(); reader.moveNext()) {
+                const mithril::data::docid_t doc = reader.currentDocID();
+                double norm = 1.0;
+                if (const auto* info = doc_reader.findDocInfo(doc); info != nullptr && avg_body_length > 0) {
+                    norm = (1.0 - mithril::BM25_B) + mithril::BM25_B * (info->body_length / avg_body_length);
+                }
+                scores[doc] += static_cast<float>(
+                    list.weight * mithril::BlockMaxWand::bm25(list.idf, reader.currentFrequency() / norm));
+            }
+        }
+        std::vector<float> expected;
+        for (const auto& [doc, score] : scores) {
+            expected.push_back(score);
+        }
+        std::sort(expected.begin(), expected.end(), std::greater<>());
+        expected.resize(std::min(k, expected.size()));
+        const auto t1 = std::chrono::steady_clock::now();
+
+        mithril::BlockMaxWand wand(make_lists(), doc_reader, avg_body_length);
+        const auto top = wand.topK(k);
+        const auto t2 = std::chrono::steady_clock::now();
+
+        std::vector<float> actual;
+        for (const auto& [doc, score] : top) {
+            actual.push_back(score);
+        }
+        std::sort(actual.begin(), actual.end(), std::greater<>());
+
+        // Ties at the k-th score may pick different documents, the scores have to agree
+        size_t mismatches = actual.size() != expected.size() ? 1 : 0;
+        for (size_t i = 0; i < std::min(actual.size(), expected.size()); ++i) {
+            if (std::abs(actual[i] - expected[i]) > 1e-5F * std::max(1.0F, expected[i])) {
+                ++mismatches;
+            }
+        }
+
+        std::cout << "Exhaustive: " << scores.size() << " documents scored in "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms" << std::endl;
+        std::cout << "Block-Max WAND: " << wand.scoredDocuments() << " documents scored in "
+                  << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms" << std::endl;
+        std::cout << "Top " << top.size() << " mismatches: " << mismatches << std::endl;
+        return mismatches == 0 ? 0 : 1;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,103 @@
+#include "DensePostings.h"
+#include "DocumentMapReader.h"
+#include "NotIndexStreamReader.h"
+#include "PositionIndex.h"
+#include "TermAND.h"
+#include "TermDictionary.h"
+#include "TermReader.h"
+#include "core/mem_map_file.h"
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+using MsBetween = std::chrono::duration<double, std::milli>;
+
+namespace {
+
+std::vector<mithril::data::docid_t> Collect(mithril::IndexStreamReader& isr) {
+    std::vector<mithril::data::docid_t> doc_ids;
+    for (; isr.hasNext(); isr.moveNext()) {
+        doc_ids.push_back(isr.currentDocID());
+    }
+    return doc_ids;
+}
+
+// Runs the same query over the posting list and over the bitmap, checks both find the same documents
+bool Compare(const char* name,
+             const std::function<std::unique_ptr<mithril::IndexStreamReader>()>& from_postings,
+             const std::function<std::unique_ptr<mithril::IndexStreamReader>()>& from_bitmap) {
+    auto t0 = Clock::now();
+    const auto expected = Collect(*from_postings());
+    auto t1 = Clock::now();
+    const auto actual = Collect(*from_bitmap());
+    auto t2 = Clock::now();
+
+    std::cout << std::left << std::setw(12) << name << std::right << std::setw(10) << expected.size()
+              << " docs, postings " << std::fixed << std::setprecision(2) << MsBetween(t1 - t0).count()
+              << "ms, bitmap " << MsBetween(t2 - t1).count() << "ms" << std::endl;
+    if (expected != actual) {
+        std::cout << "MISMATCH: bitmap found " << actual.size() << " docs" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <index_directory> <dense_term> [sparse_term]" << std::endl;
+        return 1;
+    }
+
+    std::string index_dir = argv[1];
+    std::string term = argv[2];
+
+    try {
+        core::MemMapFile index_file(index_dir + "/final_index.data");
+        mithril::TermDictionary term_dict(index_dir);
+        mithril::PositionIndex position_index(index_dir);
+        mithril::DocumentMapReader doc_reader(index_dir);
+        mithril::DensePostings dense(index_dir);
+
+        const auto docs = dense.lookup(term);
+        if (!docs) {
+            std::cout << "Term '" << term << "' has no bitmap, " << dense.termCount() << " terms do" << std::endl;
+            return 1;
+        }
+        std::cout << "Term '" << term << "' is in " << docs->docCount() << " of " << doc_reader.documentCount()
+                  << " documents" << std::endl;
+
+        const auto postings = [&](const std::string& t) {
+            return std::make_unique<mithril::TermReader>(index_dir, t, index_file, term_dict, position_index);
+        };
+        const auto bitmap = [&] { return std::make_unique<mithril::DenseTermReader>(*docs); };
+
+        bool ok = Compare("term", [&] { return postings(term); }, bitmap);
+        ok &= Compare(
+            "NOT term",
+            [&] { return std::make_unique<mithril::NotISR>(postings(term), doc_reader.documentCount()); },
+            [&] { return std::make_unique<mithril::NotISR>(bitmap(), doc_reader.documentCount()); });
+
+        if (argc > 3) {
+            const std::string sparse = argv[3];
+            const auto make_and = [&](std::unique_ptr<mithril::IndexStreamReader> dense_reader) {
+                std::vector<std::unique_ptr<mithril::IndexStreamReader>> readers;
+                readers.push_back(postings(sparse));
+                readers.push_back(std::move(dense_reader));
+                return std::make_unique<mithril::TermAND>(std::move(readers));
+            };
+            ok &= Compare(
+                "AND sparse", [&] { return make_and(postings(term)); }, [&] { return make_and(bitmap()); });
+        }
+        return ok ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
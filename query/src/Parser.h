@@ -2,6 +2,8 @@
 #define GRAMMAR_H_
 
 #include "../../index/src/TextPreprocessor.h"
+#include "DeletionBitmap.h"
+#include "DensePostings.h"
 #include "Lexer.h"
 #include "PositionIndex.h"
 #include "Query.h"
@@ -28,11 +30,17 @@ public:
     explicit Parser(const std::string& input,
                     const core::MemMapFile& index_file,
                     TermDictionary& term_dict,
-                    PositionIndex& position_index)
+                    PositionIndex& position_index,
+                    const DeletionBitmap* deleted = nullptr,
+                    const DensePostings* dense = nullptr,
+                    const DocIDRange* doc_range = nullptr)
         : input_(input),
           index_file_(index_file),
           term_dict_(term_dict),
           position_index_(position_index),
+          deleted_(deleted),
+          dense_(dense),
+          doc_range_(doc_range),
           current_position_(0) {
         Lexer lexer(input);
         while (!lexer.EndOfInput()) {
@@ -126,7 +134,7 @@ private:
                     } else if (op == "OR") {
                         leftComponent = std::make_unique<OrQuery>(leftComponent.release(), rightComponent.release());
                     } else if (op == "NOT") {
-                        return std::make_unique<NotQuery>(rightComponent.release());
+                        return std::make_unique<NotQuery>(rightComponent.release(), deleted_, doc_range_);
                     }
                 }
                 // If there's no operator but we have another component, treat as implicit AND
@@ -153,7 +161,7 @@ private:
         // Handle NOT operator as a prefix
         if (matchOperator("NOT")) {
             auto operand = parseQueryComponent();
-            return std::make_unique<NotQuery>(operand.release());
+            return std::make_unique<NotQuery>(operand.release(), deleted_, doc_range_);
         }
 
         // Handle field expressions
@@ -167,7 +175,8 @@ private:
         if (match(TokenType::WORD) || match(TokenType::TITLE) || match(TokenType::URL) || match(TokenType::ANCHOR) ||
             match(TokenType::DESC)) {
             return std::make_unique<TermQuery>(
-                Token(tokens_[current_position_ - 1].type, tokens_[current_position_ - 1].value), index_file_, term_dict_, position_index_);
+                Token(tokens_[current_position_ - 1].type, tokens_[current_position_ - 1].value),
+                index_file_, term_dict_, position_index_, deleted_, dense_);
         }
 
         // Handle exact matches (quoted terms)
@@ -176,7 +185,7 @@ private:
             // return std::make_unique<PhraseQuery>(tokens_[current_position_ - 1].value);
             // For now, create a term query with the phrase content
             return std::make_unique<QuoteQuery>(
-                tokens_[current_position_ - 1], index_file_, term_dict_, position_index_);
+                tokens_[current_position_ - 1], index_file_, term_dict_, position_index_, deleted_);
             // return std::make_unique<QuoteQuery>(Token(TokenType::QUOTE, tokens_[current_position_ - 1]),
             //                                    index_file_, term_dict_, position_index_);
         }
@@ -186,7 +195,7 @@ private:
             // return std::make_unique<PhraseQuery>(tokens_[current_position_ - 1], index_file_, term_dict_,
             // position_index_);
             return std::make_unique<PhraseQuery>(
-                tokens_[current_position_ - 1], index_file_, term_dict_, position_index_);
+                tokens_[current_position_ - 1], index_file_, term_dict_, position_index_, deleted_);
         }
 
         // Handle grouped expressions
@@ -227,6 +236,9 @@ private:
     const core::MemMapFile& index_file_;
     TermDictionary& term_dict_;
     PositionIndex& position_index_;
+    const DeletionBitmap* deleted_;  // Documents every ISR of the query skips
+    const DensePostings* dense_;     // Bitmaps term ISRs match dense terms from
+    const DocIDRange* doc_range_;    // Documents NOT takes the complement within
     std::vector<Token> tokens_;
     size_t current_position_;
     std::unordered_map<std::string, int> token_mult;
@@ -80,19 +80,24 @@ public:
     // Optional: Get query type as string
     [[nodiscard]] virtual std::string get_type() const { return "Query"; }
 
+    // Whether a NOT appears anywhere in the tree, its matches are then not limited to documents holding query terms
+    [[nodiscard]] virtual bool contains_not() const { return false; }
+
 };
 
 class TermQuery : public Query {
 public:
     TermQuery(Token token, const core::MemMapFile& index_file,
-              mithril::TermDictionary& term_dict, mithril::PositionIndex& position_index)
+              mithril::TermDictionary& term_dict, mithril::PositionIndex& position_index,
+              const mithril::DeletionBitmap* deleted = nullptr,
+              const mithril::DensePostings* dense = nullptr)
         : token_(std::move(token)), index_file_(index_file),
-          term_dict_(term_dict), position_index_(position_index) {}
+          term_dict_(term_dict), position_index_(position_index), deleted_(deleted), dense_(dense) {}
 
     Token get_token() { return token_; }
 
     std::vector<uint32_t> evaluate() const override {
-        TermReaderFactory term_reader_factory(index_file_, term_dict_, position_index_);
+        TermReaderFactory term_reader_factory(index_file_, term_dict_, position_index_, deleted_, dense_);
         const auto field = mithril::detail::TokenTypeToField(token_.type);
         auto term = term_reader_factory.CreateISR(token_.value, field);
 
@@ -109,7 +114,7 @@ public:
     }
 
     [[nodiscard]] virtual std::unique_ptr<mithril::IndexStreamReader> generate_isr() const override {
-        TermReaderFactory term_reader_factory(index_file_, term_dict_, position_index_);
+        TermReaderFactory term_reader_factory(index_file_, term_dict_, position_index_, deleted_, dense_);
         const auto field = mithril::detail::TokenTypeToField(token_.type);
         return term_reader_factory.CreateISR(token_.value, field);
     }
@@ -126,6 +131,8 @@ private:
     const core::MemMapFile& index_file_;
     mithril::TermDictionary& term_dict_;
     mithril::PositionIndex& position_index_;
+    const mithril::DeletionBitmap* deleted_;
+    const mithril::DensePostings* dense_;
 };
 
 class AndQuery : public Query {
@@ -172,6 +179,8 @@ public:
     }
 
     [[nodiscard]] std::string get_type() const override { return "AndQuery"; }
+
+    [[nodiscard]] bool contains_not() const override { return left_->contains_not() || right_->contains_not(); }
 };
 
 class OrQuery : public Query {
@@ -218,15 +227,24 @@ public:
     }
 
     [[nodiscard]] std::string get_type() const override { return "OrQuery"; }
+
+    [[nodiscard]] bool contains_not() const override { return left_->contains_not() || right_->contains_not(); }
 };
 
 
 class NotQuery : public Query {
 public:
-    NotQuery(Query* expression)
+    // Without doc_range the complement is taken over [0, QueryConfig::GetMaxDocId())
+    NotQuery(Query* expression,
+             const mithril::DeletionBitmap* deleted = nullptr,
+             const mithril::DocIDRange* doc_range = nullptr)
         : expression_(expression),
-          not_isr_(std::make_unique<mithril::NotISR>(std::move(expression->generate_isr()),
-                                                     query::QueryConfig::GetMaxDocId())) {
+          deleted_(deleted),
+          doc_range_(doc_range != nullptr ? *doc_range
+                                          : mithril::DocIDRange{0, static_cast<mithril::data::docid_t>(
+                                                                       query::QueryConfig::GetMaxDocId())}),
+          not_isr_(std::make_unique<mithril::NotISR>(
+              std::move(expression->generate_isr()), doc_range_.end, deleted, doc_range_.begin)) {
         if (!expression) {
             std::cerr << "Need an expression for NOT query\n";
             exit(1);
@@ -237,10 +255,10 @@ public:
         // Get all documents that match the expression
         std::vector<uint32_t> expr_docs = expression_->evaluate();
         std::vector<uint32_t> all_docs;
-        all_docs.reserve(query::QueryConfig::GetMaxDocId() - expr_docs.size());
+        all_docs.reserve(doc_range_.end - doc_range_.begin);
 
-        // Generate all document IDs from 0 to max_doc_id
-        for (uint32_t i = 0; i < query::QueryConfig::GetMaxDocId(); i++) {
+        // Generate all document IDs of the index
+        for (uint32_t i = doc_range_.begin; i < doc_range_.end; i++) {
             all_docs.push_back(i);
         }
 
@@ -262,15 +280,20 @@ public:
     }
 
     [[nodiscard]] std::unique_ptr<mithril::IndexStreamReader> generate_isr() const override {
-        return std::make_unique<mithril::NotISR>(expression_->generate_isr(), query::QueryConfig::GetMaxDocId());
+        return std::make_unique<mithril::NotISR>(
+            expression_->generate_isr(), doc_range_.end, deleted_, doc_range_.begin);
     }
 
     [[nodiscard]] std::string to_string() const override { return "NOT(" + expression_->to_string() + ")"; }
 
     [[nodiscard]] std::string get_type() const override { return "NotQuery"; }
 
+    [[nodiscard]] bool contains_not() const override { return true; }
+
 private:
     Query* expression_;
+    const mithril::DeletionBitmap* deleted_;
+    mithril::DocIDRange doc_range_;
     std::unique_ptr<mithril::NotISR> not_isr_;
 };
 
@@ -280,11 +303,13 @@ public:
     QuoteQuery(Token quote_token,
                const core::MemMapFile& index_file,
                mithril::TermDictionary& term_dict,
-               mithril::PositionIndex& position_index)
+               mithril::PositionIndex& position_index,
+               const mithril::DeletionBitmap* deleted = nullptr)
         : quote_token_(std::move(quote_token)),
           index_file_(index_file),
           term_dict_(term_dict),
-          position_index_(position_index) {}
+          position_index_(position_index),
+          deleted_(deleted) {}
 
     std::vector<uint32_t> evaluate() const override { return {}; }
 
@@ -301,7 +326,8 @@ public:
             quote_terms,
             index_file_,
             term_dict_,
-            position_index_
+            position_index_,
+            deleted_
         );
     }
 
@@ -314,6 +340,7 @@ private:
     const core::MemMapFile& index_file_;
     mithril::TermDictionary& term_dict_;
     mithril::PositionIndex& position_index_;
+    const mithril::DeletionBitmap* deleted_;
 };
 
 class PhraseQuery : public Query {
@@ -321,11 +348,13 @@ public:
     PhraseQuery(Token phrase_token,
                const core::MemMapFile& index_file,
                mithril::TermDictionary& term_dict,
-               mithril::PositionIndex& position_index)
+               mithril::PositionIndex& position_index,
+               const mithril::DeletionBitmap* deleted = nullptr)
         : phrase_token_(std::move(phrase_token)),
           index_file_(index_file),
           term_dict_(term_dict),
-          position_index_(position_index) {}
+          position_index_(position_index),
+          deleted_(deleted) {}
 
     std::vector<uint32_t> evaluate() const override { return {}; }
 
@@ -342,7 +371,8 @@ public:
             phrase_terms,
             index_file_,
             term_dict_,
-            position_index_
+            position_index_,
+            deleted_
         );
     }
 
@@ -355,6 +385,7 @@ private:
     const core::MemMapFile& index_file_;
     mithril::TermDictionary& term_dict_;
     mithril::PositionIndex& position_index_;
+    const mithril::DeletionBitmap* deleted_;
 };
 
 #endif  // QUERY_H_
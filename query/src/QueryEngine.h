@@ -2,17 +2,23 @@
 #define QUERYENGINE_H
 
 #include "BM25.h"
+#include "BlockMaxWand.h"
+#include "DeletionBitmap.h"
+#include "DensePostings.h"
 #include "DocumentMapReader.h"
 #include "Parser.h"
 #include "PositionIndex.h"
 #include "Query.h"
 #include "QueryConfig.h"
 #include "TermDictionary.h"
+#include "TermReader.h"
+#include "TextPreprocessor.h"
 #include "core/mem_map_file.h"
 #include "spdlog/spdlog.h"
 
 #include <iostream>
 #include <memory>
+#include <utility>
 #include <vector>
 #include <spdlog/spdlog.h>
 
@@ -24,22 +30,25 @@ public:
         : map_reader_(index_dir),
           index_file_(index_dir + "/final_index.data"),
           term_dict_(index_dir),
-          position_index_(index_dir) {
+          position_index_(index_dir),
+          deleted_(index_dir),
+          dense_postings_(index_dir),
+          doc_range_{map_reader_.baseDocID(),
+                     static_cast<data::docid_t>(map_reader_.baseDocID() + map_reader_.slotCount())} {
         spdlog::info("about to make query engine for {}", index_dir);
         query::QueryConfig::SetIndexPath(index_dir);
-        query::QueryConfig::SetMaxDocId(map_reader_.documentCount());
         results_.reserve(1000);
         spdlog::info("about to make bm25 for {}", index_dir);
         BM25Lib_ = new ranking::BM25(index_dir);
     }
 
     auto ParseQuery(const std::string& input) -> std::unique_ptr<Query> {
-        Parser parser(input, index_file_, term_dict_, position_index_);
+        Parser parser(input, index_file_, term_dict_, position_index_, &deleted_, &dense_postings_, &doc_range_);
         return std::move(parser.parse());
     }
 
     std::vector<Token> GetTokens(const std::string& input) {
-        Parser parser(input, index_file_, term_dict_, position_index_);
+        Parser parser(input, index_file_, term_dict_, position_index_, &deleted_, &dense_postings_, &doc_range_);
         return parser.get_tokens();
     }
 
@@ -47,7 +56,9 @@ public:
 
         try {
             spdlog::info("🚀 Evaluating query: {}", input);
-            Parser parser(input, index_file_, term_dict_, position_index_);
+            // Picks up a deletion bitmap created since the last query, deletions within it are seen immediately
+            deleted_.refresh();
+            Parser parser(input, index_file_, term_dict_, position_index_, &deleted_, &dense_postings_, &doc_range_);
 
             auto queryTree = parser.parse();
             if (!queryTree) {
@@ -72,6 +83,78 @@ public:
         // return queryTree->evaluate();
     }
 
+    // Reader of one decorated term, for the scoring lists passed to EvaluateQueryTopK
+    std::unique_ptr<TermReader> GetTermReader(const std::string& term) {
+        return std::make_unique<TermReader>("", term, index_file_, term_dict_, position_index_, &deleted_);
+    }
+
+    // Reader whose currentFieldMask() holds the fields a plain term occurs in for each of its documents: its
+    // any-field list, or the description list in an index built without them, which only knows that field
+    std::unique_ptr<TermReader> GetFieldReader(const std::string& term) {
+        return GetTermReader(term_dict_.has_any_field_entries()
+                                 ? any_field_term(term)
+                                 : TokenNormalizer::decorateToken(term, FieldType::DESC));
+    }
+
+    // Reader of the champion list of a decorated term, nullptr when the term has none
+    std::unique_ptr<TermReader> GetChampionReader(const std::string& term) {
+        const std::string champion = champion_term(term);
+        if (!term_dict_.lookup(champion)) {
+            return nullptr;
+        }
+        return std::make_unique<TermReader>("", champion, index_file_, term_dict_, position_index_, &deleted_);
+    }
+
+    // Matches of the query with the k best scores over lists, sorted by doc ID, in one pass that skips documents
+    // and blocks that cannot make the top k (see BlockMaxWand.h). Every match of the query must appear in one of
+    // the lists, so queries with NOT, and calls without lists, collect all matches like EvaluateQuery(). matched
+    // is set to the number of matches seen. That is every match of the query when matched_exact is set, and a
+    // lower bound otherwise: once k matches are found, documents that can't beat them are skipped uncounted.
+    std::vector<uint32_t> EvaluateQueryTopK(const std::string& input,
+                                            std::vector<BlockMaxWand::List> lists,
+                                            size_t k,
+                                            size_t& matched,
+                                            bool& matched_exact) {
+        matched = 0;
+        matched_exact = true;
+        try {
+            deleted_.refresh();
+            Parser parser(input, index_file_, term_dict_, position_index_, &deleted_, &dense_postings_, &doc_range_);
+
+            auto queryTree = parser.parse();
+            if (!queryTree) {
+                std::cerr << "Failed to parse query: " << input << std::endl;
+                return {};
+            }
+            spdlog::info("⭐ Query structure: {}", queryTree->to_string());
+
+            auto isr = queryTree->generate_isr();
+            std::vector<uint32_t> results;
+            if (lists.empty() || queryTree->contains_not()) {
+                while (isr->hasNext()) {
+                    results.emplace_back(isr->currentDocID());
+                    isr->moveNext();
+                }
+                matched = results.size();
+                return results;
+            }
+
+            BlockMaxWand wand(std::move(lists), map_reader_, BM25Lib_->AverageBodyLength(), isr.get());
+            const auto top = wand.topK(k);
+            matched = wand.scoredDocuments();
+            // Nothing is skipped until k matches set a threshold to beat
+            matched_exact = top.size() < k;
+            results.reserve(top.size());
+            for (const auto& [doc, score] : top) {
+                results.push_back(doc);
+            }
+            return results;
+        } catch (const std::exception& e) {
+            spdlog::warn("Error evaluating query: {}", e.what());
+            return {};
+        }
+    }
+
     void DisplayTokens(const std::vector<Token>& tokens) const {
         std::cout << "Tokens:" << std::endl;
         for (size_t i = 0; i < tokens.size(); ++i) {
@@ -93,8 +176,24 @@ public:
         }
     }
 
-    std::optional<data::Document> GetDocument(uint32_t doc_id) const { return map_reader_.getDocument(doc_id); }
-    DocInfo GetDocumentInfo(uint32_t doc_id) const { return map_reader_.getDocInfo(doc_id); }
+    // Results leave the engine with the crawler's doc IDs, which only differ from the index's when it was built
+    // with another doc order
+    uint32_t GetCrawlDocID(uint32_t doc_id) const { return map_reader_.crawlDocID(doc_id); }
+    // Takes a crawl doc ID, as handed out in results
+    std::optional<data::Document> GetDocument(uint32_t crawl_doc_id) const {
+        const auto doc_id = map_reader_.lookupCrawlDocID(crawl_doc_id);
+        if (!doc_id) {
+            return std::nullopt;
+        }
+        auto doc = map_reader_.getDocument(*doc_id);
+        if (!doc) {
+            return std::nullopt;
+        }
+        doc->id = crawl_doc_id;
+        return doc;
+    }
+    std::optional<DocView> GetDocumentView(uint32_t doc_id) const { return map_reader_.getDocumentView(doc_id); }
+    const DocInfo& GetDocumentInfo(uint32_t doc_id) const { return map_reader_.getDocInfo(doc_id); }
 
     mithril::PositionIndex position_index_;
     mithril::TermDictionary term_dict_;
@@ -103,6 +202,9 @@ public:
 private:
     mithril::DocumentMapReader map_reader_;
     core::MemMapFile index_file_;
+    mithril::DeletionBitmap deleted_;
+    mithril::DensePostings dense_postings_;
+    mithril::DocIDRange doc_range_;  // This index's doc IDs, what NOT takes the complement within
     // mithril::TermDictionary term_dict_;
     std::vector<uint32_t> results_;
 };
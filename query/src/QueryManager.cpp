@@ -1,6 +1,8 @@
 #include "QueryManager.h"
 
+#include "DynamicRanker.h"
 #include "Ranker.h"
+#include "SegmentManifest.h"
 #include "TextPreprocessor.h"
 
 #include <algorithm>
@@ -9,6 +11,8 @@
 #include <mutex>
 #include <regex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <spdlog/spdlog.h>
 #include <vector>
 
@@ -27,12 +31,18 @@
 // Only 100,000 matches will be ranked per thread.
 #define RESULTS_HARD_CAP 100000
 
+// Matches with the best text scores each thread hands to the ranker, found without visiting every match
+#define RANKING_CANDIDATES 1000
+
 // Minimum rank before responding to stop ranking flag
 #define MINIMUM_RANKED_RESULTS_REQUIRED 100
 
 // The number of milliseconds before query manager tells threads to wrap up ranking
 #define SOFT_QUERY_TIMEOUT 250
 
+// How often the segment manifests are checked for appended or compacted segments
+#define SEGMENT_REFRESH_INTERVAL_SECONDS 5
+
 namespace mithril {
 using QueryResult_t = QueryManager::QueryResult;
 
@@ -41,6 +51,71 @@ static inline constexpr double GetMsBetween(auto t0, auto t1) {
     return duration.count();
 }
 
+// Lists scoring the additive text features of the dynamic ranker: BM25 of the body and query coverage of the
+// title, URL and description, each term weighted by its share of the query like GetFinalScore does. They cover
+// every field a term of the query matches in. Coverage comes from the field masks of a term's any-field list, or
+// from a list per field in indexes built without them. With champions, lists with a champion list are replaced by
+// it and usedChampions is set when any was. The any-field list of a term read from its champion list follows it,
+// so only champions become candidates.
+static std::vector<BlockMaxWand::List> GetScoringLists(QueryEngine& query_engine,
+                                                       const std::vector<std::pair<std::string, int>>& tokens,
+                                                       bool champions = false,
+                                                       bool* usedChampions = nullptr) {
+    // Whether the last list reader() returned is a champion list
+    bool lastWasChampion = false;
+    const auto reader = [&](const std::string& term) {
+        lastWasChampion = false;
+        if (champions) {
+            if (auto champion = query_engine.GetChampionReader(term)) {
+                lastWasChampion = true;
+                if (usedChampions != nullptr) {
+                    *usedChampions = true;
+                }
+                return champion;
+            }
+        }
+        return query_engine.GetTermReader(term);
+    };
+
+    std::unordered_map<std::string, int> multiplicity;
+    for (const auto& [term, count] : tokens) {
+        multiplicity[term] += count;
+    }
+
+    const auto& weights = ranking::dynamic::Weights;
+    std::vector<BlockMaxWand::List> lists;
+    for (const auto& [term, count] : multiplicity) {
+        const float share = static_cast<float>(count) / static_cast<float>(tokens.size());
+        // IDF comes from the full list, a champion list only holds part of it
+        const auto entry = query_engine.term_dict_.lookup(term);
+        const double idf = query_engine.BM25Lib_->CalculateIDF(entry ? entry->postings_count : 0);
+        lists.push_back({reader(term), weights.bm25 * share, idf, true});
+
+        if (query_engine.term_dict_.has_any_field_entries()) {
+            // Any-field lists have no champion lists
+            lists.push_back({query_engine.GetTermReader(any_field_term(term)),
+                             share,
+                             0.0,
+                             false,
+                             {{FIELD_FLAG_TITLE, weights.coverage_percent_query_title},
+                              {FIELD_FLAG_URL, weights.coverage_percent_query_url},
+                              {FIELD_FLAG_DESC, weights.coverage_percent_query_description}},
+                             lastWasChampion});
+            continue;
+        }
+        const std::pair<FieldType, float> fields[] = {
+            {FieldType::TITLE, weights.coverage_percent_query_title},
+            {FieldType::URL, weights.coverage_percent_query_url},
+            {FieldType::DESC, weights.coverage_percent_query_description},
+            {FieldType::ANCHOR, 0.0F},
+        };
+        for (const auto& [field, weight] : fields) {
+            lists.push_back({reader(TokenNormalizer::decorateToken(term, field)), weight * share, 0.0, false});
+        }
+    }
+    return lists;
+}
+
 QueryResult_t QueryManager::TopKElementsFast(QueryResult_t& results, int k) {
     auto comparator = [](const auto& a, const auto& b) {
         if (std::get<1>(a) != std::get<1>(b)) {
@@ -114,17 +189,56 @@ QueryResult_t QueryManager::TopKFromSortedLists(const std::vector<QueryResult_t>
 }
 
 QueryManager::QueryManager(const std::vector<std::string>& index_dirs)
-    : stop_(false), query_available_(index_dirs.size(), 0), worker_completion_count_(0), curr_result_ct_(0) {
-    const auto numWorkers = index_dirs.size();
-    marginal_results_.resize(numWorkers);
+    : stop_(false),
+      worker_completion_count_(0),
+      curr_result_ct_(0),
+      curr_result_ct_exact_(true),
+      index_dirs_(index_dirs) {
+    LoadEngines();
+}
+
+QueryManager::~QueryManager() {
+    StopWorkers();
+}
+
+void QueryManager::LoadEngines() {
+    // Engines of segments that are still live are kept, only new segments are loaded
+    std::unordered_map<std::string, std::unique_ptr<QueryEngine>> loaded;
+    for (size_t i = 0; i < query_engines_.size(); ++i) {
+        loaded.emplace(engine_dirs_[i], std::move(query_engines_[i]));
+    }
+    query_engines_.clear();
+    engine_dirs_.clear();
+
+    manifest_generations_.clear();
+    for (const auto& index_dir : index_dirs_) {
+        manifest_generations_.push_back(SegmentManifest::currentGeneration(index_dir));
+        for (auto& dir : SegmentManifest::segmentDirs(index_dir)) {
+            engine_dirs_.push_back(std::move(dir));
+        }
+    }
+
+    const auto numWorkers = engine_dirs_.size();
+    for (size_t i = 0; i < numWorkers; ++i) {
+        auto it = loaded.find(engine_dirs_[i]);
+        if (it != loaded.end()) {
+            query_engines_.push_back(std::move(it->second));
+            continue;
+        }
+        spdlog::info("Loading query engine {} at index directory {}", i, engine_dirs_[i]);
+        query_engines_.emplace_back(std::make_unique<QueryEngine>(engine_dirs_[i]));
+    }
+
+    marginal_results_.assign(numWorkers, {});
+    query_available_.assign(numWorkers, 0);
+    stop_ = false;
     for (size_t i = 0; i < numWorkers; ++i) {
-        spdlog::info("Loading query engine {} at index directory {}", i, index_dirs[i]);
-        query_engines_.emplace_back(std::make_unique<QueryEngine>(index_dirs[i]));
         threads_.emplace_back(&QueryManager::WorkerThread, this, i);
     }
+    last_refresh_check_ = std::chrono::steady_clock::now();
 }
 
-QueryManager::~QueryManager() {
+void QueryManager::StopWorkers() {
     // tell all workers to stop
     {
         std::scoped_lock lock{mtx_};
@@ -140,9 +254,38 @@ QueryManager::~QueryManager() {
             t.join();
         }
     }
+    threads_.clear();
+}
+
+void QueryManager::RefreshSegments() {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_refresh_check_ < std::chrono::seconds(SEGMENT_REFRESH_INTERVAL_SECONDS)) {
+        return;
+    }
+    last_refresh_check_ = now;
+
+    bool changed = false;
+    for (size_t i = 0; i < index_dirs_.size(); ++i) {
+        changed |= SegmentManifest::currentGeneration(index_dirs_[i]) != manifest_generations_[i];
+    }
+    if (!changed) {
+        return;
+    }
+
+    // Workers index into query_engines_, so they are stopped while it changes. Queries are answered one at a time,
+    // none is running here.
+    spdlog::info("Segments changed, reloading query engines");
+    StopWorkers();
+    LoadEngines();
+    spdlog::info("Serving {} segments", query_engines_.size());
 }
 
 QueryResult_t QueryManager::AnswerQuery(const std::string& query) {
+    RefreshSegments();
+    if (query_engines_.empty()) {
+        return {};
+    }
+
     // prepare new query
     stop_ranking_.clear();
 
@@ -151,6 +294,7 @@ QueryResult_t QueryManager::AnswerQuery(const std::string& query) {
     {
         std::scoped_lock lock{mtx_};
         curr_result_ct_ = 0;
+        curr_result_ct_exact_ = true;
         current_query_ = query;
         worker_completion_count_ = 0;
         for (auto& result : marginal_results_) {
@@ -214,13 +358,30 @@ void QueryManager::WorkerThread(size_t worker_id) {
             queryToRun = current_query_;
         }
 
-        // Evaluate query over this thread's index
+        // Evaluate query over this thread's index, keeping only the matches worth ranking
         const auto t0 = std::chrono::high_resolution_clock::now();
-        auto result = query_engines_[worker_id]->EvaluateQuery(queryToRun);
+        std::vector<int> nonstopwordIdx;
+        std::vector<int> stopwordIdx;
+        const auto tokens = ranking::TokenifyQuery(queryToRun, stopwordIdx, nonstopwordIdx);
+        size_t totalSize = 0;
+        bool totalExact = true;
+        QueryEngine& engine = *query_engines_[worker_id];
+        bool usedChampions = false;
+        auto result = engine.EvaluateQueryTopK(queryToRun,
+                                               GetScoringLists(engine, tokens, champion_tier_first_, &usedChampions),
+                                               RANKING_CANDIDATES,
+                                               totalSize,
+                                               totalExact);
+        // The champion tier only answers on its own when it fills every candidate slot
+        if (usedChampions && result.size() < RANKING_CANDIDATES) {
+            spdlog::info(
+                "Query engine {} found {} champion matches, falling back to full lists", worker_id, result.size());
+            result = engine.EvaluateQueryTopK(
+                queryToRun, GetScoringLists(engine, tokens), RANKING_CANDIDATES, totalSize, totalExact);
+        }
         const auto t1 = std::chrono::high_resolution_clock::now();
         spdlog::info("Query engine {} matched query in {:.3f} ms", worker_id, GetMsBetween(t0,t1));
 
-        auto totalSize = result.size();
         QueryResult_t rankedResults = {};
         if (!result.empty()) {
             rankedResults = HandleRanking(queryToRun, worker_id, result);
@@ -232,6 +393,7 @@ void QueryManager::WorkerThread(size_t worker_id) {
         {
             std::scoped_lock lock{mtx_};
             curr_result_ct_ += totalSize;
+            curr_result_ct_exact_ = curr_result_ct_exact_ && totalExact;
             marginal_results_[worker_id] = std::move(rankedResults);
             ++worker_completion_count_;  // TODO: change this to std::atomic increment?
 
@@ -246,28 +408,38 @@ void QueryManager::WorkerThread(size_t worker_id) {
     }
 }
 
-void QueryManager::SetupPositionIndexPointers(QueryEngine* query_engine,
-                                              std::unordered_map<std::string, const char*>& termToPointer,
-                                              const std::vector<std::pair<std::string, int>>& tokens) {
+void QueryManager::SetupPositionCursors(QueryEngine* query_engine,
+                                        std::unordered_map<std::string, PositionCursor>& termToCursor,
+                                        const std::vector<std::pair<std::string, int>>& tokens) {
     for (const auto& token : tokens) {
         if (StopwordFilter::isStopword(token.first)) {
             continue;
         }
 
-        const char* data = query_engine->position_index_.data_file_.data();
+        termToCursor.try_emplace(token.first, query_engine->position_index_.cursor(token.first));
+    }
+}
 
-        auto it = query_engine->position_index_.posDict_.find(token.first);
-        if (it != query_engine->position_index_.posDict_.end()) {
-            termToPointer[token.first] = data + (it->second.data_offset);
+void QueryManager::SetupFieldReaders(QueryEngine* query_engine,
+                                     std::unordered_map<std::string, std::unique_ptr<TermReader>>& termToFieldReader,
+                                     const std::vector<std::pair<std::string, int>>& tokens) {
+    for (const auto& token : tokens) {
+        if (StopwordFilter::isStopword(token.first) || termToFieldReader.contains(token.first)) {
+            continue;
         }
+        termToFieldReader.emplace(token.first, query_engine->GetFieldReader(token.first));
+    }
+}
 
-        std::string descToken = mithril::TokenNormalizer::decorateToken(token.first, FieldType::DESC);
-        it = query_engine->position_index_.posDict_.find(descToken);
-        if (it != query_engine->position_index_.posDict_.end()) {
-            termToPointer[descToken] = data + (it->second.data_offset);
-        }
+void QueryManager::GetTermFields(std::unordered_map<std::string, std::unique_ptr<TermReader>>& termToFieldReader,
+                                 uint32_t doc,
+                                 std::unordered_map<std::string, uint8_t>& termFields) {
+    for (auto& [term, reader] : termToFieldReader) {
+        reader->seekToDocID(doc);
+        termFields[term] = reader->hasNext() && reader->currentDocID() == doc ? reader->currentFieldMask() : 0;
     }
 }
+
 /**
     Assumes matches is sorted by DOCID.
 */
@@ -277,8 +449,9 @@ QueryResult_t QueryManager::HandleRanking(const std::string& query, size_t worke
         return {};
     }
 
-    QueryResult_t rankedMatches;
-    rankedMatches.reserve(matches.size());
+    // {doc id, score}, URLs and titles are only copied out for the top results
+    std::vector<std::pair<uint32_t, uint32_t>> scoredMatches;
+    scoredMatches.reserve(matches.size());
 
     auto& queryEngine = query_engines_[worker_id];
 
@@ -286,8 +459,11 @@ QueryResult_t QueryManager::HandleRanking(const std::string& query, size_t worke
     std::vector<int> stopwordIdx;
     std::vector<std::pair<std::string, int>> tokens = ranking::TokenifyQuery(query, stopwordIdx, nonstopwordIdx);
     std::unordered_map<std::string, uint32_t> map = ranking::GetDocumentFrequencies(queryEngine->term_dict_, tokens);
-    std::unordered_map<std::string, const char*> termToPointer;
-    SetupPositionIndexPointers(queryEngine.get(), termToPointer, tokens);
+    std::unordered_map<std::string, PositionCursor> termToCursor;
+    SetupPositionCursors(queryEngine.get(), termToCursor, tokens);
+    std::unordered_map<std::string, std::unique_ptr<TermReader>> termToFieldReader;
+    SetupFieldReaders(queryEngine.get(), termToFieldReader, tokens);
+    std::unordered_map<std::string, uint8_t> termFields;
 
     bool shortCircuit = matches.size() > RESULTS_REQUIRED_TO_SHORTCIRCUIT;
     uint32_t resultsCollectedAboveMin = 0;
@@ -304,30 +480,31 @@ QueryResult_t QueryManager::HandleRanking(const std::string& query, size_t worke
             break;
         }
 
-        const std::optional<data::Document>& docOpt = queryEngine->GetDocument(match);
+        const std::optional<DocView> docOpt = queryEngine->GetDocumentView(match);
         if (!docOpt.has_value()) {
-            rankedMatches.push_back({match, 0, "", {}, {}});
+            scoredMatches.emplace_back(match, 0);
             continue;
         }
 
-        const data::Document& doc = docOpt.value();
-        const DocInfo& docInfo = queryEngine->GetDocumentInfo(match);
+        const DocView& doc = docOpt.value();
+        const DocInfo& docInfo = *doc.info;
 
         if (ranking::ContainsPornKeywords(doc.title) || ranking::ContainsPornKeywords(doc.url)) {
             continue;
         }
 
+        GetTermFields(termToFieldReader, match, termFields);
         uint32_t score = ranking::GetFinalScore(queryEngine->BM25Lib_,
                                                 tokens,
                                                 stopwordIdx,
                                                 nonstopwordIdx,
                                                 doc,
                                                 docInfo,
-                                                queryEngine->position_index_,
                                                 map,
-                                                termToPointer);
+                                                termToCursor,
+                                                termFields);
 
-        rankedMatches.push_back({match, score, doc.url, doc.title, {}});
+        scoredMatches.emplace_back(match, score);
 
         if (shortCircuit && score >= SCORE_FOR_SHORTCIRCUIT_REQUIRED) {
             resultsCollectedAboveMin += 1;
@@ -354,7 +531,37 @@ QueryResult_t QueryManager::HandleRanking(const std::string& query, size_t worke
         }
     }
 
-    return TopKElementsFast(rankedMatches);
+    // Same order as TopKElementsFast: score descending, then doc id descending
+    const size_t k = std::min<size_t>(50, scoredMatches.size());
+    std::partial_sort(
+        scoredMatches.begin(), scoredMatches.begin() + k, scoredMatches.end(), [](const auto& a, const auto& b) {
+            if (a.second != b.second) {
+                return a.second > b.second;
+            }
+            return a.first > b.first;
+        });
+
+    QueryResult_t rankedMatches;
+    rankedMatches.reserve(k);
+    for (size_t i = 0; i < k; ++i) {
+        const auto [match, score] = scoredMatches[i];
+        const std::optional<DocView> doc = queryEngine->GetDocumentView(match);
+        if (!doc.has_value()) {
+            rankedMatches.push_back({match, score, "", {}, {}});
+            continue;
+        }
+
+        std::vector<std::string> title;
+        title.reserve(doc->titleTokenCount());
+        for (size_t t = 0; t < doc->titleTokenCount(); ++t) {
+            title.emplace_back(doc->titleToken(t));
+        }
+        // Results carry crawl doc IDs, documents are looked up by them from here on
+        const uint32_t crawlDocId = queryEngine->GetCrawlDocID(match);
+        rankedMatches.push_back({crawlDocId, score, std::string(doc->url), std::move(title), {}});
+    }
+
+    return rankedMatches;
 }
 
 }  // namespace mithril
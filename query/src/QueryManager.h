@@ -14,6 +14,8 @@
 
 #include "QueryEngine.h"
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
 #include <memory>
@@ -38,7 +40,8 @@ public:
     /**
      * @brief Construct a new Query Manager object
      *
-     * @param index_dirs; spawns a worker thread to serve each index
+     * @param index_dirs; spawns a worker thread to serve each index, or each segment of a segmented index. Segments
+     * published or compacted later are picked up between queries.
      */
     QueryManager(const std::vector<std::string>& index_dirs);
 
@@ -55,18 +58,38 @@ public:
      */
     QueryResult AnswerQuery(const std::string& query);
 
+    /**
+     * @brief Answer from the champion lists of common terms first, falling back to their full lists only when the
+     * champions can't fill the ranking candidates. Faster on common terms, but a match outside every champion list
+     * is only found by the fallback.
+     */
+    void SetChampionTierFirst(bool enabled) { champion_tier_first_ = enabled; }
+
     std::vector<std::unique_ptr<QueryEngine>> query_engines_;
 
+    // Matches of the last query over every segment. Segments that ranked with Block-Max WAND only count the
+    // documents they scored, so unless curr_result_ct_exact_ it is a lower bound.
     size_t curr_result_ct_;
+    bool curr_result_ct_exact_;
 
     static QueryResult TopKElementsFast(QueryResult& results, int k = 50);
     static QueryResult TopKFromSortedLists(const std::vector<QueryResult>& sortedLists, size_t k = 50);
-    static void SetupPositionIndexPointers(QueryEngine* query_engine,
-                                           std::unordered_map<std::string, const char*>& termToPointer,
-                                           const std::vector<std::pair<std::string, int>>& tokens);
+    static void SetupPositionCursors(QueryEngine* query_engine,
+                                     std::unordered_map<std::string, PositionCursor>& termToCursor,
+                                     const std::vector<std::pair<std::string, int>>& tokens);
+    static void SetupFieldReaders(QueryEngine* query_engine,
+                                  std::unordered_map<std::string, std::unique_ptr<TermReader>>& termToFieldReader,
+                                  const std::vector<std::pair<std::string, int>>& tokens);
+    // Sets the FIELD_FLAG_* bits of each term in doc, readers are only moved forward
+    static void GetTermFields(std::unordered_map<std::string, std::unique_ptr<TermReader>>& termToFieldReader,
+                              uint32_t doc,
+                              std::unordered_map<std::string, uint8_t>& termFields);
 
 private:
     void WorkerThread(size_t worker_id);
+    void LoadEngines();
+    void StopWorkers();
+    void RefreshSegments();
     QueryResult HandleRanking(const std::string& query, size_t worker_id, std::vector<uint32_t>& matches);
 
     std::vector<std::thread> threads_;
@@ -82,6 +105,12 @@ private:
     size_t worker_completion_count_;
 
     std::atomic_flag stop_ranking_;
+    bool champion_tier_first_{false};
+
+    std::vector<std::string> index_dirs_;
+    std::vector<uint64_t> manifest_generations_;  // Per entry of index_dirs_, 0 without a manifest
+    std::vector<std::string> engine_dirs_;        // Directory served by each query engine
+    std::chrono::steady_clock::time_point last_refresh_check_;
 };
 
 }  // namespace mithril
@@ -1,6 +1,9 @@
 #ifndef INTERSECT_H
 #define INTERSECT_H
 
+#include "PostingIntersect.h"
+
+#include <algorithm>
 #include <cstdint>
 #include <vector>
 
@@ -31,6 +34,24 @@ inline std::vector<uint32_t> intersect_simple(const std::vector<uint32_t>& a, co
     return result;
 }
 
+// Intersection galloping through the longer array for each element of the shorter one
+// Time complexity: O(m log(n / m)) where m <= n are the sizes of the arrays
+inline std::vector<uint32_t> intersect_gallop(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    std::vector<uint32_t> result(std::min(a.size(), b.size()));
+    result.resize(mithril::PostingIntersect::intersect_gallop(a.data(), a.size(), b.data(), b.size(), result.data()));
+    return result;
+}
+
+// Intersection comparing groups of 4 or 8 elements at once with the fastest kernel the CPU supports
+// Time complexity: O(m + n) where m and n are the sizes of the arrays
+inline std::vector<uint32_t> intersect_simd(const std::vector<uint32_t>& a,
+                                            const std::vector<uint32_t>& b,
+                                            mithril::DecodeKernel kernel = mithril::StreamVByte::best_kernel()) {
+    std::vector<uint32_t> result(std::min(a.size(), b.size()));
+    result.resize(mithril::PostingIntersect::intersect(a.data(), a.size(), b.data(), b.size(), result.data(), kernel));
+    return result;
+}
+
 // Union of two sorted arrays - returns sorted array with no duplicates
 // Time complexity: O(m + n) where m and n are the sizes of the arrays
 inline std::vector<uint32_t> union_simple(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
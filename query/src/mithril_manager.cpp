@@ -15,6 +15,8 @@ void printUsage(const char* programName) {
     std::cout << "Options:" << std::endl;
     std::cout << "  --port PORT                Set the server port (required)" << std::endl;
     std::cout << "  --index INDEX_PATH         Set an index path (at least one required)" << std::endl;
+    std::cout << "  --champion-tier            Answer from champion lists first, full lists when they fall short"
+              << std::endl;
 }
 
 struct MithrilManager {
@@ -66,7 +68,7 @@ public:
         }
     }
 
-    MithrilManager(int port, const std::vector<std::string>& indexPaths) {
+    MithrilManager(int port, const std::vector<std::string>& indexPaths, bool championTier) {
         if (indexPaths.empty()) {
             throw std::runtime_error("At least one index path is required");
         }
@@ -83,6 +85,7 @@ public:
         }
 
         manager = std::make_unique<QueryManager>(indexPaths);
+        manager->SetChampionTierFirst(championTier);
 
         std::cout << "Successfully created MithrilManager" << std::endl;
     }
@@ -131,6 +134,7 @@ int main(int argc, char** argv) {
         int port = -1;
         std::vector<std::string> indexPaths;
         std::string conf_file;
+        bool championTier = false;
         // Parse command line arguments
         for (int i = 1; i < argc; ++i) {
             std::string arg = argv[i];
@@ -139,6 +143,8 @@ int main(int argc, char** argv) {
                 port = std::stoi(argv[++i]);
             } else if (arg == "--index" && i + 1 < argc) {
                 indexPaths.push_back(argv[++i]);
+            } else if (arg == "--champion-tier") {
+                championTier = true;
             } else if (arg == "--conf" && i + 1 < argc) {
                 conf_file = argv[++i];
                 std::tie(port, indexPaths) = parseConfFile(conf_file);
@@ -157,7 +163,7 @@ int main(int argc, char** argv) {
             return 1;
         }
 
-        MithrilManager mm(port, indexPaths);
+        MithrilManager mm(port, indexPaths, championTier);
         mm.Listen();
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
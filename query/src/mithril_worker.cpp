@@ -42,6 +42,9 @@ void handle_binary_query(int client_fd, QueryEngine& query_engine) {
 
         // 3. Execute query
         auto results = query_engine.EvaluateQuery(query);
+        for (auto& doc_id : results) {
+            doc_id = query_engine.GetCrawlDocID(doc_id);
+        }
 
         // 4. Send result count
         uint32_t result_count = results.size();
@@ -0,0 +1,176 @@
+#include "IndexStreamReader.h"
+#include "PostingBlock.h"
+#include "PostingIntersect.h"
+#include "TermAND.h"
+#include "intersect.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+using MsBetween = std::chrono::duration<double, std::milli>;
+
+namespace {
+
+// Posting list held in memory and read a block at a time like TermReader: seeks gallop over the blocks' last doc
+// IDs, then inside the block. With blocks off it hides its buffered doc IDs, so TermAND can only seek.
+class VectorReader : public mithril::IndexStreamReader {
+public:
+    VectorReader(const std::vector<uint32_t>& doc_ids, bool blocks) : doc_ids_(doc_ids), blocks_(blocks) {
+        for (size_t start = 0; start < doc_ids_.size(); start += BLOCK_SIZE) {
+            block_last_.push_back(doc_ids_[std::min(start + BLOCK_SIZE, doc_ids_.size()) - 1]);
+        }
+    }
+
+    bool hasNext() const override { return pos_ < doc_ids_.size(); }
+    void moveNext() override { ++pos_; }
+    mithril::data::docid_t currentDocID() const override { return doc_ids_[pos_]; }
+
+    void seekToDocID(mithril::data::docid_t target) override {
+        if (!hasNext() || doc_ids_[pos_] >= target) {
+            return;
+        }
+        const uint32_t* block_begin = block_last_.data();
+        const uint32_t* block_end = block_begin + block_last_.size();
+        const size_t block =
+            mithril::PostingIntersect::gallop(block_begin + pos_ / BLOCK_SIZE, block_end, target) - block_begin;
+        if (block == block_last_.size()) {
+            pos_ = doc_ids_.size();
+            return;
+        }
+        const uint32_t* begin = doc_ids_.data() + std::max(pos_, block * BLOCK_SIZE);
+        const uint32_t* end = doc_ids_.data() + std::min((block + 1) * BLOCK_SIZE, doc_ids_.size());
+        pos_ = mithril::PostingIntersect::gallop(begin, end, target) - doc_ids_.data();
+    }
+
+    size_t bufferedDocIDs(const mithril::data::docid_t*& doc_ids) const override {
+        if (!blocks_ || !hasNext()) {
+            return 0;
+        }
+        doc_ids = doc_ids_.data() + pos_;
+        return std::min((pos_ / BLOCK_SIZE + 1) * BLOCK_SIZE, doc_ids_.size()) - pos_;
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = mithril::PostingBlockCodec::BLOCK_SIZE;
+    const std::vector<uint32_t>& doc_ids_;
+    const bool blocks_;
+    std::vector<uint32_t> block_last_;
+    size_t pos_{0};
+};
+
+// Sorted list of count distinct doc IDs drawn uniformly from [0, universe)
+std::vector<uint32_t> GenerateList(size_t count, uint32_t universe, std::mt19937& rng) {
+    std::uniform_int_distribution<uint32_t> doc(0, universe - 1);
+    std::vector<uint32_t> list;
+    while (list.size() < count) {
+        // Draws collide, keep drawing until there are enough distinct ones
+        const size_t missing = count - list.size();
+        for (size_t i = 0; i < missing + missing / 8; ++i) {
+            list.push_back(doc(rng));
+        }
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    }
+    std::shuffle(list.begin(), list.end(), rng);
+    list.resize(count);
+    std::sort(list.begin(), list.end());
+    return list;
+}
+
+std::vector<uint32_t> CollectAND(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, bool blocks) {
+    std::vector<std::unique_ptr<mithril::IndexStreamReader>> readers;
+    readers.push_back(std::make_unique<VectorReader>(a, blocks));
+    readers.push_back(std::make_unique<VectorReader>(b, blocks));
+    mithril::TermAND isr(std::move(readers));
+    std::vector<uint32_t> result;
+    for (; isr.hasNext(); isr.moveNext()) {
+        result.push_back(isr.currentDocID());
+    }
+    return result;
+}
+
+// Best of rounds, in ms
+double Time(int rounds, const std::function<size_t()>& run, size_t& checksum) {
+    double best = 1e300;
+    for (int r = 0; r < rounds; ++r) {
+        const auto t0 = Clock::now();
+        checksum += run();
+        best = std::min(best, MsBetween(Clock::now() - t0).count());
+    }
+    return best;
+}
+
+}  // namespace
+
+// Intersects a long list with shorter ones of decreasing length, through the intersect.h helpers and through
+// TermAND over block readers with and without the block kernel
+int main(int argc, char* argv[]) {
+    size_t long_size = 2000000;
+    int rounds = 5;
+    if (argc > 1) {
+        long_size = std::stoul(argv[1]);
+    }
+    if (argc > 2) {
+        rounds = std::stoi(argv[2]);
+    }
+
+    const uint32_t universe = static_cast<uint32_t>(long_size * 4);
+    std::mt19937 rng(498);
+    const auto long_list = GenerateList(long_size, universe, rng);
+    std::cout << "Long list of " << long_size << " doc IDs out of " << universe << ", best of " << rounds
+              << " rounds, kernel " << mithril::DecodeKernelName(mithril::StreamVByte::best_kernel()) << std::endl;
+
+    struct Method {
+        const char* name;
+        std::function<std::vector<uint32_t>(const std::vector<uint32_t>&, const std::vector<uint32_t>&)> run;
+    };
+    const std::vector<Method> methods = {
+        {"intersect_simple", intersect_simple},
+        {"intersect_gallop", intersect_gallop},
+        {"intersect_simd scalar",
+         [](const auto& a, const auto& b) { return intersect_simd(a, b, mithril::DecodeKernel::Scalar); }},
+        {"intersect_simd", [](const auto& a, const auto& b) { return intersect_simd(a, b); }},
+        {"TermAND seeking", [](const auto& a, const auto& b) { return CollectAND(a, b, false); }},
+        {"TermAND blocks", [](const auto& a, const auto& b) { return CollectAND(a, b, true); }},
+    };
+
+    std::cout << std::left << std::setw(10) << "ratio" << std::setw(24) << "method" << std::right << std::setw(12)
+              << "ms" << std::setw(12) << "matches" << std::endl;
+
+    size_t checksum = 0;
+    bool ok = true;
+    for (const size_t ratio : {1, 4, 32, 1000}) {
+        const auto short_list = GenerateList(long_size / ratio, universe, rng);
+        const auto expected = intersect_simple(short_list, long_list);
+
+        for (const auto& method : methods) {
+            std::vector<uint32_t> result;
+            const double ms = Time(
+                rounds,
+                [&] {
+                    result = method.run(short_list, long_list);
+                    return result.size();
+                },
+                checksum);
+            if (result != expected) {
+                std::cout << "MISMATCH: " << method.name << " at 1:" << ratio << std::endl;
+                ok = false;
+            }
+            std::cout << std::left << std::setw(10) << ("1:" + std::to_string(ratio)) << std::setw(24) << method.name
+                      << std::right << std::setw(12) << std::fixed << std::setprecision(3) << ms << std::setw(12)
+                      << result.size() << std::endl;
+        }
+    }
+
+    std::cout << "(checksum " << checksum << ")" << std::endl;
+    return ok ? 0 : 1;
+}
@@ -17,18 +17,20 @@ public:
     // Score a single term for a document
     double ScoreTermForDoc(const data::DocInfo& doc_info, uint32_t docFreq, size_t termFreq);
 
+    double CalculateIDF(uint32_t doc_freq) const;
+    double AverageBodyLength() const { return average_body_length_; }
+
 private:
     // Index stats
     uint32_t doc_count_{0};
     double average_body_length_;
 
-    // BM25F parameters
-    double k1_{1.2};
-    double b_ = 0.75;
+    // BM25F parameters, shared with the block impacts of the index
+    double k1_{BM25_K1};
+    double b_ = BM25_B;
 
     // Helper methods
     void LoadIndexStats(const std::string& index_dir);
-    double CalculateIDF(uint32_t doc_freq) const;
 
     // Helper to get field lengths from DocInfo
     static uint32_t GetFieldLength(const DocInfo& doc_info, FieldType field);
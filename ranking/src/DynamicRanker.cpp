@@ -2,6 +2,10 @@
 
 #include "spdlog/sinks/basic_file_sink.h"
 
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <string_view>
 #include <spdlog/spdlog.h>
 
 #define LOGGING 1
@@ -71,22 +75,20 @@ void Log(const RankerFeatures& features, float total, uint32_t normalizedScore)
 };  // namespace
 
 
-float OrderedMatchScore(const std::vector<std::pair<std::string, int>>& qTokens,
-                        const std::vector<std::string>& tTokens) {
-    auto startsWith = [](const std::string& prefix, const std::string& word) -> bool {
-        return word.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), word.begin());
+float OrderedMatchScore(const std::vector<std::pair<std::string, int>>& qTokens, const DocView& doc) {
+    // Whether the lowered title token is a prefix of word
+    auto startsWith = [](std::string_view prefix, const std::string& word) -> bool {
+        return word.size() >= prefix.size() &&
+               std::equal(prefix.begin(), prefix.end(), word.begin(), [](char p, char w) {
+                   return static_cast<char>(std::tolower(static_cast<unsigned char>(p))) == w;
+               });
     };
 
     int qLen = (int)qTokens.size();
     int qIdx = 0;
 
-    for (const auto& token : tTokens) {
-        std::string loweredToken;
-        for (char c : token) {
-            loweredToken += std::tolower(c);
-        }
-
-        if (qIdx < qLen && startsWith(loweredToken, qTokens[qIdx].first)) {
+    for (size_t i = 0; i < doc.titleTokenCount(); ++i) {
+        if (qIdx < qLen && startsWith(doc.titleToken(i), qTokens[qIdx].first)) {
             qIdx++;
         }
     }
@@ -1,5 +1,6 @@
 #ifndef RANKING_RANKER_H
 #define RANKING_RANKER_H
+#include "DocumentMapReader.h"
 #include "core/config.h"
 #include <vector>
 namespace mithril::ranking::dynamic {
@@ -77,7 +78,6 @@ static inline const float MaxScore =
 static inline const float ScoreRange = MaxScore - MinScore;
 
 uint32_t GetUrlDynamicRank(const RankerFeatures& features);
-float OrderedMatchScore(const std::vector<std::pair<std::string, int>>& qTokens,
-                        const std::vector<std::string>& tTokens);
+float OrderedMatchScore(const std::vector<std::pair<std::string, int>>& qTokens, const DocView& doc);
 }  // namespace mithril::ranking::dynamic
 #endif
\ No newline at end of file
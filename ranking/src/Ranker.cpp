@@ -15,7 +15,9 @@
 #include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -26,18 +28,21 @@
 namespace mithril::ranking {
 
 namespace {
-int CountWordOccurrences(const std::string& text, const std::string& word) {
-    int count = 0;
-    std::string tempText = text;
-    std::string tempWord = word;
-
-    std::transform(tempText.begin(), tempText.end(), tempText.begin(), ::tolower);
-    std::transform(tempWord.begin(), tempWord.end(), tempWord.begin(), ::tolower);
+// Case insensitive count of non-overlapping occurrences, compares in place instead of lowering copies
+int CountWordOccurrences(std::string_view text, std::string_view word) {
+    auto equalsIgnoreCase = [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    };
 
-    size_t position = tempText.find(tempWord, 0);
-    while (position != std::string::npos) {
-        count++;
-        position = tempText.find(tempWord, position + tempWord.length());
+    int count = 0;
+    size_t position = 0;
+    while (position + word.size() <= text.size()) {
+        if (std::equal(word.begin(), word.end(), text.begin() + position, equalsIgnoreCase)) {
+            count++;
+            position += word.size();
+        } else {
+            position++;
+        }
     }
     return count;
 }
@@ -67,20 +72,22 @@ uint32_t GetFinalScore(BM25* BM25Lib,
                        const std::vector<std::pair<std::string, int>>& query,
                        const std::vector<int>& stopwordIdx,
                        const std::vector<int>& nonstopwordIdx,
-                       const data::Document& doc,
+                       const DocView& doc,
                        const data::DocInfo& info,
-                       const PositionIndex& position_index,
                        const std::unordered_map<std::string, uint32_t>& termFreq,
-                       std::unordered_map<std::string, const char*>& termToData) {
+                       std::unordered_map<std::string, PositionCursor>& termToCursor,
+                       const std::unordered_map<std::string, uint8_t>& termFields) {
 
     auto logger = spdlog::get("ranker_logger");
     if (!logger) {
         logger = spdlog::basic_logger_mt("ranker_logger", "ranker.log");
     }
 
-    std::string title;
-    for (const auto& term : doc.title) {
-        title += term;
+    // Reused across calls so scoring a document does not allocate
+    static thread_local std::string title;
+    title.clear();
+    for (size_t i = 0; i < doc.titleTokenCount(); ++i) {
+        title += doc.titleToken(i);
     }
     std::transform(title.begin(), title.end(), title.begin(), [](unsigned char c) { return std::tolower(c); });
 
@@ -90,7 +97,7 @@ uint32_t GetFinalScore(BM25* BM25Lib,
     bool isInBody = true;
 
 #if LOGGING == 1
-    logger->info("[{}] Query: {}, URL: {}, Title: {}", doc.id, query[0].first, doc.url, title);
+    logger->info("[{}] Query: {}, URL: {}, Title: {}", doc.id(), query[0].first, doc.url, title);
 #endif
 
     float totalTermsSize = (float)query.size();
@@ -112,7 +119,6 @@ uint32_t GetFinalScore(BM25* BM25Lib,
 
     int nonstopwordFound = 0;
 
-    std::unordered_map<std::string, const char*> newTermToData = termToData;
     const auto* vector = &nonstopwordIdx;
 
     while (true) {
@@ -120,26 +126,21 @@ uint32_t GetFinalScore(BM25* BM25Lib,
             bool found = false;
             const auto& [term, multiplicity] = query[idx];
 
-            std::vector<uint16_t> bodyPositions;
+            std::span<const uint16_t> bodyPositions;
             bool termInDescription = false;
 
             // Get body positions
-            if (auto it = termToData.find(term); it != termToData.end()) {
-                auto bodyPositionsIndex = position_index.getPositionsFromByte(it->second, term, doc.id);
-                newTermToData[term] = bodyPositionsIndex.second;
-                bodyPositions = std::move(bodyPositionsIndex.first);
+            if (auto it = termToCursor.find(term); it != termToCursor.end() && it->second.seekTo(doc.id())) {
+                bodyPositions = it->second.positions();
             }
 
             // Check whether term in description
-            std::string descToken = mithril::TokenNormalizer::decorateToken(term, FieldType::DESC);
-            if (auto it = termToData.find(descToken); it != termToData.end()) {
-                auto termInDescriptionIndex = position_index.hasPositionsFromByte(descToken, doc.id, it->second);
-                termInDescription = termInDescriptionIndex.first;
-                newTermToData[descToken] = termInDescriptionIndex.second;
+            if (auto it = termFields.find(term); it != termFields.end()) {
+                termInDescription = (it->second & FIELD_FLAG_DESC) != 0;
             }
 
             bool termInBody = bodyPositions.size() > 0;
-            bool termInUrl = doc.url.find(term) != std::string::npos;
+            bool termInUrl = doc.url.find(term) != std::string_view::npos;
 
             size_t pos = title.find(term);
             bool termInTitle = pos != std::string::npos;
@@ -166,8 +167,8 @@ uint32_t GetFinalScore(BM25* BM25Lib,
                 earliestPosTitle += (1 / static_cast<float>(pos + 1)) *
                                     (static_cast<float>(multiplicity) / static_cast<float>(query.size()));
 
-                int titleOccurences = std::min(CountWordOccurrences(title, term), (int)doc.title.size());
-                densityTitle += (static_cast<float>(titleOccurences) / static_cast<float>(doc.title.size())) *
+                int titleOccurences = std::min(CountWordOccurrences(title, term), (int)doc.titleTokenCount());
+                densityTitle += (static_cast<float>(titleOccurences) / static_cast<float>(doc.titleTokenCount())) *
                                 (static_cast<float>(multiplicity) / static_cast<float>(query.size()));
 
                 if (!found) {
@@ -207,9 +208,7 @@ uint32_t GetFinalScore(BM25* BM25Lib,
         break;
     }
 
-    termToData = std::move(newTermToData);
-
-    float orderedTitleScore = std::sqrt(ranking::dynamic::OrderedMatchScore(query, doc.title));
+    float orderedTitleScore = std::sqrt(ranking::dynamic::OrderedMatchScore(query, doc));
 
     dynamic::RankerFeatures features{
         // Boolean presence flags
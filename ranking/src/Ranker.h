@@ -1,4 +1,5 @@
 #include "BM25.h"
+#include "DocumentMapReader.h"
 #include "PositionIndex.h"
 #include "TermDictionary.h"
 #include "data/Document.h"
@@ -38,24 +39,25 @@ inline bool IsValidToken(const std::string& token) {
 std::unordered_map<std::string, uint32_t> GetDocumentFrequencies(const TermDictionary& term_dict,
                                                                  const std::vector<std::pair<std::string, int>>& query);
 
+// termFields holds the FIELD_FLAG_* bits of each query term in doc
 uint32_t GetFinalScore(BM25* BM25Lib,
                        const std::vector<std::pair<std::string, int>>& query,
                        const std::vector<int>& stopwordIdx,
                        const std::vector<int>& nonstopwordIdx,
-                       const data::Document& doc,
+                       const DocView& doc,
                        const data::DocInfo& info,
-                       const PositionIndex& position_index,
                        const std::unordered_map<std::string, uint32_t>& termFreq,
-                       std::unordered_map<std::string, const char*>& data);
+                       std::unordered_map<std::string, PositionCursor>& termToCursor,
+                       const std::unordered_map<std::string, uint8_t>& termFields);
 
 std::vector<std::pair<std::string, int>>
 TokenifyQuery(const std::string& query, std::vector<int>& stopwordIdx, std::vector<int>& nonstopwordIdx);
 
-inline bool ContainsPornKeywords(const std::string& input) {
+inline bool ContainsPornKeywords(std::string_view input) {
     // Precompiled regex pattern (optimized for performance)
     static const std::regex pornPattern(R"((?:p[0o]rn|\bs[e3]x\b|xxx|nsfw|nudes?|fetish|blow[-_]?job))",
                                         std::regex_constants::icase | std::regex_constants::optimize);
-    return std::regex_search(input, pornPattern);
+    return std::regex_search(input.begin(), input.end(), pornPattern);
 }
 
 inline bool ContainsPornKeywords(const std::vector<std::string>& input) {
@@ -0,0 +1,254 @@
+#include "BlockMaxWand.h"
+#include "DocumentMapReader.h"
+#include "InvertedIndex.h"
+#include "PositionIndex.h"
+#include "PostingBlock.h"
+#include "TermDictionary.h"
+#include "TermReader.h"
+#include "TestIndex.h"
+#include "TextPreprocessor.h"
+#include "core/mem_map_file.h"
+#include "data/Document.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+namespace {
+
+constexpr data::docid_t DOC_COUNT = 1500;
+constexpr double AVG_BODY_LENGTH = 8.0;
+constexpr size_t CHAMPIONS = 50;
+
+// alpha in every third document and beta in every seventh, both repeated a varying number of times in bodies of
+// varying length, alpha also in the titles of every fifth. gamma, in every other document, is the filter.
+data::Document DocumentOf(data::docid_t id) {
+    std::vector<std::string> words(id % 11, "filler");
+    for (data::docid_t i = 0; id % 3 == 0 && i < id % 4 + 1; ++i) {
+        words.push_back("alpha");
+    }
+    for (data::docid_t i = 0; id % 7 == 0 && i < id % 3 + 1; ++i) {
+        words.push_back("beta");
+    }
+    if (id % 2 == 0) {
+        words.push_back("gamma");
+    }
+    words.push_back("common");
+    auto doc = test::MakeDocument(id, std::move(words));
+    if (id % 5 == 0) {
+        doc.title = {"alpha"};
+    }
+    return doc;
+}
+
+class BlockMaxWandTest : public test::IndexDirTest {
+protected:
+    std::unique_ptr<core::MemMapFile> index_file;
+    std::unique_ptr<TermDictionary> dict;
+    std::unique_ptr<PositionIndex> positions;
+    std::unique_ptr<DocumentMapReader> documents;
+
+    void SetUp() override {
+        test::IndexDirTest::SetUp();
+        {
+            IndexBuilder builder(dir, 2);
+            builder.set_champion_lists(200, CHAMPIONS, 0.0);
+            for (data::docid_t id = 0; id < DOC_COUNT; ++id) {
+                builder.add_document(DocumentOf(id));
+            }
+            builder.finalize();
+        }
+        index_file = std::make_unique<core::MemMapFile>(dir + "/final_index.data");
+        dict = std::make_unique<TermDictionary>(dir);
+        positions = std::make_unique<PositionIndex>(dir);
+        documents = std::make_unique<DocumentMapReader>(dir);
+    }
+
+    std::unique_ptr<TermReader> Reader(const std::string& term) {
+        return std::make_unique<TermReader>(dir, term, *index_file, *dict, *positions);
+    }
+
+    // BM25 lists of alpha and beta and a presence list scoring the title and body of alpha's any-field list
+    std::vector<BlockMaxWand::List> Lists() {
+        std::vector<BlockMaxWand::List> lists;
+        for (const std::string term : {"alpha", "beta"}) {
+            auto reader = Reader(term);
+            const double n = reader->getDocumentCount();
+            const double idf = std::log((DOC_COUNT - n + 0.5) / (n + 0.5));
+            lists.push_back({std::move(reader), 1.0F, idf, true});
+        }
+        lists.push_back({Reader(any_field_term("alpha")),
+                         0.5F,
+                         0.0,
+                         false,
+                         {{FIELD_FLAG_TITLE, 0.6F}, {FIELD_FLAG_BODY, 0.1F}}});
+        return lists;
+    }
+
+    // BM25 list of alpha, its champion list with champions, and alpha's any-field list, which follows the champion
+    // list
+    std::vector<BlockMaxWand::List> AlphaLists(bool champions) {
+        const double n = dict->lookup("alpha")->postings_count;
+        const double idf = std::log((DOC_COUNT - n + 0.5) / (n + 0.5));
+        std::vector<BlockMaxWand::List> lists;
+        lists.push_back({Reader(champions ? champion_term("alpha") : "alpha"), 1.0F, idf, true});
+        lists.push_back({Reader(any_field_term("alpha")),
+                         0.5F,
+                         0.0,
+                         false,
+                         {{FIELD_FLAG_TITLE, 0.6F}, {FIELD_FLAG_BODY, 0.1F}},
+                         champions});
+        return lists;
+    }
+
+    // Score of every document in a list and, when filtered, in gamma
+    std::map<data::docid_t, float> Exhaustive(bool filtered) {
+        std::set<data::docid_t> filter;
+        for (auto reader = Reader("gamma"); reader->hasNext(); reader->moveNext()) {
+            filter.insert(reader->currentDocID());
+        }
+
+        std::map<data::docid_t, float> scores;
+        for (auto& list : Lists()) {
+            for (auto& reader = *list.reader; reader.hasNext(); reader.moveNext()) {
+                const data::docid_t doc = reader.currentDocID();
+                if (filtered && !filter.contains(doc)) {
+                    continue;
+                }
+                if (!list.bm25) {
+                    float fields = 0.0F;
+                    for (const auto& [flag, weight] : list.field_weights) {
+                        fields += (reader.currentFieldMask() & flag) != 0 ? weight : 0.0F;
+                    }
+                    scores[doc] += list.weight * fields;
+                    continue;
+                }
+                const DocInfo* info = documents->findDocInfo(doc);
+                const double norm = (1.0 - BM25_B) + BM25_B * (info->body_length / AVG_BODY_LENGTH);
+                scores[doc] +=
+                    static_cast<float>(list.weight * BlockMaxWand::bm25(list.idf, reader.currentFrequency() / norm));
+            }
+        }
+        return scores;
+    }
+
+    // Checks topK(k) against the exhaustive scores, ties at the k-th score may pick different documents
+    void ExpectTopK(size_t k, bool filtered) {
+        const auto scores = Exhaustive(filtered);
+        std::vector<float> expected;
+        for (const auto& [doc, score] : scores) {
+            expected.push_back(score);
+        }
+        std::sort(expected.begin(), expected.end(), std::greater<>());
+        expected.resize(std::min(k, expected.size()));
+
+        auto filter = Reader("gamma");
+        BlockMaxWand wand(Lists(), *documents, AVG_BODY_LENGTH, filtered ? filter.get() : nullptr);
+        const auto top = wand.topK(k);
+
+        ASSERT_TRUE(std::is_sorted(top.begin(), top.end()));
+        std::vector<float> actual;
+        for (const auto& [doc, score] : top) {
+            ASSERT_TRUE(scores.contains(doc)) << doc;
+            EXPECT_NEAR(score, scores.at(doc), 1e-5F) << doc;
+            actual.push_back(score);
+        }
+        std::sort(actual.begin(), actual.end(), std::greater<>());
+        ASSERT_EQ(actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size(); ++i) {
+            EXPECT_NEAR(actual[i], expected[i], 1e-5F) << i;
+        }
+
+        // Every match is scored while fewer than k were found (the exact count EvaluateQueryTopK reports), later
+        // ones that cannot beat the k-th best are skipped and the count is a lower bound
+        if (top.size() < k) {
+            EXPECT_EQ(wand.scoredDocuments(), scores.size());
+        } else {
+            EXPECT_LE(wand.scoredDocuments(), scores.size());
+        }
+    }
+};
+
+}  // namespace
+
+TEST_F(BlockMaxWandTest, KBeyondMatchesScoresEveryMatch) {
+    ExpectTopK(DOC_COUNT, false);
+    ExpectTopK(DOC_COUNT, true);
+}
+
+TEST_F(BlockMaxWandTest, KBelowMatchesSkipsDocuments) {
+    for (const size_t k : {1, 10, 100}) {
+        ExpectTopK(k, false);
+        ExpectTopK(k, true);
+    }
+
+    BlockMaxWand wand(Lists(), *documents, AVG_BODY_LENGTH);
+    wand.topK(10);
+    EXPECT_LT(wand.scoredDocuments(), Exhaustive(false).size());
+}
+
+TEST_F(BlockMaxWandTest, FilterRestrictsResults) {
+    std::set<data::docid_t> filter;
+    for (auto reader = Reader("gamma"); reader->hasNext(); reader->moveNext()) {
+        filter.insert(reader->currentDocID());
+    }
+
+    auto gamma = Reader("gamma");
+    BlockMaxWand wand(Lists(), *documents, AVG_BODY_LENGTH, gamma.get());
+    for (const auto& [doc, score] : wand.topK(50)) {
+        EXPECT_TRUE(filter.contains(doc)) << doc;
+    }
+}
+
+TEST_F(BlockMaxWandTest, ZeroK) {
+    BlockMaxWand wand(Lists(), *documents, AVG_BODY_LENGTH);
+    EXPECT_TRUE(wand.topK(0).empty());
+    EXPECT_EQ(wand.scoredDocuments(), 0U);
+}
+
+// A champion tier only visits the champion list's documents, scoring them like the full lists do. When it finds
+// fewer than k the caller falls back to the full lists, which find every match.
+TEST_F(BlockMaxWandTest, ChampionTierFollowsChampionList) {
+    std::set<data::docid_t> champions;
+    for (auto reader = Reader(champion_term("alpha")); reader->hasNext(); reader->moveNext()) {
+        champions.insert(reader->currentDocID());
+    }
+    ASSERT_EQ(champions.size(), CHAMPIONS);
+
+    BlockMaxWand full(AlphaLists(false), *documents, AVG_BODY_LENGTH);
+    std::map<data::docid_t, float> full_scores;
+    for (const auto& [doc, score] : full.topK(DOC_COUNT)) {
+        full_scores[doc] = score;
+    }
+    const size_t matches = full_scores.size();
+    ASSERT_GT(matches, CHAMPIONS);
+
+    for (const size_t k : {size_t{10}, CHAMPIONS, matches}) {
+        BlockMaxWand tier(AlphaLists(true), *documents, AVG_BODY_LENGTH);
+        const auto top = tier.topK(k);
+        EXPECT_EQ(top.size(), std::min(k, CHAMPIONS)) << k;
+        EXPECT_LE(tier.scoredDocuments(), CHAMPIONS) << k;
+        for (const auto& [doc, score] : top) {
+            ASSERT_TRUE(champions.contains(doc)) << doc;
+            EXPECT_NEAR(score, full_scores.at(doc), 1e-5F) << doc;
+        }
+    }
+
+    // Falling back after the tier came up short
+    BlockMaxWand tier(AlphaLists(true), *documents, AVG_BODY_LENGTH);
+    ASSERT_LT(tier.topK(CHAMPIONS + 1).size(), CHAMPIONS + 1);
+    BlockMaxWand fallback(AlphaLists(false), *documents, AVG_BODY_LENGTH);
+    EXPECT_EQ(fallback.topK(CHAMPIONS + 1).size(), CHAMPIONS + 1);
+    EXPECT_GT(fallback.scoredDocuments(), tier.scoredDocuments());
+}
@@ -0,0 +1,80 @@
+#include "DeletionBitmap.h"
+#include "DocumentMapReader.h"
+#include "InvertedIndex.h"
+#include "TestIndex.h"
+#include "data/Document.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+class DeletionBitmapTest : public test::IndexDirTest {
+protected:
+    data::docid_t base = 0;
+    size_t slots = 0;
+
+    // Indexes enough documents that the bitmap spans more than one word
+    void SetUp() override {
+        IndexDirTest::SetUp();
+        {
+            IndexBuilder builder(dir, 1);
+            test::AddDocuments(builder, 0, 150, {"deleted", "documents"});
+            builder.finalize();
+        }
+
+        DocumentMapReader documents(dir);
+        base = documents.baseDocID();
+        slots = documents.slotCount();
+        ASSERT_GT(slots, 128U);
+    }
+};
+
+TEST_F(DeletionBitmapTest, NothingDeleted) {
+    DeletionBitmap bitmap(dir);
+    EXPECT_TRUE(bitmap.empty());
+    EXPECT_FALSE(bitmap.refresh());
+    EXPECT_FALSE(bitmap.isDeleted(base));
+    EXPECT_EQ(bitmap.deletedCount(), 0U);
+    EXPECT_TRUE(bitmap.deletedIds().empty());
+}
+
+TEST_F(DeletionBitmapTest, MarkDeletedRoundTrip) {
+    const auto last = static_cast<data::docid_t>(base + slots - 1);
+    // Repeats count once, ids before and past the index are ignored
+    const std::vector<data::docid_t> ids = {base + 70, base, last, base + 63, base + 64, base + 70, last + 1};
+    EXPECT_EQ(DeletionBitmap::markDeleted(dir, ids), 5U);
+    if (base > 0) {
+        const std::vector<data::docid_t> before = {base - 1};
+        EXPECT_EQ(DeletionBitmap::markDeleted(dir, before), 0U);
+    }
+
+    DeletionBitmap bitmap(dir);
+    ASSERT_FALSE(bitmap.empty());
+    const std::vector<data::docid_t> expected = {base, base + 63, base + 64, base + 70, last};
+    EXPECT_EQ(bitmap.deletedIds(), expected);
+    EXPECT_EQ(bitmap.deletedCount(), expected.size());
+    for (size_t slot = 0; slot < slots; ++slot) {
+        const auto id = static_cast<data::docid_t>(base + slot);
+        EXPECT_EQ(bitmap.isDeleted(id), std::find(expected.begin(), expected.end(), id) != expected.end()) << id;
+    }
+    EXPECT_FALSE(bitmap.isDeleted(last + 1));
+}
+
+// The bitmap is mapped shared, so an open reader sees deletions made after it mapped the file
+TEST_F(DeletionBitmapTest, OpenReaderSeesLaterDeletions) {
+    DeletionBitmap bitmap(dir);
+    EXPECT_TRUE(bitmap.empty());
+
+    const std::vector<data::docid_t> first = {base + 1};
+    EXPECT_EQ(DeletionBitmap::markDeleted(dir, first), 1U);
+    ASSERT_TRUE(bitmap.refresh());
+    EXPECT_TRUE(bitmap.isDeleted(base + 1));
+
+    const std::vector<data::docid_t> second = {base + 1, base + 2};
+    EXPECT_EQ(DeletionBitmap::markDeleted(dir, second), 1U);
+    EXPECT_TRUE(bitmap.isDeleted(base + 2));
+    EXPECT_EQ(bitmap.deletedCount(), 2U);
+}
@@ -0,0 +1,240 @@
+#include "DeletionBitmap.h"
+#include "DensePostings.h"
+#include "DocumentMapReader.h"
+#include "IndexStreamReader.h"
+#include "InvertedIndex.h"
+#include "NotIndexStreamReader.h"
+#include "PositionIndex.h"
+#include "TermAND.h"
+#include "TermDictionary.h"
+#include "TermReader.h"
+#include "TestIndex.h"
+#include "core/mem_map_file.h"
+#include "data/Document.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+namespace {
+
+constexpr data::docid_t DOC_COUNT = 9000;
+
+// mithril is in every document and crawler in every other, both more than a Roaring array container holds, ranker
+// is in every tenth document and stored as an array. parser is too sparse for a bitmap.
+data::Document DocumentOf(data::docid_t id) {
+    std::vector<std::string> words = {"mithril"};
+    if (id % 2 == 0) {
+        words.push_back("crawler");
+    }
+    if (id % 10 == 3) {
+        words.push_back("ranker");
+    }
+    if (id % 50 == 7) {
+        words.push_back("parser");
+    }
+    return test::MakeDocument(id, std::move(words));
+}
+
+std::vector<data::docid_t> Collect(IndexStreamReader& isr) {
+    std::vector<data::docid_t> doc_ids;
+    for (; isr.hasNext(); isr.moveNext()) {
+        doc_ids.push_back(isr.currentDocID());
+    }
+    return doc_ids;
+}
+
+class DensePostingsTest : public test::IndexDirTest {
+protected:
+    const std::vector<std::string> dense_terms{"mithril", "crawler", "ranker"};
+    std::unique_ptr<core::MemMapFile> index_file;
+    std::unique_ptr<TermDictionary> dict;
+    std::unique_ptr<PositionIndex> positions;
+    std::unique_ptr<DensePostings> dense;
+    std::unique_ptr<DeletionBitmap> deleted;
+    DocIDRange range{};
+
+    void SetUp() override {
+        test::IndexDirTest::SetUp();
+        {
+            IndexBuilder builder(dir, 2);
+            builder.set_dense_postings(16);
+            for (data::docid_t id = 0; id < DOC_COUNT; ++id) {
+                builder.add_document(DocumentOf(id));
+            }
+            builder.finalize();
+        }
+        index_file = std::make_unique<core::MemMapFile>(dir + "/final_index.data");
+        dict = std::make_unique<TermDictionary>(dir);
+        positions = std::make_unique<PositionIndex>(dir);
+        dense = std::make_unique<DensePostings>(dir);
+        deleted = std::make_unique<DeletionBitmap>(dir);
+        const DocumentMapReader documents(dir);
+        range = {documents.baseDocID(), static_cast<data::docid_t>(documents.baseDocID() + documents.slotCount())};
+    }
+
+    // Deletes a run of documents that spans a bitmap word and a scattering of single ones
+    void DeleteDocuments() {
+        std::vector<data::docid_t> ids;
+        for (data::docid_t id = range.begin + 100; id < range.begin + 300; ++id) {
+            ids.push_back(id);
+        }
+        for (data::docid_t id = range.begin + 1000; id < range.end; id += 37) {
+            ids.push_back(id);
+        }
+        ASSERT_GT(DeletionBitmap::markDeleted(dir, ids), 0U);
+        ASSERT_TRUE(deleted->refresh());
+    }
+
+    std::unique_ptr<IndexStreamReader> Postings(const std::string& term) {
+        return std::make_unique<TermReader>(dir, term, *index_file, *dict, *positions, deleted.get());
+    }
+
+    std::unique_ptr<IndexStreamReader> Bitmap(const std::string& term) {
+        return std::make_unique<DenseTermReader>(*dense->lookup(term), deleted.get());
+    }
+
+    std::unique_ptr<IndexStreamReader> Not(std::unique_ptr<IndexStreamReader> reader) {
+        return std::make_unique<NotISR>(std::move(reader), range.end, deleted.get(), range.begin);
+    }
+
+    // Both readers go through the same random forward seeks, with a seek to the current or an earlier document
+    // now and then, and have to stay on the same documents
+    void ExpectSameSeeks(IndexStreamReader& expected, IndexStreamReader& actual, bool backwards) {
+        std::mt19937 rng(11);
+        data::docid_t target = range.begin;
+        while (expected.hasNext()) {
+            const int step = std::uniform_int_distribution<int>(0, 12)(rng);
+            if (step == 0 && backwards) {
+                target = expected.currentDocID() - std::min<data::docid_t>(expected.currentDocID(), 5);
+            } else if (step == 1) {
+                target = expected.currentDocID();
+            } else {
+                target = expected.currentDocID() + static_cast<data::docid_t>(step) * 3;
+            }
+            expected.seekToDocID(target);
+            actual.seekToDocID(target);
+            ASSERT_EQ(actual.hasNext(), expected.hasNext()) << target;
+            if (expected.hasNext()) {
+                ASSERT_EQ(actual.currentDocID(), expected.currentDocID()) << target;
+            }
+        }
+    }
+};
+
+}  // namespace
+
+TEST_F(DensePostingsTest, OnlyDenseTermsGetBitmaps) {
+    for (const auto& term : dense_terms) {
+        const auto docs = dense->lookup(term);
+        ASSERT_TRUE(docs.has_value()) << term;
+        EXPECT_EQ(docs->docCount(), dict->lookup(term)->postings_count) << term;
+    }
+    EXPECT_FALSE(dense->lookup("parser").has_value());
+}
+
+TEST_F(DensePostingsTest, IteratesLikePostings) {
+    for (const auto& term : dense_terms) {
+        const auto expected = Collect(*Postings(term));
+        EXPECT_FALSE(expected.empty()) << term;
+        EXPECT_EQ(Collect(*Bitmap(term)), expected) << term;
+    }
+}
+
+TEST_F(DensePostingsTest, SeeksLikePostings) {
+    for (const auto& term : dense_terms) {
+        auto expected = Postings(term);
+        auto actual = Bitmap(term);
+        ExpectSameSeeks(*expected, *actual, true);
+    }
+}
+
+TEST_F(DensePostingsTest, SkipsDeletedDocuments) {
+    DeleteDocuments();
+    for (const auto& term : dense_terms) {
+        const auto expected = Collect(*Postings(term));
+        const auto actual = Collect(*Bitmap(term));
+        EXPECT_EQ(actual, expected) << term;
+        for (const data::docid_t id : actual) {
+            ASSERT_FALSE(deleted->isDeleted(id)) << term << " " << id;
+        }
+
+        auto seeking_expected = Postings(term);
+        auto seeking_actual = Bitmap(term);
+        ExpectSameSeeks(*seeking_expected, *seeking_actual, true);
+    }
+}
+
+// Every document of the index's range that is neither in the term's list nor deleted, range.begin included
+TEST_F(DensePostingsTest, NotMatchesBruteForceComplement) {
+    for (const bool with_deletions : {false, true}) {
+        if (with_deletions) {
+            DeleteDocuments();
+        }
+        for (const std::string term : {"crawler", "ranker", "parser"}) {
+            const auto postings = Collect(*Postings(term));
+            std::vector<data::docid_t> expected;
+            for (data::docid_t id = range.begin; id < range.end; ++id) {
+                if (!std::binary_search(postings.begin(), postings.end(), id) && !deleted->isDeleted(id)) {
+                    expected.push_back(id);
+                }
+            }
+            ASSERT_FALSE(expected.empty()) << term;
+            EXPECT_EQ(Collect(*Not(Postings(term))), expected) << term;
+            if (dense->lookup(term)) {
+                EXPECT_EQ(Collect(*Not(Bitmap(term))), expected) << term;
+            }
+
+            // Seeking to the first document keeps the reader on it
+            auto not_term = Not(Postings(term));
+            not_term->seekToDocID(range.begin);
+            ASSERT_TRUE(not_term->hasNext()) << term;
+            EXPECT_EQ(not_term->currentDocID(), expected.front()) << term;
+        }
+    }
+}
+
+// AND seeks its other readers to the first reader's first document, which is the index's first document here
+TEST_F(DensePostingsTest, AndNotFromFirstDocument) {
+    std::vector<data::docid_t> expected;
+    const auto crawler = Collect(*Postings("crawler"));
+    const auto ranker = Collect(*Postings("ranker"));
+    for (const data::docid_t id : crawler) {
+        if (!std::binary_search(ranker.begin(), ranker.end(), id)) {
+            expected.push_back(id);
+        }
+    }
+    ASSERT_EQ(expected.front(), range.begin);
+
+    for (const bool bitmap : {false, true}) {
+        std::vector<std::unique_ptr<IndexStreamReader>> readers;
+        readers.push_back(Postings("crawler"));
+        readers.push_back(Not(bitmap ? Bitmap("ranker") : Postings("ranker")));
+        TermAND and_not(std::move(readers));
+        EXPECT_EQ(Collect(and_not), expected) << bitmap;
+    }
+}
+
+// The bitmap's complement is read off its words, the posting list's by walking it
+TEST_F(DensePostingsTest, NotComplementsLikePostings) {
+    for (const bool with_deletions : {false, true}) {
+        if (with_deletions) {
+            DeleteDocuments();
+        }
+        for (const auto& term : dense_terms) {
+            const auto expected = Collect(*Not(Postings(term)));
+            EXPECT_EQ(Collect(*Not(Bitmap(term))), expected) << term;
+
+            // NOT only seeks forward
+            auto seeking_expected = Not(Postings(term));
+            auto seeking_actual = Not(Bitmap(term));
+            ExpectSameSeeks(*seeking_expected, *seeking_actual, false);
+        }
+    }
+}
@@ -0,0 +1,173 @@
+#include "DeletionBitmap.h"
+#include "DocumentMapReader.h"
+#include "IndexStreamReader.h"
+#include "InvertedIndex.h"
+#include "PositionIndex.h"
+#include "TermDictionary.h"
+#include "TermQuote.h"
+#include "TermReader.h"
+#include "TestIndex.h"
+#include "core/mem_map_file.h"
+#include "data/Document.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+namespace {
+
+constexpr data::docid_t DOC_COUNT = 400;
+
+// ordered is in every document, crawler and ranker in every other and every third. "mithril search engine" is quoted
+// in every fourth document and reversed in the ones after those. The pattern is repeated three times, so its body
+// terms keep their positions.
+data::Document DocumentOf(data::docid_t id) {
+    std::vector<std::string> words = {"ordered"};
+    if (id % 2 == 0) {
+        words.push_back("crawler");
+    }
+    if (id % 3 == 0) {
+        words.push_back("ranker");
+    }
+    for (int repeat = 0; repeat < 3; ++repeat) {
+        if (id % 4 == 0) {
+            words.insert(words.end(), {"mithril", "search", "engine"});
+        } else if (id % 4 == 1) {
+            words.insert(words.end(), {"engine", "search", "mithril"});
+        }
+        for (int i = 0; i < 8; ++i) {
+            words.push_back("gap" + std::to_string(repeat * 8 + i));
+        }
+    }
+    return test::MakeDocument(id, std::move(words));
+}
+
+// One index of the corpus and the crawl IDs of the documents its readers match
+struct Index {
+    std::string dir;
+    std::unique_ptr<core::MemMapFile> index_file;
+    std::unique_ptr<TermDictionary> dict;
+    std::unique_ptr<PositionIndex> positions;
+    std::unique_ptr<DocumentMapReader> documents;
+    std::unique_ptr<DeletionBitmap> deleted;
+
+    Index(std::string index_dir, DocOrder order) : dir(std::move(index_dir)) {
+        {
+            IndexBuilder builder(dir, 2);
+            builder.set_doc_order(order);
+            // Scatters the documents, ties are left to crawl order
+            builder.set_static_rank([](const DocumentMetadata& meta) { return (meta.id * 7919) % 101; });
+            for (data::docid_t id = 0; id < DOC_COUNT; ++id) {
+                builder.add_document(DocumentOf(id));
+            }
+            builder.finalize();
+        }
+        index_file = std::make_unique<core::MemMapFile>(dir + "/final_index.data");
+        dict = std::make_unique<TermDictionary>(dir);
+        positions = std::make_unique<PositionIndex>(dir);
+        documents = std::make_unique<DocumentMapReader>(dir);
+        deleted = std::make_unique<DeletionBitmap>(dir);
+    }
+
+    // Crawl IDs of the reader's matches, sorted
+    std::vector<data::docid_t> CrawlIDs(IndexStreamReader& reader) const {
+        std::vector<data::docid_t> crawl_ids;
+        for (; reader.hasNext(); reader.moveNext()) {
+            crawl_ids.push_back(documents->crawlDocID(reader.currentDocID()));
+        }
+        std::sort(crawl_ids.begin(), crawl_ids.end());
+        return crawl_ids;
+    }
+
+    std::vector<data::docid_t> Term(const std::string& term) const {
+        TermReader reader(dir, term, *index_file, *dict, *positions, deleted.get());
+        return CrawlIDs(reader);
+    }
+
+    std::vector<data::docid_t> Quote(const std::vector<std::string>& terms) const {
+        TermQuote reader(dir, terms, *index_file, *dict, *positions, deleted.get());
+        return CrawlIDs(reader);
+    }
+
+    // Deletes the documents the crawler gave these IDs
+    void DeleteCrawlIDs(const std::vector<data::docid_t>& crawl_ids) {
+        std::vector<data::docid_t> ids;
+        for (const data::docid_t crawl_id : crawl_ids) {
+            const auto id = documents->lookupCrawlDocID(crawl_id);
+            ASSERT_TRUE(id.has_value()) << crawl_id;
+            ids.push_back(*id);
+        }
+        ASSERT_EQ(DeletionBitmap::markDeleted(dir, ids), ids.size());
+        ASSERT_TRUE(deleted->refresh());
+    }
+};
+
+class DocOrderTest : public test::IndexDirTest {
+protected:
+    const std::vector<std::string> terms{"ordered", "crawler", "ranker", "mithril"};
+    const std::vector<std::string> quote{"mithril", "search", "engine"};
+
+    // Builds the corpus in crawl order and renumbered by order, both have to match the same documents
+    void ExpectSameMatches(DocOrder order) {
+        Index crawl(dir + "/crawl", DocOrder::Crawl);
+        Index renumbered(dir + "/renumbered", order);
+
+        // Renumbering moved documents, and every crawl ID maps to a document and back
+        const DocumentMapReader& documents = *renumbered.documents;
+        ASSERT_EQ(documents.documentCount(), DOC_COUNT);
+        size_t moved = 0;
+        for (data::docid_t crawl_id = 0; crawl_id < DOC_COUNT; ++crawl_id) {
+            const auto id = documents.lookupCrawlDocID(crawl_id);
+            ASSERT_TRUE(id.has_value()) << crawl_id;
+            ASSERT_NE(documents.findDocInfo(*id), nullptr) << crawl_id;
+            EXPECT_EQ(documents.crawlDocID(*id), crawl_id);
+            EXPECT_EQ(crawl.documents->lookupCrawlDocID(crawl_id), std::optional<data::docid_t>(crawl_id));
+            moved += *id != crawl_id ? 1 : 0;
+        }
+        EXPECT_GT(moved, DOC_COUNT / 2);
+        EXPECT_FALSE(documents.lookupCrawlDocID(DOC_COUNT).has_value());
+
+        for (const bool with_deletions : {false, true}) {
+            if (with_deletions) {
+                std::vector<data::docid_t> crawl_ids;
+                for (data::docid_t crawl_id = 1; crawl_id < DOC_COUNT; crawl_id += 5) {
+                    crawl_ids.push_back(crawl_id);
+                }
+                crawl.DeleteCrawlIDs(crawl_ids);
+                renumbered.DeleteCrawlIDs(crawl_ids);
+                ASSERT_FALSE(HasFatalFailure());
+            }
+            for (const auto& term : terms) {
+                const auto expected = crawl.Term(term);
+                ASSERT_FALSE(expected.empty()) << term;
+                EXPECT_EQ(renumbered.Term(term), expected) << term << " " << with_deletions;
+            }
+            const auto expected = crawl.Quote(quote);
+            ASSERT_FALSE(expected.empty());
+            EXPECT_EQ(renumbered.Quote(quote), expected) << with_deletions;
+        }
+
+        // Deleting by crawl ID left out the same documents in both
+        const auto remaining = crawl.Term("ordered");
+        EXPECT_EQ(remaining.size(), DOC_COUNT - DOC_COUNT / 5);
+        for (const data::docid_t crawl_id : remaining) {
+            EXPECT_NE(crawl_id % 5, 1U) << crawl_id;
+        }
+    }
+};
+
+}  // namespace
+
+TEST_F(DocOrderTest, StaticRankMatchesCrawlOrder) {
+    ExpectSameMatches(DocOrder::StaticRank);
+}
+
+TEST_F(DocOrderTest, UrlMatchesCrawlOrder) {
+    ExpectSameMatches(DocOrder::Url);
+}
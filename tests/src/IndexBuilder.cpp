@@ -0,0 +1,217 @@
+#include "DocumentMapReader.h"
+#include "InvertedIndex.h"
+#include "PositionIndex.h"
+#include "TermDictionary.h"
+#include "TermReader.h"
+#include "TestIndex.h"
+#include "TextPreprocessor.h"
+#include "core/mem_map_file.h"
+#include "data/Document.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+namespace {
+
+// Terms every document has (index twice), one of seven and one of thirteen, and a title term, which keeps its
+// positions
+data::Document DocumentOf(data::docid_t id) {
+    auto doc = test::MakeDocument(
+        id, {"index", "checkpoint", "term" + std::to_string(id % 7), "rare" + std::to_string(id % 13), "index"});
+    doc.title = {"resume"};
+    return doc;
+}
+
+std::vector<std::string> Vocabulary() {
+    std::vector<std::string> terms = {"#resume", "index", "checkpoint"};
+    for (int i = 0; i < 13; ++i) {
+        terms.push_back("rare" + std::to_string(i));
+        if (i < 7) {
+            terms.push_back("term" + std::to_string(i));
+        }
+    }
+    return terms;
+}
+
+struct Posting {
+    data::docid_t id;
+    uint32_t frequency;
+    std::vector<uint16_t> positions;
+
+    bool operator==(const Posting&) const = default;
+};
+
+std::vector<Posting> ReadPostings(const std::string& dir, const std::string& term) {
+    TermDictionary dict(dir);
+    PositionIndex positions(dir);
+    core::MemMapFile index_file(dir + "/final_index.data");
+    TermReader reader(dir, term, index_file, dict, positions);
+    std::vector<Posting> postings;
+    for (; reader.hasNext(); reader.moveNext()) {
+        postings.push_back({reader.currentDocID(), reader.currentFrequency(), reader.currentPositions()});
+    }
+    return postings;
+}
+
+}  // namespace
+
+class IndexBuilderTest : public test::IndexDirTest {};
+
+// A build that checkpoints, loses the documents it indexed after the checkpoint and resumes in a fresh builder
+// ends up with the index of a build that never stopped. The small term limit makes both write several blocks.
+TEST_F(IndexBuilderTest, ResumeMatchesUninterruptedBuild) {
+    constexpr data::docid_t count = 300;
+    const std::string whole = dir + "/whole";
+    const std::string resumed = dir + "/resumed";
+    {
+        IndexBuilder builder(whole, 2, 8);
+        for (data::docid_t id = 0; id < count; ++id) {
+            builder.add_document(DocumentOf(id));
+        }
+        builder.finalize();
+    }
+    {
+        IndexBuilder builder(resumed, 2, 8);
+        for (data::docid_t id = 0; id < 120; ++id) {
+            builder.add_document(DocumentOf(id));
+        }
+        builder.checkpoint("119");
+        // Dropped with the builder, as if it crashed
+        for (data::docid_t id = 120; id < 180; ++id) {
+            builder.add_document(DocumentOf(id));
+        }
+    }
+    {
+        IndexBuilder builder(resumed, 2, 8);
+        ASSERT_TRUE(builder.resume());
+        for (data::docid_t id = 0; id < count; ++id) {
+            if (!builder.has_document(id)) {
+                builder.add_document(DocumentOf(id));
+            }
+        }
+        builder.finalize();
+    }
+
+    ASSERT_FALSE(ReadPostings(whole, "#resume").front().positions.empty());
+
+    TermDictionary whole_dict(whole);
+    TermDictionary resumed_dict(resumed);
+    ASSERT_TRUE(resumed_dict.is_loaded());
+    EXPECT_EQ(resumed_dict.size(), whole_dict.size());
+    for (const auto& term : Vocabulary()) {
+        const auto expected = whole_dict.lookup(term);
+        const auto entry = resumed_dict.lookup(term);
+        ASSERT_TRUE(expected.has_value()) << term;
+        ASSERT_TRUE(entry.has_value()) << term;
+        EXPECT_EQ(entry->postings_count, expected->postings_count) << term;
+        EXPECT_EQ(ReadPostings(resumed, term), ReadPostings(whole, term)) << term;
+    }
+
+    DocumentMapReader whole_docs(whole);
+    DocumentMapReader resumed_docs(resumed);
+    ASSERT_EQ(resumed_docs.documentCount(), count);
+    ASSERT_EQ(resumed_docs.documentCount(), whole_docs.documentCount());
+    while (whole_docs.hasNext()) {
+        ASSERT_TRUE(resumed_docs.hasNext());
+        const auto expected = whole_docs.next();
+        const auto doc = resumed_docs.next();
+        EXPECT_EQ(doc.id, expected.id);
+        EXPECT_EQ(doc.url, expected.url);
+        EXPECT_EQ(doc.words.size(), expected.words.size());
+    }
+    EXPECT_FALSE(resumed_docs.hasNext());
+}
+
+// A file where the positions directory goes fails every position buffer write. The checkpoint throws instead of
+// recording the missing buffer file as durable, and so does finalize.
+TEST_F(IndexBuilderTest, FailedPositionFlushFailsCheckpoint) {
+    const std::string broken = dir + "/broken";
+    std::filesystem::create_directories(broken);
+    std::ofstream(broken + "/positions") << "not a directory";
+    {
+        IndexBuilder builder(broken, 2, 8);
+        for (data::docid_t id = 0; id < 50; ++id) {
+            builder.add_document(DocumentOf(id));
+        }
+        EXPECT_ANY_THROW(builder.checkpoint("49"));
+        EXPECT_ANY_THROW(builder.finalize());
+    }
+
+    IndexBuilder resumed(broken, 2, 8);
+    EXPECT_FALSE(resumed.resume());
+}
+
+// Terms starting with a non-ASCII byte sort after the champion prefix, the dictionary needs them in term order
+TEST_F(IndexBuilderTest, NonAsciiTermsAndChampionLists) {
+    {
+        IndexBuilder builder(dir, 1);
+        builder.set_champion_lists(1, 2, 0.0);
+        test::AddDocuments(builder, 0, 8, {"search", "über", "élan", "engine"});
+        builder.finalize();
+    }
+
+    TermDictionary dict(dir);
+    ASSERT_TRUE(dict.is_loaded());
+    for (const std::string term : {"search", "über", "élan", "engine"}) {
+        const auto entry = dict.lookup(term);
+        ASSERT_TRUE(entry.has_value()) << term;
+        EXPECT_EQ(entry->postings_count, 8U) << term;
+
+        const auto champion = dict.lookup(champion_term(term));
+        ASSERT_TRUE(champion.has_value()) << term;
+        EXPECT_EQ(champion->postings_count, 2U) << term;
+    }
+
+    std::vector<std::string> terms;
+    dict.for_each_term([&](const TermDictionary::TermEntry& entry) { terms.push_back(entry.term); });
+    EXPECT_TRUE(std::is_sorted(terms.begin(), terms.end()));
+    EXPECT_EQ(terms.size(), dict.size());
+}
+
+// A term in more than one field gets an any-field list whose postings sum the term's frequency over the fields
+TEST_F(IndexBuilderTest, AnyFieldListSumsFieldFrequencies) {
+    {
+        IndexBuilder builder(dir, 1);
+        auto doc = test::MakeDocument(0, {"mithril", "search", "mithril"});
+        doc.title = {"mithril"};
+        builder.add_document(std::move(doc));
+        builder.add_document(test::MakeDocument(1, {"search"}));
+        builder.finalize();
+    }
+
+    const auto postings = ReadPostings(dir, any_field_term("mithril"));
+    ASSERT_EQ(postings.size(), 1U);
+    EXPECT_EQ(postings.front().id, 0U);
+    EXPECT_EQ(postings.front().frequency, 3U);
+
+    TermDictionary dict(dir);
+    EXPECT_TRUE(dict.has_any_field_entries());
+    PositionIndex positions(dir);
+    core::MemMapFile index_file(dir + "/final_index.data");
+    TermReader mithril(dir, any_field_term("mithril"), index_file, dict, positions);
+    ASSERT_TRUE(mithril.hasNext());
+    EXPECT_EQ(mithril.currentFieldMask(), FIELD_FLAG_BODY | FIELD_FLAG_TITLE);
+
+    // The any-field entry of a term of a single field is an alias of that field's list
+    const auto alias = dict.lookup(any_field_term("search"));
+    ASSERT_TRUE(alias.has_value());
+    EXPECT_EQ(alias->index_offset, dict.lookup("search")->index_offset);
+    TermReader search(dir, any_field_term("search"), index_file, dict, positions);
+    EXPECT_EQ(search.listTerm(), "search");
+    for (data::docid_t id : {0U, 1U}) {
+        ASSERT_TRUE(search.hasNext());
+        EXPECT_EQ(search.currentDocID(), id);
+        EXPECT_EQ(search.currentFrequency(), 1U);
+        EXPECT_EQ(search.currentFieldMask(), FIELD_FLAG_BODY);
+        search.moveNext();
+    }
+    EXPECT_FALSE(search.hasNext());
+}
@@ -0,0 +1,153 @@
+#include "PostingCodec.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+namespace {
+
+struct Block {
+    uint32_t base_doc_id;
+    std::vector<uint32_t> doc_ids;
+    std::vector<uint32_t> freqs;
+};
+
+// count postings after base_doc_id, each delta and frequency at most max_value
+Block RandomBlock(std::mt19937& rng, size_t count, uint32_t base_doc_id, uint32_t max_value) {
+    std::uniform_int_distribution<uint32_t> value(1, max_value);
+    Block block{base_doc_id, {}, {}};
+    uint32_t doc_id = base_doc_id;
+    for (size_t i = 0; i < count; ++i) {
+        doc_id += value(rng);
+        block.doc_ids.push_back(doc_id);
+        block.freqs.push_back(value(rng));
+    }
+    return block;
+}
+
+std::vector<DecodeKernel> Kernels() {
+    std::vector<DecodeKernel> kernels;
+    for (const auto kernel : {DecodeKernel::Scalar, DecodeKernel::SSE4, DecodeKernel::AVX2}) {
+        if (StreamVByte::kernel_supported(kernel)) {
+            kernels.push_back(kernel);
+        }
+    }
+    return kernels;
+}
+
+// Encodes the block into a buffer of exactly its size, so a kernel reading past the block trips ASan
+void ExpectRoundTrip(const Block& block) {
+    const size_t count = block.doc_ids.size();
+    for (const auto codec : {PostingCodec::VByte, PostingCodec::StreamVByte}) {
+        std::vector<char> encoded;
+        PostingBlockCodec::encode_block(
+            codec, block.doc_ids.data(), block.freqs.data(), count, block.base_doc_id, encoded);
+        const std::vector<char> exact(encoded.begin(), encoded.end());
+        const char* end = exact.data() + exact.size();
+
+        for (const auto kernel : Kernels()) {
+            std::vector<uint32_t> doc_ids(PostingBlockCodec::BLOCK_SIZE);
+            std::vector<uint32_t> freqs(PostingBlockCodec::BLOCK_SIZE);
+            const char* past = PostingBlockCodec::decode_block(
+                codec, exact.data(), end, count, block.base_doc_id, doc_ids.data(), freqs.data(), kernel);
+            doc_ids.resize(count);
+            freqs.resize(count);
+
+            EXPECT_EQ(past, end) << DecodeKernelName(kernel) << " count " << count;
+            EXPECT_EQ(doc_ids, block.doc_ids) << DecodeKernelName(kernel) << " count " << count;
+            EXPECT_EQ(freqs, block.freqs) << DecodeKernelName(kernel) << " count " << count;
+        }
+    }
+}
+
+}  // namespace
+
+TEST(PostingCodecTest, EmptyBlock) {
+    ExpectRoundTrip({0, {}, {}});
+    ExpectRoundTrip({1000, {}, {}});
+}
+
+TEST(PostingCodecTest, FullBlocks) {
+    std::mt19937 rng(2);
+    for (const uint32_t max_value : {1U, 200U, 60000U, 1U << 20}) {
+        for (int round = 0; round < 10; ++round) {
+            ExpectRoundTrip(RandomBlock(rng, PostingBlockCodec::BLOCK_SIZE, round * 1000, max_value));
+        }
+    }
+}
+
+// Counts that leave a partial group of four and fewer bytes than one 16 byte vector load
+TEST(PostingCodecTest, PartialBlocks) {
+    std::mt19937 rng(3);
+    for (size_t count = 1; count < PostingBlockCodec::BLOCK_SIZE; ++count) {
+        ExpectRoundTrip(RandomBlock(rng, count, static_cast<uint32_t>(count), 1U << (count % 25 + 1)));
+    }
+}
+
+// Deltas and frequencies that take all four StreamVByte bytes and five VByte bytes
+TEST(PostingCodecTest, MaxWidthValues) {
+    constexpr uint32_t max = std::numeric_limits<uint32_t>::max();
+    ExpectRoundTrip({0, {max}, {max}});
+
+    // Deltas of at least 2^24, a block of them stays below 2^32
+    std::mt19937 rng(4);
+    std::uniform_int_distribution<uint32_t> extra(0, 1U << 23);
+    for (const size_t count : {size_t{1}, size_t{5}, size_t{64}, PostingBlockCodec::BLOCK_SIZE}) {
+        Block block{0, {}, {}};
+        uint32_t doc_id = 0;
+        for (size_t i = 0; i < count; ++i) {
+            doc_id += (1U << 24) + extra(rng);
+            block.doc_ids.push_back(doc_id);
+            block.freqs.push_back(max - static_cast<uint32_t>(i));
+        }
+        ExpectRoundTrip(block);
+    }
+}
+
+// encode_postings splits a list into full blocks and a partial last block, each decodable from its sync point
+TEST(PostingCodecTest, PostingListBlocks) {
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<uint32_t> gap(1, 5000);
+    std::vector<Posting> postings(3 * PostingBlockCodec::BLOCK_SIZE + 17);
+    uint32_t doc_id = 0;
+    for (auto& posting : postings) {
+        doc_id += gap(rng);
+        posting.doc_id = doc_id;
+        posting.freq = gap(rng);
+    }
+
+    for (const auto codec : {PostingCodec::VByte, PostingCodec::StreamVByte}) {
+        std::vector<BlockSyncPoint> sync_points;
+        std::vector<char> encoded;
+        PostingBlockCodec::encode_postings(codec, postings, sync_points, encoded);
+        ASSERT_EQ(sync_points.size(), PostingBlockCodec::num_blocks(postings.size()));
+
+        for (const auto kernel : Kernels()) {
+            for (size_t block = 0; block < sync_points.size(); ++block) {
+                const size_t start = block * PostingBlockCodec::BLOCK_SIZE;
+                const size_t count = std::min(PostingBlockCodec::BLOCK_SIZE, postings.size() - start);
+                uint32_t doc_ids[PostingBlockCodec::BLOCK_SIZE];
+                uint32_t freqs[PostingBlockCodec::BLOCK_SIZE];
+                PostingBlockCodec::decode_block(codec,
+                                                encoded.data() + sync_points[block].byte_offset,
+                                                encoded.data() + encoded.size(),
+                                                count,
+                                                sync_points[block].base_doc_id,
+                                                doc_ids,
+                                                freqs,
+                                                kernel);
+                EXPECT_EQ(sync_points[block].last_doc_id, postings[start + count - 1].doc_id);
+                for (size_t i = 0; i < count; ++i) {
+                    ASSERT_EQ(doc_ids[i], postings[start + i].doc_id) << DecodeKernelName(kernel) << " block " << block;
+                    ASSERT_EQ(freqs[i], postings[start + i].freq) << DecodeKernelName(kernel) << " block " << block;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#include "PostingCodec.h"
+#include "PostingIntersect.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+namespace {
+
+// Sorted doc IDs without duplicates, each of [0, range) kept with probability density
+std::vector<uint32_t> RandomDocIDs(std::mt19937& rng, uint32_t range, double density) {
+    std::bernoulli_distribution keep(density);
+    std::vector<uint32_t> ids;
+    for (uint32_t id = 0; id < range; ++id) {
+        if (keep(rng)) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+std::vector<uint32_t> Expected(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    std::vector<uint32_t> out;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+    return out;
+}
+
+std::vector<uint32_t> Intersect(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, DecodeKernel kernel) {
+    std::vector<uint32_t> out(std::min(a.size(), b.size()));
+    out.resize(PostingIntersect::intersect(a.data(), a.size(), b.data(), b.size(), out.data(), kernel));
+    return out;
+}
+
+std::vector<uint32_t> IntersectGallop(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    std::vector<uint32_t> out(std::min(a.size(), b.size()));
+    out.resize(PostingIntersect::intersect_gallop(a.data(), a.size(), b.data(), b.size(), out.data()));
+    return out;
+}
+
+// The kernels this CPU can run, the vector ones fall back to scalar for what is left past their last full group
+std::vector<DecodeKernel> Kernels() {
+    std::vector<DecodeKernel> kernels;
+    for (const auto kernel : {DecodeKernel::Scalar, DecodeKernel::SSE4, DecodeKernel::AVX2}) {
+        if (StreamVByte::kernel_supported(kernel)) {
+            kernels.push_back(kernel);
+        }
+    }
+    return kernels;
+}
+
+void ExpectAllAgree(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    const auto expected = Expected(a, b);
+    for (const auto kernel : Kernels()) {
+        EXPECT_EQ(Intersect(a, b, kernel), expected) << DecodeKernelName(kernel);
+        EXPECT_EQ(Intersect(b, a, kernel), expected) << DecodeKernelName(kernel);
+    }
+    EXPECT_EQ(IntersectGallop(a, b), expected);
+    EXPECT_EQ(IntersectGallop(b, a), expected);
+}
+
+}  // namespace
+
+TEST(PostingIntersect, GallopFindsLowerBound) {
+    const std::vector<uint32_t> ids = {2, 3, 5, 8, 13, 21, 34, 55, 89, 144, 233};
+    for (uint32_t target = 0; target <= 240; ++target) {
+        for (size_t start = 0; start <= ids.size(); ++start) {
+            const uint32_t* found = PostingIntersect::gallop(ids.data() + start, ids.data() + ids.size(), target);
+            const auto expected = std::lower_bound(ids.begin() + static_cast<std::ptrdiff_t>(start), ids.end(), target);
+            EXPECT_EQ(found - ids.data(), expected - ids.begin()) << "target " << target << " start " << start;
+        }
+    }
+}
+
+TEST(PostingIntersect, EmptyInputs) {
+    const std::vector<uint32_t> empty;
+    const std::vector<uint32_t> ids = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    ExpectAllAgree(empty, empty);
+    ExpectAllAgree(empty, ids);
+}
+
+// Every length up to two groups of eight on each side, so the vector kernels leave every possible tail to scalar
+TEST(PostingIntersect, ShortTails) {
+    std::mt19937 rng(7);
+    for (size_t a_size = 0; a_size <= 17; ++a_size) {
+        for (size_t b_size = 0; b_size <= 17; ++b_size) {
+            for (int round = 0; round < 20; ++round) {
+                auto a = RandomDocIDs(rng, 48, 0.5);
+                auto b = RandomDocIDs(rng, 48, 0.5);
+                a.resize(std::min(a.size(), a_size));
+                b.resize(std::min(b.size(), b_size));
+                ExpectAllAgree(a, b);
+            }
+        }
+    }
+}
+
+TEST(PostingIntersect, IdenticalAndDisjoint) {
+    std::vector<uint32_t> evens;
+    std::vector<uint32_t> odds;
+    for (uint32_t id = 0; id < 1000; ++id) {
+        (id % 2 == 0 ? evens : odds).push_back(id);
+    }
+    ExpectAllAgree(evens, evens);
+    ExpectAllAgree(evens, odds);
+}
+
+TEST(PostingIntersect, RandomDensities) {
+    std::mt19937 rng(42);
+    for (const double a_density : {0.001, 0.05, 0.5, 0.95}) {
+        for (const double b_density : {0.001, 0.05, 0.5, 0.95}) {
+            ExpectAllAgree(RandomDocIDs(rng, 20000, a_density), RandomDocIDs(rng, 20000, b_density));
+        }
+    }
+}
+
+TEST(PostingIntersect, LargeDocIDs) {
+    std::mt19937 rng(3);
+    auto a = RandomDocIDs(rng, 5000, 0.3);
+    auto b = RandomDocIDs(rng, 5000, 0.3);
+    // Doc IDs near the top of the range, which a signed comparison would get wrong
+    for (auto* ids : {&a, &b}) {
+        for (auto& id : *ids) {
+            id += 0xFFFF0000U;
+        }
+    }
+    ExpectAllAgree(a, b);
+}
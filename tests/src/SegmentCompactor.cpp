@@ -0,0 +1,105 @@
+#include "DeletionBitmap.h"
+#include "DocumentMapReader.h"
+#include "InvertedIndex.h"
+#include "SegmentCompactor.h"
+#include "SegmentManifest.h"
+#include "TermDictionary.h"
+#include "TestIndex.h"
+#include "data/Document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+class SegmentCompactorTest : public test::IndexDirTest {
+protected:
+    // Builds count documents of words numbered from first_id into a new segment and publishes it, like
+    // mithril_indexer --segment
+    std::string AddSegment(data::docid_t first_id, size_t count, const std::vector<std::string>& words) {
+        std::filesystem::create_directories(dir);
+        std::string name;
+        {
+            SegmentManifest::Lock lock(dir);
+            auto manifest = SegmentManifest::loadOrCreate(dir);
+            name = manifest.allocateSegmentName();
+            manifest.save(dir);
+        }
+        {
+            IndexBuilder builder(dir + "/" + name, 1);
+            test::AddDocuments(builder, first_id, count, words);
+            builder.finalize();
+        }
+        SegmentManifest::Lock lock(dir);
+        auto manifest = SegmentManifest::loadOrCreate(dir);
+        manifest.segments.push_back(SegmentInfo{name, 0, count});
+        manifest.save(dir);
+        return name;
+    }
+
+    // Document count and body length, the layout IndexBuilder::save_index_stats() writes
+    static std::pair<uint32_t, uint64_t> ReadStats(const std::string& index_dir) {
+        uint32_t doc_count = 0;
+        uint64_t body_length = 0;
+        std::ifstream in(index_dir + "/index_stats.data", std::ios::binary);
+        in.read(reinterpret_cast<char*>(&doc_count), sizeof(doc_count));
+        in.read(reinterpret_cast<char*>(&body_length), sizeof(body_length));
+        return {doc_count, body_length};
+    }
+};
+
+// Two segments merge into one a level up, without the document deleted from the first
+TEST_F(SegmentCompactorTest, MergesSegmentsWithoutDeletedDocuments) {
+    const auto first = AddSegment(0, 40, {"alpha", "shared"});
+    const auto second = AddSegment(1000, 60, {"beta", "shared", "words"});
+    const std::vector<data::docid_t> deleted = {7};
+    ASSERT_EQ(DeletionBitmap::markDeleted(dir + "/" + first, deleted), 1U);
+
+    SegmentCompactor compactor(dir, 2);
+    ASSERT_TRUE(compactor.compactOnce());
+    EXPECT_FALSE(compactor.compactOnce());
+    EXPECT_FALSE(std::filesystem::exists(dir + "/" + first));
+    EXPECT_FALSE(std::filesystem::exists(dir + "/" + second));
+
+    const auto manifest = SegmentManifest::load(dir);
+    ASSERT_TRUE(manifest.has_value());
+    ASSERT_EQ(manifest->segments.size(), 1U);
+    const auto& merged = manifest->segments.front();
+    EXPECT_EQ(merged.level, 1U);
+    EXPECT_EQ(merged.doc_count, 99U);
+
+    const std::string merged_dir = dir + "/" + merged.name;
+    EXPECT_EQ(ReadStats(merged_dir), std::make_pair(uint32_t{99}, uint64_t{39 * 2 + 60 * 3}));
+    EXPECT_TRUE(DeletionBitmap(merged_dir).empty());
+
+    DocumentMapReader documents(merged_dir);
+    EXPECT_EQ(documents.documentCount(), 99U);
+    std::vector<data::docid_t> crawl_ids;
+    for (data::docid_t id = 0; id < 1060; ++id) {
+        if (id < 40 || id >= 1000) {
+            crawl_ids.push_back(id);
+        }
+    }
+    // The compactor builds in crawl order, so doc IDs are still the crawler's
+    for (const data::docid_t crawl_id : crawl_ids) {
+        const auto doc = documents.getDocument(crawl_id);
+        if (crawl_id == deleted.front()) {
+            EXPECT_FALSE(doc.has_value());
+            continue;
+        }
+        ASSERT_TRUE(doc.has_value()) << crawl_id;
+        EXPECT_EQ(doc->id, crawl_id);
+        EXPECT_EQ(doc->url, "https://example.com/" + std::to_string(crawl_id));
+    }
+
+    TermDictionary dict(merged_dir);
+    ASSERT_TRUE(dict.is_loaded());
+    EXPECT_EQ(dict.lookup("alpha")->postings_count, 39U);
+    EXPECT_EQ(dict.lookup("beta")->postings_count, 60U);
+    EXPECT_EQ(dict.lookup("shared")->postings_count, 99U);
+}
@@ -0,0 +1,210 @@
+#include "IndexStreamReader.h"
+#include "TermAND.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+namespace {
+
+// ISR over a sorted vector of doc IDs, exposing them in blocks of BLOCK_SIZE like a TermReader so TermAND takes
+// its block intersection path
+class VectorReader : public IndexStreamReader {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    explicit VectorReader(std::vector<data::docid_t> doc_ids) : doc_ids_(std::move(doc_ids)) {}
+
+    bool hasNext() const override { return pos_ < doc_ids_.size(); }
+    void moveNext() override { ++pos_; }
+    data::docid_t currentDocID() const override { return doc_ids_[pos_]; }
+    void seekToDocID(data::docid_t target) override {
+        pos_ = std::lower_bound(doc_ids_.begin() + static_cast<std::ptrdiff_t>(pos_), doc_ids_.end(), target) -
+               doc_ids_.begin();
+    }
+    size_t bufferedDocIDs(const data::docid_t*& doc_ids) const override {
+        if (!hasNext()) {
+            return 0;
+        }
+        doc_ids = doc_ids_.data() + pos_;
+        return std::min(doc_ids_.size(), (pos_ / BLOCK_SIZE + 1) * BLOCK_SIZE) - pos_;
+    }
+    size_t estimatedDocCount() const override { return doc_ids_.size(); }
+
+private:
+    std::vector<data::docid_t> doc_ids_;
+    size_t pos_{0};
+};
+
+// Sorted doc IDs without duplicates, each of [0, range) kept with probability density
+std::vector<data::docid_t> RandomDocIDs(std::mt19937& rng, data::docid_t range, double density) {
+    std::bernoulli_distribution keep(density);
+    std::vector<data::docid_t> ids;
+    for (data::docid_t id = 0; id < range; ++id) {
+        if (keep(rng)) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+std::vector<data::docid_t> Intersect(const std::vector<std::vector<data::docid_t>>& lists) {
+    std::vector<data::docid_t> out = lists[0];
+    for (size_t i = 1; i < lists.size(); ++i) {
+        std::vector<data::docid_t> next;
+        std::set_intersection(out.begin(), out.end(), lists[i].begin(), lists[i].end(), std::back_inserter(next));
+        out = std::move(next);
+    }
+    return out;
+}
+
+std::vector<data::docid_t> Collect(IndexStreamReader& isr) {
+    std::vector<data::docid_t> docs;
+    for (; isr.hasNext(); isr.moveNext()) {
+        docs.push_back(isr.currentDocID());
+    }
+    return docs;
+}
+
+// AND(AND(...AND(lists[0], lists[1])...), lists[n - 1]), the shape AndQuery::generate_isr builds
+std::unique_ptr<IndexStreamReader> MakeNestedAND(const std::vector<std::vector<data::docid_t>>& lists) {
+    std::unique_ptr<IndexStreamReader> isr = std::make_unique<VectorReader>(lists[0]);
+    for (size_t i = 1; i < lists.size(); ++i) {
+        std::vector<std::unique_ptr<IndexStreamReader>> readers;
+        readers.push_back(std::move(isr));
+        readers.push_back(std::make_unique<VectorReader>(lists[i]));
+        isr = std::make_unique<TermAND>(std::move(readers));
+    }
+    return isr;
+}
+
+}  // namespace
+
+TEST(TermANDTest, EmptyReaders) {
+    TermAND isr({});
+    EXPECT_FALSE(isr.hasNext());
+    EXPECT_EQ(isr.currentDocID(), std::numeric_limits<data::docid_t>::max());
+}
+
+TEST(TermANDTest, FlatAND) {
+    std::mt19937 rng(3);
+    for (int round = 0; round < 50; ++round) {
+        std::vector<std::vector<data::docid_t>> lists;
+        std::vector<std::unique_ptr<IndexStreamReader>> readers;
+        for (size_t i = 0; i < 2 + rng() % 3; ++i) {
+            lists.push_back(RandomDocIDs(rng, 20000, 0.05 + 0.9 * (rng() % 100) / 100.0));
+            readers.push_back(std::make_unique<VectorReader>(lists.back()));
+        }
+        TermAND isr(std::move(readers));
+        EXPECT_EQ(Collect(isr), Intersect(lists));
+    }
+}
+
+TEST(TermANDTest, NestedAND) {
+    std::mt19937 rng(7);
+    for (int round = 0; round < 50; ++round) {
+        std::vector<std::vector<data::docid_t>> lists;
+        for (size_t i = 0; i < 3 + rng() % 3; ++i) {
+            lists.push_back(RandomDocIDs(rng, 20000, 0.2 + 0.7 * (rng() % 100) / 100.0));
+        }
+        auto isr = MakeNestedAND(lists);
+        EXPECT_EQ(Collect(*isr), Intersect(lists));
+    }
+}
+
+// Readers are ordered rarest first on estimatedDocCount(), ties and readers without an estimate keep their order
+TEST(TermANDTest, OrdersReadersByEstimate) {
+    class UnknownCountReader : public VectorReader {
+    public:
+        using VectorReader::VectorReader;
+        size_t estimatedDocCount() const override { return std::numeric_limits<size_t>::max(); }
+    };
+
+    std::vector<data::docid_t> all(1000);
+    for (data::docid_t id = 0; id < all.size(); ++id) {
+        all[id] = id;
+    }
+    const std::vector<data::docid_t> rare = {7, 500, 999};
+    const std::vector<data::docid_t> tied = {7, 8, 500};
+
+    std::vector<std::unique_ptr<IndexStreamReader>> readers;
+    readers.push_back(std::make_unique<UnknownCountReader>(all));
+    readers.push_back(std::make_unique<VectorReader>(all));
+    readers.push_back(std::make_unique<VectorReader>(tied));
+    readers.push_back(std::make_unique<VectorReader>(rare));
+    std::vector<IndexStreamReader*> original;
+    for (const auto& reader : readers) {
+        original.push_back(reader.get());
+    }
+
+    TermAND isr(std::move(readers));
+    ASSERT_EQ(isr.numReaders(), 4U);
+    EXPECT_EQ(isr.get(0), original[2]);
+    EXPECT_EQ(isr.get(1), original[3]);
+    EXPECT_EQ(isr.get(2), original[1]);
+    EXPECT_EQ(isr.get(3), original[0]);
+    EXPECT_EQ(isr.estimatedDocCount(), 3U);
+    EXPECT_EQ(Collect(isr), (std::vector<data::docid_t>{7, 500}));
+}
+
+// A seek to the current match or before it leaves the AND where it is
+TEST(TermANDTest, SeekToCurrentAndEarlierDoc) {
+    std::mt19937 rng(13);
+    const std::vector<std::vector<data::docid_t>> lists = {
+        RandomDocIDs(rng, 5000, 0.6), RandomDocIDs(rng, 5000, 0.6), RandomDocIDs(rng, 5000, 0.6)};
+    const auto expected = Intersect(lists);
+    ASSERT_GT(expected.size(), 10U);
+
+    auto isr = MakeNestedAND(lists);
+    for (size_t i = 0; i < 10; ++i) {
+        isr->moveNext();
+    }
+    ASSERT_EQ(isr->currentDocID(), expected[10]);
+    isr->seekToDocID(expected[10]);
+    EXPECT_EQ(isr->currentDocID(), expected[10]);
+    isr->seekToDocID(expected[2]);
+    EXPECT_EQ(isr->currentDocID(), expected[10]);
+    isr->seekToDocID(0);
+    EXPECT_EQ(isr->currentDocID(), expected[10]);
+    isr->moveNext();
+    EXPECT_EQ(isr->currentDocID(), expected[11]);
+}
+
+TEST(TermANDTest, RandomSeeks) {
+    std::mt19937 rng(17);
+    for (int round = 0; round < 50; ++round) {
+        std::vector<std::vector<data::docid_t>> lists;
+        for (size_t i = 0; i < 3; ++i) {
+            lists.push_back(RandomDocIDs(rng, 20000, 0.3 + 0.6 * (rng() % 100) / 100.0));
+        }
+        const auto expected = Intersect(lists);
+        auto isr = MakeNestedAND(lists);
+        auto next = expected.begin();
+        while (isr->hasNext()) {
+            ASSERT_EQ(isr->currentDocID(), *next);
+            if (rng() % 4 != 0) {
+                isr->moveNext();
+                ++next;
+                continue;
+            }
+            // Seeks up to a few blocks ahead, sometimes to the current document
+            const data::docid_t target = isr->currentDocID() + rng() % 600;
+            isr->seekToDocID(target);
+            next = std::lower_bound(next, expected.end(), target);
+            if (next == expected.end()) {
+                EXPECT_FALSE(isr->hasNext()) << "seek to " << target;
+                break;
+            }
+            ASSERT_TRUE(isr->hasNext()) << "seek to " << target;
+        }
+        EXPECT_TRUE(next == expected.end());
+    }
+}
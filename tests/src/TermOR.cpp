@@ -0,0 +1,180 @@
+#include "IndexStreamReader.h"
+#include "TermOR.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+namespace {
+
+// ISR over a sorted vector of doc IDs
+class VectorReader : public IndexStreamReader {
+public:
+    explicit VectorReader(std::vector<data::docid_t> doc_ids) : doc_ids_(std::move(doc_ids)) {}
+
+    bool hasNext() const override { return pos_ < doc_ids_.size(); }
+    void moveNext() override { ++pos_; }
+    data::docid_t currentDocID() const override { return doc_ids_[pos_]; }
+    void seekToDocID(data::docid_t target) override {
+        pos_ = std::lower_bound(doc_ids_.begin() + static_cast<std::ptrdiff_t>(pos_), doc_ids_.end(), target) -
+               doc_ids_.begin();
+    }
+
+private:
+    std::vector<data::docid_t> doc_ids_;
+    size_t pos_{0};
+};
+
+class TermORTest : public ::testing::Test {
+protected:
+    std::vector<std::vector<data::docid_t>> lists;
+
+    std::unique_ptr<TermOR> MakeOR() const {
+        std::vector<std::unique_ptr<IndexStreamReader>> readers;
+        for (const auto& list : lists) {
+            readers.push_back(std::make_unique<VectorReader>(list));
+        }
+        return std::make_unique<TermOR>(std::move(readers));
+    }
+
+    std::vector<data::docid_t> Union() const {
+        std::set<data::docid_t> docs;
+        for (const auto& list : lists) {
+            docs.insert(list.begin(), list.end());
+        }
+        return {docs.begin(), docs.end()};
+    }
+
+    static std::vector<data::docid_t> Collect(IndexStreamReader& isr) {
+        std::vector<data::docid_t> docs;
+        for (; isr.hasNext(); isr.moveNext()) {
+            docs.push_back(isr.currentDocID());
+        }
+        return docs;
+    }
+
+    // Adds the ids in [begin, end) whose offset from begin is a multiple of step to list
+    void AddRange(size_t list, data::docid_t begin, data::docid_t end, data::docid_t step) {
+        lists.resize(std::max(lists.size(), list + 1));
+        for (data::docid_t id = begin; id < end; id += step) {
+            lists[list].push_back(id);
+        }
+    }
+};
+
+}  // namespace
+
+TEST_F(TermORTest, EmptyReaders) {
+    lists = {{}, {}};
+    auto isr = MakeOR();
+    EXPECT_FALSE(isr->hasNext());
+    EXPECT_EQ(isr->currentDocID(), std::numeric_limits<data::docid_t>::max());
+}
+
+TEST_F(TermORTest, SparseUnionStaysOnHeap) {
+    AddRange(0, 0, 100000, 997);
+    AddRange(1, 5, 100000, 1009);
+    AddRange(2, 0, 100000, 997 * 3);
+    auto isr = MakeOR();
+    EXPECT_EQ(Collect(*isr), Union());
+}
+
+// Three windows with a match at every doc ID switch to dense mode, the sparse stretch after them has fewer
+// matches than a window needs and goes back to the heap, the dense stretch at the end switches again
+TEST_F(TermORTest, EntersAndLeavesDenseMode) {
+    constexpr data::docid_t window = TermOR::WINDOW_SIZE;
+    AddRange(0, 0, 3 * window, 2);
+    AddRange(1, 1, 3 * window, 2);
+    AddRange(0, 3 * window, 10 * window, 500);
+    AddRange(1, 10 * window + 3, 14 * window, 1);
+    AddRange(2, 10 * window, 14 * window, 3);
+    auto isr = MakeOR();
+    EXPECT_EQ(Collect(*isr), Union());
+}
+
+TEST_F(TermORTest, NestedUnion) {
+    AddRange(0, 0, 20000, 3);
+    AddRange(1, 1, 20000, 5);
+    AddRange(2, 2, 20000, 7);
+    std::vector<std::unique_ptr<IndexStreamReader>> inner;
+    inner.push_back(std::make_unique<VectorReader>(lists[0]));
+    inner.push_back(std::make_unique<VectorReader>(lists[1]));
+    std::vector<std::unique_ptr<IndexStreamReader>> outer;
+    outer.push_back(std::make_unique<TermOR>(std::move(inner)));
+    outer.push_back(std::make_unique<VectorReader>(lists[2]));
+    TermOR isr(std::move(outer));
+    EXPECT_EQ(Collect(isr), Union());
+}
+
+// Seeks land a little ahead, on the last doc ID of a WINDOW_SIZE aligned range, just past it, and several windows
+// ahead. They are interleaved with runs of moveNext, so they start from dense mode as well as from the heap.
+TEST_F(TermORTest, SeeksAcrossWindows) {
+    constexpr data::docid_t window = TermOR::WINDOW_SIZE;
+    AddRange(0, 0, 8 * window, 2);
+    AddRange(1, 1, 8 * window, 2);
+    AddRange(0, 8 * window, 12 * window, 701);
+    AddRange(1, 12 * window, 20 * window, 1);
+    AddRange(2, 12 * window + 1, 20 * window, 4);
+    const auto expected = Union();
+
+    std::mt19937 rng(11);
+    for (int round = 0; round < 50; ++round) {
+        auto isr = MakeOR();
+        data::docid_t target = 0;
+        auto next = expected.begin();
+        while (isr->hasNext()) {
+            // Mostly moveNext, so dense mode gets a run of matches to switch on
+            const uint32_t action = rng() % 64;
+            if (action < 56) {
+                ASSERT_EQ(isr->currentDocID(), *next);
+                isr->moveNext();
+                ++next;
+                continue;
+            }
+            const data::docid_t current = isr->currentDocID();
+            const data::docid_t base = current - current % window;
+            switch (action % 4) {
+            case 0:
+                target = current + 1 + rng() % 64;
+                break;
+            case 1:
+                target = base + window - 1;
+                break;
+            case 2:
+                target = base + window;
+                break;
+            default:
+                target = current + window * (1 + rng() % 4);
+                break;
+            }
+            isr->seekToDocID(target);
+            next = std::lower_bound(next, expected.end(), target);
+            if (next == expected.end()) {
+                EXPECT_FALSE(isr->hasNext()) << "seek to " << target;
+                break;
+            }
+            ASSERT_TRUE(isr->hasNext()) << "seek to " << target;
+            ASSERT_EQ(isr->currentDocID(), *next) << "seek to " << target;
+        }
+        EXPECT_TRUE(next == expected.end());
+    }
+}
+
+TEST_F(TermORTest, SeekBackwardsIsIgnored) {
+    AddRange(0, 0, 3 * TermOR::WINDOW_SIZE, 1);
+    AddRange(1, 0, 3 * TermOR::WINDOW_SIZE, 2);
+    auto isr = MakeOR();
+    isr->seekToDocID(2 * TermOR::WINDOW_SIZE + 5);
+    ASSERT_TRUE(isr->hasNext());
+    EXPECT_EQ(isr->currentDocID(), 2 * TermOR::WINDOW_SIZE + 5);
+    isr->seekToDocID(10);
+    EXPECT_EQ(isr->currentDocID(), 2 * TermOR::WINDOW_SIZE + 5);
+}
@@ -0,0 +1,212 @@
+#include "IndexStreamReader.h"
+#include "InvertedIndex.h"
+#include "PositionIndex.h"
+#include "PostingCodec.h"
+#include "TermAND.h"
+#include "TermDictionary.h"
+#include "TermPhrase.h"
+#include "TermQuote.h"
+#include "TermReader.h"
+#include "TestIndex.h"
+#include "core/mem_map_file.h"
+#include "data/Document.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace mithril;
+
+namespace {
+
+constexpr data::docid_t DOC_COUNT = 700;
+constexpr data::docid_t BLOCK = PostingBlockCodec::BLOCK_SIZE;
+
+// How "mithril search engine" appears in a document
+enum class Kind {
+    Quote,     // In order and adjacent, matches both
+    Spread,    // In order within a phrase's span, matches a phrase only
+    Reversed,  // Matches neither
+    Partial,   // Without mithril
+};
+
+bool AtBlockBoundary(data::docid_t id) {
+    return id % BLOCK == 0 || id % BLOCK == BLOCK - 1;
+}
+
+// The documents on either side of each posting block boundary hold the quote. search is in every document, so
+// its blocks end there while mithril's do not.
+Kind KindOf(data::docid_t id) {
+    return AtBlockBoundary(id) ? Kind::Quote : static_cast<Kind>(id % 4);
+}
+
+bool HasCrawler(data::docid_t id) {
+    return id % 3 != 2 || AtBlockBoundary(id);
+}
+
+std::vector<std::string> PatternOf(Kind kind) {
+    switch (kind) {
+    case Kind::Quote:
+        return {"mithril", "search", "engine"};
+    case Kind::Spread:
+        return {"mithril", "filler", "search", "filler", "engine"};
+    case Kind::Reversed:
+        return {"engine", "search", "mithril"};
+    case Kind::Partial:
+        break;
+    }
+    return {"search", "engine"};
+}
+
+// Body terms keep their positions when they occur more than twice and make up at most an eighth of the document.
+// The pattern is repeated three times, far enough apart that no phrase spans two of them.
+data::Document DocumentOf(data::docid_t id) {
+    std::vector<std::string> words(id % 5, "lead");
+    for (int repeat = 0; repeat < 3; ++repeat) {
+        for (auto& word : PatternOf(KindOf(id))) {
+            words.push_back(std::move(word));
+        }
+        for (int i = 0; i < 8; ++i) {
+            words.push_back("gap" + std::to_string(repeat * 8 + i));
+        }
+    }
+    if (HasCrawler(id)) {
+        words.push_back("crawler");
+    }
+    return test::MakeDocument(id, std::move(words));
+}
+
+template<typename Reader>
+bool Matches(data::docid_t id) {
+    const Kind kind = KindOf(id);
+    return HasCrawler(id) && (kind == Kind::Quote || (std::is_same_v<Reader, TermPhrase> && kind == Kind::Spread));
+}
+
+template<typename Reader>
+class PositionReaderTest : public test::IndexDirTest {
+protected:
+    const std::vector<std::string> quote{"mithril", "search", "engine"};
+    std::unique_ptr<core::MemMapFile> index_file;
+    std::unique_ptr<TermDictionary> dict;
+    std::unique_ptr<PositionIndex> positions;
+    std::vector<data::docid_t> expected;
+
+    void SetUp() override {
+        test::IndexDirTest::SetUp();
+        {
+            IndexBuilder builder(dir, 1);
+            for (data::docid_t id = 0; id < DOC_COUNT; ++id) {
+                builder.add_document(DocumentOf(id));
+            }
+            builder.finalize();
+        }
+        index_file = std::make_unique<core::MemMapFile>(dir + "/final_index.data");
+        dict = std::make_unique<TermDictionary>(dir);
+        positions = std::make_unique<PositionIndex>(dir);
+        for (data::docid_t id = 0; id < DOC_COUNT; ++id) {
+            if (Matches<Reader>(id)) {
+                expected.push_back(id);
+            }
+        }
+    }
+
+    // crawler AND the quote or phrase
+    std::unique_ptr<IndexStreamReader> MakeAND() {
+        std::vector<std::unique_ptr<IndexStreamReader>> readers;
+        readers.push_back(std::make_unique<Reader>(dir, quote, *index_file, *dict, *positions));
+        readers.push_back(std::make_unique<TermReader>(dir, "crawler", *index_file, *dict, *positions));
+        return std::make_unique<TermAND>(std::move(readers));
+    }
+
+    // First expected match at or after target, the document the reader must be on after seeking to it
+    data::docid_t ExpectedFrom(data::docid_t target) const {
+        const auto it = std::lower_bound(expected.begin(), expected.end(), target);
+        return it == expected.end() ? DOC_COUNT : *it;
+    }
+};
+
+using Readers = ::testing::Types<TermQuote, TermPhrase>;
+TYPED_TEST_SUITE(PositionReaderTest, Readers);
+
+}  // namespace
+
+TYPED_TEST(PositionReaderTest, IteratesInsideAND) {
+    std::vector<data::docid_t> actual;
+    for (auto reader = this->MakeAND(); reader->hasNext(); reader->moveNext()) {
+        actual.push_back(reader->currentDocID());
+    }
+    EXPECT_EQ(actual, this->expected);
+}
+
+TYPED_TEST(PositionReaderTest, SeeksForwardInsideAND) {
+    std::mt19937 rng(7);
+    for (int round = 0; round < 20; ++round) {
+        auto reader = this->MakeAND();
+        data::docid_t target = 0;
+        while (reader->hasNext()) {
+            target += std::uniform_int_distribution<data::docid_t>(1, 40)(rng);
+            reader->seekToDocID(target);
+            const data::docid_t expected = this->ExpectedFrom(target);
+            if (expected == DOC_COUNT) {
+                EXPECT_FALSE(reader->hasNext()) << target;
+                break;
+            }
+            ASSERT_TRUE(reader->hasNext()) << target;
+            ASSERT_EQ(reader->currentDocID(), expected) << target;
+            target = expected;
+        }
+    }
+}
+
+TYPED_TEST(PositionReaderTest, SeekToCurrentOrEarlierDocStays) {
+    auto reader = this->MakeAND();
+    reader->seekToDocID(300);
+    const data::docid_t current = this->ExpectedFrom(300);
+    ASSERT_TRUE(reader->hasNext());
+    ASSERT_EQ(reader->currentDocID(), current);
+
+    reader->seekToDocID(current);
+    ASSERT_TRUE(reader->hasNext());
+    EXPECT_EQ(reader->currentDocID(), current);
+    reader->seekToDocID(10);
+    ASSERT_TRUE(reader->hasNext());
+    EXPECT_EQ(reader->currentDocID(), current);
+
+    reader->moveNext();
+    ASSERT_TRUE(reader->hasNext());
+    EXPECT_EQ(reader->currentDocID(), this->ExpectedFrom(current + 1));
+}
+
+// Seeks land on the documents at each end of a posting block, where the readers of the terms are in different
+// blocks of their lists
+TYPED_TEST(PositionReaderTest, MatchesAcrossBlockBoundaries) {
+    for (data::docid_t boundary = BLOCK; boundary < DOC_COUNT; boundary += BLOCK) {
+        for (const data::docid_t target : {boundary - 2, boundary - 1, boundary}) {
+            auto reader = this->MakeAND();
+            reader->seekToDocID(target);
+            ASSERT_TRUE(reader->hasNext()) << target;
+            EXPECT_EQ(reader->currentDocID(), this->ExpectedFrom(target)) << target;
+        }
+
+        // Walking over the boundary decodes the next block of search mid-iteration
+        auto reader = this->MakeAND();
+        reader->seekToDocID(boundary - 2);
+        std::vector<data::docid_t> actual;
+        for (; reader->hasNext() && reader->currentDocID() <= boundary + 1; reader->moveNext()) {
+            actual.push_back(reader->currentDocID());
+        }
+        std::vector<data::docid_t> expected;
+        for (data::docid_t id = boundary - 2; id <= boundary + 1; ++id) {
+            if (Matches<TypeParam>(id)) {
+                expected.push_back(id);
+            }
+        }
+        EXPECT_EQ(actual, expected) << boundary;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef TESTS_TESTINDEX_H
+#define TESTS_TESTINDEX_H
+
+#include "InvertedIndex.h"
+#include "data/Document.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace mithril::test {
+
+// Gives each test an empty directory named after it, removed once the test is done
+class IndexDirTest : public ::testing::Test {
+protected:
+    std::string dir;
+
+    void SetUp() override {
+        const auto* test = ::testing::UnitTest::GetInstance()->current_test_info();
+        dir = (std::filesystem::temp_directory_path() /
+               (std::string("mithril_") + test->test_suite_name() + "_" + test->name()))
+                  .string();
+        std::filesystem::remove_all(dir);
+    }
+
+    void TearDown() override { std::filesystem::remove_all(dir); }
+};
+
+// Document id at https://example.com/<id> holding words
+inline data::Document MakeDocument(data::docid_t id, std::vector<std::string> words) {
+    data::Document doc;
+    doc.id = id;
+    doc.url = "https://example.com/" + std::to_string(id);
+    doc.words = std::move(words);
+    return doc;
+}
+
+// Queues count documents of the same words, numbered from first_id
+inline void AddDocuments(IndexBuilder& builder,
+                         data::docid_t first_id,
+                         size_t count,
+                         const std::vector<std::string>& words) {
+    for (size_t i = 0; i < count; ++i) {
+        builder.add_document(MakeDocument(static_cast<data::docid_t>(first_id + i), words));
+    }
+}
+
+}  // namespace mithril::test
+
+#endif  // TESTS_TESTINDEX_H
@@ -414,7 +414,9 @@ document.addEventListener('DOMContentLoaded', function() {
         const searchTime = ((data._frontend_time_ms || 0) / 1000).toFixed(3);
         const formatter = new Intl.NumberFormat('en-US');
 
-        resultsCount.textContent = `${formatter.format(resultCount)} results`;
+        // A total the engine stopped counting is a lower bound
+        const totalSuffix = data.total_exact === false ? '+' : '';
+        resultsCount.textContent = `${formatter.format(resultCount)}${totalSuffix} results`;
         queryTime.textContent = `${searchTime}s${fromCache ? ' (cached)' : ''}`;
         resultsMeta.style.display = 'flex';
 
@@ -372,7 +372,8 @@ std::string SearchPlugin::ExecuteQuery(const std::string& query_text, int max_re
 
             auto results = query_manager_->AnswerQuery(query_text);
 
-            json = GenerateJsonResults(results, query_manager_->curr_result_ct_, false, temp);
+            json = GenerateJsonResults(
+                results, query_manager_->curr_result_ct_, false, temp, query_manager_->curr_result_ct_exact_);
             return json;
         }
 
@@ -479,7 +480,8 @@ std::string SearchPlugin::GenerateJsonResults(const std::vector<std::pair<uint32
 std::string SearchPlugin::GenerateJsonResults(const QueryResults& results,
                                               size_t num_results,
                                               bool demo_mode,
-                                              const std::string& error) {
+                                              const std::string& error,
+                                              bool total_exact) {
     std::string json;
     json.reserve(1024 + results.size() * 256);
 
@@ -513,6 +515,8 @@ std::string SearchPlugin::GenerateJsonResults(const QueryResults& results,
 
     json += "],\"total\":" + std::to_string(num_results);
     json += ",\"time_ms\":0";
+    if (!total_exact)
+        json += ",\"total_exact\":false";
 
     if (demo_mode)
         json += ",\"demo_mode\":true";
@@ -66,8 +66,12 @@ private:
                                     bool demo_mode,
                                     const std::string& error = "");
 
-    std::string
-    GenerateJsonResults(const QueryResults& doc_ids, size_t num_results, bool demo_mode, const std::string& error);
+    // total_exact is false when num_results is only a lower bound of the matches
+    std::string GenerateJsonResults(const QueryResults& doc_ids,
+                                    size_t num_results,
+                                    bool demo_mode,
+                                    const std::string& error,
+                                    bool total_exact = true);
     bool TryInitializeCoordinator();
     void CleanExpiredCache();
 